@@ -6,8 +6,8 @@
 
 int process_awb_file(const char* filename);
 int process_uasset_file(const char* filename);
+// Optional human readable export of the header index
 int write_header_csv(const char* filename, HCAHeader* headers, int count);
-int read_header_csv(const char* filename, HCAHeader** headers, int* count);
 
 typedef HCAHeader UAssetHeader;
 
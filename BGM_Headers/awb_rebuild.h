@@ -0,0 +1,95 @@
+#ifndef AWB_REBUILD_H
+#define AWB_REBUILD_H
+
+#include "bgm_data.h"
+#include "hca_encoder.h"
+
+// Entries start on this boundary after a replaced track, like the game's AWBs
+#define AWB_ENTRY_ALIGNMENT 32
+// Encoded frames buffered per WAV that is streamed into an AWB
+#define STREAM_RING_SIZE (8 * 1024 * 1024)
+
+// Key and loop used for WAVs, from the command line
+extern HcaEncodeOptions encode_options;
+
+typedef struct {
+	int entry;              // Position of the replaced track in the headers array
+	const char* hca_path;   // File that takes its place
+	bool from_wav;          // hca_path is a WAV, encoded while it is written
+	uint16_t frame_size;    // For WAVs, 0 keeps the default bitrate
+	long size;              // Size of the HCA
+} AwbReplacement;
+
+/**
+ * @brief Looks for the loops of WAVs queued for injection, on all cores
+ *
+ * Only when a loop is asked for without a range. The encoders of these WAVs
+ * take the loops from here instead of each reading the whole WAV to find
+ * it, a WAV that wasn't searched is searched by its encoder.
+ */
+void find_wav_loops(const char** wav_paths, int count);
+
+// Releases the loops kept by find_wav_loops
+void free_found_loops(void);
+
+/**
+ * @brief Encodes the start of a WAV, for the uasset's copy of each track
+ *
+ * Only the frames that make up the first HCA_MAX_SIZE bytes are encoded, the
+ * encoder gives the same bytes when the whole WAV is streamed later.
+ *
+ * @param frame_size Bytes per HCA frame, 0 for the default bitrate
+ * @param hca_size Receives the size of the whole HCA
+ * @return false if the WAV can't be encoded
+ */
+bool encode_wav_prefix(const char* wav_path, uint16_t frame_size,
+                       uint8_t prefix[HCA_MAX_SIZE], long* hca_size);
+
+/**
+ * @brief Applies every replacement to an AWB in a single sequential pass
+ *
+ * The new layout is computed up front, then the AWB is streamed into
+ * output_path: untouched tracks are copied as they are, replaced ones are
+ * written from their HCA file (or encoded from their WAV, a few tracks ahead
+ * of the writer) and padded to AWB_ENTRY_ALIGNMENT (except the
+ * last track). The AWB's own AFS2 offset table is updated to the new layout.
+ * The AWB itself is never written, swapping the output in is up to the caller.
+ *
+ * @param headers Tracks of the AWB in file order, offsets are updated in place
+ * @param file_end_offset Receives the size of the rebuilt AWB
+ * @return true on success, output_path is removed on failure
+ */
+bool rebuild_awb(const char* awb_path, const char* output_path,
+                 HCAHeader* headers, int header_count,
+                 const AwbReplacement* replacements, int replacement_count,
+                 long* file_end_offset);
+
+/**
+ * @brief Checks that every replacement fits into the slot of the track it
+ * replaces (up to the next track), without writing anything
+ *
+ * WAVs are given the largest frame size that fits their slot, their
+ * frame_size and size are updated. Prints one line for each HCA that is too
+ * large.
+ *
+ * @param fits Receives for each replacement whether it can be written
+ * @return Number of replacements that don't fit, -1 if a size is unreadable
+ */
+int check_awb_slots(const char* awb_path, const HCAHeader* headers,
+                    int header_count, AwbReplacement* replacements,
+                    int replacement_count, bool* fits);
+
+/**
+ * @brief Writes each replacement over the track it replaces, in place
+ *
+ * The HCA is copied or encoded straight into its slot and the rest of the slot is
+ * zeroed, no track moves and memory use doesn't depend on the track sizes.
+ * Every replacement must have passed check_awb_slots.
+ *
+ * @return true on success
+ */
+bool write_awb_slots(const char* awb_path, const HCAHeader* headers,
+                     int header_count, const AwbReplacement* replacements,
+                     int replacement_count);
+
+#endif // AWB_REBUILD_H
@@ -35,6 +35,9 @@ typedef struct {
     char hca_path[MAX_PATH];
     char target_file[MAX_PATH];
     int index;
+    bool from_wav;    // hca_path is a WAV, encoded while it is written
+    uint16_t frame_size; // Bytes per frame the WAV is encoded with, 0 = default
+    long hca_size;
     uint8_t new_header[HCA_MAX_SIZE];
 } InjectionInfo;
 
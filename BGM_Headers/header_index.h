@@ -0,0 +1,54 @@
+#ifndef HEADER_INDEX_H
+#define HEADER_INDEX_H
+
+#include "bgm_data.h"
+
+#define HEADER_INDEX_MAGIC "HIDX"
+#define HEADER_INDEX_VERSION 1
+
+// On-disk layout, written as-is. Records follow the file header directly
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t record_size;   // sizeof(HeaderIndexRecord)
+	uint32_t count;
+	uint64_t source_size;   // Size of the AWB/uasset the records describe
+	int64_t source_mtime;   // Its modification time
+	uint32_t checksum;      // FNV-1a of the records
+	uint32_t reserved;
+} HeaderIndexFileHeader;
+
+typedef struct {
+	int32_t index;
+	uint32_t reserved;
+	uint64_t offset;
+	uint8_t header[HCA_HEADER_SIZE];
+} HeaderIndexRecord;
+
+extern int export_csv;
+
+/**
+ * @brief Stores the headers of source_path in <name>.idx
+ *
+ * The index lives in the program directory like the old CSV files. An
+ * existing index with the same number of records is overwritten in place.
+ * <name>.csv is written as well when --csv was given.
+ *
+ * @return 0 on success, -1 on failure
+ */
+int save_header_index(const char* name, const char* source_path,
+                      const HCAHeader* headers, int count);
+
+/**
+ * @brief Loads <name>.idx with a single mapping of the file
+ *
+ * Fails if the index is missing, corrupted, from another version or if
+ * source_path changed size or modification time since it was written.
+ *
+ * @param headers Receives a malloc'd array
+ * @return 0 on success, -1 on failure
+ */
+int load_header_index(const char* name, const char* source_path,
+                      HCAHeader** headers, int* count);
+
+#endif // HEADER_INDEX_H
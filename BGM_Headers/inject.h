@@ -4,10 +4,14 @@
 #include "bgm_data.h"
 #include <unistd.h>
 #define BUFFER_SIZE 8192
+// Lists the working copies of an injection in progress, see file_transaction.h
+#define INJECTION_JOURNAL "bgm_injection.journal"
 
 extern int fixed_size;
 bool inject_hca(const char* uasset_path, InjectionInfo* injections, int injection_count);
 bool create_backup(const char* filename);
+// Releases the AWB headers cached by inject_hca
+void free_header_cache(void);
 bool find_and_replace_header(FILE* file, const uint8_t* old_header, const uint8_t* new_header);
 long find_next_header_offset(FILE* file, long current_offset);
 bool replace_header_at_offset(FILE* file, long offset, long next_offset,
@@ -6,13 +6,36 @@
 #include <string.h>
 #include <stdbool.h>
 #include "awb.h"
+#include "afs2.h"
 
-bool update_offset_range(const char* awb_path, const char* uasset_path,
-                         const HCAHeader* headers, int start_idx, int end_idx, int file_end_offset);
-bool update_offset_range_with_padding(const char* awb_path,const char* uasset_path,
-                                      const HCAHeader* headers,
-                                      int start_idx, int end_idx, int file_end_offset,
-                                      long size_difference, int padding_count);
+// AFS2 header embedded in a uasset/acb, one per port
+typedef struct {
+	long position;          // Position of the "AFS2" magic in the uasset
+	Afs2Archive archive;    // Layout of the header, entries aren't used
+	bool dirty;
+} PortOffsetTable;
+
+// Every embedded AFS2 header of a uasset/acb, loaded with a single read and
+// written back with one write per modified port
+typedef struct {
+	char uasset_path[MAX_PATH];
+	long base;              // Uasset position of data[0]
+	long size;
+	uint8_t* data;          // Tail of the uasset holding the headers
+	PortOffsetTable* ports;
+	int port_count;
+} UassetOffsetTables;
+
+bool offset_tables_load(const char* uasset_path, UassetOffsetTables* tables);
+// Writes every modified port table back to the uasset
+bool offset_tables_flush(UassetOffsetTables* tables);
+void offset_tables_free(UassetOffsetTables* tables);
+
+// Stores the new track offsets of an AWB in the table of its port, the last
+// offset is the end of the AWB. Nothing is written until the tables are flushed
+bool offset_tables_set_awb(UassetOffsetTables* tables, const char* awb_path,
+                           const HCAHeader* headers, int header_count,
+                           long file_end_offset);
 
 
 #endif // OFFSET_UPDATER_H_INCLUDED
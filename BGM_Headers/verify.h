@@ -0,0 +1,20 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "bgm_data.h"
+
+extern int verify_only;
+
+// Checks the header and frame CRCs of every HCA in a folder and reports the
+// broken ones. Returns how many were broken, or -1 if the folder can't be read
+int verify_hca_folder(const char* dirpath);
+
+// Same for every entry of an AWB
+int verify_awb_file(const char* filename);
+
+// Checks the HCAs queued for injection before anything is written, reporting
+// the broken ones by index and removing them from injections. Returns how
+// many were removed
+int verify_injections(InjectionInfo* injections, int* injection_count);
+
+#endif
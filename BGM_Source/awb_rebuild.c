@@ -0,0 +1,564 @@
+#include "awb_rebuild.h"
+#include "utils.h"
+#include "afs2.h"
+#include "range_writer.h"
+#include "hca_stream.h"
+#include "thread_pool.h"
+#include <sys/stat.h>
+
+#define COPY_BUFFER_SIZE (1024 * 1024) // 1MB buffer
+// Per channel bitrates for tracks fitted to their slot: under the first they
+// sound noticeably worse, under the second they are mostly silence and skipped
+#define LOW_FITTED_KBPS 48
+#define MIN_FITTED_KBPS 8
+
+extern int thread_count;
+
+static long get_file_size(FILE* file) {
+	if (fseek(file, 0, SEEK_END) != 0) return -1;
+	long size = ftell(file);
+	if (fseek(file, 0, SEEK_SET) != 0) return -1;
+	return size;
+}
+
+static bool copy_bytes(FILE* source, FILE* dest, long size, uint8_t* buffer) {
+	while (size > 0) {
+		size_t chunk = (size > COPY_BUFFER_SIZE) ? COPY_BUFFER_SIZE : (size_t)size;
+		if (fread(buffer, 1, chunk, source) != chunk ||
+		        fwrite(buffer, 1, chunk, dest) != chunk) {
+			return false;
+		}
+		size -= chunk;
+	}
+	return true;
+}
+
+// Loops of the WAVs, searched for up front by find_wav_loops so the encoders
+// of a WAV don't each read the whole of it again
+typedef struct {
+	char wav_path[MAX_PATH];
+	uint32_t start;
+	uint32_t end;
+} FoundLoop;
+
+static FoundLoop* found_loops = NULL;
+static int found_loop_count = 0;
+
+typedef struct {
+	const char** paths;
+	FoundLoop* loops;
+	bool* found;
+} LoopJob;
+
+static void find_wav_loop(void* context, int i, int worker) {
+	(void)worker;
+	LoopJob* job = context;
+	WavReader wav;
+	if (wav_reader_open(job->paths[i], &wav) != 0) {
+		return;
+	}
+	HcaEncodeOptions options;
+	if (hca_prepare_wav(&wav, &encode_options, &options) == 0) {
+		FoundLoop* loop = &job->loops[i];
+		snprintf(loop->wav_path, sizeof(loop->wav_path), "%s", job->paths[i]);
+		// Nothing repeats, the whole track is looped
+		loop->start = options.loop_start;
+		loop->end = options.loop_end ? options.loop_end : wav.frame_count;
+		job->found[i] = true;
+	}
+	wav_reader_close(&wav);
+}
+
+static bool is_loop_known(const char* wav_path) {
+	for (int i = 0; i < found_loop_count; i++) {
+		if (strcmp(found_loops[i].wav_path, wav_path) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void find_wav_loops(const char** wav_paths, int count) {
+	if (!encode_options.loop || encode_options.loop_start != 0 ||
+	        encode_options.loop_end != 0 || count == 0) {
+		return;
+	}
+
+	// Each WAV once, paired entries queue the same one twice
+	const char** paths = malloc(count * sizeof(const char*));
+	FoundLoop* loops = realloc(found_loops, (found_loop_count + count) * sizeof(FoundLoop));
+	bool* found = calloc(count, sizeof(bool));
+	if (loops) {
+		found_loops = loops;
+	}
+	if (!paths || !loops || !found) {
+		// The encoders search for the loops themselves
+		free(paths);
+		free(found);
+		return;
+	}
+	int unique = 0;
+	for (int i = 0; i < count; i++) {
+		bool seen = is_loop_known(wav_paths[i]);
+		for (int j = 0; j < unique && !seen; j++) {
+			seen = strcmp(paths[j], wav_paths[i]) == 0;
+		}
+		if (!seen) {
+			paths[unique++] = wav_paths[i];
+		}
+	}
+
+	LoopJob job = {paths, found_loops + found_loop_count, found};
+	if (parallel_for(unique, thread_count, find_wav_loop, &job) == 0) {
+		for (int i = 0; i < unique; i++) {
+			if (found[i]) {
+				found_loops[found_loop_count++] = job.loops[i];
+			}
+		}
+	}
+	free(paths);
+	free(found);
+}
+
+void free_found_loops(void) {
+	free(found_loops);
+	found_loops = NULL;
+	found_loop_count = 0;
+}
+
+// Options WAVs are encoded with, the bitrate can differ from track to track
+static HcaEncodeOptions wav_options(const char* wav_path, uint16_t frame_size) {
+	HcaEncodeOptions options = encode_options;
+	options.frame_size = frame_size;
+	if (options.loop && options.loop_start == 0 && options.loop_end == 0) {
+		for (int i = 0; i < found_loop_count; i++) {
+			if (strcmp(found_loops[i].wav_path, wav_path) == 0) {
+				options.loop_start = found_loops[i].start;
+				options.loop_end = found_loops[i].end;
+				break;
+			}
+		}
+	}
+	return options;
+}
+
+bool encode_wav_prefix(const char* wav_path, uint16_t frame_size,
+                       uint8_t prefix[HCA_MAX_SIZE], long* hca_size) {
+	HcaEncodeOptions options = wav_options(wav_path, frame_size);
+	HcaStream* stream = hca_stream_open(wav_path, &options, HCA_MAX_SIZE);
+	if (!stream) {
+		return false;
+	}
+
+	*hca_size = (long)hca_stream_size(stream);
+	memset(prefix, 0, HCA_MAX_SIZE);
+	size_t filled = 0;
+	size_t size;
+	const uint8_t* data;
+	while (filled < HCA_MAX_SIZE && (data = hca_stream_read(stream, &size)) != NULL) {
+		if (size > HCA_MAX_SIZE - filled) {
+			size = HCA_MAX_SIZE - filled;
+		}
+		memcpy(prefix + filled, data, size);
+		filled += size;
+	}
+	// Closed early on purpose, the result only says the stream wasn't drained
+	hca_stream_close(stream);
+	return true;
+}
+
+// Keeps the encoders of the WAV replacements from first on running, one per
+// core, so they encode while the tracks before them are written
+static bool start_streams(const AwbReplacement* replacements, int first, int count,
+                          HcaStream** streams) {
+	int ahead = thread_pool_default_workers();
+	for (int r = first; r < count && ahead > 0; r++) {
+		if (!replacements[r].from_wav) continue;
+		ahead--;
+		if (streams[r]) continue;
+
+		HcaEncodeOptions options = wav_options(replacements[r].hca_path, replacements[r].frame_size);
+		streams[r] = hca_stream_open(replacements[r].hca_path, &options, STREAM_RING_SIZE);
+		// The size was taken when the injection was queued
+		if (!streams[r] || hca_stream_size(streams[r]) != (uint64_t)replacements[r].size) {
+			fprintf(stderr, "Error: Could not encode %s\n",
+			        extract_name_from_path(replacements[r].hca_path));
+			return false;
+		}
+	}
+	return true;
+}
+
+static void close_streams(HcaStream** streams, int count) {
+	for (int r = 0; r < count; r++) {
+		if (streams[r]) {
+			hca_stream_close(streams[r]);
+			streams[r] = NULL;
+		}
+	}
+}
+
+// Writes the rest of an encoded WAV and closes its stream
+static bool write_stream(HcaStream** stream, FILE* output) {
+	bool written = true;
+	const uint8_t* data;
+	size_t size;
+	while (written && (data = hca_stream_read(*stream, &size)) != NULL) {
+		written = fwrite(data, 1, size, output) == size;
+	}
+	written = hca_stream_close(*stream) == 0 && written;
+	*stream = NULL;
+	return written;
+}
+
+static int compare_replacements(const void* a, const void* b) {
+	return ((const AwbReplacement*)a)->entry - ((const AwbReplacement*)b)->entry;
+}
+
+// Rewrites the AWB's own offset table so it matches the new layout. Tables
+// that don't describe the same tracks are left alone, the uasset copy is
+// what the game actually uses
+static void update_afs2_table(uint8_t* header, long header_size,
+                              const long* new_offsets, int header_count,
+                              long end_offset) {
+	Afs2Archive archive;
+	if (afs2_parse(header, header_size, &archive) != 0) {
+		return;
+	}
+
+	if (archive.count == (uint32_t)header_count) {
+		for (int i = 0; i < header_count; i++) {
+			afs2_set_offset(header, &archive, i, new_offsets[i]);
+		}
+		afs2_set_offset(header, &archive, header_count, end_offset);
+	}
+	afs2_free(&archive);
+}
+
+bool rebuild_awb(const char* awb_path, const char* output_path,
+                 HCAHeader* headers, int header_count,
+                 const AwbReplacement* replacements, int replacement_count,
+                 long* file_end_offset) {
+	if (header_count <= 0 || replacement_count <= 0) {
+		return false;
+	}
+
+	FILE* source = fopen(awb_path, "rb");
+	if (!source) {
+		fprintf(stderr, "Error: Could not open AWB file: %s\n", awb_path);
+		return false;
+	}
+
+	long source_size = get_file_size(source);
+	long header_size = headers[0].offset;
+	if (source_size < 0 || header_size <= 0 || header_size > source_size) {
+		fprintf(stderr, "Error: Invalid track layout for %s\n", awb_path);
+		fclose(source);
+		return false;
+	}
+
+	// Replacements are applied in file order
+	AwbReplacement* sorted = malloc(replacement_count * sizeof(AwbReplacement));
+	long* new_offsets = malloc(header_count * sizeof(long));
+	long* new_sizes = malloc(replacement_count * sizeof(long));
+	HcaStream** streams = calloc(replacement_count, sizeof(HcaStream*));
+	uint8_t* header = malloc(header_size);
+	uint8_t* buffer = malloc(COPY_BUFFER_SIZE);
+	FILE* output = NULL;
+	bool success = false;
+
+	if (!sorted || !new_offsets || !new_sizes || !streams || !header || !buffer) {
+		fprintf(stderr, "Error: Memory allocation failed while rebuilding %s\n",
+		        awb_path);
+		goto cleanup;
+	}
+
+	memcpy(sorted, replacements, replacement_count * sizeof(AwbReplacement));
+	qsort(sorted, replacement_count, sizeof(AwbReplacement), compare_replacements);
+
+	for (int r = 0; r < replacement_count; r++) {
+		if (sorted[r].entry < 0 || sorted[r].entry >= header_count ||
+		        (r > 0 && sorted[r].entry == sorted[r - 1].entry)) {
+			fprintf(stderr, "Error: Invalid replacement for track %d of %s\n",
+			        sorted[r].entry, awb_path);
+			goto cleanup;
+		}
+
+		new_sizes[r] = sorted[r].size;
+		if (new_sizes[r] <= 0) {
+			fprintf(stderr, "Error: Could not read size of %s\n", sorted[r].hca_path);
+			goto cleanup;
+		}
+	}
+
+	// 1. Lay out the new file before writing anything
+	long position = header_size;
+	for (int i = 0, r = 0; i < header_count; i++) {
+		long original_end = (i < header_count - 1) ? headers[i + 1].offset :
+		                    source_size;
+		new_offsets[i] = position;
+
+		if (r < replacement_count && sorted[r].entry == i) {
+			position += new_sizes[r++];
+			if (i < header_count - 1 && position % AWB_ENTRY_ALIGNMENT != 0) {
+				position += AWB_ENTRY_ALIGNMENT - position % AWB_ENTRY_ALIGNMENT;
+			}
+		} else {
+			if (original_end < headers[i].offset) {
+				fprintf(stderr, "Error: Invalid track layout for %s\n", awb_path);
+				goto cleanup;
+			}
+			position += original_end - headers[i].offset;
+		}
+	}
+	long new_end = position;
+
+	// 2. Header with the final offset table
+	if (fread(header, 1, header_size, source) != (size_t)header_size) {
+		fprintf(stderr, "Error: Could not read AWB header: %s\n", awb_path);
+		goto cleanup;
+	}
+	update_afs2_table(header, header_size, new_offsets, header_count, new_end);
+
+	output = fopen(output_path, "wb");
+	if (!output) {
+		fprintf(stderr, "Error: Could not create %s\n", output_path);
+		goto cleanup;
+	}
+	setvbuf(output, NULL, _IOFBF, COPY_BUFFER_SIZE);
+
+	if (fwrite(header, 1, header_size, output) != (size_t)header_size) {
+		goto write_failed;
+	}
+
+	// 3. Stream every track, each byte of the source is read at most once
+	for (int i = 0, r = 0; i < header_count; i++) {
+		long original_end = (i < header_count - 1) ? headers[i + 1].offset :
+		                    source_size;
+		long next_offset = (i < header_count - 1) ? new_offsets[i + 1] : new_end;
+
+		if (r < replacement_count && sorted[r].entry == i) {
+			if (sorted[r].from_wav) {
+				if (!start_streams(sorted, r, replacement_count, streams)) {
+					goto cleanup;
+				}
+				if (!write_stream(&streams[r], output)) {
+					goto write_failed;
+				}
+			} else {
+				FILE* hca = fopen(sorted[r].hca_path, "rb");
+				if (!hca) {
+					fprintf(stderr, "Error opening new HCA file: %s\n", sorted[r].hca_path);
+					goto cleanup;
+				}
+				bool copied = copy_bytes(hca, output, new_sizes[r], buffer);
+				fclose(hca);
+				if (!copied) {
+					goto write_failed;
+				}
+			}
+
+			long padding = next_offset - (new_offsets[i] + new_sizes[r]);
+			memset(buffer, 0, padding);
+			if (fwrite(buffer, 1, padding, output) != (size_t)padding) {
+				goto write_failed;
+			}
+			r++;
+		} else {
+			if (fseek(source, headers[i].offset, SEEK_SET) != 0 ||
+			        !copy_bytes(source, output, original_end - headers[i].offset, buffer)) {
+				goto write_failed;
+			}
+		}
+	}
+
+	if (fclose(output) != 0) {
+		output = NULL;
+		goto write_failed;
+	}
+	output = NULL;
+
+	for (int i = 0; i < header_count; i++) {
+		headers[i].offset = new_offsets[i];
+	}
+	*file_end_offset = new_end;
+	success = true;
+	goto cleanup;
+
+write_failed:
+	fprintf(stderr, "Error: Failed to write rebuilt AWB: %s\n", output_path);
+	if (output) fclose(output);
+	output = NULL;
+	remove(output_path);
+
+cleanup:
+	if (output) {
+		fclose(output);
+		remove(output_path);
+	}
+	if (source) fclose(source);
+	if (streams) close_streams(streams, replacement_count);
+	free(streams);
+	free(sorted);
+	free(new_offsets);
+	free(new_sizes);
+	free(header);
+	free(buffer);
+	return success;
+}
+
+static long get_path_size(const char* path) {
+	struct stat st;
+	return (stat(path, &st) == 0) ? (long)st.st_size : -1;
+}
+
+// Same as write_stream, into a slot of the AWB
+static bool write_stream_at(HcaStream** stream, RangeWriter* writer, uint64_t offset) {
+	bool written = true;
+	const uint8_t* data;
+	size_t size;
+	while (written && (data = hca_stream_read(*stream, &size)) != NULL) {
+		written = range_writer_write(writer, offset, data, size) == 0;
+		offset += size;
+	}
+	written = hca_stream_close(*stream) == 0 && written;
+	*stream = NULL;
+	return written;
+}
+
+// Slot of a track, its padding included
+static long get_slot_size(const HCAHeader* headers, int header_count, int entry,
+                          long awb_size) {
+	long next_offset = (entry < header_count - 1) ? headers[entry + 1].offset :
+	                   awb_size;
+	return next_offset - headers[entry].offset;
+}
+
+// Fixed size mode: gives a WAV the bitrate that fills its slot, returns
+// false if even the lowest one doesn't fit
+static bool fit_wav_to_slot(AwbReplacement* replacement, long slot_size) {
+	WavReader wav;
+	if (wav_reader_open(replacement->hca_path, &wav) != 0) {
+		return false;
+	}
+	uint64_t size = 0;
+	HcaEncodeOptions requested = wav_options(replacement->hca_path, 0);
+	HcaEncodeOptions options;
+	unsigned frame_size = 0;
+	if (hca_prepare_wav(&wav, &requested, &options) == 0) {
+		frame_size = hca_encoder_fit_frame_size(wav.channels, wav.sample_rate,
+		                                        wav.frame_count, &options,
+		                                        (uint64_t)slot_size, &size);
+	}
+	unsigned channels = wav.channels;
+	unsigned sample_rate = wav.sample_rate;
+	wav_reader_close(&wav);
+
+	unsigned kbps = (unsigned)((uint64_t)frame_size * 8 * sample_rate /
+	                           HCA_SAMPLES_PER_FRAME / 1000);
+	if (frame_size == 0 || kbps < MIN_FITTED_KBPS * channels) {
+		return false;
+	}
+	if (kbps < LOW_FITTED_KBPS * channels) {
+		printf("Warning: %s only fits its slot at %u kbps, expect audible artifacts\n",
+		       extract_name_from_path(replacement->hca_path), kbps);
+	} else if (frame_size != replacement->frame_size) {
+		printf("%s will be encoded at %u kbps to fill its slot\n",
+		       extract_name_from_path(replacement->hca_path), kbps);
+	}
+	replacement->frame_size = (uint16_t)frame_size;
+	replacement->size = (long)size;
+	return true;
+}
+
+int check_awb_slots(const char* awb_path, const HCAHeader* headers,
+                    int header_count, AwbReplacement* replacements,
+                    int replacement_count, bool* fits) {
+	long awb_size = get_path_size(awb_path);
+	if (awb_size < 0) {
+		fprintf(stderr, "Error: Could not read size of %s\n", awb_path);
+		return -1;
+	}
+
+	int oversized = 0;
+	for (int r = 0; r < replacement_count; r++) {
+		AwbReplacement* replacement = &replacements[r];
+		long new_size = replacement->size;
+		if (new_size <= 0) {
+			fprintf(stderr, "Error: Could not read size of %s\n", replacement->hca_path);
+			return -1;
+		}
+
+		long slot_size = get_slot_size(headers, header_count, replacement->entry,
+		                               awb_size);
+		fits[r] = replacement->from_wav ? fit_wav_to_slot(replacement, slot_size) :
+		          new_size <= slot_size;
+		if (fits[r]) continue;
+
+		if (oversized++ == 0) {
+			fprintf(stderr, "Tracks that don't fit into %s:\n",
+			        extract_name_from_path(awb_path));
+		}
+		// A WAV only fails when even a very low bitrate doesn't fit
+		const char* reason = replacement->from_wav ? "is too long for" : "is larger than";
+		int thousands = slot_size / (1024 * 1000);
+		int remainder = (slot_size / 1024) % 1000;
+		if (thousands)
+			fprintf(stderr, "-> Error: %s %s the original %d,%dKB. File skipped.\n",
+			        extract_name_from_path(replacement->hca_path), reason, thousands, remainder);
+		else
+			fprintf(stderr, "-> Error: %s %s the original %dKB. File skipped.\n",
+			        extract_name_from_path(replacement->hca_path), reason, remainder);
+	}
+
+	if (oversized) {
+		fprintf(stderr, "\n");
+	}
+	return oversized;
+}
+
+bool write_awb_slots(const char* awb_path, const HCAHeader* headers,
+                     int header_count, const AwbReplacement* replacements,
+                     int replacement_count) {
+	long awb_size = get_path_size(awb_path);
+	RangeWriter writer;
+	if (awb_size < 0 || range_writer_open(awb_path, &writer) != 0) {
+		fprintf(stderr, "Error opening target file: %s\n", awb_path);
+		return false;
+	}
+
+	HcaStream** streams = calloc(replacement_count, sizeof(HcaStream*));
+	bool success = streams != NULL;
+	for (int r = 0; r < replacement_count && success; r++) {
+		const AwbReplacement* replacement = &replacements[r];
+		long offset = headers[replacement->entry].offset;
+		long slot_size = get_slot_size(headers, header_count, replacement->entry,
+		                               awb_size);
+		long new_size = replacement->size;
+
+		bool written = new_size > 0 && new_size <= slot_size;
+		if (written && replacement->from_wav) {
+			written = start_streams(replacements, r, replacement_count, streams) &&
+			          write_stream_at(&streams[r], &writer, offset);
+		} else if (written) {
+			written = range_writer_copy_file(&writer, offset, replacement->hca_path,
+			                                 new_size) == 0;
+		}
+		if (!written ||
+		        range_writer_zero(&writer, offset + new_size, slot_size - new_size) != 0) {
+			fprintf(stderr, "Error: Failed to write %s into %s\n",
+			        extract_name_from_path(replacement->hca_path),
+			        extract_name_from_path(awb_path));
+			success = false;
+		}
+	}
+
+	if (streams) {
+		close_streams(streams, replacement_count);
+		free(streams);
+	}
+	if (range_writer_close(&writer) != 0) {
+		success = false;
+	}
+	return success;
+}
@@ -2,6 +2,10 @@
 #include "inject.h"
 #include "utils.h"
 #include "awb.h"
+#include "hca_format.h"
+#include "awb_rebuild.h"
+#include "verify.h"
+#include "audio_decoder.h"
 bool check_and_process_hca(const char* filepath, const char* dirpath,
                            InjectionInfo* injections, int* injection_count) {
 	const char* filename = get_basename(filepath);
@@ -80,6 +84,71 @@ bool is_index_in_pair(int index1, int index2) {
 	return false;
 }
 
+// Reads the start of an HCA for the uasset's copy of it
+static bool read_hca_prefix(const char* filepath, InjectionInfo* injection) {
+	// The header says how long the file is, so a short read is only an error
+	// when the file is cut off
+	HcaInfo info;
+	if (hca_query_file(filepath, &info) != 0) {
+		printf("Error: '%s' is not a valid HCA file\n", extract_name_from_path(filepath));
+		return false;
+	}
+	uint64_t file_size = info.header_size + (uint64_t)info.frame_count * info.frame_size;
+	long expected = (file_size < HCA_MAX_SIZE) ? (long)file_size : HCA_MAX_SIZE;
+
+	// Read HCA header
+	FILE* hca_file = fopen(filepath, "rb");
+	if (!hca_file) {
+		printf("Error: Could not open HCA file '%s'\n", filepath);
+		return false;
+	}
+
+	long bytes_read = fread(injection->new_header, 1, HCA_MAX_SIZE, hca_file);
+	if (bytes_read < expected && !info.vbr) {
+		printf("Error: Only read %ld bytes from '%s' instead of expected %ld bytes.\n",
+		       bytes_read, filepath, expected);
+	}
+
+	fseek(hca_file, 0, SEEK_END);
+	injection->hca_size = ftell(hca_file);
+	fclose(hca_file);
+	return true;
+}
+
+// Same for the queued WAVs, FLACs, Ogg Vorbis and MP3s once the folder is
+// read, after their loops were searched for on all cores. The whole HCA is
+// encoded later straight into the AWB. Drops the ones that can't be encoded
+static void encode_wav_prefixes(InjectionInfo* injections, int* injection_count) {
+	const char** paths = malloc(*injection_count * sizeof(const char*));
+	if (paths) {
+		int wav_count = 0;
+		for (int i = 0; i < *injection_count; i++) {
+			if (injections[i].from_wav) {
+				paths[wav_count++] = injections[i].hca_path;
+			}
+		}
+		find_wav_loops(paths, wav_count);
+		free(paths);
+	}
+
+	int kept = 0;
+	for (int i = 0; i < *injection_count; i++) {
+		InjectionInfo* injection = &injections[i];
+		if (injection->from_wav &&
+		        !encode_wav_prefix(injection->hca_path, 0, injection->new_header,
+		                           &injection->hca_size)) {
+			printf("Error: Could not encode '%s' (PCM or float WAV, FLAC, Ogg Vorbis or MP3 "
+			       "expected)\n", extract_name_from_path(injection->hca_path));
+			continue;
+		}
+		if (kept != i) {
+			injections[kept] = *injection;
+		}
+		kept++;
+	}
+	*injection_count = kept;
+}
+
 // Helper function to process an individual HCA entry
 bool process_hca_entry(const char* filepath, const char* dirpath,
                        InjectionInfo* injections, int* injection_count, int index) {
@@ -111,13 +180,6 @@ bool process_hca_entry(const char* filepath, const char* dirpath,
 		return false;
 	}
 
-	// Read HCA header
-	FILE* hca_file = fopen(filepath, "rb");
-	if (!hca_file) {
-		printf("Error: Could not open HCA file '%s'\n", filepath);
-		return false;
-	}
-
 	memset(&injections[*injection_count], 0, sizeof(InjectionInfo));
 	strncpy(injections[*injection_count].hca_path, filepath, MAX_PATH - 1);
 	injections[*injection_count].hca_path[MAX_PATH - 1] = '\0';
@@ -127,17 +189,15 @@ bool process_hca_entry(const char* filepath, const char* dirpath,
 
 	injections[*injection_count].index = index;
 
-	memset(injections[*injection_count].new_header, 0, HCA_MAX_SIZE);
-
-	long bytes_read = fread(injections[*injection_count].new_header, 1,
-	                        HCA_MAX_SIZE, hca_file);
-	if (bytes_read != HCA_MAX_SIZE) {
-		printf("Error: Only read %ld bytes from '%s' instead of expected %d bytes.\n",
-		       bytes_read, filepath, HCA_MAX_SIZE);
+	const char* ext = get_file_extension(filepath);
+	bool is_wav = strcasecmp(ext, "wav") == 0 || audio_decoder_handles(ext);
+	// WAVs are encoded once the whole folder is queued, see encode_wav_prefixes
+	injections[*injection_count].from_wav = is_wav;
+	if (!is_wav && !read_hca_prefix(filepath, &injections[*injection_count])) {
+		return false;
 	}
 
 	(*injection_count)++;
-	fclose(hca_file);
 	return true;
 }
 
@@ -234,6 +294,20 @@ const char* get_container_file(const char* target_file,
 	return NULL;
 }
 
+// Whether an HCA has a WAV, FLAC, Ogg Vorbis or MP3 of the same name next to it
+static bool has_source_audio(const char* hca_path) {
+	struct stat source_stat;
+	if (stat(replace_extension(hca_path, "wav"), &source_stat) == 0) {
+		return true;
+	}
+	for (int i = 0; i < AUDIO_DECODER_EXTENSION_COUNT; i++) {
+		if (stat(replace_extension(hca_path, audio_decoder_extensions[i]), &source_stat) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 int process_directory(const char* dirpath) {
 	DIR* dir = opendir(dirpath);
 	if (!dir) {
@@ -258,16 +332,29 @@ int process_directory(const char* dirpath) {
 	while ((entry = readdir(dir)) != NULL) {
 		const char* ext = get_file_extension(entry->d_name);
 
-		if (strcasecmp(ext, "hca") == 0) {
-			char filepath[MAX_PATH];
-			snprintf(filepath, sizeof(filepath), "%s\\%s", dirpath, entry->d_name);
+		char filepath[MAX_PATH];
+		snprintf(filepath, sizeof(filepath), "%s\\%s", dirpath, entry->d_name);
 
-			check_and_process_hca(filepath, dir_name,
-			                      injections, &injection_count);
+		// WAVs are encoded while they are injected, an HCA next to one is
+		// left for the WAV, as is one next to a FLAC, Ogg Vorbis or MP3
+		if (strcasecmp(ext, "hca") == 0) {
+			if (has_source_audio(filepath)) continue;
+		} else if (strcasecmp(ext, "wav") != 0 && !audio_decoder_handles(ext)) {
+			continue;
 		}
+
+		check_and_process_hca(filepath, dir_name,
+		                      injections, &injection_count);
 	}
 
 	closedir(dir);
+	encode_wav_prefixes(injections, &injection_count);
+
+	// Broken HCAs are left out before any AWB or uasset is touched
+	int broken = verify_injections(injections, &injection_count);
+	if (broken > 0) {
+		printf("%d HCA(s) will not be injected as they are corrupted\n", broken);
+	}
 
 	// If we found any HCA files to inject, process them
 	if (injection_count > 0) {
@@ -289,6 +376,7 @@ int process_directory(const char* dirpath) {
 				        "Error: Could not find corresponding uasset/acb file for: %s\n",
 				        injections[i].target_file);
 				free(injections);
+				free_found_loops();
 				return -1;
 			}
 
@@ -313,6 +401,7 @@ int process_directory(const char* dirpath) {
 						free(grouped_injections[k]);
 					}
 					free(injections);
+					free_found_loops();
 					return -1;
 				}
 				// Initialize the new group with -2 (end-of-group marker)
@@ -342,6 +431,8 @@ int process_directory(const char* dirpath) {
 					free(grouped_injections[j]);
 				}
 				free(injections);
+				free_header_cache();
+				free_found_loops();
 				return -1;
 			}
 
@@ -360,6 +451,8 @@ int process_directory(const char* dirpath) {
 					free(grouped_injections[j]);
 				}
 				free(injections);
+				free_header_cache();
+				free_found_loops();
 				return -1;
 			}
 		}
@@ -370,8 +463,10 @@ int process_directory(const char* dirpath) {
 				free(grouped_injections[i]);
 			}
 		}
+		free_header_cache();
 	}
 
 	free(injections);
+	free_found_loops();
 	return 0;
 }
@@ -3,11 +3,24 @@
 #include "awb.h"
 #include "directory.h"
 #include "inject.h"
+#include "verify.h"
 #include <stdio.h>
 #include <string.h>
 
 
 int bgm_process_input(const char* input) {
+	// Only reports broken HCAs, nothing is written
+	if (verify_only) {
+		const char* ext = get_file_extension(input);
+		if (is_directory(input)) {
+			return verify_hca_folder(input) != 0;
+		} else if (ext && strcasecmp(ext, "awb") == 0) {
+			return verify_awb_file(input) != 0;
+		}
+		printf("Unsupported file type for verification: %s\n", extract_name_from_path(input));
+		return 1;
+	}
+
 	if (is_directory(input)) {
 		return bgm_process_directory(input);
 	} else { // Assuming it's a file at this point
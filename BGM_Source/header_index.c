@@ -0,0 +1,155 @@
+#include "header_index.h"
+#include "initialization.h"
+#include "awb.h"
+#include "mapped_file.h"
+
+static uint32_t fnv1a(const uint8_t* data, size_t size) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static void get_index_path(const char* name, char* path, size_t size) {
+	snprintf(path, size, "%s%s.idx", app_config.program_directory,
+	         extract_name_from_path(name));
+}
+
+static bool get_source_info(const char* source_path, uint64_t* size,
+                            int64_t* mtime) {
+	struct stat st;
+	if (stat(source_path, &st) != 0) {
+		return false;
+	}
+	*size = (uint64_t)st.st_size;
+	*mtime = (int64_t)st.st_mtime;
+	return true;
+}
+
+int save_header_index(const char* name, const char* source_path,
+                      const HCAHeader* headers, int count) {
+	char index_path[MAX_PATH];
+	get_index_path(name, index_path, sizeof(index_path));
+
+	size_t records_size = (size_t)count * sizeof(HeaderIndexRecord);
+	size_t total_size = sizeof(HeaderIndexFileHeader) + records_size;
+	uint8_t* data = calloc(1, total_size);
+	if (!data) {
+		return -1;
+	}
+
+	HeaderIndexFileHeader* file_header = (HeaderIndexFileHeader*)data;
+	HeaderIndexRecord* records = (HeaderIndexRecord*)(data + sizeof(*file_header));
+
+	for (int i = 0; i < count; i++) {
+		records[i].index = headers[i].index;
+		records[i].offset = (uint64_t)headers[i].offset;
+		memcpy(records[i].header, headers[i].header, HCA_HEADER_SIZE);
+	}
+
+	memcpy(file_header->magic, HEADER_INDEX_MAGIC, 4);
+	file_header->version = HEADER_INDEX_VERSION;
+	file_header->record_size = sizeof(HeaderIndexRecord);
+	file_header->count = count;
+	file_header->checksum = fnv1a((const uint8_t*)records, records_size);
+	if (!get_source_info(source_path, &file_header->source_size,
+	                     &file_header->source_mtime)) {
+		fprintf(stderr, "Error: Could not stat %s\n", source_path);
+		free(data);
+		return -1;
+	}
+
+	// Same record count means same file size, overwrite it in place
+	struct stat st;
+	bool same_size = stat(index_path, &st) == 0 && (size_t)st.st_size == total_size;
+	FILE* file = fopen(index_path, same_size ? "r+b" : "wb");
+	if (!file) {
+		fprintf(stderr, "Error: Could not write header index: %s\n", index_path);
+		free(data);
+		return -1;
+	}
+
+	bool written = fwrite(data, 1, total_size, file) == total_size;
+	if (fclose(file) != 0) written = false;
+	free(data);
+
+	if (!written) {
+		fprintf(stderr, "Error: Could not write header index: %s\n", index_path);
+		return -1;
+	}
+
+	if (export_csv) {
+		char csv_name[MAX_PATH];
+		snprintf(csv_name, sizeof(csv_name), "%s.csv", extract_name_from_path(name));
+		if (write_header_csv(csv_name, (HCAHeader*)headers, count) != 0) {
+			fprintf(stderr, "Warning: Could not export %s\n", csv_name);
+		}
+	}
+	return 0;
+}
+
+int load_header_index(const char* name, const char* source_path,
+                      HCAHeader** headers, int* count) {
+	*headers = NULL;
+	*count = 0;
+
+	char index_path[MAX_PATH];
+	get_index_path(name, index_path, sizeof(index_path));
+
+	MappedFile file;
+	if (mapped_file_open(index_path, &file) != 0) {
+		return -1;
+	}
+
+	const HeaderIndexFileHeader* file_header = (const HeaderIndexFileHeader*)file.data;
+	if (file.size < sizeof(*file_header) ||
+	        memcmp(file_header->magic, HEADER_INDEX_MAGIC, 4) != 0 ||
+	        file_header->version != HEADER_INDEX_VERSION ||
+	        file_header->record_size != sizeof(HeaderIndexRecord) ||
+	        file.size != sizeof(*file_header) +
+	        (uint64_t)file_header->count * sizeof(HeaderIndexRecord)) {
+		fprintf(stderr, "Warning: %s is not a valid header index\n",
+		        extract_name_from_path(index_path));
+		mapped_file_close(&file);
+		return -1;
+	}
+
+	const HeaderIndexRecord* records =
+	    (const HeaderIndexRecord*)(file.data + sizeof(*file_header));
+	size_t records_size = (size_t)file_header->count * sizeof(HeaderIndexRecord);
+	if (fnv1a((const uint8_t*)records, records_size) != file_header->checksum) {
+		fprintf(stderr, "Warning: %s is corrupted\n",
+		        extract_name_from_path(index_path));
+		mapped_file_close(&file);
+		return -1;
+	}
+
+	uint64_t source_size;
+	int64_t source_mtime;
+	if (!get_source_info(source_path, &source_size, &source_mtime) ||
+	        source_size != file_header->source_size ||
+	        source_mtime != file_header->source_mtime) {
+		printf("Note: %s changed since its headers were read\n",
+		       extract_name_from_path(source_path));
+		mapped_file_close(&file);
+		return -1;
+	}
+
+	int record_count = (int)file_header->count;
+	*headers = malloc((record_count > 0 ? record_count : 1) * sizeof(HCAHeader));
+	if (!*headers) {
+		mapped_file_close(&file);
+		return -1;
+	}
+
+	for (int i = 0; i < record_count; i++) {
+		(*headers)[i].index = records[i].index;
+		(*headers)[i].offset = (long)records[i].offset;
+		memcpy((*headers)[i].header, records[i].header, HCA_HEADER_SIZE);
+	}
+	*count = record_count;
+
+	mapped_file_close(&file);
+	return 0;
+}
@@ -1,5 +1,7 @@
 #include "initialization.h"
 #include "bgm_data.h"
+#include "inject.h"
+#include "file_transaction.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -20,6 +22,22 @@ int initialize_program(const char* program_path) {
         *(last_backslash + 1) = '\0';
     }
 
+    // Finish or undo an injection that was interrupted last time
+    char journal_path[MAX_PATH];
+    get_program_file_path(INJECTION_JOURNAL, journal_path, sizeof(journal_path));
+    switch (file_transaction_recover(journal_path)) {
+    case FILE_TRANSACTION_ROLLED_BACK:
+        printf("An interrupted injection was rolled back, your files are unchanged.\n");
+        break;
+    case FILE_TRANSACTION_FINISHED:
+        printf("Finished saving an interrupted injection.\n");
+        break;
+    case -1:
+        fprintf(stderr, "Error: Could not recover the injection listed in %s\n",
+                journal_path);
+        return 1;
+    }
+
     // Load data from CSV files
     if (!read_bgm_dictionary("Mapping\\bgm_dictionary.csv")) {
         fprintf(stderr, "Error loading BGM dictionary.\n");
@@ -2,6 +2,11 @@
 #include "utils.h"
 #include "awb.h"
 #include "offset_updater.h"
+#include "awb_rebuild.h"
+#include "header_index.h"
+#include "initialization.h"
+#include "atomic_file.h"
+#include "file_transaction.h"
 
 bool create_backup(const char* filename) {
 	char backup_path[MAX_PATH];
@@ -12,209 +17,275 @@ bool create_backup(const char* filename) {
 		return true;  // Backup already exists
 	}
 
-	FILE* source = fopen(filename, "rb");
-	FILE* backup = fopen(backup_path, "wb");
+	// Shares the blocks of the original where the filesystem supports it
+	return atomic_file_clone(filename, backup_path) == 0;
+}
 
-	if (!source || !backup) {
-		if (source) fclose(source);
-		if (backup) fclose(backup);
-		return false;
+// Headers of every AWB touched during this run, written back once per container
+typedef struct {
+	char target_file[MAX_PATH];
+	HCAHeader* headers;
+	int count;
+	bool dirty;
+} CachedHeaders;
+
+static CachedHeaders* header_cache = NULL;
+static int header_cache_count = 0;
+
+// Loads the headers of an AWB, they are read again from the AWB if its index
+// is missing or no longer matches the file
+static int load_target_headers(const char* target_file, HCAHeader** headers,
+                               int* count) {
+	char index_name[MAX_PATH];
+	snprintf(index_name, sizeof(index_name), "%s_headers",
+	         get_basename(target_file));
+
+	if (load_header_index(index_name, target_file, headers, count) == 0) {
+		return 0;
 	}
 
-	char buffer[8192];
-	size_t bytes;
+	printf("Reading headers of %s again\n", extract_name_from_path(target_file));
+	process_awb_file(target_file);
+	return load_header_index(index_name, target_file, headers, count);
+}
 
-	while ((bytes = fread(buffer, 1, sizeof(buffer), source)) > 0) {
-		if (fwrite(buffer, 1, bytes, backup) != bytes) {
-			fclose(source);
-			fclose(backup);
-			return false;
+// Headers of target_file, only read from disk the first time
+static CachedHeaders* get_cached_headers(const char* target_file) {
+	for (int i = 0; i < header_cache_count; i++) {
+		if (strcasecmp(header_cache[i].target_file, target_file) == 0) {
+			return &header_cache[i];
 		}
 	}
 
-	fclose(source);
-	fclose(backup);
-	return true;
-}
+	HCAHeader* headers = NULL;
+	int count = 0;
+	if (load_target_headers(target_file, &headers, &count) != 0) {
+		free(headers);
+		return NULL;
+	}
 
-void recalculate_subsequent_offsets(HCAHeader* headers, int header_count,
-                                    int current_index, long size_difference) {
-	// Adjust all offsets that come after the replaced file
-	for (int i = current_index + 1; i < header_count; i++) {
-		headers[i].offset += size_difference;
+	CachedHeaders* cache = realloc(header_cache,
+	                               (header_cache_count + 1) * sizeof(CachedHeaders));
+	if (!cache) {
+		free(headers);
+		return NULL;
 	}
+	header_cache = cache;
+
+	CachedHeaders* entry = &header_cache[header_cache_count++];
+	snprintf(entry->target_file, sizeof(entry->target_file), "%s", target_file);
+	entry->headers = headers;
+	entry->count = count;
+	entry->dirty = false;
+	return entry;
 }
 
-// Fixed version with additional safety checks and proper error handling
-#define SAFE_BUFFER_SIZE (1024 * 128)  // 128KB chunks
-
-long replaceFileContent(FILE* target, FILE* new_hca,
-                        HCAHeader* target_headers,
-                        int j, int target_header_count, long file_end_offset, int *padding_added) {
-	*padding_added = 0; // Initialize padding to zero
-
-	// Get content boundaries
-	long content_start = target_headers[j].offset;
-	long content_end = (j < target_header_count - 1) ?
-	                   target_headers[j + 1].offset : file_end_offset;
-
-	// Validate positions and parameters
-	if (!target || !new_hca || !target_headers || j < 0 ||
-	        content_start < 0 || content_end < 0 || content_start >= content_end) {
-		return -1;
+// Saves the index of every AWB whose offsets changed
+static bool write_back_headers(void) {
+	bool success = true;
+	for (int i = 0; i < header_cache_count; i++) {
+		CachedHeaders* entry = &header_cache[i];
+		if (!entry->dirty) continue;
+
+		char index_name[MAX_PATH];
+		snprintf(index_name, sizeof(index_name), "%s_headers",
+		         get_basename(entry->target_file));
+		if (save_header_index(index_name, entry->target_file, entry->headers,
+		                      entry->count) != 0) {
+			fprintf(stderr, "Failed to update target header index\n");
+			success = false;
+			continue;
+		}
+		entry->dirty = false;
 	}
+	return success;
+}
 
-	// Get sizes and validate file positions
-	if (fseek(new_hca, 0, SEEK_END) != 0) return -1;
-	long new_size = ftell(new_hca);
-	if (new_size < 0) return -1;
-
-	clearerr(new_hca);
-	rewind(new_hca);
-
-	if (fseek(target, 0, SEEK_END) != 0) return -1;
-	long total_size = ftell(target);
-	if (total_size < 0 || total_size < content_end) return -1;
+void free_header_cache(void) {
+	for (int i = 0; i < header_cache_count; i++) {
+		free(header_cache[i].headers);
+	}
+	free(header_cache);
+	header_cache = NULL;
+	header_cache_count = 0;
+}
 
-	long original_size = content_end - content_start;
+// Track replacement waiting for its AWB to be written
+typedef struct {
+	const char* target_file;
+	const char* hca_path;
+	int index;
+	bool from_wav;
+	uint16_t frame_size;
+	long size;
+} PendingReplacement;
+
+static void set_pending(PendingReplacement* pending, const InjectionInfo* injection) {
+	pending->target_file = injection->target_file;
+	pending->hca_path = injection->hca_path;
+	pending->index = injection->index;
+	pending->from_wav = injection->from_wav;
+	pending->frame_size = injection->frame_size;
+	pending->size = injection->hca_size;
+}
 
-	// Calculate padding before calculating size difference
-	long padding = 0;
-	if (content_end != file_end_offset && j < target_header_count - 1) {
-		long next_file_offset = content_start + new_size;
-		if (next_file_offset % 32 != 0) {
-			padding = 32 - (next_file_offset % 32);
-			*padding_added = padding;
+// Gathers the pending replacements for the AWB of pending[0] and marks them
+// done. Returns how many were stored in replacements, sources (optional)
+// receives the position in pending each of them came from
+static int collect_replacements(const CachedHeaders* target,
+                                const PendingReplacement* pending,
+                                int pending_count, bool* done,
+                                AwbReplacement* replacements, int* sources) {
+	int replacement_count = 0;
+	for (int i = 0; i < pending_count; i++) {
+		if (done[i] ||
+		        strcasecmp(pending[i].target_file, pending[0].target_file) != 0) continue;
+		done[i] = true;
+
+		for (int j = 0; j < target->count; j++) {
+			if (target->headers[j].index == pending[i].index) {
+				replacements[replacement_count].entry = j;
+				replacements[replacement_count].hca_path = pending[i].hca_path;
+				replacements[replacement_count].from_wav = pending[i].from_wav;
+				replacements[replacement_count].frame_size = pending[i].frame_size;
+				replacements[replacement_count].size = pending[i].size;
+				if (sources) sources[replacement_count] = i;
+				replacement_count++;
+				break;
+			}
 		}
 	}
+	return replacement_count;
+}
 
-	// Calculate total size difference including padding
-	long size_diff = (new_size + padding) - original_size;
-	long remaining_data = total_size - content_end;
-
-	// Allocate buffer with error handling
-	char* buffer = malloc(SAFE_BUFFER_SIZE);
-	if (!buffer) return -1;
-
-	// Handle data movement if size changes
-	if (size_diff != 0 && remaining_data > 0) {
-		if (size_diff > 0) {
-			// Move data forward (working backwards)
-			for (long pos = remaining_data; pos > 0; pos -= SAFE_BUFFER_SIZE) {
-				long chunk_size = (pos > SAFE_BUFFER_SIZE) ? SAFE_BUFFER_SIZE : pos;
-				long read_pos = content_end + pos - chunk_size;
-				long write_pos = read_pos + size_diff;
-
-				if (fseek(target, read_pos, SEEK_SET) != 0) {
-					free(buffer);
-					return -1;
-				}
-
-				size_t bytes_read = fread(buffer, 1, chunk_size, target);
-				if (bytes_read != chunk_size) {
-					free(buffer);
-					return -1;
-				}
-
-				if (fseek(target, write_pos, SEEK_SET) != 0) {
-					free(buffer);
-					return -1;
-				}
-
-				if (fwrite(buffer, 1, bytes_read, target) != bytes_read) {
-					free(buffer);
-					return -1;
-				}
-			}
-		} else {
-			// Move data backward (working forwards)
-			for (long pos = 0; pos < remaining_data; pos += SAFE_BUFFER_SIZE) {
-				long chunk_size = (remaining_data - pos > SAFE_BUFFER_SIZE) ?
-				                  SAFE_BUFFER_SIZE : remaining_data - pos;
-
-				if (fseek(target, content_end + pos, SEEK_SET) != 0) {
-					free(buffer);
-					return -1;
-				}
+// Fixed size mode: checks every slot of each AWB before anything is written,
+// so all the tracks that don't fit are reported up front and then skipped.
+// WAVs are fitted to their slot, their uasset copy is encoded again to match
+static bool check_fixed_slots(InjectionInfo* injections,
+                              int injection_count, bool* skipped) {
+	PendingReplacement* pending = malloc(injection_count * sizeof(PendingReplacement));
+	int* owners = malloc(injection_count * sizeof(int));
+	bool* done = calloc(injection_count, sizeof(bool));
+	AwbReplacement* replacements = malloc(injection_count * sizeof(AwbReplacement));
+	int* sources = malloc(injection_count * sizeof(int));
+	bool* fits = malloc(injection_count * sizeof(bool));
+	bool success = pending && owners && done && replacements && sources && fits;
+
+	int pending_count = 0;
+	for (int i = 0; i < injection_count && success; i++) {
+		if (injections[i].index == -1) continue;
+		set_pending(&pending[pending_count], &injections[i]);
+		owners[pending_count++] = i;
+	}
 
-				size_t bytes_read = fread(buffer, 1, chunk_size, target);
-				if (bytes_read != chunk_size) {
-					free(buffer);
-					return -1;
-				}
+	for (int i = 0; i < pending_count && success; i++) {
+		if (done[i]) continue;
 
-				if (fseek(target, content_start + new_size + padding + pos, SEEK_SET) != 0) {
-					free(buffer);
-					return -1;
-				}
+		CachedHeaders* target = get_cached_headers(pending[i].target_file);
+		if (!target) {
+			success = false;
+			break;
+		}
 
-				if (fwrite(buffer, 1, bytes_read, target) != bytes_read) {
-					free(buffer);
-					return -1;
-				}
-			}
+		int replacement_count = collect_replacements(target, pending + i,
+		                                             pending_count - i, done + i,
+		                                             replacements, sources);
+		if (check_awb_slots(pending[i].target_file, target->headers, target->count,
+		                    replacements, replacement_count, fits) < 0) {
+			success = false;
+			break;
+		}
 
-			// Truncate immediately after moving data for shrinking case
-			if (ftruncate(fileno(target), total_size + size_diff) != 0) {
-				free(buffer);
-				return -1;
+		for (int r = 0; r < replacement_count; r++) {
+			InjectionInfo* injection = &injections[owners[i + sources[r]]];
+			skipped[owners[i + sources[r]]] = !fits[r];
+			if (!fits[r] || replacements[r].frame_size == injection->frame_size) continue;
+
+			injection->frame_size = replacements[r].frame_size;
+			if (!encode_wav_prefix(injection->hca_path, injection->frame_size,
+			                       injection->new_header, &injection->hca_size) ||
+			        injection->hca_size != replacements[r].size) {
+				fprintf(stderr, "Error: Could not encode %s\n",
+				        extract_name_from_path(injection->hca_path));
+				skipped[owners[i + sources[r]]] = true;
 			}
 		}
 	}
 
-	// Write new content
-	if (fseek(target, content_start, SEEK_SET) != 0) {
-		free(buffer);
-		return -1;
+	free(pending);
+	free(owners);
+	free(done);
+	free(replacements);
+	free(sources);
+	free(fits);
+	return success;
+}
+
+// Rebuilds one AWB with all of its queued replacements, then updates its
+// cached headers and its table in the in-memory uasset tables
+static bool rebuild_target(FileTransaction* transaction,
+                           UassetOffsetTables* offset_tables,
+                           const PendingReplacement* pending, int pending_count,
+                           bool* done) {
+	const char* target_file = pending[0].target_file;
+
+	CachedHeaders* target = get_cached_headers(target_file);
+	const char* output_path = file_transaction_stage(transaction, target_file);
+	if (!target || !output_path) {
+		return false;
 	}
 
-	// Copy new content
-	size_t total_written = 0;
-	while (total_written < (size_t)new_size) {
-		size_t remaining = new_size - total_written;
-		size_t chunk_size = (remaining > SAFE_BUFFER_SIZE) ? SAFE_BUFFER_SIZE :
-		                    remaining;
-
-		size_t bytes_read = fread(buffer, 1, chunk_size, new_hca);
-		if (bytes_read == 0) {
-			free(buffer);
-			return -1;
-		}
+	AwbReplacement* replacements = malloc(pending_count * sizeof(AwbReplacement));
+	if (!replacements) {
+		return false;
+	}
 
-		if (fwrite(buffer, 1, bytes_read, target) != bytes_read) {
-			free(buffer);
-			return -1;
-		}
+	int replacement_count = collect_replacements(target, pending, pending_count,
+	                                             done, replacements, NULL);
 
-		total_written += bytes_read;
+	long file_end_offset = 0;
+	if (!rebuild_awb(target_file, output_path, target->headers, target->count,
+	                 replacements, replacement_count, &file_end_offset)) {
+		fprintf(stderr, "Failed to replace file content\n");
+		free(replacements);
+		return false;
 	}
+	free(replacements);
+	target->dirty = true;
 
-	// Write padding bytes
-	if (padding > 0) {
-		char zero_buffer[32] = {0};
-		if (fwrite(zero_buffer, 1, padding, target) != padding) {
-			free(buffer);
-			return -1;
-		}
-		fflush(target);
+	if (!offset_tables_set_awb(offset_tables, target_file, target->headers,
+	                           target->count, file_end_offset)) {
+		fprintf(stderr, "Failed to update offsets, your uasset is corrupted.\n");
+		return false;
 	}
+	return true;
+}
 
-	// Final size verification and adjustment
-	if (fseek(target, 0, SEEK_END) != 0) {
-		free(buffer);
-		return -1;
+// Fixed size mode: writes the queued replacements of one AWB over their
+// tracks in its working copy, nothing moves so the offsets stay as they are
+static bool fill_target_slots(FileTransaction* transaction,
+                              const PendingReplacement* pending, int pending_count,
+                              bool* done) {
+	const char* target_file = pending[0].target_file;
+
+	CachedHeaders* target = get_cached_headers(target_file);
+	const char* work_path = file_transaction_open(transaction, target_file);
+	if (!target || !work_path) {
+		fprintf(stderr, "Error opening target file: %s\n", target_file);
+		return false;
 	}
 
-	long final_size = ftell(target);
-	if (final_size != total_size + size_diff) {
-		if (ftruncate(fileno(target), total_size + size_diff) != 0) {
-			free(buffer);
-			return -1;
-		}
+	AwbReplacement* replacements = malloc(pending_count * sizeof(AwbReplacement));
+	if (!replacements) {
+		return false;
 	}
 
-	free(buffer);
-	return 0;
+	int replacement_count = collect_replacements(target, pending, pending_count,
+	                                             done, replacements, NULL);
+	bool success = write_awb_slots(work_path, target->headers, target->count,
+	                               replacements, replacement_count);
+	free(replacements);
+	return success;
 }
 
 bool inject_hca(const char* container_path, InjectionInfo* injections,
@@ -222,34 +293,56 @@ bool inject_hca(const char* container_path, InjectionInfo* injections,
 
 	printf("Processing container: %s\n", extract_name_from_path(container_path));
 
-	FILE* container = fopen(container_path, "r+b");
+	create_backup(container_path);
+
+	// Every file is edited through a working copy, the copies replace the
+	// originals together once the whole container went through
+	FileTransaction transaction;
+	char journal_path[MAX_PATH];
+	get_program_file_path(INJECTION_JOURNAL, journal_path, sizeof(journal_path));
+	file_transaction_begin(&transaction, journal_path);
+
+	const char* container_work = file_transaction_open(&transaction, container_path);
+	FILE* container = container_work ? fopen(container_work, "r+b") : NULL;
 	if (!container) {
 		fprintf(stderr, "Error opening container file\n");
+		file_transaction_abort(&transaction);
 		return false;
 	}
 
-	create_backup(container_path);
-
 	// Get target uasset headers - headers CSV should be in same directory as target file
 	UAssetHeader* uasset_headers = NULL;
 	int uasset_header_count = 0;
-	char uasset_header_csv[MAX_PATH];
-
-	// Get directory path of target uasset file
-	char target_uasset_dir[MAX_PATH] = {0};
-	strcpy(target_uasset_dir, get_parent_directory(container_path));
+	char uasset_header_index[MAX_PATH];
 
-	snprintf(uasset_header_csv, sizeof(uasset_header_csv),
-	         "%s_uasset_headers.csv", get_basename(container_path));
+	snprintf(uasset_header_index, sizeof(uasset_header_index),
+	         "%s_uasset_headers", get_basename(container_path));
 
 	// Only needed once since containers are grouped
-	if (read_header_csv(uasset_header_csv, &uasset_headers,
-	                    &uasset_header_count) != 0) {
+	if (load_header_index(uasset_header_index, container_path, &uasset_headers,
+	                      &uasset_header_count) != 0) {
 		fclose(container);
+		file_transaction_abort(&transaction);
 		free(uasset_headers);
 		return false;
 	}
 
+	PendingReplacement* pending = malloc(injection_count * sizeof(PendingReplacement));
+	bool* done = calloc(injection_count, sizeof(bool));
+	bool* skipped = calloc(injection_count, sizeof(bool));
+	int pending_count = 0;
+	if (!pending || !done || !skipped ||
+	        (fixed_size && !check_fixed_slots(injections, injection_count, skipped))) {
+		fprintf(stderr, "Error: Could not prepare the injections\n");
+		fclose(container);
+		file_transaction_abort(&transaction);
+		free(uasset_headers);
+		free(pending);
+		free(done);
+		free(skipped);
+		return false;
+	}
+
 	// Process each injection
 	for (int i = 0; i < injection_count; i++) {
 		// Skip injections that were already processed (marked with index -1)
@@ -257,33 +350,27 @@ bool inject_hca(const char* container_path, InjectionInfo* injections,
 
 
 
-		// Get target file headers - headers CSV should be in same directory as target file
-		HCAHeader* target_headers = NULL;
-		int target_header_count = 0;
-		char header_csv[MAX_PATH];
-
-		// Get directory path of target file
-		char target_dir[MAX_PATH] = {0};
-		strcpy(target_dir, get_parent_directory(injections[i].target_file));
-
-		snprintf(header_csv, sizeof(header_csv), "%s\\%s_headers.csv",
-		         target_dir, get_basename(injections[i].target_file));
-
-		// Why read and write each time? I don't want to implement a cache and there
-		// are multiple AWBs for the same container
-		if (read_header_csv(header_csv, &target_headers, &target_header_count) != 0) {
+		// Get target file headers, cached since there are multiple AWBs for the
+		// same container
+		CachedHeaders* target_cache = get_cached_headers(injections[i].target_file);
+		if (!target_cache) {
 			fclose(container);
+			file_transaction_abort(&transaction);
 			free(uasset_headers);
-			free(target_headers);
-			fclose(container);
+			free(pending);
+			free(done);
+			free(skipped);
 			return false;
 		}
+		HCAHeader* target_headers = target_cache->headers;
+		int target_header_count = target_cache->count;
 
 		bool header_found = false;
 		// Find matching header in target headers
 		for (int j = 0; j < target_header_count; j++) {
 			if (target_headers[j].index == injections[i].index) {
 				header_found = true;
+				if (skipped[i]) break; // Already reported
 
 				printf("Injecting %s at index (%d)\n",
 				       extract_name_from_path(injections[i].hca_path), injections[i].index);
@@ -303,55 +390,15 @@ bool inject_hca(const char* container_path, InjectionInfo* injections,
 					continue; // Skip to the next injection
 				}
 
-				// Read new HCA file
+				// The HCA itself is written once its whole AWB is known
 				FILE* new_hca = fopen(injections[i].hca_path, "rb");
 				if (!new_hca) {
 					fprintf(stderr, "Error opening new HCA file: %s\n", injections[i].hca_path);
 					continue;
 				}
-
-				// Read target file
-				FILE* target = fopen(injections[i].target_file, "r+b");
-				if (!target) {
-					fprintf(stderr, "Error opening target file: %s\n", injections[i].target_file);
-					fclose(new_hca);
-					continue;
-				}
-
-				fseek(target, 0, SEEK_END);
-				long file_end_offset = ftell(target);
-
-				// Get file sizes
-				fseek(new_hca, 0, SEEK_END);
-				long new_size = ftell(new_hca);
-				fseek(new_hca, 0, SEEK_SET);
+				fclose(new_hca);
 
 				long next_offset;
-				if (j < target_header_count - 1)
-					next_offset = target_headers[j + 1].offset;
-				else
-					next_offset = file_end_offset;
-
-				long original_size = next_offset - target_headers[j].offset;
-
-				// Check if the new file is too large to replace the existing content
-				if (fixed_size && new_size > original_size) {
-					int thousands = original_size / (1024 * 1000);
-					int remainder = (original_size / 1024) % 1000;
-					if (thousands)
-						fprintf(stderr,
-						        "-> Error: New HCA file is larger than the original %d,%dKB. File skipped.\n\n",
-						        thousands, remainder);
-					else
-						fprintf(stderr,
-						        "-> Error: New HCA file is larger than the original %dKB. File skipped.\n\n",
-						        remainder);
-
-					fclose(new_hca);
-					fclose(target);
-					continue; // Skip this injection and move to the next
-				}
-
 				if (uasset_header_index < uasset_header_count - 1)
 					next_offset = uasset_headers[uasset_header_index + 1].offset;
 				else
@@ -362,97 +409,10 @@ bool inject_hca(const char* container_path, InjectionInfo* injections,
 				                              injections[i].new_header, HCA_MAX_SIZE)) {
 					fprintf(stderr, "Failed to replace header in uasset for index %d\n",
 					        injections[i].index);
-					fclose(new_hca);
-					fclose(target);
 					continue;
 				}
 
-				// Perform replacement
-				fseek(target, target_headers[j].offset, SEEK_SET);
-
-				if (fixed_size) {
-					// Option 1: Replace content and zero out remaining bytes if new content is smaller
-					long remaining = original_size - new_size;
-					long buffer_size = (remaining > 0) ? original_size : new_size;
-
-					char* buffer = malloc(buffer_size);
-					if (buffer) {
-						// Write new HCA content
-						fread(buffer, 1, new_size, new_hca);
-						fwrite(buffer, 1, new_size, target);
-
-						// If new content is smaller, zero out remaining bytes
-						if (new_size < original_size) {
-							// Zero out the remaining bytes if there's any remaining space
-							memset(buffer, 0, remaining);  // Only zero out remaining space
-							fwrite(buffer, 1, remaining, target);
-						}
-
-						free(buffer);
-					} else {
-						fprintf(stderr, "Memory allocation failed for buffer\n");
-					}
-
-					fclose(target);
-					fclose(new_hca);
-				} else {
-					// Option 2: Delete and shift content
-					int padding_count;
-					int result = replaceFileContent(target, new_hca, target_headers, j,
-					                                target_header_count, file_end_offset, &padding_count);
-					if (result != 0) {
-						// Handle error
-						fprintf(stderr, "Failed to replace file content\n");
-						fclose(target);
-						fclose(new_hca);
-						free(uasset_headers);
-						free(target_headers);
-						fclose(container);
-						return false;
-					}
-
-					fclose(target);
-					fclose(new_hca);
-
-					long size_difference = new_size - original_size + padding_count;
-
-					recalculate_subsequent_offsets(target_headers, target_header_count,
-					                               j, size_difference);
-
-					if (write_header_csv(header_csv, target_headers, target_header_count) != 0) {
-						fprintf(stderr, "Failed to update target headers CSV file\n");
-						free(uasset_headers);
-						free(target_headers);
-						fclose(container);
-						return false;
-					}
-
-					file_end_offset += size_difference;
-
-					// After injection is complete, update offsets
-					// injections[i].index OR get_file_index_start(injections[i].target_file)
-					if (!update_offset_range(injections[i].target_file, container_path,
-					                         target_headers,
-					                         get_file_index_start(injections[i].target_file), target_header_count, file_end_offset)) {
-						fprintf(stderr, "Failed to update offsets, your uasset is corrupted.\n");
-						free(uasset_headers);
-						free(target_headers);
-						fclose(container);
-						return false;
-					}
-					// This one subtracts padding 0s as the game originally does, to a T
-					// Yet it for some reason doesn't like it
-					/*if (!update_offset_range_with_padding(injections[i].target_file, container_path,
-					                                      target_headers,
-					                                      get_file_index_start(injections[i].target_file),
-					                                      target_header_count, file_end_offset, size_difference, padding_count)) {
-						fprintf(stderr, "Failed to update offsets, your uasset is corrupted.\n");
-						free(uasset_headers);
-						free(target_headers);
-						fclose(container);
-						return false;
-					}*/
-				}
+				set_pending(&pending[pending_count++], &injections[i]);
 				break;
 			}
 		}
@@ -461,11 +421,71 @@ bool inject_hca(const char* container_path, InjectionInfo* injections,
 			fprintf(stderr, "No matching header found for index %d\n",
 			        injections[i].index);
 		}
+	}
 
-		free(target_headers);
+	// Header writes must reach the uasset before its offset tables are updated
+	free(uasset_headers);
+	bool success = fclose(container) == 0;
+	if (!success) {
+		fprintf(stderr, "Error writing container file\n");
 	}
 
-	return true;
+	// Fixed size: tracks are overwritten in place, one AWB at a time
+	if (success && fixed_size) {
+		for (int i = 0; i < pending_count && success; i++) {
+			if (done[i]) continue;
+			success = fill_target_slots(&transaction, pending + i, pending_count - i,
+			                            done + i);
+		}
+	}
+
+	// Rebuild every AWB that had tracks replaced, one pass each
+	UassetOffsetTables offset_tables;
+	if (success && !fixed_size && pending_count > 0) {
+		success = offset_tables_load(container_work, &offset_tables);
+		if (!success) {
+			fprintf(stderr, "Failed to read AFS2 tables of %s\n",
+			        extract_name_from_path(container_path));
+		}
+
+		for (int i = 0; i < pending_count && success; i++) {
+			if (done[i]) continue;
+			success = rebuild_target(&transaction, &offset_tables, pending + i,
+			                         pending_count - i, done + i);
+		}
+
+		// Uasset offsets of every rebuilt AWB, one write per port
+		if (success && !offset_tables_flush(&offset_tables)) {
+			fprintf(stderr, "Failed to update offsets of %s\n",
+			        extract_name_from_path(container_path));
+			success = false;
+		}
+		offset_tables_free(&offset_tables);
+	}
+	free(pending);
+	free(done);
+	free(skipped);
+
+	if (!success) {
+		// Nothing was written to the originals, drop the offsets of the
+		// rebuilt copies too
+		fprintf(stderr, "No changes were made to %s\n",
+		        extract_name_from_path(container_path));
+		file_transaction_abort(&transaction);
+		free_header_cache();
+		return false;
+	}
+
+	if (file_transaction_commit(&transaction) != 0) {
+		fprintf(stderr, "Error: Could not save the changes to %s, they are "
+		        "finished the next time the tool runs\n",
+		        extract_name_from_path(container_path));
+		free_header_cache();
+		return false;
+	}
+
+	// Header indexes of the rebuilt AWBs, once per container
+	return write_back_headers();
 }
 
 bool replace_header_at_offset(FILE * file, long offset, long next_offset,
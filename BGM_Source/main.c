@@ -2,6 +2,7 @@
 #include "file_processor.h"
 #include "config.h"
 #include "utils.h"
+#include "awb_rebuild.h"
 #include <stdio.h>
 #include <dirent.h>
 
@@ -9,6 +10,10 @@ extern Config config;
 int extract_flag = 0;
 int fixed_size = 0;
 int cmd = 0;
+int thread_count = 0; // 0 = one per CPU
+int export_csv = 0;
+int verify_only = 0;
+HcaEncodeOptions encode_options = {0}; // for WAVs given instead of HCAs
 
 int main(int argc, char* argv[]) {
 	if (argc < 2) {
@@ -38,6 +43,19 @@ int main(int argc, char* argv[]) {
 			cmd = 1;
 		} else if (strcmp(argv[i], "--fixed-size") == 0) {
 			fixed_size = 1;
+		} else if (strcmp(argv[i], "--csv") == 0) {
+			export_csv = 1;
+		} else if (strcmp(argv[i], "--verify") == 0) {
+			verify_only = 1;
+		} else if (strcmp(argv[i], "--loop") == 0) {
+			encode_options.loop = true;
+		} else if (strcmp(argv[i], "--resample") == 0) {
+			encode_options.sample_rate = 48000;
+		} else if (strncmp(argv[i], "--hca-key=", 10) == 0) {
+			encode_options.key = strtoull(argv[i] + 10, NULL, 10);
+		} else if (strncmp(argv[i], "--threads=", 10) == 0) {
+			thread_count = atoi(argv[i] + 10);
+			if (thread_count < 0) thread_count = 0;
 		}
 	}
 
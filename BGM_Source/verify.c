@@ -0,0 +1,219 @@
+#include "verify.h"
+#include "utils.h"
+#include "afs2.h"
+#include "hca_verify.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <dirent.h>
+
+extern int thread_count;
+
+static void report(const char* name, int result, uint32_t bad_frame) {
+	if (result == HCA_VERIFY_BAD_FRAME) {
+		printf("Error: %s is corrupted (frame %u fails its checksum)\n", name, bad_frame);
+	} else if (result == HCA_VERIFY_TRUNCATED) {
+		printf("Error: %s is corrupted (cut off before its last frame)\n", name);
+	} else {
+		printf("Error: %s is corrupted (not an HCA or damaged header)\n", name);
+	}
+}
+
+typedef struct {
+	const char** paths;
+	const MappedFile* awb;
+	const Afs2Entry* entries;
+	int* results;
+	uint32_t* bad_frames;
+} VerifyJob;
+
+static void verify_path(void* context, int i, int worker) {
+	(void)worker;
+	VerifyJob* job = context;
+	// No path for WAVs, they are encoded on the way in
+	job->results[i] = job->paths[i] ? hca_verify_file(job->paths[i], &job->bad_frames[i]) :
+	                  HCA_VERIFY_OK;
+}
+
+static void verify_entry(void* context, int i, int worker) {
+	(void)worker;
+	VerifyJob* job = context;
+	const Afs2Entry* entry = &job->entries[i];
+	if (entry->offset >= job->awb->size) {
+		job->results[i] = HCA_VERIFY_TRUNCATED;
+		return;
+	}
+
+	uint64_t available = job->awb->size - entry->offset;
+	job->results[i] = hca_verify(job->awb->data + entry->offset,
+	                             entry->size < available ? entry->size : available,
+	                             &job->bad_frames[i]);
+}
+
+// Runs task over count items on all cores, results are left in the job.
+// Returns -1 if the job couldn't be allocated or started
+static int run_verify(VerifyJob* job, int count, ParallelTask task) {
+	job->results = calloc(count, sizeof(int));
+	job->bad_frames = calloc(count, sizeof(uint32_t));
+	if (!job->results || !job->bad_frames ||
+	        parallel_for(count, thread_count, task, job) != 0) {
+		fprintf(stderr, "Error: Could not start the verification\n");
+		free(job->results);
+		free(job->bad_frames);
+		return -1;
+	}
+	return 0;
+}
+
+int verify_hca_folder(const char* dirpath) {
+	DIR* dir = opendir(dirpath);
+	if (!dir) {
+		fprintf(stderr, "Error: Could not open directory: %s\n", dirpath);
+		return -1;
+	}
+
+	// Paths are collected first so the files can be checked on all cores
+	char (*names)[MAX_PATH] = NULL;
+	const char** paths = NULL;
+	int count = 0;
+	int capacity = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		const char* ext = get_file_extension(entry->d_name);
+		if (!ext || strcasecmp(ext, "hca") != 0) continue;
+
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			void* grown = realloc(names, capacity * sizeof(*names));
+			if (!grown) {
+				fprintf(stderr, "Error: Could not allocate memory for the file list\n");
+				free(names);
+				closedir(dir);
+				return -1;
+			}
+			names = grown;
+		}
+		snprintf(names[count++], MAX_PATH, "%s\\%s", dirpath, entry->d_name);
+	}
+	closedir(dir);
+
+	if (count == 0) {
+		printf("No HCAs found in %s\n", extract_name_from_path(dirpath));
+		free(names);
+		return 0;
+	}
+
+	paths = malloc(count * sizeof(const char*));
+	if (!paths) {
+		free(names);
+		return -1;
+	}
+	for (int i = 0; i < count; i++) {
+		paths[i] = names[i];
+	}
+	VerifyJob job = {paths, NULL, NULL, NULL, NULL};
+	if (run_verify(&job, count, verify_path) != 0) {
+		free(names);
+		free(paths);
+		return -1;
+	}
+
+	int broken = 0;
+	for (int i = 0; i < count; i++) {
+		if (job.results[i] != HCA_VERIFY_OK) {
+			report(extract_name_from_path(names[i]), job.results[i], job.bad_frames[i]);
+			broken++;
+		}
+	}
+	printf("%d of %d HCAs in %s are intact\n", count - broken, count,
+	       extract_name_from_path(dirpath));
+
+	free(job.results);
+	free(job.bad_frames);
+	free(names);
+	free(paths);
+	return broken;
+}
+
+int verify_awb_file(const char* filename) {
+	MappedFile awb;
+	if (mapped_file_open(filename, &awb) != 0) {
+		fprintf(stderr, "Error: Could not map AWB file: %s\n", filename);
+		return -1;
+	}
+
+	Afs2Archive archive;
+	if (!awb.data || afs2_parse(awb.data, (size_t)awb.size, &archive) != 0) {
+		fprintf(stderr, "Error: %s is not a valid AWB\n", extract_name_from_path(filename));
+		mapped_file_close(&awb);
+		return -1;
+	}
+
+	int count = (int)archive.count;
+	VerifyJob job = {NULL, &awb, archive.entries, NULL, NULL};
+	if (count > 0 && run_verify(&job, count, verify_entry) != 0) {
+		afs2_free(&archive);
+		mapped_file_close(&awb);
+		return -1;
+	}
+
+	int broken = 0;
+	char name[64];
+	for (int i = 0; i < count; i++) {
+		if (job.results[i] != HCA_VERIFY_OK) {
+			snprintf(name, sizeof(name), "Track %d (id %u)", i, archive.entries[i].id);
+			report(name, job.results[i], job.bad_frames[i]);
+			broken++;
+		}
+	}
+	printf("%d of %d tracks in %s are intact\n", count - broken, count,
+	       extract_name_from_path(filename));
+
+	if (count > 0) {
+		free(job.results);
+		free(job.bad_frames);
+	}
+	afs2_free(&archive);
+	mapped_file_close(&awb);
+	return broken;
+}
+
+int verify_injections(InjectionInfo* injections, int* injection_count) {
+	int count = *injection_count;
+	if (count == 0) {
+		return 0;
+	}
+
+	const char** paths = malloc(count * sizeof(const char*));
+	if (!paths) {
+		return 0;
+	}
+	for (int i = 0; i < count; i++) {
+		paths[i] = injections[i].from_wav ? NULL : injections[i].hca_path;
+	}
+	VerifyJob job = {paths, NULL, NULL, NULL, NULL};
+	if (run_verify(&job, count, verify_path) != 0) {
+		free(paths);
+		return 0;
+	}
+
+	int kept = 0;
+	char name[MAX_PATH + 32];
+	for (int i = 0; i < count; i++) {
+		if (job.results[i] != HCA_VERIFY_OK) {
+			snprintf(name, sizeof(name), "%s for index %d",
+			         extract_name_from_path(injections[i].hca_path), injections[i].index);
+			report(name, job.results[i], job.bad_frames[i]);
+			continue;
+		}
+		if (kept != i) {
+			injections[kept] = injections[i];
+		}
+		kept++;
+	}
+
+	free(job.results);
+	free(job.bad_frames);
+	free(paths);
+	*injection_count = kept;
+	return count - kept;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef AFS2_H
+#define AFS2_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Fixed part of an AFS2 header: magic, version, offset size, id size,
+// entry count, alignment and subkey
+#define AFS2_FIXED_HEADER_SIZE 0x10
+
+typedef struct {
+	uint32_t id;
+	uint64_t raw_offset; // Value stored in the offset table
+	uint64_t offset;     // raw_offset rounded up to the archive alignment
+	uint64_t size;       // Distance from offset to the next raw offset
+} Afs2Entry;
+
+typedef struct {
+	uint8_t version;
+	uint8_t offset_size;    // Width of each offset table entry (2, 4 or 8)
+	uint16_t id_size;       // Width of each id table entry (2 or 4)
+	uint32_t count;
+	uint16_t alignment;
+	uint16_t subkey;        // Used to derive per-AWB HCA keys
+	uint32_t ids_pos;       // Position of the id table, relative to the magic
+	uint32_t offsets_pos;   // Position of the offset table, relative to the magic
+	uint32_t header_size;   // Fixed header plus both tables
+	uint64_t end_offset;    // Last offset table entry (end of the last file)
+	Afs2Entry* entries;
+} Afs2Archive;
+
+/**
+ * @brief Decodes an AFS2 header and its id/offset tables from memory
+ *
+ * Only the header and tables are read, never the audio payload, so this is
+ * O(entries) regardless of the archive size.
+ *
+ * @param data Buffer starting at the "AFS2" magic
+ * @param size Number of valid bytes in data
+ * @param archive Receives the decoded tables, free with afs2_free()
+ * @return 0 on success, -1 if the data is not a complete AFS2 header
+ */
+int afs2_parse(const uint8_t* data, size_t size, Afs2Archive* archive);
+
+// Same as afs2_parse but only decodes the fixed header and table positions,
+// entries is left NULL and the table contents aren't validated
+int afs2_parse_layout(const uint8_t* data, size_t size, Afs2Archive* archive);
+
+// Same as afs2_parse but reads the header found at position base in file
+int afs2_read(FILE* file, long base, Afs2Archive* archive);
+
+// Opens path and reads the AFS2 header at its start
+int afs2_read_file(const char* path, Afs2Archive* archive);
+
+// Size of the header and tables described by the fixed 16 header bytes,
+// or 0 if they are not a valid AFS2 header
+uint32_t afs2_header_size(const uint8_t* fixed_header);
+
+bool afs2_is_magic(const uint8_t* data);
+
+// Stores value in slot index (0..count) of the offset table of a header
+// buffer described by archive, returns -1 if it doesn't fit the offset size
+int afs2_set_offset(uint8_t* header, const Afs2Archive* archive,
+                    uint32_t index, uint64_t value);
+
+void afs2_free(Afs2Archive* archive);
+
+#endif // AFS2_H
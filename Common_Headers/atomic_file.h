@@ -0,0 +1,32 @@
+#pragma once
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <stddef.h>
+
+// Name of the temporary file written next to path before it gets swapped in
+void atomic_file_temp_path(const char* path, char* temp_path, size_t size);
+
+/**
+ * @brief Replaces path with temp_path in one step
+ *
+ * Readers see either the old or the new file, never a partial one.
+ *
+ * @return 0 on success, -1 on failure (temp_path is left in place)
+ */
+int atomic_file_replace(const char* temp_path, const char* path);
+
+/**
+ * @brief Copies source to dest, sharing the data blocks where possible
+ *
+ * Tries a reflink (FICLONE) first, then copy_file_range, then a plain copy.
+ * On Windows CopyFile is used, which clones blocks itself on ReFS/Dev Drives.
+ *
+ * @return 0 on success, -1 on failure
+ */
+int atomic_file_clone(const char* source, const char* dest);
+
+// Flushes the contents of a closed file to disk, returns -1 on failure
+int atomic_file_sync(const char* path);
+
+#endif // ATOMIC_FILE_H
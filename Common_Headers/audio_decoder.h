@@ -0,0 +1,73 @@
+#pragma once
+#ifndef AUDIO_DECODER_H
+#define AUDIO_DECODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Compressed audio decoded to interleaved floats in [-1, 1]
+ *
+ * FLAC, Ogg Vorbis and MP3 are told apart by their contents. The file is
+ * read in blocks and at most one frame or packet is kept decoded, so a
+ * track of any length is streamed. Channels come out in WAV order.
+ */
+typedef struct AudioDecoder AudioDecoder;
+
+struct AudioDecoder {
+	unsigned channels;
+	unsigned sample_rate;
+	uint64_t frame_count;  // Samples per channel
+	bool has_loop;         // From LOOPSTART/LOOPLENGTH/LOOPEND comments
+	uint32_t loop_start;   // First looped sample
+	uint32_t loop_end;     // Sample after the last looped one
+	// Up to count frames, fewer only at the end or once the stream is corrupt
+	size_t (*read)(AudioDecoder* decoder, float* samples, size_t count);
+	void (*close)(AudioDecoder* decoder);
+};
+
+/**
+ * @brief Opens the audio of a file positioned at its start
+ *
+ * An ID3v2 tag in front of the audio is skipped. The file stays owned by the
+ * caller and must outlive the decoder.
+ *
+ * @return NULL if the file is none of the formats or can't be decoded
+ */
+AudioDecoder* audio_decoder_open(FILE* file);
+
+#define AUDIO_DECODER_EXTENSION_COUNT 3
+
+// Extensions of the files audio_decoder_open is meant for ("flac", "ogg", "mp3")
+extern const char* const audio_decoder_extensions[AUDIO_DECODER_EXTENSION_COUNT];
+
+// Whether extension is one of audio_decoder_extensions, case insensitive
+bool audio_decoder_handles(const char* extension);
+
+void audio_decoder_close(AudioDecoder* decoder);
+
+/* For the decoders */
+
+AudioDecoder* flac_decoder_open(FILE* file);
+AudioDecoder* vorbis_decoder_open(FILE* file);
+AudioDecoder* mp3_decoder_open(FILE* file);
+
+// Loop tags seen in a stream's Vorbis comments
+typedef struct {
+	bool has_start;
+	bool has_length;
+	bool has_end;
+	uint64_t start;
+	uint64_t length;
+	uint64_t end;
+} LoopComments;
+
+// Picks up one "NAME=value" comment if it is a loop tag
+void loop_comments_parse(LoopComments* loop, const char* comment, size_t length);
+
+// Sets the decoder's loop once its frame count is known
+void loop_comments_apply(const LoopComments* loop, AudioDecoder* decoder);
+
+#endif // AUDIO_DECODER_H
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "simd.h"
+
+#define BYTE_SCAN_MAX_PATTERN 16
+#define BYTE_SCAN_NOT_FOUND ((size_t)-1)
+
+/**
+ * @brief Finds the first occurrence of pattern in data
+ *
+ * Uses an AVX2 or SSE2 first/last byte filter when the CPU supports it,
+ * memchr + memcmp otherwise.
+ *
+ * @return Index of the match in data, or BYTE_SCAN_NOT_FOUND
+ */
+size_t byte_scan_find(const uint8_t* data, size_t size, const uint8_t* pattern,
+                      size_t length);
+
+typedef size_t (*ByteScanFind)(const uint8_t* data, size_t size,
+                               const uint8_t* pattern, size_t length);
+
+// byte_scan_find of one level, NULL if it has no version for that level
+ByteScanFind byte_scan_kernel(SimdLevel level);
+
+// Called for each match, return false to stop the scan
+typedef bool (*ByteScanCallback)(void* context, uint64_t position);
+
+// Scans a stream chunk by chunk, matches that straddle two chunks are found
+// too. Matches never overlap, scanning resumes after the end of each match
+typedef struct {
+	uint8_t pattern[BYTE_SCAN_MAX_PATTERN];
+	size_t length;
+	uint8_t tail[BYTE_SCAN_MAX_PATTERN - 1]; // End of the previous chunks
+	size_t tail_size;
+	uint64_t position;                       // Stream position of the next chunk
+	uint64_t next_match;                     // Earliest position a match may start
+	bool stopped;
+} ByteScanner;
+
+// Returns -1 if the pattern is empty or longer than BYTE_SCAN_MAX_PATTERN
+int byte_scanner_init(ByteScanner* scanner, const uint8_t* pattern,
+                      size_t length, uint64_t start_position);
+
+// Reports every match that ends in this chunk, returns false once the
+// callback stopped the scan
+bool byte_scanner_feed(ByteScanner* scanner, const uint8_t* chunk, size_t size,
+                       ByteScanCallback callback, void* context);
+
+// Position of the nth match (0 = first) at or after start in file, or -1
+long byte_scan_file_nth(FILE* file, long start, const uint8_t* pattern,
+                        size_t length, int n);
+
+/**
+ * @brief Collects the positions of every match in file
+ *
+ * @param positions Receives a malloc'd array, free it even on failure
+ * @return 0 on success, -1 on read or allocation failure
+ */
+int byte_scan_file_all(FILE* file, const uint8_t* pattern, size_t length,
+                       long** positions, int* count);
+
+#endif // BYTE_SCAN_H
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef FILE_TRANSACTION_H
+#define FILE_TRANSACTION_H
+
+#define FILE_TRANSACTION_MAX_PATH 1024
+
+typedef struct {
+	char path[FILE_TRANSACTION_MAX_PATH];
+	char temp_path[FILE_TRANSACTION_MAX_PATH]; // Where the new contents are written
+} TransactionFile;
+
+/**
+ * Groups the changes to several files so they land together or not at all.
+ *
+ * Changes are made to temporary copies, the originals are only touched by
+ * file_transaction_commit. The journal lists the copies and records the
+ * commit, so file_transaction_recover can tell whether an interrupted run
+ * has to be rolled back (copies deleted) or finished (copies swapped in).
+ */
+typedef struct {
+	char journal_path[FILE_TRANSACTION_MAX_PATH];
+	TransactionFile* files;
+	int count;
+} FileTransaction;
+
+void file_transaction_begin(FileTransaction* transaction, const char* journal_path);
+
+// Copy of path to edit in place (reflinked where the filesystem allows it),
+// or NULL on failure. The same copy is returned for repeated calls
+const char* file_transaction_open(FileTransaction* transaction, const char* path);
+
+// Path to write the complete new contents of path to, or NULL on failure
+const char* file_transaction_stage(FileTransaction* transaction, const char* path);
+
+// Flushes every copy and swaps them in, returns 0 on success, -1 on failure.
+// Once the commit is journaled a failed swap is finished by the next recovery
+int file_transaction_commit(FileTransaction* transaction);
+
+// Deletes every copy, the originals stay as they were
+void file_transaction_abort(FileTransaction* transaction);
+
+#define FILE_TRANSACTION_CLEAN 0
+#define FILE_TRANSACTION_ROLLED_BACK 1
+#define FILE_TRANSACTION_FINISHED 2
+
+// Cleans up after a run that was interrupted, returns one of the values
+// above, or -1 if a file could not be swapped in (the journal is kept)
+int file_transaction_recover(const char* journal_path);
+
+#endif // FILE_TRANSACTION_H
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef HCA_CIPHER_H
+#define HCA_CIPHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Builds the table mapping bytes stored under one cipher to the bytes
+ * stored under another
+ *
+ * Types are HCA_CIPHER_NONE, HCA_CIPHER_STATIC or HCA_CIPHER_KEYED, keys are
+ * only used by the keyed type.
+ *
+ * @return 0, or -1 for an unknown cipher type
+ */
+int hca_rekey_table(uint8_t table[256], unsigned from_type, uint64_t from_key,
+                    unsigned to_type, uint64_t to_key);
+
+/**
+ * @brief Re-encrypts one frame in place with a table from hca_rekey_table
+ *
+ * @return 0, or -1 if the frame fails its checksum (it is left unchanged)
+ */
+int hca_rekey_frame(uint8_t* frame, size_t size, const uint8_t table[256]);
+
+#define HCA_REKEY_WRITE_FAILED -1
+#define HCA_REKEY_BAD_INPUT -2
+
+/**
+ * @brief Re-encrypts an HCA file without decoding it
+ *
+ * The frames are read with the cipher type of the file's ciph chunk and
+ * from_key, and rewritten with to_type and to_key. The ciph chunk is updated
+ * (added if missing) and every checksum recomputed. The file is swapped in
+ * whole, a failure leaves the original untouched.
+ *
+ * @return 0, HCA_REKEY_WRITE_FAILED or HCA_REKEY_BAD_INPUT
+ */
+int hca_rekey_file(const char* path, uint64_t from_key, unsigned to_type, uint64_t to_key);
+
+#endif // HCA_CIPHER_H
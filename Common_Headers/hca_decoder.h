@@ -0,0 +1,52 @@
+#pragma once
+#ifndef HCA_DECODER_H
+#define HCA_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hca_format.h"
+
+typedef struct HcaDecoder HcaDecoder;
+
+/**
+ * @brief Sets up a decoder for a parsed header
+ *
+ * Handles versions 1.x to 3.0 with fixed frame sizes. ATH type 1 curves and
+ * variable bitrate streams aren't supported.
+ *
+ * @param key Type 56 cipher key, ignored for other cipher types
+ * @return NULL if the stream isn't supported or on allocation failure
+ */
+HcaDecoder* hca_decoder_create(const HcaInfo* info, uint64_t key);
+
+void hca_decoder_free(HcaDecoder* decoder);
+
+// Clears the overlap and noise state, call before decoding from a new position
+void hca_decoder_reset(HcaDecoder* decoder);
+
+/**
+ * @brief Decodes the next frame
+ *
+ * @param frame info->frame_size bytes as stored in the file
+ * @param samples Receives HCA_SAMPLES_PER_FRAME interleaved samples per
+ *                channel, including the encoder delay and padding
+ * @return 0, or -1 if the frame fails its checksum or doesn't unpack
+ */
+int hca_decoder_decode_frame(HcaDecoder* decoder, const uint8_t* frame, float* samples);
+
+#define HCA_DECODE_WRITE_FAILED -1
+#define HCA_DECODE_BAD_INPUT -2
+#define HCA_DECODE_UNSUPPORTED -3
+
+/**
+ * @brief Decodes an HCA file into a 16-bit PCM WAV
+ *
+ * Encoder delay and padding are trimmed. A partly written output is removed
+ * on failure.
+ *
+ * @return 0, HCA_DECODE_WRITE_FAILED, HCA_DECODE_BAD_INPUT or
+ *         HCA_DECODE_UNSUPPORTED
+ */
+int hca_decode_file(const char* hca_path, const char* wav_path, uint64_t key);
+
+#endif // HCA_DECODER_H
@@ -0,0 +1,55 @@
+#pragma once
+#ifndef HCA_DSP_H
+#define HCA_DSP_H
+
+#include <stdint.h>
+#include "simd.h"
+
+// Complex points of the FFT inside the 128-point DCT-IV
+#define HCA_FFT_SIZE 64
+
+/**
+ * Inner loops of the HCA transform and stereo reconstruction
+ *
+ * hca_dsp_get picks the set of simd_level() (AVX2, then SSE2 or NEON).
+ * Every set does the same float operations in the same order as the scalar
+ * one, so the results are bit-identical as long as the compiler doesn't fuse
+ * multiply-adds, which it doesn't for these x86 targets. Tests/check_simd
+ * compares each set the CPU runs against the scalar one.
+ */
+typedef struct {
+	const char* name;
+
+	// spectra[i] = gains[i] * values[i]
+	void (*dequantize)(float* spectra, const float* gains, const int32_t* values,
+	                   unsigned count);
+
+	// right[i] = left[i] * ratio_right, then left[i] *= ratio_left
+	void (*intensity_stereo)(float* left, float* right, float ratio_left,
+	                         float ratio_right, unsigned count);
+
+	// Mid/side to left/right, both scaled by sqrt(1/2) first
+	void (*mid_side_stereo)(float* left, float* right, unsigned count);
+
+	// (re, im)[i] *= (w_re, w_im)[i]
+	void (*complex_multiply)(float* re, float* im, const float* w_re, const float* w_im,
+	                         unsigned count);
+
+	// One radix-2 pass over HCA_FFT_SIZE points for blocks of size points,
+	// twiddles holds size / 2 factors
+	void (*fft_stage)(float* re, float* im, const float* tw_re, const float* tw_im,
+	                  unsigned size);
+
+	// Windows a DCT-IV output into 128 samples, adding and replacing the
+	// 128-sample overlap from the previous subframe
+	void (*imdct_window)(const float* dct, float* overlap, float* samples);
+} HcaDsp;
+
+// Best kernels for this CPU
+const HcaDsp* hca_dsp_get(void);
+
+// Kernels of one level, NULL if it isn't compiled in. SIMD_SCALAR gives the
+// reference the vector sets are checked against
+const HcaDsp* hca_dsp_kernels(SimdLevel level);
+
+#endif // HCA_DSP_H
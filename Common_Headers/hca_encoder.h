@@ -0,0 +1,99 @@
+#pragma once
+#ifndef HCA_ENCODER_H
+#define HCA_ENCODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hca_format.h"
+#include "wav_reader.h"
+
+// Raised whenever the same input and options encode to different bytes, so
+// HCAs kept from an older encoder aren't reused
+#define HCA_ENCODER_VERSION 2
+
+typedef struct {
+	uint64_t key;        // Type 56 cipher key, 0 writes an unencrypted file
+	bool loop;           // Without a range, hca_prepare_wav uses the WAV's own loop
+	uint32_t loop_start; // First looped sample
+	uint32_t loop_end;   // Sample after the last looped one, 0 = end of the audio
+	uint16_t frame_size; // Bytes per frame, 0 = 1/6 of the PCM bitrate
+	uint32_t sample_rate; // Rate WAVs are resampled to first, 0 keeps theirs
+} HcaEncodeOptions;
+
+typedef struct HcaEncoder HcaEncoder;
+
+/**
+ * @brief Readies an opened WAV for encoding and gives the options to encode it with
+ *
+ * The WAV is resampled to options->sample_rate when that is set and differs
+ * from its own. A loop asked for without a range (loop_start and loop_end
+ * both 0) takes the loop of the WAV's smpl chunk when it has one. Otherwise
+ * the audio is read once by loop_find before it is rewound, and only if no
+ * part of it repeats does the loop cover the whole file.
+ *
+ * @return 0, or -1 if the resampler couldn't be set up or the WAV rewound
+ */
+int hca_prepare_wav(WavReader* wav, const HcaEncodeOptions* options,
+                    HcaEncodeOptions* prepared);
+
+/**
+ * @brief Sets up a version 2.0 encoder at options->frame_size bytes per frame
+ *
+ * @param sample_count Samples per channel that will be fed in total
+ * @return NULL if the format isn't encodable, the frame size is too small to
+ * hold a frame or on allocation failure
+ */
+HcaEncoder* hca_encoder_create(unsigned channels, unsigned sample_rate,
+                               uint32_t sample_count, const HcaEncodeOptions* options);
+
+void hca_encoder_free(HcaEncoder* encoder);
+
+/**
+ * @brief Largest frame size that keeps the encoded file within budget bytes
+ *
+ * Every frame has the same size, so the file size is known before anything is
+ * encoded. The result is capped at the 16-bit PCM bitrate, which the encoder
+ * can't fill anyway.
+ *
+ * @param size Receives the size of the file with that frame size
+ * @return The frame size for options->frame_size, 0 if even the smallest
+ * frame doesn't fit
+ */
+unsigned hca_encoder_fit_frame_size(unsigned channels, unsigned sample_rate,
+                                    uint32_t sample_count, const HcaEncodeOptions* options,
+                                    uint64_t budget, uint64_t* size);
+
+// Header describing the stream, header->header_size is set after
+// hca_encoder_write_header
+const HcaInfo* hca_encoder_info(const HcaEncoder* encoder);
+
+// Returns the header size, or -1 if buffer is too small
+int hca_encoder_write_header(HcaEncoder* encoder, uint8_t* buffer, size_t size);
+
+/**
+ * @brief Encodes the next frame
+ *
+ * Call it info->frame_count times. Every call takes up to
+ * HCA_SAMPLES_PER_FRAME interleaved samples per channel, fewer only once the
+ * input has run out.
+ *
+ * @param frame Receives info->frame_size bytes, encrypted and checksummed
+ */
+void hca_encoder_encode_frame(HcaEncoder* encoder, const float* samples,
+                              unsigned count, uint8_t* frame);
+
+#define HCA_ENCODE_WRITE_FAILED -1
+#define HCA_ENCODE_BAD_INPUT -2
+
+/**
+ * @brief Encodes an opened WAV into an HCA file
+ *
+ * A partly written output is removed on failure.
+ *
+ * @return 0, HCA_ENCODE_WRITE_FAILED or HCA_ENCODE_BAD_INPUT
+ */
+int hca_encode_wav(WavReader* wav, const char* hca_path,
+                   const HcaEncodeOptions* options);
+
+#endif // HCA_ENCODER_H
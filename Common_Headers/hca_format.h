@@ -0,0 +1,138 @@
+#pragma once
+#ifndef HCA_FORMAT_H
+#define HCA_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define HCA_SAMPLES_PER_FRAME 1024
+#define HCA_SUBFRAMES 8
+#define HCA_SAMPLES_PER_SUBFRAME 128
+#define HCA_MAX_CHANNELS 16
+// Largest header hca_write_header produces
+#define HCA_MAX_HEADER_SIZE 0x60
+
+#define HCA_VERSION_V200 0x0200
+#define HCA_VERSION_V300 0x0300
+
+// ciph chunk types
+#define HCA_CIPHER_NONE 0
+#define HCA_CIPHER_STATIC 1
+#define HCA_CIPHER_KEYED 56
+
+typedef struct {
+	uint16_t version;
+	uint16_t header_size;       // Offset of the first frame
+	unsigned channels;
+	unsigned sample_rate;
+	uint32_t frame_count;
+	uint16_t encoder_delay;     // Samples dropped at the start of the first frame
+	uint16_t encoder_padding;   // Samples dropped at the end of the last frame
+	uint16_t frame_size;
+	uint8_t min_resolution;
+	uint8_t max_resolution;
+	uint8_t track_count;
+	uint8_t channel_config;
+	uint8_t total_band_count;
+	uint8_t base_band_count;
+	uint8_t stereo_band_count;
+	uint8_t bands_per_hfr_group;
+	uint8_t ms_stereo;          // Version 3.0 mid/side coding
+	bool vbr;                   // Variable frame sizes, frame_size is the maximum
+	uint16_t ath_type;
+	float volume;               // rva chunk, 1.0 without one
+	bool loop_enabled;
+	uint32_t loop_start_frame;
+	uint32_t loop_end_frame;
+	uint16_t loop_start_delay;  // Samples into loop_start_frame where the loop starts
+	uint16_t loop_end_padding;  // Samples after the loop end in loop_end_frame
+	uint16_t cipher_type;
+} HcaInfo;
+
+// CRC16 (polynomial 0x8005) used for the header and every frame. Running it
+// over a block that ends with its stored CRC gives 0
+uint16_t hca_crc16(const uint8_t* data, size_t size);
+
+/**
+ * @brief Writes the HCA, fmt, comp, loop and ciph chunks plus the header CRC
+ *
+ * Sets info->header_size to the number of bytes written.
+ *
+ * @return Header size, or -1 if buffer is smaller than the header
+ */
+int hca_write_header(HcaInfo* info, uint8_t* buffer, size_t size);
+
+// Returns the header size from the first 8 bytes, or -1 if data isn't an HCA
+int hca_header_size(const uint8_t* data, size_t size);
+
+/**
+ * @brief Parses a complete header, chunk IDs are matched with masked names
+ *
+ * Fields of absent chunks are left 0, except volume (1.0) and ath_type (1
+ * before version 2.0).
+ *
+ * @return 0, or -1 if the header is damaged or describes an impossible layout
+ */
+int hca_read_header(const uint8_t* data, size_t size, HcaInfo* info);
+
+// Reads and parses the header at the start of file, leaving file at the first
+// frame. Returns 0, or -1 if the header can't be read or is invalid
+int hca_read_file_header(FILE* file, HcaInfo* info);
+
+/**
+ * @brief Reads the header of the HCA file at path
+ *
+ * Only the header is read, through a stack buffer and without stdio
+ * buffering, so it is cheap enough to run over whole folders.
+ *
+ * @return 0, or -1 if the file can't be opened or isn't a valid HCA
+ */
+int hca_query_file(const char* path, HcaInfo* info);
+
+// Samples per channel once the encoder delay and padding are dropped
+uint32_t hca_sample_count(const HcaInfo* info);
+
+// Gets the loop as the first looped sample and the sample after the last one,
+// counted like hca_sample_count. Returns false if the HCA doesn't loop
+bool hca_loop_range(const HcaInfo* info, uint32_t* start, uint32_t* end);
+
+// Enables the loop from start to the sample before end, an end of 0 or past
+// the audio loops to the end. Returns -1 (leaving info as it was) if the
+// range is empty
+int hca_set_loop_range(HcaInfo* info, uint32_t start, uint32_t end);
+
+/**
+ * @brief Copies a header with one chunk's body replaced
+ *
+ * A missing chunk is inserted where the fixed chunk order puts it, taking
+ * the space from a pad chunk if there is enough of it and growing the header
+ * otherwise. The header size and CRC are updated. An existing chunk keeps its
+ * masked name.
+ *
+ * @param body Chunk contents after the name
+ * @return New header size, or -1 if id isn't a fixed-size chunk, the body has
+ * the wrong size or output is too small
+ */
+int hca_header_set_chunk(const uint8_t* header, size_t size, const char id[4],
+                         const uint8_t* body, size_t body_size,
+                         uint8_t* output, size_t output_size);
+
+// Offset of the chunk named id (as written, e.g. "ciph") in a header, or -1
+int hca_find_chunk(const uint8_t* header, size_t header_size, const char id[4]);
+
+/**
+ * @brief Builds the substitution table the decoder applies to every frame byte
+ *
+ * Type 56 derives the table from the 64-bit key, type 1 uses a fixed table
+ * and type 0 leaves bytes unchanged.
+ *
+ * @return 0, or -1 for an unknown cipher type
+ */
+int hca_cipher_init(uint8_t table[256], unsigned type, uint64_t key);
+
+// Inverts a decryption table into the matching encryption table
+void hca_cipher_invert(const uint8_t table[256], uint8_t inverse[256]);
+
+#endif // HCA_FORMAT_H
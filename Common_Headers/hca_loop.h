@@ -0,0 +1,25 @@
+#pragma once
+#ifndef HCA_LOOP_H
+#define HCA_LOOP_H
+
+#include <stdint.h>
+
+#define HCA_LOOP_WRITE_FAILED -1
+#define HCA_LOOP_BAD_INPUT -2
+
+/**
+ * @brief Sets the loop of an HCA file by patching its header
+ *
+ * start and end are counted like in hca_set_loop_range, an end of 0 loops
+ * to the end of the audio. Only the header changes, the frames are kept as
+ * they are so encrypted files stay encrypted with their key.
+ *
+ * The header is overwritten in place when it keeps its size (the loop chunk
+ * exists or fits in the padding), otherwise the file is swapped in whole and
+ * a failure leaves the original untouched.
+ *
+ * @return 0, HCA_LOOP_WRITE_FAILED or HCA_LOOP_BAD_INPUT
+ */
+int hca_set_loop_file(const char* path, uint32_t start, uint32_t end);
+
+#endif // HCA_LOOP_H
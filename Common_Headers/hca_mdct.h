@@ -0,0 +1,11 @@
+#pragma once
+#ifndef HCA_MDCT_H
+#define HCA_MDCT_H
+
+#define HCA_MDCT_SIZE 128
+
+// Orthonormal 128-point DCT-IV, its own inverse. The MDCT of both the encoder
+// and the decoder is a window and fold around it. input and output may alias
+void hca_dct4(const float* input, float* output);
+
+#endif // HCA_MDCT_H
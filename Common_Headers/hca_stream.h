@@ -0,0 +1,40 @@
+#pragma once
+#ifndef HCA_STREAM_H
+#define HCA_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hca_encoder.h"
+
+typedef struct HcaStream HcaStream;
+
+/**
+ * @brief Opens a WAV and starts encoding it to HCA on a thread of its own
+ *
+ * Encoded frames go through a ring of about ring_size bytes (at least one
+ * frame), the encoder waits whenever the ring is full, so memory use doesn't
+ * depend on the track length and nothing is written to disk.
+ *
+ * @return NULL if the WAV can't be read or encoded, or the thread can't start
+ */
+HcaStream* hca_stream_open(const char* wav_path, const HcaEncodeOptions* options,
+                           size_t ring_size);
+
+// Size of the whole HCA, known before any frame is encoded
+uint64_t hca_stream_size(const HcaStream* stream);
+
+/**
+ * @brief Waits for the next bytes of the HCA, the header first, then frames
+ *
+ * The returned block stays valid until the next call, which hands it back to
+ * the encoder.
+ *
+ * @return NULL once the whole HCA was read
+ */
+const uint8_t* hca_stream_read(HcaStream* stream, size_t* size);
+
+// Stops the encoder if it is still running and frees the stream. Returns 0
+// if the whole HCA was read, -1 otherwise
+int hca_stream_close(HcaStream* stream);
+
+#endif // HCA_STREAM_H
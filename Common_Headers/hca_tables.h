@@ -0,0 +1,27 @@
+#pragma once
+#ifndef HCA_TABLES_H
+#define HCA_TABLES_H
+
+#include <stdint.h>
+
+// Rising half of the 256-sample IMDCT window, the falling half is its mirror
+extern const float hca_window[128];
+
+// Dequantization step of a band is scaling[scalefactor] * range[resolution]
+extern const float hca_scaling_table[64];
+extern const float hca_range_table[16];
+
+// Bits read per coefficient, prefix codes for resolutions 1-7 are this long at most
+extern const uint8_t hca_max_bit_size[16];
+
+// Prefix code decode tables for resolutions 0-7, indexed by the next
+// hca_max_bit_size[resolution] bits: code length and coefficient value
+extern const uint8_t hca_quant_bit_count[8][16];
+extern const int8_t hca_quant_value[8][16];
+
+// Maps (noise level + 1 - 5 * scalefactor / 2) to a resolution, positions
+// past 56 only come up in version 3.0 streams and give 0 past the table
+#define HCA_INVERT_TABLE_SIZE 66
+extern const uint8_t hca_invert_table[HCA_INVERT_TABLE_SIZE];
+
+#endif // HCA_TABLES_H
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef HCA_VERIFY_H
+#define HCA_VERIFY_H
+
+#include <stdint.h>
+
+#define HCA_VERIFY_OK 0
+#define HCA_VERIFY_BAD_HEADER -1 // Not an HCA, or its header fails its CRC
+#define HCA_VERIFY_TRUNCATED -2  // Shorter than its frames
+#define HCA_VERIFY_BAD_FRAME -3  // A frame fails its CRC
+
+/**
+ * @brief Checks the header CRC and the CRC of every frame of an HCA
+ *
+ * Bytes after the last frame are ignored, so AWB entries can be checked with
+ * their alignment padding. Variable bitrate streams don't store their frame
+ * sizes in the header, only their header is checked.
+ *
+ * @param bad_frame Receives the first failing frame for HCA_VERIFY_BAD_FRAME
+ * @return One of the HCA_VERIFY_ codes
+ */
+int hca_verify(const uint8_t* data, uint64_t size, uint32_t* bad_frame);
+
+// Same as hca_verify for the file at path, which is mapped rather than read.
+// A file that can't be opened is reported as HCA_VERIFY_BAD_HEADER
+int hca_verify_file(const char* path, uint32_t* bad_frame);
+
+#endif // HCA_VERIFY_H
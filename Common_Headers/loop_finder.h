@@ -0,0 +1,27 @@
+#pragma once
+#ifndef LOOP_FINDER_H
+#define LOOP_FINDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "wav_reader.h"
+
+/**
+ * @brief Looks for the points a track can loop between without a seam
+ *
+ * Reads what is left of the reader, mixed down to mono and decimated to
+ * about 8 kHz. The autocorrelation of a 1 kHz version, taken with an FFT,
+ * proposes loop lengths. Each is checked block by block at 8 kHz, from the
+ * longest down, and the first stretch of audio that repeats at the same
+ * level for a few seconds gives the loop. It ends where the repetition
+ * does, before any fade-out or ending, and its length is refined to the
+ * exact sample. The 8 kHz signal is kept in memory, about 32 KB per second
+ * of audio whatever the source rate.
+ *
+ * @param start Receives the first looped sample
+ * @param end Receives the sample after the last looped one
+ * @return false if no part of the track repeats, or on allocation failure
+ */
+bool loop_find(WavReader* wav, uint32_t* start, uint32_t* end);
+
+#endif // LOOP_FINDER_H
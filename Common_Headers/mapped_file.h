@@ -0,0 +1,42 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdint.h>
+
+// Read-only view of a whole file
+typedef struct {
+	const uint8_t* data;
+	uint64_t size;
+#ifdef _WIN32
+	void* file_handle;
+	void* mapping_handle;
+#else
+	int fd;
+#endif
+} MappedFile;
+
+/**
+ * @brief Maps a file read-only into memory
+ *
+ * Empty files are valid and have a NULL data pointer.
+ *
+ * @return 0 on success, -1 on failure
+ */
+int mapped_file_open(const char* path, MappedFile* file);
+
+void mapped_file_close(MappedFile* file);
+
+/**
+ * @brief Writes size bytes starting at offset of a mapped file to dest_path
+ *
+ * Uses copy_file_range/sendfile where the kernel supports them so the data
+ * never passes through user space, otherwise writes straight from the mapping.
+ * No intermediate buffer is allocated either way.
+ *
+ * @return 0 on success, -1 on failure
+ */
+int mapped_file_write_range(const MappedFile* file, uint64_t offset,
+                            uint64_t size, const char* dest_path);
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef RANGE_WRITER_H
+#define RANGE_WRITER_H
+
+#include <stdint.h>
+
+// Existing file opened for positional writes, nothing is buffered
+typedef struct {
+#ifdef _WIN32
+	void* handle;
+#else
+	int fd;
+#endif
+} RangeWriter;
+
+// Opens an existing file without truncating it, returns 0 or -1
+int range_writer_open(const char* path, RangeWriter* writer);
+
+// Returns -1 if a write didn't reach the disk
+int range_writer_close(RangeWriter* writer);
+
+/**
+ * @brief Copies the first size bytes of source_path to offset
+ *
+ * Uses copy_file_range where the kernel supports it, otherwise goes through
+ * a fixed 64KB stack buffer, so memory use doesn't grow with the file.
+ *
+ * @return 0 on success, -1 on failure or if source_path is shorter than size
+ */
+int range_writer_copy_file(RangeWriter* writer, uint64_t offset,
+                           const char* source_path, uint64_t size);
+
+// Writes size bytes of data at offset, returns 0 or -1
+int range_writer_write(RangeWriter* writer, uint64_t offset, const uint8_t* data,
+                       uint64_t size);
+
+// Zeroes size bytes at offset without changing the file size. Whole blocks
+// are deallocated where the filesystem can punch holes, returns 0 or -1
+int range_writer_zero(RangeWriter* writer, uint64_t offset, uint64_t size);
+
+#endif // RANGE_WRITER_H
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Polyphase windowed-sinc sample rate converter
+ *
+ * Interleaved float frames go in with resampler_write and come out with
+ * resampler_read. The filter is a Kaiser windowed sinc cut off just below
+ * the lower of the two Nyquist frequencies, one set of taps per phase of the
+ * rate ratio. Its dot products run on simd_dot_kernel, whose vector
+ * versions give the same bits as the scalar one.
+ */
+typedef struct Resampler Resampler;
+
+// NULL for a rate of 0 or on allocation failure
+Resampler* resampler_create(unsigned channels, unsigned input_rate, unsigned output_rate);
+
+void resampler_free(Resampler* resampler);
+
+// Frames input_frames frames turn into, rounded to the nearest
+uint64_t resampler_output_frames(uint64_t input_frames, unsigned input_rate,
+                                 unsigned output_rate);
+
+// Takes up to frames input frames, returns how many fit into its buffer
+size_t resampler_write(Resampler* resampler, const float* samples, size_t frames);
+
+// Marks the end of the input, the filter is drained with silence from then on
+void resampler_finish(Resampler* resampler);
+
+/**
+ * @brief Produces up to frames output frames
+ *
+ * @return Fewer than frames only when more input has to be written first,
+ * after resampler_finish it always fills the request
+ */
+size_t resampler_read(Resampler* resampler, float* samples, size_t frames);
+
+#endif // RESAMPLER_H
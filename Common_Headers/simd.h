@@ -0,0 +1,87 @@
+#pragma once
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stddef.h>
+
+/**
+ * Vector support shared by the DSP modules
+ *
+ * 4-wide kernels are written once against the v4_* operations below, which
+ * map to SSE2 on x86 and NEON on ARM. AVX2 kernels are compiled per function
+ * with AVX2_FUNCTION and only run once simd_level reports that the CPU has it.
+ *
+ * The NEON mapping has never been compiled, so ARM builds use the scalar code
+ * unless SIMD_ENABLE_NEON is defined. ARM compilers fuse multiply-adds by
+ * default, which breaks the bit-identical results the checks expect: build
+ * with -ffp-contract=off and run Tests/check_simd before enabling it.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAVE_VECTOR4 1
+#define VECTOR4_NAME "sse2"
+typedef __m128 v4;
+#define v4_load _mm_loadu_ps
+#define v4_store _mm_storeu_ps
+#define v4_zero _mm_setzero_ps
+#define v4_set1 _mm_set1_ps
+#define v4_add _mm_add_ps
+#define v4_sub _mm_sub_ps
+#define v4_mul _mm_mul_ps
+#define v4_load_int(p) _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(p)))
+#define v4_reverse(v) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(0, 1, 2, 3))
+#elif defined(__ARM_NEON) && defined(SIMD_ENABLE_NEON)
+#include <arm_neon.h>
+#define HAVE_VECTOR4 1
+#define VECTOR4_NAME "neon"
+typedef float32x4_t v4;
+#define v4_load vld1q_f32
+#define v4_store vst1q_f32
+#define v4_zero() vdupq_n_f32(0.0f)
+#define v4_set1 vdupq_n_f32
+#define v4_add vaddq_f32
+#define v4_sub vsubq_f32
+#define v4_mul vmulq_f32
+#define v4_load_int(p) vcvtq_f32_s32(vld1q_s32(p))
+static inline v4 v4_reverse(v4 v) {
+	v4 swapped = vrev64q_f32(v);
+	return vcombine_f32(vget_high_f32(swapped), vget_low_f32(swapped));
+}
+#endif
+
+// AVX2 is compiled per function and only used when the CPU reports it
+#if defined(HAVE_VECTOR4) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2 1
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+typedef enum {
+	SIMD_SCALAR,
+	SIMD_VECTOR4, // SSE2 or NEON
+	SIMD_AVX2
+} SimdLevel;
+
+// Widest level the CPU runs among those compiled in, checked on the first call
+SimdLevel simd_level(void);
+
+// "scalar", "sse2", "neon" or "avx2"
+const char* simd_level_name(SimdLevel level);
+
+typedef float (*SimdDot)(const float* a, const float* b, size_t count);
+
+/**
+ * @brief Dot product kernel of a level
+ *
+ * Products are summed in 8 lanes that are folded in a fixed order, then the
+ * count % 8 tail is added in order, so every level gives the same bits.
+ *
+ * @return The kernel, or NULL if the level isn't compiled in
+ */
+SimdDot simd_dot_kernel(SimdLevel level);
+
+// Dot product with the kernel of simd_level()
+float simd_dot(const float* a, const float* b, size_t count);
+
+#endif // SIMD_H
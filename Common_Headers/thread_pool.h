@@ -0,0 +1,23 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Called once per index, worker is the id of the thread running it (0 = caller)
+typedef void (*ParallelTask)(void* context, int index, int worker);
+
+// Number of workers to use when the user didn't ask for a specific count
+int thread_pool_default_workers(void);
+
+/**
+ * @brief Runs task for every index in [0, count) on up to worker_count threads
+ *
+ * Each worker starts with a contiguous share of the indices and steals half of
+ * the largest remaining share once it runs out, so one slow index never holds
+ * up the others. The calling thread takes part as worker 0.
+ *
+ * @param worker_count Number of threads, 0 or less picks the default
+ * @return 0 when every index ran, -1 if the job could not be started
+ */
+int parallel_for(int count, int worker_count, ParallelTask task, void* context);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,106 @@
+#pragma once
+#ifndef WAV_READER_H
+#define WAV_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "audio_decoder.h"
+#include "resampler.h"
+
+#define WAV_READER_CANNOT_OPEN -1
+#define WAV_READER_UNSUPPORTED -2
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+// What the chunks of a RIFF or RF64 WAV say, no audio is read
+typedef struct {
+	unsigned format;         // Format tag, the sub-format's for WAVE_FORMAT_EXTENSIBLE
+	unsigned channels;
+	unsigned sample_rate;
+	unsigned bits_per_sample;
+	unsigned block_align;
+	bool rf64;
+	uint64_t data_offset;    // Position of the first sample
+	uint64_t frame_count;    // Samples per channel, cut to what the file holds
+	bool has_loop;           // First loop of the smpl chunk, if inside the audio
+	uint32_t loop_start;     // First looped sample
+	uint32_t loop_end;       // Sample after the last looped one
+} WavInfo;
+
+/**
+ * @brief Walks the chunks of an opened WAV
+ *
+ * Handles WAVE_FORMAT_EXTENSIBLE, RF64/BW64 (ds64 sizes), chunks with or
+ * without their odd-size padding byte and any LIST, cue or other chunk
+ * around the audio. The chunks before the audio come from a single small
+ * read, the ones after it (often smpl) from one more. The file position is
+ * left anywhere.
+ *
+ * @return 0 or WAV_READER_UNSUPPORTED, any format is accepted
+ */
+int wav_read_info(FILE* file, WavInfo* info);
+
+// Same as wav_read_info on a path, WAV_READER_CANNOT_OPEN if it can't be opened
+int wav_query_file(const char* path, WavInfo* info);
+
+// PCM or float WAV, or a FLAC, Ogg Vorbis or MP3, opened for sequential
+// reading of its audio
+typedef struct {
+	FILE* file;
+	unsigned channels;
+	unsigned sample_rate;
+	unsigned bits_per_sample;
+	unsigned block_align;
+	bool is_float;
+	uint32_t frame_count;  // Samples per channel
+	uint32_t frames_left;
+	bool has_loop;         // Loop of the smpl chunk, see WavInfo
+	uint32_t loop_start;
+	uint32_t loop_end;
+	Resampler* resampler;  // Set by wav_reader_resample
+	uint32_t source_frames_left;
+	AudioDecoder* decoder; // Set instead of the WAV fields for compressed files
+	uint64_t data_offset;  // Start of the audio, for wav_reader_rewind
+} WavReader;
+
+/**
+ * @brief Opens a WAV and positions it at the start of the audio
+ *
+ * Accepts 8/16/24/32-bit integer and 32-bit float samples. Files that don't
+ * start as a RIFF/RF64 WAV go to audio_decoder_open, whatever their name.
+ *
+ * @return 0, WAV_READER_CANNOT_OPEN or WAV_READER_UNSUPPORTED
+ */
+int wav_reader_open(const char* path, WavReader* reader);
+
+/**
+ * @brief Makes wav_reader_read return the audio at another sample rate
+ *
+ * Must come before the first read. sample_rate, frame_count and the loop
+ * are changed to match what will be read.
+ *
+ * @return 0, or -1 on allocation failure or if the result would be too long
+ */
+int wav_reader_resample(WavReader* reader, unsigned sample_rate);
+
+// Reads up to count frames as interleaved floats in [-1, 1], returns the
+// number of frames read (0 at the end or on a read error)
+size_t wav_reader_read(WavReader* reader, float* samples, size_t count);
+
+/**
+ * @brief Goes back to the first frame so the audio can be read again
+ *
+ * Compressed files are decoded again from the start. Not available once
+ * wav_reader_resample was called.
+ *
+ * @return 0, or -1 if the file can't be read again the same way
+ */
+int wav_reader_rewind(WavReader* reader);
+
+void wav_reader_close(WavReader* reader);
+
+#endif // WAV_READER_H
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef WAV_TAGGER_H
+#define WAV_TAGGER_H
+
+// RIFF INFO tags of one WAV, NULL fields are left out
+typedef struct {
+	const char* path;
+	const char* title;  // INAM
+	const char* album;  // IPRD
+	const char* artist; // IART
+	const char* genre;  // IGNR
+	const char* track;  // ITRK
+} WavTags;
+
+#define WAV_TAG_WRITE_FAILED -1
+#define WAV_TAG_BAD_INPUT -2
+
+/**
+ * @brief Replaces the LIST/INFO chunk of a WAV
+ *
+ * The chunks are walked from the RIFF header, the audio is never read or
+ * moved. An INFO list at the end of the file is rewritten where it is, one
+ * elsewhere is overwritten in place when the new one has the same size and
+ * turned into a JUNK chunk otherwise, the new list then going after the
+ * last chunk. The RIFF size is updated to match.
+ *
+ * @return 0, WAV_TAG_WRITE_FAILED or WAV_TAG_BAD_INPUT (not a RIFF WAV, RF64
+ * or cut short)
+ */
+int wav_tag_file(const WavTags* tags);
+
+/**
+ * @brief Tags a list of WAVs, one file per worker at a time
+ *
+ * @param worker_count Number of threads, 0 or less picks the default
+ * @return Number of files that could not be tagged, or -1 if the workers
+ * could not be started
+ */
+int wav_tag_files(const WavTags* files, int count, int worker_count);
+
+#endif // WAV_TAGGER_H
@@ -0,0 +1,18 @@
+#pragma once
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Writes a 44-byte 16-bit PCM header for frame_count samples per channel,
+// returns 0 or -1 on a write error
+int wav_write_header(FILE* file, unsigned channels, unsigned sample_rate,
+                     uint32_t frame_count);
+
+// Clips interleaved floats in [-1, 1] to 16 bits and appends them, returns 0
+// or -1 on a write error
+int wav_write_samples(FILE* file, const float* samples, size_t count);
+
+#endif // WAV_WRITER_H
@@ -0,0 +1,16 @@
+#pragma once
+#ifndef XXH64_H
+#define XXH64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 64-bit xxHash (XXH64) of a buffer
+ *
+ * Matches the reference implementation, so hashes can be compared with
+ * other tools. Not a cryptographic hash.
+ */
+uint64_t xxh64(const void* data, size_t size, uint64_t seed);
+
+#endif // XXH64_H
@@ -0,0 +1,170 @@
+#include "afs2.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t read_le(const uint8_t* data, int size) {
+	uint64_t value = 0;
+	for (int i = size - 1; i >= 0; i--) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+bool afs2_is_magic(const uint8_t* data) {
+	return data[0] == 'A' && data[1] == 'F' && data[2] == 'S' && data[3] == '2';
+}
+
+uint32_t afs2_header_size(const uint8_t* fixed_header) {
+	if (!afs2_is_magic(fixed_header)) {
+		return 0;
+	}
+
+	uint8_t offset_size = fixed_header[0x05];
+	uint16_t id_size = (uint16_t)read_le(fixed_header + 0x06, 2);
+	uint32_t count = (uint32_t)read_le(fixed_header + 0x08, 4);
+
+	if ((offset_size != 2 && offset_size != 4 && offset_size != 8) ||
+	        (id_size != 2 && id_size != 4) || count > 0x00FFFFFF) {
+		return 0;
+	}
+
+	return AFS2_FIXED_HEADER_SIZE + count * id_size + (count + 1) * offset_size;
+}
+
+int afs2_parse_layout(const uint8_t* data, size_t size, Afs2Archive* archive) {
+	memset(archive, 0, sizeof(*archive));
+
+	if (size < AFS2_FIXED_HEADER_SIZE) {
+		return -1;
+	}
+
+	uint32_t header_size = afs2_header_size(data);
+	if (header_size == 0 || header_size > size) {
+		return -1;
+	}
+
+	archive->version = data[0x04];
+	archive->offset_size = data[0x05];
+	archive->id_size = (uint16_t)read_le(data + 0x06, 2);
+	archive->count = (uint32_t)read_le(data + 0x08, 4);
+	archive->alignment = (uint16_t)read_le(data + 0x0C, 2);
+	archive->subkey = (uint16_t)read_le(data + 0x0E, 2);
+	archive->ids_pos = AFS2_FIXED_HEADER_SIZE;
+	archive->offsets_pos = archive->ids_pos + archive->count * archive->id_size;
+	archive->header_size = header_size;
+
+	if (archive->alignment == 0) {
+		archive->alignment = 1;
+	}
+
+	archive->end_offset = read_le(data + archive->offsets_pos +
+	                              archive->count * archive->offset_size,
+	                              archive->offset_size);
+	return 0;
+}
+
+int afs2_parse(const uint8_t* data, size_t size, Afs2Archive* archive) {
+	if (afs2_parse_layout(data, size, archive) != 0) {
+		return -1;
+	}
+
+	const uint8_t* ids = data + archive->ids_pos;
+	const uint8_t* offsets = data + archive->offsets_pos;
+
+	if (archive->count == 0) {
+		return 0;
+	}
+
+	archive->entries = malloc(archive->count * sizeof(Afs2Entry));
+	if (!archive->entries) {
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < archive->count; i++) {
+		Afs2Entry* entry = &archive->entries[i];
+		uint64_t next = read_le(offsets + (i + 1) * archive->offset_size,
+		                        archive->offset_size);
+
+		entry->id = (uint32_t)read_le(ids + i * archive->id_size, archive->id_size);
+		entry->raw_offset = read_le(offsets + i * archive->offset_size,
+		                            archive->offset_size);
+		entry->offset = entry->raw_offset;
+		if (entry->offset % archive->alignment) {
+			entry->offset += archive->alignment - entry->offset % archive->alignment;
+		}
+		entry->size = (next > entry->offset) ? next - entry->offset : 0;
+
+		if (next < entry->raw_offset) {
+			afs2_free(archive);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int afs2_read(FILE* file, long base, Afs2Archive* archive) {
+	uint8_t fixed[AFS2_FIXED_HEADER_SIZE];
+
+	memset(archive, 0, sizeof(*archive));
+	if (fseek(file, base, SEEK_SET) != 0 ||
+	        fread(fixed, 1, sizeof(fixed), file) != sizeof(fixed)) {
+		return -1;
+	}
+
+	uint32_t header_size = afs2_header_size(fixed);
+	if (header_size == 0) {
+		return -1;
+	}
+
+	// One read for the header and both tables
+	uint8_t* header = malloc(header_size);
+	if (!header) {
+		return -1;
+	}
+	memcpy(header, fixed, sizeof(fixed));
+
+	size_t table_bytes = header_size - sizeof(fixed);
+	if (fread(header + sizeof(fixed), 1, table_bytes, file) != table_bytes) {
+		free(header);
+		return -1;
+	}
+
+	int result = afs2_parse(header, header_size, archive);
+	free(header);
+	return result;
+}
+
+int afs2_read_file(const char* path, Afs2Archive* archive) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		memset(archive, 0, sizeof(*archive));
+		return -1;
+	}
+
+	int result = afs2_read(file, 0, archive);
+	fclose(file);
+	return result;
+}
+
+int afs2_set_offset(uint8_t* header, const Afs2Archive* archive,
+                    uint32_t index, uint64_t value) {
+	if (index > archive->count) {
+		return -1;
+	}
+	if (archive->offset_size < 8 && (value >> (archive->offset_size * 8)) != 0) {
+		return -1;
+	}
+
+	uint8_t* slot = header + archive->offsets_pos + index * archive->offset_size;
+	for (int i = 0; i < archive->offset_size; i++) {
+		slot[i] = (uint8_t)(value >> (i * 8));
+	}
+	return 0;
+}
+
+void afs2_free(Afs2Archive* archive) {
+	free(archive->entries);
+	archive->entries = NULL;
+	archive->count = 0;
+}
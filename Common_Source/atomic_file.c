@@ -0,0 +1,153 @@
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // copy_file_range
+#endif
+#include "atomic_file.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+void atomic_file_temp_path(const char* path, char* temp_path, size_t size) {
+	snprintf(temp_path, size, "%s.tmp", path);
+}
+
+#ifdef _WIN32
+
+int atomic_file_replace(const char* temp_path, const char* path) {
+	// Plain rename() refuses to overwrite on Windows
+	if (!MoveFileExA(temp_path, path,
+	                 MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		return -1;
+	}
+	return 0;
+}
+
+int atomic_file_clone(const char* source, const char* dest) {
+	return CopyFileA(source, dest, FALSE) ? 0 : -1;
+}
+
+int atomic_file_sync(const char* path) {
+	HANDLE handle = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+	                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+	BOOL flushed = FlushFileBuffers(handle);
+	CloseHandle(handle);
+	return flushed ? 0 : -1;
+}
+
+#else
+
+// Makes a rename inside the directory of path durable
+static void sync_parent_directory(const char* path) {
+	char directory[4096];
+	snprintf(directory, sizeof(directory), "%s", path);
+	char* slash = strrchr(directory, '/');
+	if (slash) {
+		*slash = '\0';
+	} else {
+		strcpy(directory, ".");
+	}
+
+	int fd = open(directory, O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+}
+
+int atomic_file_replace(const char* temp_path, const char* path) {
+	if (rename(temp_path, path) != 0) {
+		return -1;
+	}
+	sync_parent_directory(path);
+	return 0;
+}
+
+static int copy_contents(int source, int dest) {
+#ifdef __linux__
+	if (ioctl(dest, FICLONE, source) == 0) {
+		return 0;
+	}
+
+	ssize_t copied;
+	while ((copied = copy_file_range(source, NULL, dest, NULL, 1 << 30, 0)) > 0) {
+	}
+	if (copied == 0) {
+		return 0;
+	}
+	// Not supported between these files, copy whatever is left by hand
+	if (errno != EXDEV && errno != ENOSYS && errno != EOPNOTSUPP && errno != EINVAL) {
+		return -1;
+	}
+#endif
+
+	char buffer[64 * 1024];
+	ssize_t bytes;
+	while ((bytes = read(source, buffer, sizeof(buffer))) > 0) {
+		char* position = buffer;
+		while (bytes > 0) {
+			ssize_t written = write(dest, position, bytes);
+			if (written < 0) {
+				if (errno == EINTR) continue;
+				return -1;
+			}
+			position += written;
+			bytes -= written;
+		}
+	}
+	return bytes < 0 ? -1 : 0;
+}
+
+int atomic_file_clone(const char* source, const char* dest) {
+	int source_fd = open(source, O_RDONLY);
+	if (source_fd < 0) {
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(source_fd, &st) != 0) {
+		close(source_fd);
+		return -1;
+	}
+
+	int dest_fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+	if (dest_fd < 0) {
+		close(source_fd);
+		return -1;
+	}
+
+	int result = copy_contents(source_fd, dest_fd);
+	close(source_fd);
+	if (close(dest_fd) != 0) {
+		result = -1;
+	}
+	if (result != 0) {
+		unlink(dest);
+	}
+	return result;
+}
+
+int atomic_file_sync(const char* path) {
+	int fd = open(path, O_RDWR);
+	if (fd < 0) {
+		return -1;
+	}
+	int result = fsync(fd);
+	close(fd);
+	return result == 0 ? 0 : -1;
+}
+
+#endif
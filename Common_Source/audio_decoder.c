@@ -0,0 +1,128 @@
+#include "audio_decoder.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef _WIN32
+#define seek_file _fseeki64
+#define tell_file _ftelli64
+#else
+#define seek_file fseeko
+#define tell_file ftello
+#endif
+
+#define ID3_HEADER_SIZE 10
+#define ID3_FOOTER_FLAG 0x10
+
+// Skips ID3v2 tags, some taggers put them in front of FLACs as well as MP3s
+static bool skip_id3(FILE* file) {
+	uint8_t header[ID3_HEADER_SIZE];
+	for (;;) {
+		int64_t start = tell_file(file);
+		if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+		        memcmp(header, "ID3", 3) != 0 || ((header[6] | header[7] | header[8] |
+		                                           header[9]) & 0x80)) {
+			return seek_file(file, start, SEEK_SET) == 0;
+		}
+		// Sizes are stored 7 bits per byte
+		int64_t size = (int64_t)header[6] << 21 | header[7] << 14 | header[8] << 7 | header[9];
+		if (header[5] & ID3_FOOTER_FLAG) {
+			size += ID3_HEADER_SIZE;
+		}
+		if (seek_file(file, start + ID3_HEADER_SIZE + size, SEEK_SET) != 0) {
+			return false;
+		}
+	}
+}
+
+AudioDecoder* audio_decoder_open(FILE* file) {
+	if (!skip_id3(file)) {
+		return NULL;
+	}
+	int64_t start = tell_file(file);
+	uint8_t magic[4];
+	if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+	        seek_file(file, start, SEEK_SET) != 0) {
+		return NULL;
+	}
+
+	if (memcmp(magic, "fLaC", 4) == 0) {
+		return flac_decoder_open(file);
+	}
+	if (memcmp(magic, "OggS", 4) == 0) {
+		return vorbis_decoder_open(file);
+	}
+	return mp3_decoder_open(file);
+}
+
+const char* const audio_decoder_extensions[AUDIO_DECODER_EXTENSION_COUNT] = {
+	"flac", "ogg", "mp3"
+};
+
+bool audio_decoder_handles(const char* extension) {
+	for (int i = 0; extension && i < AUDIO_DECODER_EXTENSION_COUNT; i++) {
+		if (strcasecmp(extension, audio_decoder_extensions[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void audio_decoder_close(AudioDecoder* decoder) {
+	if (decoder) {
+		decoder->close(decoder);
+	}
+}
+
+void loop_comments_parse(LoopComments* loop, const char* comment, size_t length) {
+	static const char* names[] = {"LOOPSTART=", "LOOPLENGTH=", "LOOPEND="};
+	for (int i = 0; i < 3; i++) {
+		size_t name_length = strlen(names[i]);
+		if (length <= name_length || strncasecmp(comment, names[i], name_length) != 0) {
+			continue;
+		}
+
+		// Plain decimal sample counts only
+		uint64_t value = 0;
+		size_t p = name_length;
+		for (; p < length && comment[p] >= '0' && comment[p] <= '9'; p++) {
+			value = value * 10 + (uint64_t)(comment[p] - '0');
+		}
+		if (p != length || value > UINT32_MAX) {
+			return;
+		}
+
+		if (i == 0) {
+			loop->has_start = true;
+			loop->start = value;
+		} else if (i == 1) {
+			loop->has_length = true;
+			loop->length = value;
+		} else {
+			loop->has_end = true;
+			loop->end = value;
+		}
+		return;
+	}
+}
+
+void loop_comments_apply(const LoopComments* loop, AudioDecoder* decoder) {
+	if (!loop->has_start) {
+		return;
+	}
+	// LOOPLENGTH (RPG Maker) wins over LOOPEND, either defaults to the end
+	uint64_t end = decoder->frame_count;
+	if (loop->has_length) {
+		end = loop->start + loop->length;
+	} else if (loop->has_end) {
+		end = loop->end;
+	}
+	if (end > decoder->frame_count) {
+		end = decoder->frame_count;
+	}
+	if (loop->start < end) {
+		decoder->has_loop = true;
+		decoder->loop_start = (uint32_t)loop->start;
+		decoder->loop_end = (uint32_t)end;
+	}
+}
@@ -0,0 +1,296 @@
+#include "byte_scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SCAN_CHUNK_SIZE (1024 * 1024) // 1MB buffer
+
+static size_t find_scalar(const uint8_t* data, size_t size,
+                          const uint8_t* pattern, size_t length) {
+	if (length == 0) return 0;
+	if (size < length) return BYTE_SCAN_NOT_FOUND;
+
+	const uint8_t* p = data;
+	const uint8_t* end = data + size - length + 1; // One past the last start
+
+	while (p < end) {
+		p = memchr(p, pattern[0], end - p);
+		if (!p) break;
+		if (memcmp(p + 1, pattern + 1, length - 1) == 0) {
+			return p - data;
+		}
+		p++;
+	}
+	return BYTE_SCAN_NOT_FOUND;
+}
+
+// The vector versions are x86 only, the check for AVX2 implies an x86 build
+// with SSE2
+#ifdef HAVE_AVX2
+// Compares the first and last pattern byte at 16 starts at once, only starts
+// where both match get a full memcmp
+static size_t find_sse2(const uint8_t* data, size_t size,
+                        const uint8_t* pattern, size_t length) {
+	if (length < 2 || size < length) {
+		return find_scalar(data, size, pattern, length);
+	}
+
+	const __m128i first = _mm_set1_epi8((char)pattern[0]);
+	const __m128i last = _mm_set1_epi8((char)pattern[length - 1]);
+	size_t starts = size - length + 1;
+	size_t i = 0;
+
+	for (; i + 16 <= starts; i += 16) {
+		__m128i block_first = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i block_last = _mm_loadu_si128((const __m128i*)(data + i + length - 1));
+		unsigned mask = (unsigned)_mm_movemask_epi8(
+		                    _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+		                                  _mm_cmpeq_epi8(block_last, last)));
+		while (mask) {
+			int bit = __builtin_ctz(mask);
+			if (memcmp(data + i + bit + 1, pattern + 1, length - 2) == 0) {
+				return i + bit;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	size_t rest = find_scalar(data + i, size - i, pattern, length);
+	return (rest == BYTE_SCAN_NOT_FOUND) ? rest : i + rest;
+}
+
+// Same filter on 32 starts at once
+AVX2_FUNCTION static size_t find_avx2(const uint8_t* data, size_t size,
+                        const uint8_t* pattern, size_t length) {
+	if (length < 2 || size < length) {
+		return find_scalar(data, size, pattern, length);
+	}
+
+	const __m256i first = _mm256_set1_epi8((char)pattern[0]);
+	const __m256i last = _mm256_set1_epi8((char)pattern[length - 1]);
+	size_t starts = size - length + 1;
+	size_t i = 0;
+
+	for (; i + 32 <= starts; i += 32) {
+		__m256i block_first = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i block_last = _mm256_loadu_si256((const __m256i*)(data + i + length - 1));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(
+		                    _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+		                                     _mm256_cmpeq_epi8(block_last, last)));
+		while (mask) {
+			int bit = __builtin_ctz(mask);
+			if (memcmp(data + i + bit + 1, pattern + 1, length - 2) == 0) {
+				return i + bit;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	size_t rest = find_sse2(data + i, size - i, pattern, length);
+	return (rest == BYTE_SCAN_NOT_FOUND) ? rest : i + rest;
+}
+#endif
+
+ByteScanFind byte_scan_kernel(SimdLevel level) {
+	switch (level) {
+	case SIMD_SCALAR:
+		return find_scalar;
+#ifdef HAVE_AVX2
+	case SIMD_VECTOR4:
+		return find_sse2;
+	case SIMD_AVX2:
+		return find_avx2;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+size_t byte_scan_find(const uint8_t* data, size_t size, const uint8_t* pattern,
+                      size_t length) {
+	ByteScanFind find = byte_scan_kernel(simd_level());
+	if (!find) {
+		find = find_scalar; // NEON builds have no vector version
+	}
+	return find(data, size, pattern, length);
+}
+
+int byte_scanner_init(ByteScanner* scanner, const uint8_t* pattern,
+                      size_t length, uint64_t start_position) {
+	memset(scanner, 0, sizeof(*scanner));
+	if (length == 0 || length > BYTE_SCAN_MAX_PATTERN) {
+		return -1;
+	}
+
+	memcpy(scanner->pattern, pattern, length);
+	scanner->length = length;
+	scanner->position = start_position;
+	scanner->next_match = start_position;
+	return 0;
+}
+
+// Reports the matches found in data, where data[0] sits at stream position
+// base. Only matches starting before limit are reported
+static bool scan_block(ByteScanner* scanner, const uint8_t* data, size_t size,
+                       uint64_t base, size_t limit, ByteScanCallback callback,
+                       void* context) {
+	for (;;) {
+		// Resume after the previous match so matches never overlap
+		size_t offset = 0;
+		if (scanner->next_match > base) {
+			if (scanner->next_match - base >= limit) {
+				return true;
+			}
+			offset = (size_t)(scanner->next_match - base);
+		}
+
+		size_t found = byte_scan_find(data + offset, size - offset, scanner->pattern,
+		                              scanner->length);
+		if (found == BYTE_SCAN_NOT_FOUND || offset + found >= limit) {
+			return true;
+		}
+
+		uint64_t position = base + offset + found;
+		scanner->next_match = position + scanner->length;
+		if (!callback(context, position)) {
+			scanner->stopped = true;
+			return false;
+		}
+	}
+}
+
+bool byte_scanner_feed(ByteScanner* scanner, const uint8_t* chunk, size_t size,
+                       ByteScanCallback callback, void* context) {
+	if (scanner->stopped) {
+		return false;
+	}
+
+	size_t keep = scanner->length - 1;
+
+	// 1. Matches that start in the previous chunks and end in this one
+	if (scanner->tail_size > 0 && size > 0) {
+		uint8_t joined[2 * BYTE_SCAN_MAX_PATTERN];
+		size_t head = (size < keep) ? size : keep;
+		memcpy(joined, scanner->tail, scanner->tail_size);
+		memcpy(joined + scanner->tail_size, chunk, head);
+
+		if (!scan_block(scanner, joined, scanner->tail_size + head,
+		                scanner->position - scanner->tail_size, scanner->tail_size,
+		                callback, context)) {
+			return false;
+		}
+	}
+
+	// 2. Matches inside the chunk
+	if (!scan_block(scanner, chunk, size, scanner->position, size, callback,
+	                context)) {
+		return false;
+	}
+
+	// 3. Keep the last length - 1 bytes for the next chunk
+	if (size >= keep) {
+		memcpy(scanner->tail, chunk + size - keep, keep);
+		scanner->tail_size = keep;
+	} else {
+		size_t total = scanner->tail_size + size;
+		size_t drop = (total > keep) ? total - keep : 0;
+		memmove(scanner->tail, scanner->tail + drop, scanner->tail_size - drop);
+		memcpy(scanner->tail + scanner->tail_size - drop, chunk, size);
+		scanner->tail_size = total - drop;
+	}
+
+	scanner->position += size;
+	return true;
+}
+
+typedef struct {
+	int remaining;
+	long position;
+} NthMatch;
+
+static bool take_nth(void* context, uint64_t position) {
+	NthMatch* match = context;
+	if (match->remaining-- == 0) {
+		match->position = (long)position;
+		return false;
+	}
+	return true;
+}
+
+long byte_scan_file_nth(FILE* file, long start, const uint8_t* pattern,
+                        size_t length, int n) {
+	ByteScanner scanner;
+	if (n < 0 || byte_scanner_init(&scanner, pattern, length, start) != 0 ||
+	        fseek(file, start, SEEK_SET) != 0) {
+		return -1;
+	}
+
+	uint8_t* buffer = malloc(SCAN_CHUNK_SIZE);
+	if (!buffer) {
+		return -1;
+	}
+
+	NthMatch match = {n, -1};
+	size_t bytes_read;
+	while ((bytes_read = fread(buffer, 1, SCAN_CHUNK_SIZE, file)) > 0) {
+		if (!byte_scanner_feed(&scanner, buffer, bytes_read, take_nth, &match)) {
+			break;
+		}
+	}
+
+	free(buffer);
+	return match.position;
+}
+
+typedef struct {
+	long* positions;
+	int count;
+	int capacity;
+	bool failed;
+} MatchList;
+
+static bool collect_match(void* context, uint64_t position) {
+	MatchList* list = context;
+	if (list->count == list->capacity) {
+		int capacity = list->capacity ? list->capacity * 2 : 64;
+		long* positions = realloc(list->positions, capacity * sizeof(long));
+		if (!positions) {
+			list->failed = true;
+			return false;
+		}
+		list->positions = positions;
+		list->capacity = capacity;
+	}
+	list->positions[list->count++] = (long)position;
+	return true;
+}
+
+int byte_scan_file_all(FILE* file, const uint8_t* pattern, size_t length,
+                       long** positions, int* count) {
+	*positions = NULL;
+	*count = 0;
+
+	ByteScanner scanner;
+	if (byte_scanner_init(&scanner, pattern, length, 0) != 0 ||
+	        fseek(file, 0, SEEK_SET) != 0) {
+		return -1;
+	}
+
+	uint8_t* buffer = malloc(SCAN_CHUNK_SIZE);
+	if (!buffer) {
+		return -1;
+	}
+
+	MatchList list = {0};
+	size_t bytes_read;
+	while ((bytes_read = fread(buffer, 1, SCAN_CHUNK_SIZE, file)) > 0) {
+		if (!byte_scanner_feed(&scanner, buffer, bytes_read, collect_match, &list)) {
+			break;
+		}
+	}
+	bool read_failed = ferror(file) != 0;
+
+	free(buffer);
+	*positions = list.positions;
+	*count = list.count;
+	return (list.failed || read_failed) ? -1 : 0;
+}
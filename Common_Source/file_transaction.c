@@ -0,0 +1,235 @@
+#include "file_transaction.h"
+#include "atomic_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMMIT_RECORD "commit"
+
+// Writes the whole journal next to it and swaps it in, it only holds a few
+// lines. A crash leaves the previous journal or the new one, never a torn one
+static int write_journal(const FileTransaction* transaction, int committed) {
+	char temp_path[FILE_TRANSACTION_MAX_PATH + 4];
+	atomic_file_temp_path(transaction->journal_path, temp_path, sizeof(temp_path));
+	FILE* journal = fopen(temp_path, "wb");
+	if (!journal) {
+		return -1;
+	}
+
+	for (int i = 0; i < transaction->count; i++) {
+		fprintf(journal, "file\t%s\t%s\n", transaction->files[i].path,
+		        transaction->files[i].temp_path);
+	}
+	if (committed) {
+		fprintf(journal, COMMIT_RECORD "\n");
+	}
+
+	if (fclose(journal) != 0 || atomic_file_sync(temp_path) != 0 ||
+	        atomic_file_replace(temp_path, transaction->journal_path) != 0) {
+		remove(temp_path);
+		return -1;
+	}
+	return 0;
+}
+
+static const char* find_file(const FileTransaction* transaction, const char* path) {
+	for (int i = 0; i < transaction->count; i++) {
+		if (strcmp(transaction->files[i].path, path) == 0) {
+			return transaction->files[i].temp_path;
+		}
+	}
+	return NULL;
+}
+
+// Records path in the journal before its copy exists, so a crash never
+// leaves a copy recovery doesn't know about
+static TransactionFile* add_file(FileTransaction* transaction, const char* path) {
+	if (strlen(path) + 5 > FILE_TRANSACTION_MAX_PATH) {
+		return NULL;
+	}
+
+	TransactionFile* files = realloc(transaction->files,
+	                                 (transaction->count + 1) * sizeof(TransactionFile));
+	if (!files) {
+		return NULL;
+	}
+	transaction->files = files;
+
+	TransactionFile* file = &files[transaction->count++];
+	snprintf(file->path, sizeof(file->path), "%s", path);
+	atomic_file_temp_path(path, file->temp_path, sizeof(file->temp_path));
+
+	if (write_journal(transaction, 0) != 0) {
+		transaction->count--;
+		return NULL;
+	}
+	return file;
+}
+
+void file_transaction_begin(FileTransaction* transaction, const char* journal_path) {
+	memset(transaction, 0, sizeof(*transaction));
+	snprintf(transaction->journal_path, sizeof(transaction->journal_path), "%s",
+	         journal_path);
+}
+
+const char* file_transaction_open(FileTransaction* transaction, const char* path) {
+	const char* existing = find_file(transaction, path);
+	if (existing) {
+		return existing;
+	}
+
+	TransactionFile* file = add_file(transaction, path);
+	if (!file) {
+		return NULL;
+	}
+	if (atomic_file_clone(file->path, file->temp_path) != 0) {
+		return NULL;
+	}
+	return file->temp_path;
+}
+
+const char* file_transaction_stage(FileTransaction* transaction, const char* path) {
+	const char* existing = find_file(transaction, path);
+	if (existing) {
+		return existing;
+	}
+
+	TransactionFile* file = add_file(transaction, path);
+	return file ? file->temp_path : NULL;
+}
+
+static void end_transaction(FileTransaction* transaction) {
+	remove(transaction->journal_path);
+	free(transaction->files);
+	transaction->files = NULL;
+	transaction->count = 0;
+}
+
+static int file_exists(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return 0;
+	}
+	fclose(file);
+	return 1;
+}
+
+int file_transaction_commit(FileTransaction* transaction) {
+	if (transaction->count == 0) {
+		end_transaction(transaction);
+		return 0;
+	}
+
+	// 1. Every copy is on disk before the commit is recorded
+	for (int i = 0; i < transaction->count; i++) {
+		const char* temp_path = transaction->files[i].temp_path;
+		if (file_exists(temp_path) && atomic_file_sync(temp_path) != 0) {
+			file_transaction_abort(transaction);
+			return -1;
+		}
+	}
+
+	// 2. From here on recovery finishes the commit instead of undoing it
+	if (write_journal(transaction, 1) != 0) {
+		file_transaction_abort(transaction);
+		return -1;
+	}
+
+	// 3. Swap the copies in, a copy that was staged but never written is skipped
+	int result = 0;
+	for (int i = 0; i < transaction->count; i++) {
+		const TransactionFile* file = &transaction->files[i];
+		if (file_exists(file->temp_path) &&
+		        atomic_file_replace(file->temp_path, file->path) != 0) {
+			result = -1;
+		}
+	}
+
+	if (result != 0) {
+		// Keep the journal so the next run can finish the swap
+		free(transaction->files);
+		transaction->files = NULL;
+		transaction->count = 0;
+		return -1;
+	}
+
+	end_transaction(transaction);
+	return 0;
+}
+
+void file_transaction_abort(FileTransaction* transaction) {
+	for (int i = 0; i < transaction->count; i++) {
+		remove(transaction->files[i].temp_path);
+	}
+	end_transaction(transaction);
+}
+
+int file_transaction_recover(const char* journal_path) {
+	// A journal that was still being written never replaced the last one
+	char temp_path[FILE_TRANSACTION_MAX_PATH + 4];
+	atomic_file_temp_path(journal_path, temp_path, sizeof(temp_path));
+	remove(temp_path);
+
+	FILE* journal = fopen(journal_path, "rb");
+	if (!journal) {
+		return FILE_TRANSACTION_CLEAN;
+	}
+
+	FileTransaction transaction;
+	file_transaction_begin(&transaction, journal_path);
+
+	int committed = 0;
+	char line[2 * FILE_TRANSACTION_MAX_PATH + 16];
+	while (fgets(line, sizeof(line), journal)) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if (strcmp(line, COMMIT_RECORD) == 0) {
+			committed = 1;
+			continue;
+		}
+
+		// file\t<path>\t<temp path>
+		char* path = strchr(line, '\t');
+		char* temp_path = path ? strchr(path + 1, '\t') : NULL;
+		if (strncmp(line, "file", 4) != 0 || !temp_path) {
+			continue; // Not a file record
+		}
+		*temp_path++ = '\0';
+		path++;
+
+		TransactionFile* files = realloc(transaction.files,
+		                                 (transaction.count + 1) * sizeof(TransactionFile));
+		if (!files) {
+			fclose(journal);
+			free(transaction.files);
+			return -1;
+		}
+		transaction.files = files;
+		snprintf(files[transaction.count].path, FILE_TRANSACTION_MAX_PATH, "%s", path);
+		snprintf(files[transaction.count].temp_path, FILE_TRANSACTION_MAX_PATH, "%s",
+		         temp_path);
+		transaction.count++;
+	}
+	fclose(journal);
+
+	if (!committed) {
+		file_transaction_abort(&transaction);
+		return FILE_TRANSACTION_ROLLED_BACK;
+	}
+
+	int result = FILE_TRANSACTION_FINISHED;
+	for (int i = 0; i < transaction.count; i++) {
+		const TransactionFile* file = &transaction.files[i];
+		if (file_exists(file->temp_path) &&
+		        atomic_file_replace(file->temp_path, file->path) != 0) {
+			result = -1;
+		}
+	}
+
+	if (result < 0) {
+		free(transaction.files); // Keep the journal for another attempt
+		return -1;
+	}
+	end_transaction(&transaction);
+	return result;
+}
@@ -0,0 +1,530 @@
+#include "audio_decoder.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_BUFFER_SIZE 65536
+#define STREAMINFO_SIZE 34
+#define BLOCK_STREAMINFO 0
+#define BLOCK_VORBIS_COMMENT 4
+#define MAX_CHANNELS 8
+#define MAX_BLOCK_SIZE 65535
+#define MAX_LPC_ORDER 32
+// Deeper samples would overflow the 32-bit side channel
+#define MAX_BITS_PER_SAMPLE 24
+
+#define CHANNELS_LEFT_SIDE 8
+#define CHANNELS_RIGHT_SIDE 9
+#define CHANNELS_MID_SIDE 10
+
+// Bits are read most significant first
+typedef struct {
+	FILE* file;
+	uint8_t* buffer;
+	size_t size;
+	size_t position;
+	uint64_t cache;  // Next bits at the top
+	int bits;
+	int padding;     // Zero bits at the bottom of the cache once the file has ended
+	bool eof;
+	bool ended;      // Reads went past the end of the file
+} BitInput;
+
+typedef struct {
+	AudioDecoder base;
+	BitInput input;
+	unsigned bits_per_sample;
+	int32_t* samples[MAX_CHANNELS];
+	unsigned block_size;
+	unsigned block_position;
+	float scale;
+	bool failed;
+} FlacDecoder;
+
+static void refill(BitInput* in) {
+	while (in->bits <= 56) {
+		if (in->position == in->size) {
+			in->size = fread(in->buffer, 1, INPUT_BUFFER_SIZE, in->file);
+			in->position = 0;
+			if (in->size == 0) {
+				// Zeros, enough for any read to finish
+				in->eof = true;
+				in->padding += 8;
+				in->bits += 8;
+				continue;
+			}
+		}
+		in->cache |= (uint64_t)in->buffer[in->position++] << (56 - in->bits);
+		in->bits += 8;
+	}
+}
+
+static uint32_t read_bits(BitInput* in, int count) {
+	if (count == 0) {
+		return 0;
+	}
+	if (in->bits < count) {
+		refill(in);
+	}
+	uint32_t value = (uint32_t)(in->cache >> (64 - count));
+	in->cache <<= count;
+	in->bits -= count;
+	if (in->bits < in->padding) {
+		in->ended = true;
+	}
+	return value;
+}
+
+static int32_t read_signed(BitInput* in, int count) {
+	if (count == 0) {
+		return 0;
+	}
+	uint32_t value = read_bits(in, count);
+	uint32_t sign = 1u << (count - 1);
+	return (int32_t)((value ^ sign) - sign);
+}
+
+// Zeros before the next one bit
+static uint32_t read_unary(BitInput* in) {
+	uint32_t count = 0;
+	for (;;) {
+		if (in->bits == 0) {
+			refill(in);
+		}
+		if (in->cache != 0) {
+			int zeros = __builtin_clzll(in->cache);
+			if (zeros < in->bits - in->padding) {
+				in->cache <<= zeros + 1;
+				in->bits -= zeros + 1;
+				return count + (uint32_t)zeros;
+			}
+		}
+		if (in->eof) {
+			in->ended = true;
+			return count;
+		}
+		count += (uint32_t)in->bits;
+		in->cache = 0;
+		in->bits = 0;
+	}
+}
+
+static void align_to_byte(BitInput* in) {
+	int extra = in->bits & 7;
+	in->cache <<= extra;
+	in->bits -= extra;
+}
+
+// Reads whole bytes, the bit position has to be byte aligned
+static bool read_bytes(BitInput* in, uint8_t* data, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		data[i] = (uint8_t)read_bits(in, 8);
+	}
+	return !in->ended;
+}
+
+static bool skip_bytes(BitInput* in, uint64_t count) {
+	while (count > 0 && in->bits > 0) {
+		read_bits(in, 8);
+		count--;
+	}
+	while (count > 0) {
+		if (in->position == in->size) {
+			in->size = fread(in->buffer, 1, INPUT_BUFFER_SIZE, in->file);
+			in->position = 0;
+			if (in->size == 0) {
+				in->eof = true;
+				in->ended = true;
+				return false;
+			}
+		}
+		size_t step = in->size - in->position;
+		if (step > count) {
+			step = (size_t)count;
+		}
+		in->position += step;
+		count -= step;
+	}
+	return true;
+}
+
+static uint32_t read_le32(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+	       ((uint32_t)p[3] << 24);
+}
+
+/* Frames */
+
+static void decode_residual_partition(BitInput* in, int32_t* residual, unsigned count,
+                                      int parameter_bits) {
+	unsigned escape = (1u << parameter_bits) - 1;
+	unsigned parameter = read_bits(in, parameter_bits);
+	if (parameter == escape) {
+		int bits = (int)read_bits(in, 5);
+		for (unsigned i = 0; i < count; i++) {
+			residual[i] = read_signed(in, bits);
+		}
+		return;
+	}
+	for (unsigned i = 0; i < count; i++) {
+		uint32_t value = (read_unary(in) << parameter) | read_bits(in, (int)parameter);
+		residual[i] = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+	}
+}
+
+// Residual of the samples after the first order warm-up ones
+static bool decode_residual(BitInput* in, int32_t* residual, unsigned block_size,
+                            unsigned order) {
+	unsigned method = read_bits(in, 2);
+	if (method > 1) {
+		return false;
+	}
+	unsigned partition_order = read_bits(in, 4);
+	unsigned partitions = 1u << partition_order;
+	unsigned partition_size = block_size >> partition_order;
+	if ((partition_size << partition_order) != block_size || partition_size < order) {
+		return false;
+	}
+
+	for (unsigned p = 0; p < partitions; p++) {
+		unsigned count = p == 0 ? partition_size - order : partition_size;
+		decode_residual_partition(in, residual, count, method == 0 ? 4 : 5);
+		residual += count;
+	}
+	return !in->ended;
+}
+
+static void restore_fixed(int32_t* x, unsigned count, unsigned order) {
+	for (unsigned i = order; i < count; i++) {
+		int64_t prediction = 0;
+		switch (order) {
+		case 1:
+			prediction = x[i - 1];
+			break;
+		case 2:
+			prediction = 2 * (int64_t)x[i - 1] - x[i - 2];
+			break;
+		case 3:
+			prediction = 3 * ((int64_t)x[i - 1] - x[i - 2]) + x[i - 3];
+			break;
+		case 4:
+			prediction = 4 * ((int64_t)x[i - 1] + x[i - 3]) - 6 * (int64_t)x[i - 2] - x[i - 4];
+			break;
+		}
+		x[i] += (int32_t)prediction;
+	}
+}
+
+static void restore_lpc(int32_t* x, unsigned count, const int32_t* coeffs, unsigned order,
+                        int shift) {
+	for (unsigned i = order; i < count; i++) {
+		int64_t sum = 0;
+		for (unsigned j = 0; j < order; j++) {
+			sum += (int64_t)coeffs[j] * x[i - 1 - j];
+		}
+		x[i] += (int32_t)(sum >> shift);
+	}
+}
+
+static bool decode_subframe(BitInput* in, int32_t* x, unsigned block_size, unsigned bits) {
+	if (read_bits(in, 1) != 0) {
+		return false;
+	}
+	unsigned type = read_bits(in, 6);
+	unsigned wasted = 0;
+	if (read_bits(in, 1)) {
+		wasted = read_unary(in) + 1;
+		if (wasted >= bits) {
+			return false;
+		}
+		bits -= wasted;
+	}
+
+	if (type == 0) {
+		int32_t value = read_signed(in, (int)bits);
+		for (unsigned i = 0; i < block_size; i++) {
+			x[i] = value;
+		}
+	} else if (type == 1) {
+		for (unsigned i = 0; i < block_size; i++) {
+			x[i] = read_signed(in, (int)bits);
+		}
+	} else if (type >= 8 && type <= 12) {
+		unsigned order = type - 8;
+		if (order > block_size) {
+			return false;
+		}
+		for (unsigned i = 0; i < order; i++) {
+			x[i] = read_signed(in, (int)bits);
+		}
+		if (!decode_residual(in, x + order, block_size, order)) {
+			return false;
+		}
+		restore_fixed(x, block_size, order);
+	} else if (type >= 32) {
+		unsigned order = type - 31;
+		if (order > block_size) {
+			return false;
+		}
+		for (unsigned i = 0; i < order; i++) {
+			x[i] = read_signed(in, (int)bits);
+		}
+		unsigned precision = read_bits(in, 4) + 1;
+		int shift = read_signed(in, 5);
+		if (precision == 16 || shift < 0) {
+			return false;
+		}
+		int32_t coeffs[MAX_LPC_ORDER];
+		for (unsigned i = 0; i < order; i++) {
+			coeffs[i] = read_signed(in, (int)precision);
+		}
+		if (!decode_residual(in, x + order, block_size, order)) {
+			return false;
+		}
+		restore_lpc(x, block_size, coeffs, order, shift);
+	} else {
+		return false;
+	}
+
+	if (wasted > 0) {
+		for (unsigned i = 0; i < block_size; i++) {
+			x[i] = (int32_t)((uint32_t)x[i] << wasted);
+		}
+	}
+	return !in->ended;
+}
+
+// Finds the next frame header, false at the end of the file
+static bool find_sync(BitInput* in) {
+	align_to_byte(in);
+	uint32_t previous = read_bits(in, 8);
+	while (!in->ended) {
+		uint32_t current = read_bits(in, 8);
+		if (previous == 0xFF && (current & 0xFE) == 0xF8) {
+			return true;
+		}
+		previous = current;
+	}
+	return false;
+}
+
+static bool decode_frame(FlacDecoder* decoder) {
+	BitInput* in = &decoder->input;
+	while (find_sync(in)) {
+		// Everything but the frame number is checked against the stream
+		unsigned block_code = read_bits(in, 4);
+		unsigned rate_code = read_bits(in, 4);
+		unsigned assignment = read_bits(in, 4);
+		unsigned size_code = read_bits(in, 3);
+		read_bits(in, 1);
+
+		// UTF-8 style frame or sample number
+		unsigned first = read_bits(in, 8);
+		int extra = 0;
+		while (extra < 7 && (first & (0x80u >> extra))) {
+			extra++;
+		}
+		extra = extra > 0 ? extra - 1 : 0;
+		for (int i = 0; i < extra; i++) {
+			read_bits(in, 8);
+		}
+
+		unsigned block_size = 0;
+		if (block_code == 1) {
+			block_size = 192;
+		} else if (block_code >= 2 && block_code <= 5) {
+			block_size = 576u << (block_code - 2);
+		} else if (block_code == 6) {
+			block_size = read_bits(in, 8) + 1;
+		} else if (block_code == 7) {
+			block_size = read_bits(in, 16) + 1;
+		} else if (block_code >= 8) {
+			block_size = 256u << (block_code - 8);
+		}
+		if (rate_code == 12) {
+			read_bits(in, 8);
+		} else if (rate_code == 13 || rate_code == 14) {
+			read_bits(in, 16);
+		}
+		read_bits(in, 8); // CRC-8 of the header
+
+		static const unsigned sizes[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+		unsigned bits = size_code == 0 ? decoder->bits_per_sample : sizes[size_code];
+		unsigned channels = assignment < CHANNELS_LEFT_SIDE ? assignment + 1 : 2;
+		if (block_size == 0 || block_size > MAX_BLOCK_SIZE || rate_code == 15 ||
+		        assignment > CHANNELS_MID_SIDE || bits != decoder->bits_per_sample ||
+		        channels != decoder->base.channels) {
+			// A false sync inside another frame, look further
+			continue;
+		}
+
+		for (unsigned c = 0; c < channels; c++) {
+			bool side = (assignment == CHANNELS_LEFT_SIDE && c == 1) ||
+			            (assignment == CHANNELS_RIGHT_SIDE && c == 0) ||
+			            (assignment == CHANNELS_MID_SIDE && c == 1);
+			if (!decode_subframe(in, decoder->samples[c], block_size, bits + side)) {
+				return false;
+			}
+		}
+		align_to_byte(in);
+		read_bits(in, 16); // CRC-16 of the frame
+
+		int32_t* left = decoder->samples[0];
+		int32_t* right = decoder->samples[1];
+		if (assignment == CHANNELS_LEFT_SIDE) {
+			for (unsigned i = 0; i < block_size; i++) {
+				right[i] = left[i] - right[i];
+			}
+		} else if (assignment == CHANNELS_RIGHT_SIDE) {
+			for (unsigned i = 0; i < block_size; i++) {
+				left[i] += right[i];
+			}
+		} else if (assignment == CHANNELS_MID_SIDE) {
+			for (unsigned i = 0; i < block_size; i++) {
+				int32_t side = right[i];
+				int32_t mid = (int32_t)(((uint32_t)left[i] << 1) | (side & 1));
+				left[i] = (mid + side) >> 1;
+				right[i] = (mid - side) >> 1;
+			}
+		}
+
+		decoder->block_size = block_size;
+		decoder->block_position = 0;
+		return true;
+	}
+	return false;
+}
+
+static size_t flac_read(AudioDecoder* base, float* samples, size_t count) {
+	FlacDecoder* decoder = (FlacDecoder*)base;
+	unsigned channels = base->channels;
+	size_t done = 0;
+
+	while (done < count) {
+		if (decoder->block_position == decoder->block_size) {
+			if (decoder->failed || !decode_frame(decoder)) {
+				decoder->failed = true;
+				break;
+			}
+		}
+		size_t frames = decoder->block_size - decoder->block_position;
+		if (frames > count - done) {
+			frames = count - done;
+		}
+		for (unsigned c = 0; c < channels; c++) {
+			const int32_t* source = decoder->samples[c] + decoder->block_position;
+			float* target = samples + done * channels + c;
+			for (size_t i = 0; i < frames; i++) {
+				target[i * channels] = (float)source[i] * decoder->scale;
+			}
+		}
+		decoder->block_position += (unsigned)frames;
+		done += frames;
+	}
+	return done;
+}
+
+static void flac_close(AudioDecoder* base) {
+	FlacDecoder* decoder = (FlacDecoder*)base;
+	for (int c = 0; c < MAX_CHANNELS; c++) {
+		free(decoder->samples[c]);
+	}
+	free(decoder->input.buffer);
+	free(decoder);
+}
+
+/* Metadata */
+
+static void read_comments(BitInput* in, uint32_t size, LoopComments* loop) {
+	uint8_t* block = malloc(size);
+	if (!block || !read_bytes(in, block, size)) {
+		free(block);
+		return;
+	}
+	// Little endian lengths, unlike the rest of FLAC
+	uint64_t position = 4 + (uint64_t)(size >= 4 ? read_le32(block) : size);
+	if (position + 4 <= size) {
+		uint32_t count = read_le32(block + position);
+		position += 4;
+		for (uint32_t i = 0; i < count && position + 4 <= size; i++) {
+			uint32_t length = read_le32(block + position);
+			position += 4;
+			if (position + length > size) {
+				break;
+			}
+			loop_comments_parse(loop, (const char*)block + position, length);
+			position += length;
+		}
+	}
+	free(block);
+}
+
+static bool read_metadata(FlacDecoder* decoder, LoopComments* loop) {
+	BitInput* in = &decoder->input;
+	if (read_bits(in, 32) != 0x664C6143) { // "fLaC"
+		return false;
+	}
+
+	bool has_info = false;
+	bool last = false;
+	while (!last) {
+		last = read_bits(in, 1);
+		unsigned type = read_bits(in, 7);
+		uint32_t size = read_bits(in, 24);
+		if (in->ended) {
+			return false;
+		}
+
+		if (type == BLOCK_STREAMINFO && size >= STREAMINFO_SIZE) {
+			// Block and frame size bounds aren't needed
+			read_bits(in, 16);
+			read_bits(in, 16);
+			read_bits(in, 24);
+			read_bits(in, 24);
+			decoder->base.sample_rate = read_bits(in, 20);
+			decoder->base.channels = read_bits(in, 3) + 1;
+			decoder->bits_per_sample = read_bits(in, 5) + 1;
+			uint64_t high = read_bits(in, 4);
+			decoder->base.frame_count = high << 32 | read_bits(in, 32);
+			if (!skip_bytes(in, size - 18)) {
+				return false;
+			}
+			has_info = true;
+		} else if (type == BLOCK_VORBIS_COMMENT) {
+			read_comments(in, size, loop);
+		} else if (!skip_bytes(in, size)) {
+			return false;
+		}
+	}
+	return has_info;
+}
+
+AudioDecoder* flac_decoder_open(FILE* file) {
+	FlacDecoder* decoder = calloc(1, sizeof(FlacDecoder));
+	if (!decoder) {
+		return NULL;
+	}
+	decoder->base.read = flac_read;
+	decoder->base.close = flac_close;
+	decoder->input.file = file;
+	decoder->input.buffer = malloc(INPUT_BUFFER_SIZE);
+
+	LoopComments loop = {0};
+	if (!decoder->input.buffer || !read_metadata(decoder, &loop) ||
+	        decoder->base.sample_rate == 0 || decoder->base.channels > MAX_CHANNELS ||
+	        decoder->bits_per_sample < 4 || decoder->bits_per_sample > MAX_BITS_PER_SAMPLE ||
+	        decoder->base.frame_count == 0) {
+		// A stream without its length in STREAMINFO can't be sized up front
+		flac_close(&decoder->base);
+		return NULL;
+	}
+	for (unsigned c = 0; c < decoder->base.channels; c++) {
+		decoder->samples[c] = malloc(MAX_BLOCK_SIZE * sizeof(int32_t));
+		if (!decoder->samples[c]) {
+			flac_close(&decoder->base);
+			return NULL;
+		}
+	}
+	decoder->scale = 1.0f / (float)(1u << (decoder->bits_per_sample - 1));
+	loop_comments_apply(&loop, &decoder->base);
+	return &decoder->base;
+}
@@ -0,0 +1,138 @@
+#include "hca_cipher.h"
+#include "atomic_file.h"
+#include "hca_format.h"
+#include "mapped_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CIPH_CHUNK_SIZE 6
+#define TEMP_PATH_SIZE 1024
+// Frames re-encrypted per write
+#define BLOCK_FRAMES 256
+
+int hca_rekey_table(uint8_t table[256], unsigned from_type, uint64_t from_key,
+                    unsigned to_type, uint64_t to_key) {
+	uint8_t decrypt[256];
+	uint8_t target[256];
+	uint8_t encrypt[256];
+	if (hca_cipher_init(decrypt, from_type, from_key) != 0 ||
+	        hca_cipher_init(target, to_type, to_key) != 0) {
+		return -1;
+	}
+	hca_cipher_invert(target, encrypt);
+
+	for (int i = 0; i < 256; i++) {
+		table[i] = encrypt[decrypt[i]];
+	}
+	return 0;
+}
+
+int hca_rekey_frame(uint8_t* frame, size_t size, const uint8_t table[256]) {
+	if (size < 2 || hca_crc16(frame, size) != 0) {
+		return -1;
+	}
+
+	// The CRC covers the stored bytes, so it is recomputed after the mapping
+	size_t payload = size - 2;
+	for (size_t i = 0; i < payload; i++) {
+		frame[i] = table[frame[i]];
+	}
+	uint16_t crc = hca_crc16(frame, payload);
+	frame[payload] = (uint8_t)(crc >> 8);
+	frame[payload + 1] = (uint8_t)crc;
+	return 0;
+}
+
+static int write_rekeyed(const MappedFile* source, const HcaInfo* info,
+                         const uint8_t table[256], unsigned to_type, FILE* output) {
+	uint8_t* header = malloc((size_t)info->header_size + CIPH_CHUNK_SIZE);
+	uint8_t* block = malloc((size_t)BLOCK_FRAMES * info->frame_size);
+	int result = (header && block) ? 0 : HCA_REKEY_WRITE_FAILED;
+
+	if (result == 0) {
+		const uint8_t type[2] = {(uint8_t)(to_type >> 8), (uint8_t)to_type};
+		int header_size = hca_header_set_chunk(source->data, info->header_size, "ciph", type,
+		                                       sizeof(type), header,
+		                                       (size_t)info->header_size + CIPH_CHUNK_SIZE);
+		if (header_size < 0) {
+			result = HCA_REKEY_BAD_INPUT;
+		} else if (fwrite(header, 1, (size_t)header_size, output) != (size_t)header_size) {
+			result = HCA_REKEY_WRITE_FAILED;
+		}
+	}
+
+	const uint8_t* frames = source->data + info->header_size;
+	for (uint32_t first = 0; result == 0 && first < info->frame_count; first += BLOCK_FRAMES) {
+		uint32_t count = info->frame_count - first;
+		if (count > BLOCK_FRAMES) {
+			count = BLOCK_FRAMES;
+		}
+		size_t bytes = (size_t)count * info->frame_size;
+		memcpy(block, frames + (size_t)first * info->frame_size, bytes);
+		for (uint32_t i = 0; i < count; i++) {
+			if (hca_rekey_frame(block + (size_t)i * info->frame_size, info->frame_size,
+			                    table) != 0) {
+				result = HCA_REKEY_BAD_INPUT;
+				break;
+			}
+		}
+		if (result == 0 && fwrite(block, 1, bytes, output) != bytes) {
+			result = HCA_REKEY_WRITE_FAILED;
+		}
+	}
+
+	// Anything after the last frame is kept as it is
+	uint64_t end = info->header_size + (uint64_t)info->frame_count * info->frame_size;
+	if (result == 0 && end < source->size) {
+		size_t rest = (size_t)(source->size - end);
+		if (fwrite(source->data + end, 1, rest, output) != rest) {
+			result = HCA_REKEY_WRITE_FAILED;
+		}
+	}
+
+	free(header);
+	free(block);
+	return result;
+}
+
+int hca_rekey_file(const char* path, uint64_t from_key, unsigned to_type, uint64_t to_key) {
+	MappedFile source;
+	if (mapped_file_open(path, &source) != 0) {
+		return HCA_REKEY_BAD_INPUT;
+	}
+
+	HcaInfo info;
+	uint8_t table[256];
+	int header_size = hca_header_size(source.data, (size_t)source.size);
+	if (header_size < 0 || (uint64_t)header_size > source.size ||
+	        hca_read_header(source.data, (size_t)header_size, &info) != 0 || info.vbr ||
+	        header_size + (uint64_t)info.frame_count * info.frame_size > source.size ||
+	        hca_rekey_table(table, info.cipher_type, from_key, to_type, to_key) != 0) {
+		mapped_file_close(&source);
+		return HCA_REKEY_BAD_INPUT;
+	}
+
+	char temp_path[TEMP_PATH_SIZE];
+	atomic_file_temp_path(path, temp_path, sizeof(temp_path));
+	FILE* output = fopen(temp_path, "wb");
+	if (!output) {
+		mapped_file_close(&source);
+		return HCA_REKEY_WRITE_FAILED;
+	}
+
+	int result = write_rekeyed(&source, &info, table, to_type, output);
+	if (fclose(output) != 0 && result == 0) {
+		result = HCA_REKEY_WRITE_FAILED;
+	}
+	// The mapping has to go before the file can be replaced on Windows
+	mapped_file_close(&source);
+
+	if (result == 0 && atomic_file_replace(temp_path, path) != 0) {
+		result = HCA_REKEY_WRITE_FAILED;
+	}
+	if (result != 0) {
+		remove(temp_path);
+	}
+	return result;
+}
@@ -0,0 +1,581 @@
+#include "hca_decoder.h"
+#include "hca_dsp.h"
+#include "hca_mdct.h"
+#include "hca_tables.h"
+#include "wav_writer.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BAND_COUNT 128
+#define FRAME_SYNC 0xFFFF
+#define NOISE_SEED 1
+// Intensity value that leaves the stereo pair unchanged in version 3.0
+#define DEFAULT_INTENSITY 7
+// Zeroed bytes after the frame copy so the bit reader can load whole words
+#define FRAME_PADDING 4
+
+enum {
+	CHANNEL_DISCRETE,
+	CHANNEL_STEREO_PRIMARY,
+	CHANNEL_STEREO_SECONDARY
+};
+
+typedef struct {
+	int type;
+	unsigned coded_count;
+	uint8_t scalefactors[BAND_COUNT];
+	uint8_t resolutions[BAND_COUNT];
+	// Bands without bits from the front, bands with bits from the back
+	uint8_t noises[BAND_COUNT];
+	unsigned noise_count;
+	unsigned valid_count;
+	uint8_t intensity[HCA_SUBFRAMES];
+	uint8_t hfr_scales[BAND_COUNT];
+	float gains[BAND_COUNT];
+	float spectra[BAND_COUNT];
+	float overlap[HCA_SAMPLES_PER_SUBFRAME]; // Second half of the previous IMDCT
+} ChannelState;
+
+struct HcaDecoder {
+	HcaInfo info;
+	uint8_t cipher[256]; // Stored byte -> plain byte
+	unsigned hfr_group_count;
+	uint32_t random;
+	const HcaDsp* dsp;
+	uint8_t* frame;      // Decrypted copy of the current frame, plus padding
+	ChannelState channels[HCA_MAX_CHANNELS];
+};
+
+typedef struct {
+	const uint8_t* data;
+	size_t size;     // In bits
+	size_t position; // In bits
+} BitReader;
+
+// 2^(53/128 * (index - 63)), the ratio between two scalefactors
+static float scale_conversion[128];
+static float intensity_ratio[16];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void init_tables(void) {
+	for (int i = 1; i < 128; i++) {
+		scale_conversion[i] = powf(2.0f, (i - 63) * 53.0f / 128.0f);
+	}
+	for (int i = 0; i < 15; i++) {
+		intensity_ratio[i] = (14 - i) / 7.0f;
+	}
+}
+
+// Reads up to 16 bits, reads past the end of the frame return zeros
+static unsigned peek_bits(const BitReader* reader, unsigned count) {
+	if (count == 0 || reader->position >= reader->size) {
+		return 0;
+	}
+	const uint8_t* p = reader->data + (reader->position >> 3);
+	uint32_t word = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	return (word << (reader->position & 7)) >> (32 - count);
+}
+
+static void skip_bits(BitReader* reader, unsigned count) {
+	reader->position += count;
+}
+
+static unsigned read_bits(BitReader* reader, unsigned count) {
+	unsigned value = peek_bits(reader, count);
+	skip_bits(reader, count);
+	return value;
+}
+
+// Same as dividing and rounding up, 0 if there are no groups
+static unsigned ceil_div(unsigned value, unsigned divisor) {
+	return divisor ? (value + divisor - 1) / divisor : 0;
+}
+
+// Which channels of every track share stereo bands
+static void assign_channel_types(HcaDecoder* decoder) {
+	const HcaInfo* info = &decoder->info;
+	unsigned per_track = info->channels / info->track_count;
+	int types[HCA_MAX_CHANNELS] = {0};
+
+	if (info->stereo_band_count > 0 && per_track > 1) {
+		static const int layouts[9][8] = {
+			{0},
+			{0},
+			{1, 2},
+			{1, 2, 0},
+			{1, 2, 1, 2},
+			{1, 2, 0, 1, 2},
+			{1, 2, 0, 0, 1, 2},
+			{1, 2, 0, 0, 1, 2, 0},
+			{1, 2, 0, 0, 1, 2, 1, 2},
+		};
+		for (unsigned track = 0; track < info->track_count; track++) {
+			int* type = &types[track * per_track];
+			for (unsigned c = 0; c < per_track && c < 8; c++) {
+				type[c] = layouts[per_track < 9 ? per_track : 0][c];
+			}
+			// Four and five channel tracks pair the back channels only in some configs
+			if (per_track == 4 && info->channel_config != 0) {
+				type[2] = type[3] = 0;
+			} else if (per_track == 5 && info->channel_config > 2) {
+				type[3] = type[4] = 0;
+			}
+		}
+	}
+
+	for (unsigned c = 0; c < info->channels; c++) {
+		ChannelState* channel = &decoder->channels[c];
+		channel->type = types[c];
+		channel->coded_count = info->base_band_count;
+		if (channel->type != CHANNEL_STEREO_SECONDARY) {
+			channel->coded_count += info->stereo_band_count;
+		}
+	}
+}
+
+HcaDecoder* hca_decoder_create(const HcaInfo* info, uint64_t key) {
+	if (info->vbr || info->ath_type != 0 || info->frame_size < 8) {
+		return NULL;
+	}
+
+	HcaDecoder* decoder = calloc(1, sizeof(HcaDecoder));
+	if (!decoder) {
+		return NULL;
+	}
+	decoder->frame = calloc(1, info->frame_size + FRAME_PADDING);
+	if (!decoder->frame || hca_cipher_init(decoder->cipher, info->cipher_type, key) != 0) {
+		hca_decoder_free(decoder);
+		return NULL;
+	}
+	pthread_once(&tables_once, init_tables);
+
+	decoder->info = *info;
+	decoder->dsp = hca_dsp_get();
+	decoder->hfr_group_count = ceil_div(info->total_band_count - info->base_band_count -
+	                                    info->stereo_band_count, info->bands_per_hfr_group);
+	assign_channel_types(decoder);
+	hca_decoder_reset(decoder);
+	return decoder;
+}
+
+void hca_decoder_free(HcaDecoder* decoder) {
+	if (decoder) {
+		free(decoder->frame);
+		free(decoder);
+	}
+}
+
+void hca_decoder_reset(HcaDecoder* decoder) {
+	decoder->random = NOISE_SEED;
+	for (unsigned c = 0; c < decoder->info.channels; c++) {
+		memset(decoder->channels[c].overlap, 0, sizeof(decoder->channels[c].overlap));
+	}
+}
+
+static int unpack_scalefactors(HcaDecoder* decoder, ChannelState* channel, BitReader* reader) {
+	unsigned count = channel->coded_count;
+	unsigned extra_count = 0;
+
+	// Version 3.0 codes the HFR scales along with the scalefactors
+	if (decoder->info.version > HCA_VERSION_V200 &&
+	        channel->type != CHANNEL_STEREO_SECONDARY && decoder->hfr_group_count > 0) {
+		extra_count = decoder->hfr_group_count;
+		count += extra_count;
+		if (count > BAND_COUNT) {
+			return -1;
+		}
+	}
+
+	unsigned delta_bits = read_bits(reader, 3);
+	if (delta_bits >= 6) {
+		for (unsigned i = 0; i < count; i++) {
+			channel->scalefactors[i] = (uint8_t)read_bits(reader, 6);
+		}
+	} else if (delta_bits > 0) {
+		int escape = (1 << delta_bits) - 1;
+		int value = (int)read_bits(reader, 6);
+		channel->scalefactors[0] = (uint8_t)value;
+		for (unsigned i = 1; i < count; i++) {
+			int delta = (int)read_bits(reader, delta_bits);
+			if (delta == escape) {
+				value = (int)read_bits(reader, 6);
+			} else {
+				value += delta - (escape >> 1);
+				if (value < 0 || value >= 64) {
+					return -1;
+				}
+			}
+			channel->scalefactors[i] = (uint8_t)value;
+		}
+	} else {
+		memset(channel->scalefactors, 0, sizeof(channel->scalefactors));
+	}
+
+	for (unsigned i = 0; i < extra_count; i++) {
+		channel->hfr_scales[i] = channel->scalefactors[channel->coded_count + i];
+	}
+	return 0;
+}
+
+static int unpack_intensity(HcaDecoder* decoder, ChannelState* channel, BitReader* reader) {
+	bool v3 = decoder->info.version > HCA_VERSION_V200;
+
+	if (channel->type != CHANNEL_STEREO_SECONDARY) {
+		if (!v3) {
+			for (unsigned i = 0; i < decoder->hfr_group_count; i++) {
+				channel->hfr_scales[i] = (uint8_t)read_bits(reader, 6);
+			}
+		}
+		return 0;
+	}
+
+	unsigned value = peek_bits(reader, 4);
+	if (!v3) {
+		// 15 is a single value for the whole frame and takes no bits
+		channel->intensity[0] = (uint8_t)value;
+		if (value < 15) {
+			skip_bits(reader, 4);
+			for (int i = 1; i < HCA_SUBFRAMES; i++) {
+				channel->intensity[i] = (uint8_t)read_bits(reader, 4);
+			}
+		}
+		return 0;
+	}
+
+	skip_bits(reader, 4);
+	if (value == 15) {
+		memset(channel->intensity, DEFAULT_INTENSITY, sizeof(channel->intensity));
+		return 0;
+	}
+
+	channel->intensity[0] = (uint8_t)value;
+	unsigned delta_bits = read_bits(reader, 2);
+	if (delta_bits == 3) {
+		for (int i = 1; i < HCA_SUBFRAMES; i++) {
+			channel->intensity[i] = (uint8_t)read_bits(reader, 4);
+		}
+		return 0;
+	}
+
+	int escape = (2 << delta_bits) - 1;
+	int current = (int)value;
+	for (int i = 1; i < HCA_SUBFRAMES; i++) {
+		int delta = (int)read_bits(reader, delta_bits + 1);
+		if (delta == escape) {
+			current = (int)read_bits(reader, 4);
+		} else {
+			current += delta - (escape >> 1);
+			if (current < 0 || current > 15) {
+				return -1;
+			}
+		}
+		channel->intensity[i] = (uint8_t)current;
+	}
+	return 0;
+}
+
+static void calculate_resolutions(const HcaDecoder* decoder, ChannelState* channel,
+                                  int packed_noise_level) {
+	const HcaInfo* info = &decoder->info;
+	channel->noise_count = 0;
+	channel->valid_count = 0;
+
+	for (unsigned i = 0; i < channel->coded_count; i++) {
+		int resolution = 0;
+		int scalefactor = channel->scalefactors[i];
+		if (scalefactor > 0) {
+			// ATH type 0 adds nothing to the noise level
+			int noise_level = (packed_noise_level + (int)i) >> 8;
+			int position = noise_level + 1 - ((5 * scalefactor) >> 1);
+			if (position < 0) {
+				resolution = 15;
+			} else if (position < HCA_INVERT_TABLE_SIZE) {
+				resolution = hca_invert_table[position];
+			}
+
+			if (resolution > info->max_resolution) {
+				resolution = info->max_resolution;
+			} else if (resolution < info->min_resolution) {
+				resolution = info->min_resolution;
+			}
+
+			if (resolution < 1) {
+				channel->noises[channel->noise_count++] = (uint8_t)i;
+			} else {
+				channel->noises[BAND_COUNT - 1 - channel->valid_count++] = (uint8_t)i;
+			}
+		}
+		channel->resolutions[i] = (uint8_t)resolution;
+		channel->gains[i] = hca_scaling_table[scalefactor] * hca_range_table[resolution];
+	}
+}
+
+static void dequantize(const HcaDecoder* decoder, ChannelState* channel, BitReader* reader) {
+	int32_t values[BAND_COUNT];
+	for (unsigned i = 0; i < channel->coded_count; i++) {
+		int resolution = channel->resolutions[i];
+		unsigned bits = hca_max_bit_size[resolution];
+		unsigned code = peek_bits(reader, bits);
+		int value;
+
+		if (resolution > 7) {
+			// Sign and magnitude, zero is stored one bit shorter
+			value = (int)(code >> 1);
+			if (code & 1) {
+				value = -value;
+			}
+			skip_bits(reader, value ? bits : bits - 1);
+		} else {
+			skip_bits(reader, hca_quant_bit_count[resolution][code]);
+			value = hca_quant_value[resolution][code];
+		}
+		values[i] = value;
+	}
+	decoder->dsp->dequantize(channel->spectra, channel->gains, values, channel->coded_count);
+	memset(&channel->spectra[channel->coded_count], 0,
+	       (BAND_COUNT - channel->coded_count) * sizeof(float));
+}
+
+// Bands that got no bits copy a random band that did, rescaled
+static void reconstruct_noise(HcaDecoder* decoder, ChannelState* channel) {
+	if (decoder->info.min_resolution > 0 || channel->valid_count == 0 ||
+	        channel->noise_count == 0 ||
+	        (decoder->info.ms_stereo && channel->type != CHANNEL_STEREO_PRIMARY)) {
+		return;
+	}
+
+	uint32_t random = decoder->random;
+	for (unsigned i = 0; i < channel->noise_count; i++) {
+		random = 0x343FD * random + 0x269EC3;
+		unsigned pick = BAND_COUNT - channel->valid_count +
+		                ((random & 0x7FFF) * channel->valid_count >> 15);
+		int noise_band = channel->noises[i];
+		int valid_band = channel->noises[pick];
+		int index = channel->scalefactors[noise_band] - channel->scalefactors[valid_band] + 62;
+		if (index < 0) {
+			index = 0;
+		}
+		channel->spectra[noise_band] = scale_conversion[index] * channel->spectra[valid_band];
+	}
+	decoder->random = random;
+}
+
+// Rebuilds the bands above the coded ones from mirrored lower bands
+static void reconstruct_high_frequency(const HcaDecoder* decoder, ChannelState* channel) {
+	const HcaInfo* info = &decoder->info;
+	if (info->bands_per_hfr_group == 0 || channel->type == CHANNEL_STEREO_SECONDARY) {
+		return;
+	}
+
+	// Version 3.0 stops mirroring halfway and repeats the last band
+	unsigned group_limit = decoder->hfr_group_count;
+	if (info->version > HCA_VERSION_V200) {
+		group_limit >>= 1;
+	}
+
+	int high = info->base_band_count + info->stereo_band_count;
+	int low = high - 1;
+	for (unsigned group = 0; group < decoder->hfr_group_count; group++) {
+		int step = (group < group_limit) ? 1 : 0;
+		for (unsigned i = 0; i < info->bands_per_hfr_group; i++) {
+			if (high >= info->total_band_count || low < 0) {
+				break;
+			}
+			int index = channel->hfr_scales[group] - channel->scalefactors[low] + 63;
+			if (index < 0) {
+				index = 0;
+			}
+			channel->spectra[high++] = scale_conversion[index] * channel->spectra[low];
+			low -= step;
+		}
+	}
+	if (high > 0) {
+		channel->spectra[high - 1] = 0.0f;
+	}
+}
+
+// The secondary channel of a pair is rebuilt from the primary one above the
+// base bands
+static void apply_stereo(const HcaDecoder* decoder, ChannelState* left, ChannelState* right,
+                         int subframe) {
+	const HcaInfo* info = &decoder->info;
+	unsigned start = info->base_band_count;
+	unsigned end = info->total_band_count;
+
+	if (end <= start) {
+		return;
+	}
+	if (info->stereo_band_count > 0) {
+		float ratio_left = intensity_ratio[right->intensity[subframe] & 0xF];
+		decoder->dsp->intensity_stereo(left->spectra + start, right->spectra + start,
+		                               ratio_left, ratio_left - 2.0f, end - start);
+	}
+	if (info->ms_stereo) {
+		decoder->dsp->mid_side_stereo(left->spectra + start, right->spectra + start,
+		                              end - start);
+	}
+}
+
+// Inverse of the encoder's window and fold, with overlap-add
+static void imdct(const HcaDecoder* decoder, ChannelState* channel, float* samples,
+                  unsigned stride) {
+	float dct[HCA_MDCT_SIZE];
+	float output[HCA_SAMPLES_PER_SUBFRAME];
+	hca_dct4(channel->spectra, dct);
+
+	if (stride == 1) {
+		decoder->dsp->imdct_window(dct, channel->overlap, samples);
+		return;
+	}
+	decoder->dsp->imdct_window(dct, channel->overlap, output);
+	for (int i = 0; i < HCA_SAMPLES_PER_SUBFRAME; i++) {
+		samples[i * stride] = output[i];
+	}
+}
+
+int hca_decoder_decode_frame(HcaDecoder* decoder, const uint8_t* frame, float* samples) {
+	const HcaInfo* info = &decoder->info;
+	if (hca_crc16(frame, info->frame_size) != 0) {
+		return -1;
+	}
+
+	// The checksum covers the encrypted bytes, so decrypt the first 2 too
+	for (unsigned i = 0; i < info->frame_size; i++) {
+		decoder->frame[i] = decoder->cipher[frame[i]];
+	}
+
+	BitReader reader = {decoder->frame, (size_t)info->frame_size * 8, 0};
+	if (read_bits(&reader, 16) != FRAME_SYNC) {
+		return -1;
+	}
+	int noise_level = (int)read_bits(&reader, 9);
+	int evaluation_boundary = (int)read_bits(&reader, 7);
+	int packed_noise_level = (noise_level << 8) - evaluation_boundary;
+
+	for (unsigned c = 0; c < info->channels; c++) {
+		ChannelState* channel = &decoder->channels[c];
+		if (unpack_scalefactors(decoder, channel, &reader) != 0 ||
+		        unpack_intensity(decoder, channel, &reader) != 0) {
+			return -1;
+		}
+		calculate_resolutions(decoder, channel, packed_noise_level);
+	}
+
+	for (int subframe = 0; subframe < HCA_SUBFRAMES; subframe++) {
+		for (unsigned c = 0; c < info->channels; c++) {
+			dequantize(decoder, &decoder->channels[c], &reader);
+		}
+		for (unsigned c = 0; c < info->channels; c++) {
+			reconstruct_noise(decoder, &decoder->channels[c]);
+			reconstruct_high_frequency(decoder, &decoder->channels[c]);
+		}
+		for (unsigned c = 0; c + 1 < info->channels; c++) {
+			if (decoder->channels[c].type == CHANNEL_STEREO_PRIMARY) {
+				apply_stereo(decoder, &decoder->channels[c], &decoder->channels[c + 1], subframe);
+			}
+		}
+
+		float* out = samples + (size_t)subframe * HCA_SAMPLES_PER_SUBFRAME * info->channels;
+		for (unsigned c = 0; c < info->channels; c++) {
+			imdct(decoder, &decoder->channels[c], out + c, info->channels);
+		}
+	}
+
+	if (info->volume != 1.0f) {
+		for (size_t i = 0; i < (size_t)HCA_SAMPLES_PER_FRAME * info->channels; i++) {
+			samples[i] *= info->volume;
+		}
+	}
+	return 0;
+}
+
+static int decode_frames(HcaDecoder* decoder, FILE* input, FILE* output) {
+	const HcaInfo* info = &decoder->info;
+	uint8_t* frame = malloc(info->frame_size);
+	float* samples = malloc(sizeof(float) * HCA_SAMPLES_PER_FRAME * info->channels);
+	if (!frame || !samples) {
+		free(frame);
+		free(samples);
+		return HCA_DECODE_WRITE_FAILED;
+	}
+
+	int64_t skip = info->encoder_delay;
+	int64_t left = (int64_t)info->frame_count * HCA_SAMPLES_PER_FRAME -
+	               info->encoder_delay - info->encoder_padding;
+	int result = 0;
+
+	for (uint32_t i = 0; i < info->frame_count && left > 0; i++) {
+		if (fread(frame, 1, info->frame_size, input) != info->frame_size ||
+		        hca_decoder_decode_frame(decoder, frame, samples) != 0) {
+			result = HCA_DECODE_BAD_INPUT;
+			break;
+		}
+
+		int64_t first = (skip < HCA_SAMPLES_PER_FRAME) ? skip : HCA_SAMPLES_PER_FRAME;
+		int64_t count = HCA_SAMPLES_PER_FRAME - first;
+		skip -= first;
+		if (count > left) {
+			count = left;
+		}
+		if (wav_write_samples(output, samples + first * info->channels,
+		                      (size_t)count * info->channels) != 0) {
+			result = HCA_DECODE_WRITE_FAILED;
+			break;
+		}
+		left -= count;
+	}
+
+	free(frame);
+	free(samples);
+	return result;
+}
+
+int hca_decode_file(const char* hca_path, const char* wav_path, uint64_t key) {
+	FILE* input = fopen(hca_path, "rb");
+	if (!input) {
+		return HCA_DECODE_BAD_INPUT;
+	}
+
+	HcaInfo info;
+	if (hca_read_file_header(input, &info) != 0) {
+		fclose(input);
+		return HCA_DECODE_BAD_INPUT;
+	}
+	int result;
+
+	int64_t total = (int64_t)info.frame_count * HCA_SAMPLES_PER_FRAME -
+	                info.encoder_delay - info.encoder_padding;
+	HcaDecoder* decoder = hca_decoder_create(&info, key);
+	if (!decoder || total < 0 || total > UINT32_MAX / (info.channels * 2)) {
+		hca_decoder_free(decoder);
+		fclose(input);
+		return decoder ? HCA_DECODE_BAD_INPUT : HCA_DECODE_UNSUPPORTED;
+	}
+
+	FILE* output = fopen(wav_path, "wb");
+	if (!output) {
+		hca_decoder_free(decoder);
+		fclose(input);
+		return HCA_DECODE_WRITE_FAILED;
+	}
+
+	if (wav_write_header(output, info.channels, info.sample_rate, (uint32_t)total) != 0) {
+		result = HCA_DECODE_WRITE_FAILED;
+	} else {
+		result = decode_frames(decoder, input, output);
+	}
+
+	hca_decoder_free(decoder);
+	fclose(input);
+	if (fclose(output) != 0 && result == 0) {
+		result = HCA_DECODE_WRITE_FAILED;
+	}
+	if (result != 0) {
+		remove(wav_path);
+	}
+	return result;
+}
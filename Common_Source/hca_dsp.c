@@ -0,0 +1,338 @@
+#include "hca_dsp.h"
+#include "hca_tables.h"
+
+#define SUBFRAME_SIZE 128
+#define HALF_SUBFRAME 64
+#define MID_SIDE_SCALE 0.70710676908493f
+
+/* Scalar reference */
+
+static void dequantize_scalar(float* spectra, const float* gains, const int32_t* values,
+                              unsigned count) {
+	for (unsigned i = 0; i < count; i++) {
+		spectra[i] = gains[i] * (float)values[i];
+	}
+}
+
+static void intensity_stereo_scalar(float* left, float* right, float ratio_left,
+                                    float ratio_right, unsigned count) {
+	for (unsigned i = 0; i < count; i++) {
+		right[i] = left[i] * ratio_right;
+		left[i] *= ratio_left;
+	}
+}
+
+static void mid_side_stereo_scalar(float* left, float* right, unsigned count) {
+	for (unsigned i = 0; i < count; i++) {
+		float l = left[i] * MID_SIDE_SCALE;
+		float r = right[i] * MID_SIDE_SCALE;
+		left[i] = l + r;
+		right[i] = l - r;
+	}
+}
+
+static void complex_multiply_scalar(float* re, float* im, const float* w_re,
+                                    const float* w_im, unsigned count) {
+	for (unsigned i = 0; i < count; i++) {
+		float r = re[i] * w_re[i] - im[i] * w_im[i];
+		float j = re[i] * w_im[i] + im[i] * w_re[i];
+		re[i] = r;
+		im[i] = j;
+	}
+}
+
+static void fft_stage_scalar(float* re, float* im, const float* tw_re, const float* tw_im,
+                             unsigned size) {
+	unsigned half = size / 2;
+	for (unsigned start = 0; start < HCA_FFT_SIZE; start += size) {
+		float* a_re = re + start;
+		float* a_im = im + start;
+		float* b_re = a_re + half;
+		float* b_im = a_im + half;
+		for (unsigned j = 0; j < half; j++) {
+			float t_re = b_re[j] * tw_re[j] - b_im[j] * tw_im[j];
+			float t_im = b_re[j] * tw_im[j] + b_im[j] * tw_re[j];
+			b_re[j] = a_re[j] - t_re;
+			b_im[j] = a_im[j] - t_im;
+			a_re[j] += t_re;
+			a_im[j] += t_im;
+		}
+	}
+}
+
+static void imdct_window_scalar(const float* dct, float* overlap, float* samples) {
+	const float* w = hca_window;
+	for (int i = 0; i < HALF_SUBFRAME; i++) {
+		samples[i] = overlap[i] - w[i] * dct[HALF_SUBFRAME + i];
+	}
+	for (int i = HALF_SUBFRAME; i < SUBFRAME_SIZE; i++) {
+		samples[i] = overlap[i] + w[i] * dct[191 - i];
+	}
+	for (int i = 0; i < HALF_SUBFRAME; i++) {
+		overlap[i] = w[127 - i] * dct[63 - i];
+		overlap[HALF_SUBFRAME + i] = w[63 - i] * dct[i];
+	}
+}
+
+static const HcaDsp scalar_dsp = {
+	"scalar",
+	dequantize_scalar,
+	intensity_stereo_scalar,
+	mid_side_stereo_scalar,
+	complex_multiply_scalar,
+	fft_stage_scalar,
+	imdct_window_scalar
+};
+
+/* SSE2 / NEON */
+
+#ifdef HAVE_VECTOR4
+static void dequantize_v4(float* spectra, const float* gains, const int32_t* values,
+                          unsigned count) {
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v4_store(spectra + i, v4_mul(v4_load(gains + i), v4_load_int(values + i)));
+	}
+	dequantize_scalar(spectra + i, gains + i, values + i, count - i);
+}
+
+static void intensity_stereo_v4(float* left, float* right, float ratio_left,
+                                float ratio_right, unsigned count) {
+	v4 scale_left = v4_set1(ratio_left);
+	v4 scale_right = v4_set1(ratio_right);
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v4 l = v4_load(left + i);
+		v4_store(right + i, v4_mul(l, scale_right));
+		v4_store(left + i, v4_mul(l, scale_left));
+	}
+	intensity_stereo_scalar(left + i, right + i, ratio_left, ratio_right, count - i);
+}
+
+static void mid_side_stereo_v4(float* left, float* right, unsigned count) {
+	v4 scale = v4_set1(MID_SIDE_SCALE);
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v4 l = v4_mul(v4_load(left + i), scale);
+		v4 r = v4_mul(v4_load(right + i), scale);
+		v4_store(left + i, v4_add(l, r));
+		v4_store(right + i, v4_sub(l, r));
+	}
+	mid_side_stereo_scalar(left + i, right + i, count - i);
+}
+
+static void complex_multiply_v4(float* re, float* im, const float* w_re, const float* w_im,
+                                unsigned count) {
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4) {
+		v4 a_re = v4_load(re + i);
+		v4 a_im = v4_load(im + i);
+		v4 b_re = v4_load(w_re + i);
+		v4 b_im = v4_load(w_im + i);
+		v4_store(re + i, v4_sub(v4_mul(a_re, b_re), v4_mul(a_im, b_im)));
+		v4_store(im + i, v4_add(v4_mul(a_re, b_im), v4_mul(a_im, b_re)));
+	}
+	complex_multiply_scalar(re + i, im + i, w_re + i, w_im + i, count - i);
+}
+
+static void fft_stage_v4(float* re, float* im, const float* tw_re, const float* tw_im,
+                         unsigned size) {
+	unsigned half = size / 2;
+	if (half < 4) {
+		fft_stage_scalar(re, im, tw_re, tw_im, size);
+		return;
+	}
+
+	for (unsigned start = 0; start < HCA_FFT_SIZE; start += size) {
+		float* a_re = re + start;
+		float* a_im = im + start;
+		float* b_re = a_re + half;
+		float* b_im = a_im + half;
+		for (unsigned j = 0; j < half; j += 4) {
+			v4 w_re = v4_load(tw_re + j);
+			v4 w_im = v4_load(tw_im + j);
+			v4 x_re = v4_load(b_re + j);
+			v4 x_im = v4_load(b_im + j);
+			v4 t_re = v4_sub(v4_mul(x_re, w_re), v4_mul(x_im, w_im));
+			v4 t_im = v4_add(v4_mul(x_re, w_im), v4_mul(x_im, w_re));
+			v4 y_re = v4_load(a_re + j);
+			v4 y_im = v4_load(a_im + j);
+			v4_store(b_re + j, v4_sub(y_re, t_re));
+			v4_store(b_im + j, v4_sub(y_im, t_im));
+			v4_store(a_re + j, v4_add(y_re, t_re));
+			v4_store(a_im + j, v4_add(y_im, t_im));
+		}
+	}
+}
+
+static void imdct_window_v4(const float* dct, float* overlap, float* samples) {
+	const float* w = hca_window;
+	for (int i = 0; i < HALF_SUBFRAME; i += 4) {
+		v4 product = v4_mul(v4_load(w + i), v4_load(dct + HALF_SUBFRAME + i));
+		v4_store(samples + i, v4_sub(v4_load(overlap + i), product));
+	}
+	for (int i = HALF_SUBFRAME; i < SUBFRAME_SIZE; i += 4) {
+		v4 mirrored = v4_reverse(v4_load(dct + 188 - i));
+		v4 product = v4_mul(v4_load(w + i), mirrored);
+		v4_store(samples + i, v4_add(v4_load(overlap + i), product));
+	}
+	for (int i = 0; i < HALF_SUBFRAME; i += 4) {
+		v4 rising = v4_mul(v4_reverse(v4_load(w + 124 - i)), v4_reverse(v4_load(dct + 60 - i)));
+		v4 falling = v4_mul(v4_reverse(v4_load(w + 60 - i)), v4_load(dct + i));
+		v4_store(overlap + i, rising);
+		v4_store(overlap + HALF_SUBFRAME + i, falling);
+	}
+}
+
+static const HcaDsp vector4_dsp = {
+	VECTOR4_NAME,
+	dequantize_v4,
+	intensity_stereo_v4,
+	mid_side_stereo_v4,
+	complex_multiply_v4,
+	fft_stage_v4,
+	imdct_window_v4
+};
+#endif // HAVE_VECTOR4
+
+/* AVX2 */
+
+#ifdef HAVE_AVX2
+AVX2_FUNCTION static __m256 reverse8(__m256 v) {
+	return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+AVX2_FUNCTION static void dequantize_avx2(float* spectra, const float* gains,
+                                          const int32_t* values, unsigned count) {
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 value = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(values + i)));
+		_mm256_storeu_ps(spectra + i, _mm256_mul_ps(_mm256_loadu_ps(gains + i), value));
+	}
+	dequantize_v4(spectra + i, gains + i, values + i, count - i);
+}
+
+AVX2_FUNCTION static void intensity_stereo_avx2(float* left, float* right, float ratio_left,
+                                                float ratio_right, unsigned count) {
+	__m256 scale_left = _mm256_set1_ps(ratio_left);
+	__m256 scale_right = _mm256_set1_ps(ratio_right);
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 l = _mm256_loadu_ps(left + i);
+		_mm256_storeu_ps(right + i, _mm256_mul_ps(l, scale_right));
+		_mm256_storeu_ps(left + i, _mm256_mul_ps(l, scale_left));
+	}
+	intensity_stereo_v4(left + i, right + i, ratio_left, ratio_right, count - i);
+}
+
+AVX2_FUNCTION static void mid_side_stereo_avx2(float* left, float* right, unsigned count) {
+	__m256 scale = _mm256_set1_ps(MID_SIDE_SCALE);
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 l = _mm256_mul_ps(_mm256_loadu_ps(left + i), scale);
+		__m256 r = _mm256_mul_ps(_mm256_loadu_ps(right + i), scale);
+		_mm256_storeu_ps(left + i, _mm256_add_ps(l, r));
+		_mm256_storeu_ps(right + i, _mm256_sub_ps(l, r));
+	}
+	mid_side_stereo_v4(left + i, right + i, count - i);
+}
+
+AVX2_FUNCTION static void complex_multiply_avx2(float* re, float* im, const float* w_re,
+                                                const float* w_im, unsigned count) {
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 a_re = _mm256_loadu_ps(re + i);
+		__m256 a_im = _mm256_loadu_ps(im + i);
+		__m256 b_re = _mm256_loadu_ps(w_re + i);
+		__m256 b_im = _mm256_loadu_ps(w_im + i);
+		_mm256_storeu_ps(re + i, _mm256_sub_ps(_mm256_mul_ps(a_re, b_re),
+		                                       _mm256_mul_ps(a_im, b_im)));
+		_mm256_storeu_ps(im + i, _mm256_add_ps(_mm256_mul_ps(a_re, b_im),
+		                                       _mm256_mul_ps(a_im, b_re)));
+	}
+	complex_multiply_v4(re + i, im + i, w_re + i, w_im + i, count - i);
+}
+
+AVX2_FUNCTION static void fft_stage_avx2(float* re, float* im, const float* tw_re,
+                                         const float* tw_im, unsigned size) {
+	unsigned half = size / 2;
+	if (half < 8) {
+		fft_stage_v4(re, im, tw_re, tw_im, size);
+		return;
+	}
+
+	for (unsigned start = 0; start < HCA_FFT_SIZE; start += size) {
+		float* a_re = re + start;
+		float* a_im = im + start;
+		float* b_re = a_re + half;
+		float* b_im = a_im + half;
+		for (unsigned j = 0; j < half; j += 8) {
+			__m256 w_re = _mm256_loadu_ps(tw_re + j);
+			__m256 w_im = _mm256_loadu_ps(tw_im + j);
+			__m256 x_re = _mm256_loadu_ps(b_re + j);
+			__m256 x_im = _mm256_loadu_ps(b_im + j);
+			__m256 t_re = _mm256_sub_ps(_mm256_mul_ps(x_re, w_re), _mm256_mul_ps(x_im, w_im));
+			__m256 t_im = _mm256_add_ps(_mm256_mul_ps(x_re, w_im), _mm256_mul_ps(x_im, w_re));
+			__m256 y_re = _mm256_loadu_ps(a_re + j);
+			__m256 y_im = _mm256_loadu_ps(a_im + j);
+			_mm256_storeu_ps(b_re + j, _mm256_sub_ps(y_re, t_re));
+			_mm256_storeu_ps(b_im + j, _mm256_sub_ps(y_im, t_im));
+			_mm256_storeu_ps(a_re + j, _mm256_add_ps(y_re, t_re));
+			_mm256_storeu_ps(a_im + j, _mm256_add_ps(y_im, t_im));
+		}
+	}
+}
+
+AVX2_FUNCTION static void imdct_window_avx2(const float* dct, float* overlap, float* samples) {
+	const float* w = hca_window;
+	for (int i = 0; i < HALF_SUBFRAME; i += 8) {
+		__m256 product = _mm256_mul_ps(_mm256_loadu_ps(w + i),
+		                               _mm256_loadu_ps(dct + HALF_SUBFRAME + i));
+		_mm256_storeu_ps(samples + i, _mm256_sub_ps(_mm256_loadu_ps(overlap + i), product));
+	}
+	for (int i = HALF_SUBFRAME; i < SUBFRAME_SIZE; i += 8) {
+		__m256 mirrored = reverse8(_mm256_loadu_ps(dct + 184 - i));
+		__m256 product = _mm256_mul_ps(_mm256_loadu_ps(w + i), mirrored);
+		_mm256_storeu_ps(samples + i, _mm256_add_ps(_mm256_loadu_ps(overlap + i), product));
+	}
+	for (int i = 0; i < HALF_SUBFRAME; i += 8) {
+		__m256 rising = _mm256_mul_ps(reverse8(_mm256_loadu_ps(w + 120 - i)),
+		                              reverse8(_mm256_loadu_ps(dct + 56 - i)));
+		__m256 falling = _mm256_mul_ps(reverse8(_mm256_loadu_ps(w + 56 - i)),
+		                               _mm256_loadu_ps(dct + i));
+		_mm256_storeu_ps(overlap + i, rising);
+		_mm256_storeu_ps(overlap + HALF_SUBFRAME + i, falling);
+	}
+}
+
+static const HcaDsp avx2_dsp = {
+	"avx2",
+	dequantize_avx2,
+	intensity_stereo_avx2,
+	mid_side_stereo_avx2,
+	complex_multiply_avx2,
+	fft_stage_avx2,
+	imdct_window_avx2
+};
+#endif // HAVE_AVX2
+
+const HcaDsp* hca_dsp_kernels(SimdLevel level) {
+	switch (level) {
+	case SIMD_SCALAR:
+		return &scalar_dsp;
+#ifdef HAVE_VECTOR4
+	case SIMD_VECTOR4:
+		return &vector4_dsp;
+#endif
+#ifdef HAVE_AVX2
+	case SIMD_AVX2:
+		return &avx2_dsp;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const HcaDsp* hca_dsp_get(void) {
+	return hca_dsp_kernels(simd_level());
+}
@@ -0,0 +1,556 @@
+#include "hca_encoder.h"
+#include "hca_mdct.h"
+#include "hca_tables.h"
+#include "loop_finder.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BAND_COUNT 128
+#define RESOLUTION_COUNT 16
+#define NOT_COUNTED 0xFFFF
+// Same size/quality trade-off as VGAudio's default ("high"), 1/6 of 16-bit PCM
+#define COMPRESSION_RATIO 6
+#define MAX_NOISE_LEVEL 511
+#define MAX_EVALUATION_BOUNDARY 127
+// Curve positions version 2.0 decoders define
+#define MAX_CURVE_POSITION 56
+// Sync word, noise level, evaluation boundary and the CRC
+#define FRAME_OVERHEAD_BITS (16 + 9 + 7 + 16)
+// At the highest noise level every band is dropped, leaving the overhead and
+// a 3-bit scalefactor header per channel
+#define MIN_FRAME_BITS(channels) (FRAME_OVERHEAD_BITS + 3 * (channels))
+
+typedef struct {
+	float spectra[HCA_SUBFRAMES][BAND_COUNT];
+	float previous[HCA_SAMPLES_PER_SUBFRAME]; // First half of the next window
+	uint8_t peak_scalefactors[BAND_COUNT];    // Smallest scale covering each band
+	uint8_t scalefactors[BAND_COUNT];         // Written values, 0 for dropped bands
+	uint8_t resolutions[BAND_COUNT];
+	uint16_t band_bits[BAND_COUNT][RESOLUTION_COUNT];
+	int delta_bits;
+} ChannelState;
+
+struct HcaEncoder {
+	HcaInfo info;
+	uint8_t cipher[256]; // Plain byte -> stored byte
+	ChannelState channels[HCA_MAX_CHANNELS];
+};
+
+typedef struct {
+	uint8_t* data;
+	size_t position; // In bits
+} BitWriter;
+
+// Prefix codes for resolutions 1-7, indexed by value + 7
+static uint8_t code_values[8][15];
+static uint8_t code_lengths[8][15];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void init_tables(void) {
+	// Invert the decoder tables, the first index of a code holds its value
+	for (int resolution = 1; resolution < 8; resolution++) {
+		int max_bits = hca_max_bit_size[resolution];
+		for (int index = (1 << max_bits) - 1; index >= 0; index--) {
+			int length = hca_quant_bit_count[resolution][index];
+			int value = hca_quant_value[resolution][index];
+			code_values[resolution][value + 7] = (uint8_t)(index >> (max_bits - length));
+			code_lengths[resolution][value + 7] = (uint8_t)length;
+		}
+	}
+}
+
+static int max_quantized_value(int resolution) {
+	if (resolution < 8) {
+		return resolution;
+	}
+	return (1 << (hca_max_bit_size[resolution] - 1)) - 1;
+}
+
+static int quantize(float value, float inverse_step, int resolution) {
+	int max_value = max_quantized_value(resolution);
+	long quantized = lrintf(value * inverse_step);
+	if (quantized > max_value) return max_value;
+	if (quantized < -max_value) return -max_value;
+	return (int)quantized;
+}
+
+static unsigned coefficient_bits(int resolution, int value) {
+	if (resolution < 8) {
+		return code_lengths[resolution][value + 7];
+	}
+	// Zero drops the sign bit
+	return hca_max_bit_size[resolution] - (value == 0);
+}
+
+static float inverse_step(int scalefactor, int resolution) {
+	return 1.0f / (hca_scaling_table[scalefactor] * hca_range_table[resolution]);
+}
+
+// Resolution the decoder derives for a band, -1 if the curve position is past
+// what version 2.0 decoders define, those bands are dropped instead
+static int band_resolution(int scalefactor, int noise_level) {
+	if (scalefactor == 0) {
+		return 0;
+	}
+
+	int position = noise_level + 1 - ((5 * scalefactor) >> 1);
+	if (position < 0) {
+		return 15;
+	}
+	if (position > MAX_CURVE_POSITION) {
+		return -1;
+	}
+	return hca_invert_table[position];
+}
+
+static unsigned count_band_bits(ChannelState* channel, int band, int resolution) {
+	if (resolution == 0) {
+		return 0;
+	}
+
+	uint16_t* cached = &channel->band_bits[band][resolution];
+	if (*cached == NOT_COUNTED) {
+		float step = inverse_step(channel->peak_scalefactors[band], resolution);
+		unsigned bits = 0;
+		for (int s = 0; s < HCA_SUBFRAMES; s++) {
+			int value = quantize(channel->spectra[s][band], step, resolution);
+			bits += coefficient_bits(resolution, value);
+		}
+		*cached = (uint16_t)bits;
+	}
+	return *cached;
+}
+
+static bool delta_fits(int delta, int delta_bits) {
+	int escape = (1 << delta_bits) - 1;
+	int offset = escape >> 1;
+	return delta >= -offset && delta < escape - offset;
+}
+
+// Picks the cheapest scalefactor coding: 0 bits when all are zero, deltas of
+// 1-5 bits with 6-bit escapes, or 6 raw bits each
+static unsigned scalefactor_bits(const uint8_t* scalefactors, int* delta_bits) {
+	bool all_zero = true;
+	for (int b = 0; b < BAND_COUNT; b++) {
+		if (scalefactors[b] != 0) {
+			all_zero = false;
+			break;
+		}
+	}
+	if (all_zero) {
+		*delta_bits = 0;
+		return 3;
+	}
+
+	unsigned best = 3 + 6 * BAND_COUNT;
+	*delta_bits = 6;
+	for (int bits = 1; bits < 6; bits++) {
+		unsigned total = 3 + 6;
+		for (int b = 1; b < BAND_COUNT && total < best; b++) {
+			int delta = scalefactors[b] - scalefactors[b - 1];
+			total += delta_fits(delta, bits) ? bits : bits + 6;
+		}
+		if (total < best) {
+			best = total;
+			*delta_bits = bits;
+		}
+	}
+	return best;
+}
+
+// Fills in the scalefactors and resolutions the decoder will derive from a
+// noise level and evaluation boundary, returns the frame size in bits
+static unsigned evaluate_frame(HcaEncoder* encoder, int noise_level, int boundary) {
+	unsigned bits = FRAME_OVERHEAD_BITS;
+
+	for (unsigned c = 0; c < encoder->info.channels; c++) {
+		ChannelState* channel = &encoder->channels[c];
+		for (int b = 0; b < BAND_COUNT; b++) {
+			int level = (b < boundary) ? noise_level - 1 : noise_level;
+			int resolution = band_resolution(channel->peak_scalefactors[b], level);
+			if (resolution < 0) {
+				channel->scalefactors[b] = 0;
+				channel->resolutions[b] = 0;
+			} else {
+				channel->scalefactors[b] = channel->peak_scalefactors[b];
+				channel->resolutions[b] = (uint8_t)resolution;
+				bits += count_band_bits(channel, b, resolution);
+			}
+		}
+		bits += scalefactor_bits(channel->scalefactors, &channel->delta_bits);
+	}
+	return bits;
+}
+
+// Finds the finest quantization that fits the frame. A higher noise level never
+// costs more bits, a higher boundary moves more bands to the finer level below
+static void allocate_bits(HcaEncoder* encoder, int* noise_level, int* boundary) {
+	unsigned budget = encoder->info.frame_size * 8u;
+
+	int low = 0;
+	int high = MAX_NOISE_LEVEL;
+	while (low < high) {
+		int middle = (low + high) / 2;
+		if (evaluate_frame(encoder, middle, 0) <= budget) {
+			high = middle;
+		} else {
+			low = middle + 1;
+		}
+	}
+	*noise_level = high;
+
+	// The boundary lowers the level of the bands below it, which can't go
+	// under zero
+	low = 0;
+	high = (*noise_level > 0) ? MAX_EVALUATION_BOUNDARY : 0;
+	while (low < high) {
+		int middle = (low + high + 1) / 2;
+		if (evaluate_frame(encoder, *noise_level, middle) <= budget) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+	*boundary = low;
+}
+
+static int find_scalefactor(float peak) {
+	if (peak <= 0.0f) {
+		return 0;
+	}
+	int scalefactor = 1;
+	while (scalefactor < 63 && hca_scaling_table[scalefactor] < peak) {
+		scalefactor++;
+	}
+	return scalefactor;
+}
+
+// MDCT of the previous and the current block, the transpose of the decoder's
+// window, fold and DCT-IV
+static void transform_block(ChannelState* channel, const float* block,
+                            float* spectrum) {
+	const int half = HCA_SAMPLES_PER_SUBFRAME / 2;
+	float folded[BAND_COUNT];
+
+	for (int i = 0; i < half; i++) {
+		folded[half + i] = hca_window[127 - i] * channel->previous[127 - i] -
+		                   hca_window[i] * channel->previous[i];
+		folded[i] = hca_window[64 + i] * block[63 - i] +
+		            hca_window[63 - i] * block[64 + i];
+	}
+	hca_dct4(folded, spectrum);
+
+	memcpy(channel->previous, block, sizeof(channel->previous));
+}
+
+static void analyze_channel(ChannelState* channel, const float* samples,
+                            unsigned channels, unsigned count) {
+	float block[HCA_SAMPLES_PER_SUBFRAME];
+
+	for (int s = 0; s < HCA_SUBFRAMES; s++) {
+		for (int i = 0; i < HCA_SAMPLES_PER_SUBFRAME; i++) {
+			unsigned index = s * HCA_SAMPLES_PER_SUBFRAME + i;
+			block[i] = (index < count) ? samples[index * channels] : 0.0f;
+		}
+		transform_block(channel, block, channel->spectra[s]);
+	}
+
+	for (int b = 0; b < BAND_COUNT; b++) {
+		float peak = 0.0f;
+		for (int s = 0; s < HCA_SUBFRAMES; s++) {
+			float magnitude = fabsf(channel->spectra[s][b]);
+			if (magnitude > peak) peak = magnitude;
+		}
+		channel->peak_scalefactors[b] = (uint8_t)find_scalefactor(peak);
+	}
+
+	for (int b = 0; b < BAND_COUNT; b++) {
+		for (int r = 0; r < RESOLUTION_COUNT; r++) {
+			channel->band_bits[b][r] = NOT_COUNTED;
+		}
+	}
+}
+
+// Writes the low bits of value MSB first into a zeroed buffer
+static void put_bits(BitWriter* writer, unsigned value, int bits) {
+	while (bits > 0) {
+		int room = 8 - (int)(writer->position & 7);
+		int take = (bits < room) ? bits : room;
+		unsigned chunk = (value >> (bits - take)) & ((1u << take) - 1);
+		writer->data[writer->position >> 3] |= (uint8_t)(chunk << (room - take));
+		writer->position += take;
+		bits -= take;
+	}
+}
+
+static void write_scalefactors(BitWriter* writer, const ChannelState* channel) {
+	int bits = channel->delta_bits;
+	put_bits(writer, (unsigned)bits, 3);
+	if (bits == 0) {
+		return;
+	}
+	if (bits >= 6) {
+		for (int b = 0; b < BAND_COUNT; b++) {
+			put_bits(writer, channel->scalefactors[b], 6);
+		}
+		return;
+	}
+
+	int escape = (1 << bits) - 1;
+	put_bits(writer, channel->scalefactors[0], 6);
+	for (int b = 1; b < BAND_COUNT; b++) {
+		int delta = channel->scalefactors[b] - channel->scalefactors[b - 1];
+		if (delta_fits(delta, bits)) {
+			put_bits(writer, (unsigned)(delta + (escape >> 1)), bits);
+		} else {
+			put_bits(writer, (unsigned)escape, bits);
+			put_bits(writer, channel->scalefactors[b], 6);
+		}
+	}
+}
+
+static void write_coefficients(BitWriter* writer, const ChannelState* channel,
+                               int subframe) {
+	for (int b = 0; b < BAND_COUNT; b++) {
+		int resolution = channel->resolutions[b];
+		if (resolution == 0) {
+			continue;
+		}
+
+		float step = inverse_step(channel->scalefactors[b], resolution);
+		int value = quantize(channel->spectra[subframe][b], step, resolution);
+		if (resolution < 8) {
+			put_bits(writer, code_values[resolution][value + 7],
+			         code_lengths[resolution][value + 7]);
+		} else if (value == 0) {
+			put_bits(writer, 0, hca_max_bit_size[resolution] - 1);
+		} else {
+			unsigned code = ((unsigned)abs(value) << 1) | (value < 0);
+			put_bits(writer, code, hca_max_bit_size[resolution]);
+		}
+	}
+}
+
+int hca_prepare_wav(WavReader* wav, const HcaEncodeOptions* options,
+                    HcaEncodeOptions* prepared) {
+	// A loop found in the audio stands in for a missing smpl loop, it is
+	// looked for at the WAV's own rate and scaled along with a smpl loop
+	if (options->loop && options->loop_start == 0 && options->loop_end == 0 &&
+	        !wav->has_loop) {
+		uint32_t start;
+		uint32_t end;
+		bool found = loop_find(wav, &start, &end);
+		if (wav_reader_rewind(wav) != 0) {
+			return -1;
+		}
+		if (found) {
+			wav->has_loop = true;
+			wav->loop_start = start;
+			wav->loop_end = end;
+		}
+	}
+	if (options->sample_rate != 0 && wav_reader_resample(wav, options->sample_rate) != 0) {
+		return -1;
+	}
+	*prepared = *options;
+	if (prepared->loop && prepared->loop_start == 0 && prepared->loop_end == 0 &&
+	        wav->has_loop) {
+		prepared->loop_start = wav->loop_start;
+		prepared->loop_end = wav->loop_end;
+	}
+	return 0;
+}
+
+HcaEncoder* hca_encoder_create(unsigned channels, unsigned sample_rate,
+                               uint32_t sample_count, const HcaEncodeOptions* options) {
+	if (channels == 0 || channels > HCA_MAX_CHANNELS || sample_rate == 0 ||
+	        sample_rate > 0xFFFFFF) {
+		return NULL;
+	}
+
+	HcaEncoder* encoder = calloc(1, sizeof(HcaEncoder));
+	if (!encoder) {
+		return NULL;
+	}
+	pthread_once(&tables_once, init_tables);
+
+	HcaInfo* info = &encoder->info;
+	info->version = HCA_VERSION_V200;
+	info->channels = channels;
+	info->sample_rate = sample_rate;
+
+	// The decoder's first subframe only holds the window lead-in
+	uint64_t total = (uint64_t)sample_count + HCA_SAMPLES_PER_SUBFRAME;
+	uint64_t frame_count = (total + HCA_SAMPLES_PER_FRAME - 1) / HCA_SAMPLES_PER_FRAME;
+	if (frame_count > UINT32_MAX) {
+		free(encoder);
+		return NULL;
+	}
+	info->frame_count = (uint32_t)frame_count;
+	info->encoder_delay = HCA_SAMPLES_PER_SUBFRAME;
+	info->encoder_padding = (uint16_t)(frame_count * HCA_SAMPLES_PER_FRAME - total);
+
+	// Bitrate / frames per second, the sample rate cancels out
+	info->frame_size = options->frame_size ? options->frame_size :
+	                   (uint16_t)(channels * 16u * HCA_SAMPLES_PER_FRAME / COMPRESSION_RATIO / 8);
+	if (info->frame_size * 8u < MIN_FRAME_BITS(channels) || info->frame_size < 8) {
+		free(encoder);
+		return NULL;
+	}
+	info->min_resolution = 1;
+	info->max_resolution = 15;
+	info->track_count = 1;
+	info->channel_config = 0;
+	// Every channel coded on its own over the full band, no joint stereo or
+	// high frequency reconstruction
+	info->total_band_count = BAND_COUNT;
+	info->base_band_count = BAND_COUNT;
+	info->stereo_band_count = 0;
+	info->bands_per_hfr_group = 0;
+
+	// An empty range leaves the file without a loop
+	if (options->loop) {
+		hca_set_loop_range(info, options->loop_start, options->loop_end);
+	}
+
+	uint8_t table[256];
+	info->cipher_type = options->key ? HCA_CIPHER_KEYED : HCA_CIPHER_NONE;
+	hca_cipher_init(table, info->cipher_type, options->key);
+	hca_cipher_invert(table, encoder->cipher);
+	return encoder;
+}
+
+void hca_encoder_free(HcaEncoder* encoder) {
+	free(encoder);
+}
+
+unsigned hca_encoder_fit_frame_size(unsigned channels, unsigned sample_rate,
+                                    uint32_t sample_count, const HcaEncodeOptions* options,
+                                    uint64_t budget, uint64_t* size) {
+	// The header doesn't depend on the frame size
+	HcaEncodeOptions fitted = *options;
+	fitted.frame_size = 0;
+	HcaEncoder* encoder = hca_encoder_create(channels, sample_rate, sample_count, &fitted);
+	if (!encoder) {
+		return 0;
+	}
+	uint8_t header[HCA_MAX_HEADER_SIZE];
+	int header_size = hca_encoder_write_header(encoder, header, sizeof(header));
+	uint32_t frame_count = encoder->info.frame_count;
+	hca_encoder_free(encoder);
+	if (header_size < 0 || budget < (uint64_t)header_size) {
+		return 0;
+	}
+
+	uint64_t frame_size = (budget - (uint64_t)header_size) / frame_count;
+	uint64_t max_size = channels * 2u * HCA_SAMPLES_PER_FRAME;
+	if (max_size > 0xFFFF) {
+		max_size = 0xFFFF;
+	}
+	if (frame_size > max_size) {
+		frame_size = max_size;
+	}
+	if (frame_size * 8 < MIN_FRAME_BITS(channels) || frame_size < 8) {
+		return 0;
+	}
+
+	*size = (uint64_t)header_size + (uint64_t)frame_count * frame_size;
+	return (unsigned)frame_size;
+}
+
+const HcaInfo* hca_encoder_info(const HcaEncoder* encoder) {
+	return &encoder->info;
+}
+
+int hca_encoder_write_header(HcaEncoder* encoder, uint8_t* buffer, size_t size) {
+	return hca_write_header(&encoder->info, buffer, size);
+}
+
+void hca_encoder_encode_frame(HcaEncoder* encoder, const float* samples,
+                              unsigned count, uint8_t* frame) {
+	const HcaInfo* info = &encoder->info;
+	if (count > HCA_SAMPLES_PER_FRAME) {
+		count = HCA_SAMPLES_PER_FRAME;
+	}
+
+	for (unsigned c = 0; c < info->channels; c++) {
+		analyze_channel(&encoder->channels[c], samples + c, info->channels, count);
+	}
+
+	int noise_level;
+	int boundary;
+	allocate_bits(encoder, &noise_level, &boundary);
+	evaluate_frame(encoder, noise_level, boundary);
+
+	memset(frame, 0, info->frame_size);
+	BitWriter writer = {frame, 0};
+	put_bits(&writer, 0xFFFF, 16);
+	put_bits(&writer, (unsigned)noise_level, 9);
+	put_bits(&writer, (unsigned)boundary, 7);
+	for (unsigned c = 0; c < info->channels; c++) {
+		write_scalefactors(&writer, &encoder->channels[c]);
+	}
+	for (int s = 0; s < HCA_SUBFRAMES; s++) {
+		for (unsigned c = 0; c < info->channels; c++) {
+			write_coefficients(&writer, &encoder->channels[c], s);
+		}
+	}
+
+	// The CRC covers the stored (encrypted) bytes
+	size_t payload = info->frame_size - 2u;
+	for (size_t i = 0; i < payload; i++) {
+		frame[i] = encoder->cipher[frame[i]];
+	}
+	uint16_t crc = hca_crc16(frame, payload);
+	frame[payload] = (uint8_t)(crc >> 8);
+	frame[payload + 1] = (uint8_t)crc;
+}
+
+int hca_encode_wav(WavReader* wav, const char* hca_path,
+                   const HcaEncodeOptions* options) {
+	HcaEncodeOptions wav_options;
+	HcaEncoder* encoder = NULL;
+	if (hca_prepare_wav(wav, options, &wav_options) == 0) {
+		encoder = hca_encoder_create(wav->channels, wav->sample_rate, wav->frame_count,
+		                             &wav_options);
+	}
+	if (!encoder) {
+		return HCA_ENCODE_BAD_INPUT;
+	}
+
+	const HcaInfo* info = hca_encoder_info(encoder);
+	float* samples = malloc(HCA_SAMPLES_PER_FRAME * info->channels * sizeof(float));
+	uint8_t* frame = malloc(info->frame_size);
+	FILE* output = fopen(hca_path, "wb");
+	int result = (samples && frame && output) ? 0 : HCA_ENCODE_WRITE_FAILED;
+
+	uint8_t header[HCA_MAX_HEADER_SIZE];
+	int header_size = hca_encoder_write_header(encoder, header, sizeof(header));
+	if (result == 0 && (header_size < 0 ||
+	                    fwrite(header, 1, header_size, output) != (size_t)header_size)) {
+		result = HCA_ENCODE_WRITE_FAILED;
+	}
+
+	for (uint32_t f = 0; result == 0 && f < info->frame_count; f++) {
+		size_t count = wav_reader_read(wav, samples, HCA_SAMPLES_PER_FRAME);
+		hca_encoder_encode_frame(encoder, samples, (unsigned)count, frame);
+		if (fwrite(frame, 1, info->frame_size, output) != info->frame_size) {
+			result = HCA_ENCODE_WRITE_FAILED;
+		}
+	}
+
+	if (output && fclose(output) != 0) {
+		result = HCA_ENCODE_WRITE_FAILED;
+	}
+	if (result != 0 && output) {
+		remove(hca_path);
+	}
+
+	free(samples);
+	free(frame);
+	hca_encoder_free(encoder);
+	return result;
+}
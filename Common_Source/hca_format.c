@@ -0,0 +1,627 @@
+#include "hca_format.h"
+#include <pthread.h>
+#include <string.h>
+
+// Stack buffer the file readers parse through, larger headers are only
+// checksummed past this point
+#define PARSE_BUFFER_SIZE 2048
+
+static const uint16_t crc16_table[256] = {
+	0x0000, 0x8005, 0x800F, 0x000A, 0x801B, 0x001E, 0x0014, 0x8011,
+	0x8033, 0x0036, 0x003C, 0x8039, 0x0028, 0x802D, 0x8027, 0x0022,
+	0x8063, 0x0066, 0x006C, 0x8069, 0x0078, 0x807D, 0x8077, 0x0072,
+	0x0050, 0x8055, 0x805F, 0x005A, 0x804B, 0x004E, 0x0044, 0x8041,
+	0x80C3, 0x00C6, 0x00CC, 0x80C9, 0x00D8, 0x80DD, 0x80D7, 0x00D2,
+	0x00F0, 0x80F5, 0x80FF, 0x00FA, 0x80EB, 0x00EE, 0x00E4, 0x80E1,
+	0x00A0, 0x80A5, 0x80AF, 0x00AA, 0x80BB, 0x00BE, 0x00B4, 0x80B1,
+	0x8093, 0x0096, 0x009C, 0x8099, 0x0088, 0x808D, 0x8087, 0x0082,
+	0x8183, 0x0186, 0x018C, 0x8189, 0x0198, 0x819D, 0x8197, 0x0192,
+	0x01B0, 0x81B5, 0x81BF, 0x01BA, 0x81AB, 0x01AE, 0x01A4, 0x81A1,
+	0x01E0, 0x81E5, 0x81EF, 0x01EA, 0x81FB, 0x01FE, 0x01F4, 0x81F1,
+	0x81D3, 0x01D6, 0x01DC, 0x81D9, 0x01C8, 0x81CD, 0x81C7, 0x01C2,
+	0x0140, 0x8145, 0x814F, 0x014A, 0x815B, 0x015E, 0x0154, 0x8151,
+	0x8173, 0x0176, 0x017C, 0x8179, 0x0168, 0x816D, 0x8167, 0x0162,
+	0x8123, 0x0126, 0x012C, 0x8129, 0x0138, 0x813D, 0x8137, 0x0132,
+	0x0110, 0x8115, 0x811F, 0x011A, 0x810B, 0x010E, 0x0104, 0x8101,
+	0x8303, 0x0306, 0x030C, 0x8309, 0x0318, 0x831D, 0x8317, 0x0312,
+	0x0330, 0x8335, 0x833F, 0x033A, 0x832B, 0x032E, 0x0324, 0x8321,
+	0x0360, 0x8365, 0x836F, 0x036A, 0x837B, 0x037E, 0x0374, 0x8371,
+	0x8353, 0x0356, 0x035C, 0x8359, 0x0348, 0x834D, 0x8347, 0x0342,
+	0x03C0, 0x83C5, 0x83CF, 0x03CA, 0x83DB, 0x03DE, 0x03D4, 0x83D1,
+	0x83F3, 0x03F6, 0x03FC, 0x83F9, 0x03E8, 0x83ED, 0x83E7, 0x03E2,
+	0x83A3, 0x03A6, 0x03AC, 0x83A9, 0x03B8, 0x83BD, 0x83B7, 0x03B2,
+	0x0390, 0x8395, 0x839F, 0x039A, 0x838B, 0x038E, 0x0384, 0x8381,
+	0x0280, 0x8285, 0x828F, 0x028A, 0x829B, 0x029E, 0x0294, 0x8291,
+	0x82B3, 0x02B6, 0x02BC, 0x82B9, 0x02A8, 0x82AD, 0x82A7, 0x02A2,
+	0x82E3, 0x02E6, 0x02EC, 0x82E9, 0x02F8, 0x82FD, 0x82F7, 0x02F2,
+	0x02D0, 0x82D5, 0x82DF, 0x02DA, 0x82CB, 0x02CE, 0x02C4, 0x82C1,
+	0x8243, 0x0246, 0x024C, 0x8249, 0x0258, 0x825D, 0x8257, 0x0252,
+	0x0270, 0x8275, 0x827F, 0x027A, 0x826B, 0x026E, 0x0264, 0x8261,
+	0x0220, 0x8225, 0x822F, 0x022A, 0x823B, 0x023E, 0x0234, 0x8231,
+	0x8213, 0x0216, 0x021C, 0x8219, 0x0208, 0x820D, 0x8207, 0x0202,
+};
+
+// crc16_slices[k - 1][b] is the CRC of byte b followed by k zero bytes, so 8
+// bytes can be folded in with independent lookups
+static uint16_t crc16_slices[7][256];
+static pthread_once_t crc16_once = PTHREAD_ONCE_INIT;
+
+static void init_crc16_slices(void) {
+	const uint16_t* previous = crc16_table;
+	for (int k = 0; k < 7; k++) {
+		for (int b = 0; b < 256; b++) {
+			uint16_t crc = previous[b];
+			crc16_slices[k][b] = (uint16_t)((crc << 8) ^ crc16_table[crc >> 8]);
+		}
+		previous = crc16_slices[k];
+	}
+}
+
+static uint16_t crc16_update(uint16_t crc, const uint8_t* data, size_t size) {
+	if (size >= 8) {
+		pthread_once(&crc16_once, init_crc16_slices);
+	}
+	// The running CRC goes into the first two bytes of each block
+	const uint16_t (*t)[256] = crc16_slices;
+	for (; size >= 8; data += 8, size -= 8) {
+		crc = t[6][data[0] ^ (crc >> 8)] ^ t[5][data[1] ^ (crc & 0xFF)] ^
+		      t[4][data[2]] ^ t[3][data[3]] ^ t[2][data[4]] ^ t[1][data[5]] ^
+		      t[0][data[6]] ^ crc16_table[data[7]];
+	}
+	for (size_t i = 0; i < size; i++) {
+		crc = (uint16_t)((crc << 8) ^ crc16_table[(crc >> 8) ^ data[i]]);
+	}
+	return crc;
+}
+
+uint16_t hca_crc16(const uint8_t* data, size_t size) {
+	return crc16_update(0, data, size);
+}
+
+static uint8_t* put_u8(uint8_t* p, unsigned value) {
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static uint8_t* put_u16(uint8_t* p, unsigned value) {
+	*p++ = (uint8_t)(value >> 8);
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static uint8_t* put_u24(uint8_t* p, uint32_t value) {
+	*p++ = (uint8_t)(value >> 16);
+	return put_u16(p, value & 0xFFFF);
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t value) {
+	p = put_u16(p, value >> 16);
+	return put_u16(p, value & 0xFFFF);
+}
+
+static uint8_t* put_id(uint8_t* p, const char id[4]) {
+	memcpy(p, id, 4);
+	return p + 4;
+}
+
+int hca_write_header(HcaInfo* info, uint8_t* buffer, size_t size) {
+	size_t header_size = 8 + 16 + 16 + 6 + 2;
+	if (info->loop_enabled) {
+		header_size += 16;
+	}
+	if (size < header_size) {
+		return -1;
+	}
+	info->header_size = (uint16_t)header_size;
+
+	uint8_t* p = buffer;
+	p = put_id(p, "HCA\0");
+	p = put_u16(p, info->version);
+	p = put_u16(p, info->header_size);
+
+	p = put_id(p, "fmt\0");
+	p = put_u8(p, info->channels);
+	p = put_u24(p, info->sample_rate);
+	p = put_u32(p, info->frame_count);
+	p = put_u16(p, info->encoder_delay);
+	p = put_u16(p, info->encoder_padding);
+
+	p = put_id(p, "comp");
+	p = put_u16(p, info->frame_size);
+	p = put_u8(p, info->min_resolution);
+	p = put_u8(p, info->max_resolution);
+	p = put_u8(p, info->track_count);
+	p = put_u8(p, info->channel_config);
+	p = put_u8(p, info->total_band_count);
+	p = put_u8(p, info->base_band_count);
+	p = put_u8(p, info->stereo_band_count);
+	p = put_u8(p, info->bands_per_hfr_group);
+	p = put_u8(p, info->ms_stereo);
+	p = put_u8(p, 0); // Reserved
+
+	if (info->loop_enabled) {
+		p = put_id(p, "loop");
+		p = put_u32(p, info->loop_start_frame);
+		p = put_u32(p, info->loop_end_frame);
+		p = put_u16(p, info->loop_start_delay);
+		p = put_u16(p, info->loop_end_padding);
+	}
+
+	p = put_id(p, "ciph");
+	p = put_u16(p, info->cipher_type);
+
+	put_u16(p, hca_crc16(buffer, header_size - 2));
+	return (int)header_size;
+}
+
+static uint16_t get_u16(const uint8_t* p) {
+	return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get_u24(const uint8_t* p) {
+	return (uint32_t)p[0] << 16 | get_u16(p + 1);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+	return (uint32_t)get_u16(p) << 16 | get_u16(p + 2);
+}
+
+// Chunk IDs may have their high bits set to hide the names
+#define CHUNK_ID(a, b, c, d) \
+	((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+#define CHUNK_MASK 0x7F7F7F7F
+
+static uint32_t get_id(const uint8_t* p) {
+	return get_u32(p) & CHUNK_MASK;
+}
+
+int hca_header_size(const uint8_t* data, size_t size) {
+	if (size < 8 || get_id(data) != CHUNK_ID('H', 'C', 'A', 0)) {
+		return -1;
+	}
+	uint16_t header_size = get_u16(data + 6);
+	return (header_size < 8) ? -1 : header_size;
+}
+
+// Bytes a chunk takes, 0 for pad and unknown chunks which run to the CRC
+static size_t chunk_size(uint32_t id, const uint8_t* p, size_t left) {
+	switch (id) {
+	case CHUNK_ID('f', 'm', 't', 0):
+	case CHUNK_ID('c', 'o', 'm', 'p'):
+	case CHUNK_ID('l', 'o', 'o', 'p'):
+		return 16;
+	case CHUNK_ID('d', 'e', 'c', 0):
+		return 12;
+	case CHUNK_ID('v', 'b', 'r', 0):
+	case CHUNK_ID('r', 'v', 'a', 0):
+		return 8;
+	case CHUNK_ID('a', 't', 'h', 0):
+	case CHUNK_ID('c', 'i', 'p', 'h'):
+		return 6;
+	case CHUNK_ID('c', 'o', 'm', 'm'):
+		return (left > 4) ? 5u + p[4] : 0;
+	default:
+		return 0;
+	}
+}
+
+int hca_find_chunk(const uint8_t* header, size_t header_size, const char id[4]) {
+	uint32_t wanted = CHUNK_ID(id[0], id[1], id[2], id[3]) & CHUNK_MASK;
+	if (header_size < 10) {
+		return -1;
+	}
+
+	size_t end = header_size - 2;
+	size_t offset = 8;
+	while (offset + 4 <= end) {
+		uint32_t current = get_id(header + offset);
+		if (current == wanted) {
+			return (int)offset;
+		}
+		size_t size = chunk_size(current, header + offset, end - offset);
+		if (size == 0) {
+			break;
+		}
+		offset += size;
+	}
+	return -1;
+}
+
+static bool is_known_version(uint16_t version) {
+	switch (version) {
+	case 0x0101:
+	case 0x0102:
+	case 0x0103:
+	case HCA_VERSION_V200:
+	case HCA_VERSION_V300:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Checks the fields the frame layout is derived from
+static bool is_valid_layout(const HcaInfo* info) {
+	return info->channels > 0 && info->channels <= HCA_MAX_CHANNELS &&
+	       info->sample_rate > 0 && info->frame_count > 0 &&
+	       info->frame_size >= 8 && info->max_resolution <= 15 &&
+	       info->min_resolution <= info->max_resolution &&
+	       info->track_count > 0 && info->track_count <= info->channels &&
+	       info->total_band_count <= HCA_SAMPLES_PER_SUBFRAME &&
+	       info->base_band_count + info->stereo_band_count <= info->total_band_count;
+}
+
+// Parses the chunks of a header whose first size bytes are in data, which
+// only needs to reach past the last chunk before comm and pad. The CRC is
+// left to the caller
+static int parse_header(const uint8_t* data, size_t size, HcaInfo* info) {
+	int header_size = hca_header_size(data, size);
+	if (header_size < 10) {
+		return -1;
+	}
+	if (size > (size_t)header_size - 2) {
+		size = (size_t)header_size - 2;
+	}
+
+	memset(info, 0, sizeof(*info));
+	info->version = get_u16(data + 4);
+	info->header_size = (uint16_t)header_size;
+	info->ath_type = (info->version < HCA_VERSION_V200) ? 1 : 0;
+	info->volume = 1.0f;
+	if (!is_known_version(info->version)) {
+		return -1;
+	}
+
+	// fmt and comp/dec come first, the rest are optional and in a fixed order
+	const uint8_t* p = data + 8;
+	const uint8_t* end = data + size;
+	if (end - p < 16 || get_id(p) != CHUNK_ID('f', 'm', 't', 0)) {
+		return -1;
+	}
+	info->channels = p[4];
+	info->sample_rate = get_u24(p + 5);
+	info->frame_count = get_u32(p + 8);
+	info->encoder_delay = get_u16(p + 12);
+	info->encoder_padding = get_u16(p + 14);
+	p += 16;
+
+	if (end - p >= 16 && get_id(p) == CHUNK_ID('c', 'o', 'm', 'p')) {
+		info->frame_size = get_u16(p + 4);
+		info->min_resolution = p[6];
+		info->max_resolution = p[7];
+		info->track_count = p[8];
+		info->channel_config = p[9];
+		info->total_band_count = p[10];
+		info->base_band_count = p[11];
+		info->stereo_band_count = p[12];
+		info->bands_per_hfr_group = p[13];
+		info->ms_stereo = p[14];
+		p += 16;
+	} else if (end - p >= 12 && get_id(p) == CHUNK_ID('d', 'e', 'c', 0)) {
+		// Older layout, band counts are stored minus one and there is no HFR
+		info->frame_size = get_u16(p + 4);
+		info->min_resolution = p[6];
+		info->max_resolution = p[7];
+		info->total_band_count = (uint8_t)(p[8] + 1);
+		info->base_band_count = (uint8_t)(p[9] + 1);
+		info->track_count = p[10] >> 4;
+		info->channel_config = p[10] & 0xF;
+		if (p[11] == 0) {
+			info->base_band_count = info->total_band_count;
+		}
+		info->stereo_band_count = (uint8_t)(info->total_band_count - info->base_band_count);
+		p += 12;
+	} else {
+		return -1;
+	}
+
+	if (end - p >= 8 && get_id(p) == CHUNK_ID('v', 'b', 'r', 0)) {
+		info->vbr = true;
+		p += 8;
+	}
+	if (end - p >= 6 && get_id(p) == CHUNK_ID('a', 't', 'h', 0)) {
+		info->ath_type = get_u16(p + 4);
+		p += 6;
+	}
+	if (end - p >= 16 && get_id(p) == CHUNK_ID('l', 'o', 'o', 'p')) {
+		info->loop_enabled = true;
+		info->loop_start_frame = get_u32(p + 4);
+		info->loop_end_frame = get_u32(p + 8);
+		info->loop_start_delay = get_u16(p + 12);
+		info->loop_end_padding = get_u16(p + 14);
+		p += 16;
+	}
+	if (end - p >= 6 && get_id(p) == CHUNK_ID('c', 'i', 'p', 'h')) {
+		info->cipher_type = get_u16(p + 4);
+		p += 6;
+	}
+	if (end - p >= 8 && get_id(p) == CHUNK_ID('r', 'v', 'a', 0)) {
+		uint32_t bits = get_u32(p + 4);
+		memcpy(&info->volume, &bits, sizeof(info->volume));
+	}
+	// comm and pad only carry text and filler
+
+	if (info->track_count == 0) {
+		info->track_count = 1;
+	}
+	if (!is_valid_layout(info) || info->loop_start_frame > info->loop_end_frame) {
+		return -1;
+	}
+	return 0;
+}
+
+int hca_read_header(const uint8_t* data, size_t size, HcaInfo* info) {
+	int header_size = hca_header_size(data, size);
+	if (header_size < 0 || (size_t)header_size > size ||
+	        hca_crc16(data, (size_t)header_size) != 0) {
+		return -1;
+	}
+	return parse_header(data, (size_t)header_size, info);
+}
+
+// Parses the header starting in buffer, which holds read bytes of the file
+// (at least 8), reading the rest through the same buffer. Bytes past the
+// header in buffer are ignored
+static int read_header_from(FILE* file, uint8_t buffer[PARSE_BUFFER_SIZE], size_t read,
+                            HcaInfo* info) {
+	int header_size = hca_header_size(buffer, read);
+	if (header_size < 0) {
+		return -1;
+	}
+
+	size_t prefix = (header_size < PARSE_BUFFER_SIZE) ? (size_t)header_size : PARSE_BUFFER_SIZE;
+	if (read < prefix && fread(buffer + read, 1, prefix - read, file) != prefix - read) {
+		return -1;
+	}
+	if (parse_header(buffer, prefix, info) != 0) {
+		return -1;
+	}
+
+	uint16_t crc = crc16_update(0, buffer, prefix);
+	for (size_t rest = (size_t)header_size - prefix; rest > 0;) {
+		size_t bytes = (rest < PARSE_BUFFER_SIZE) ? rest : PARSE_BUFFER_SIZE;
+		if (fread(buffer, 1, bytes, file) != bytes) {
+			return -1;
+		}
+		crc = crc16_update(crc, buffer, bytes);
+		rest -= bytes;
+	}
+	return (crc == 0) ? 0 : -1;
+}
+
+int hca_read_file_header(FILE* file, HcaInfo* info) {
+	uint8_t buffer[PARSE_BUFFER_SIZE];
+	if (fread(buffer, 1, 8, file) != 8) {
+		return -1;
+	}
+	return read_header_from(file, buffer, 8, info);
+}
+
+int hca_query_file(const char* path, HcaInfo* info) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return -1;
+	}
+	// One read covers most headers, a stdio buffer would only add a copy
+	setvbuf(file, NULL, _IONBF, 0);
+
+	uint8_t buffer[PARSE_BUFFER_SIZE];
+	size_t read = fread(buffer, 1, sizeof(buffer), file);
+	int result = (read >= 8) ? read_header_from(file, buffer, read, info) : -1;
+	fclose(file);
+	return result;
+}
+
+uint32_t hca_sample_count(const HcaInfo* info) {
+	uint64_t samples = (uint64_t)info->frame_count * HCA_SAMPLES_PER_FRAME;
+	uint32_t dropped = (uint32_t)info->encoder_delay + info->encoder_padding;
+	return (samples > dropped) ? (uint32_t)(samples - dropped) : 0;
+}
+
+bool hca_loop_range(const HcaInfo* info, uint32_t* start, uint32_t* end) {
+	if (!info->loop_enabled) {
+		return false;
+	}
+	uint64_t first = (uint64_t)info->loop_start_frame * HCA_SAMPLES_PER_FRAME +
+	                 info->loop_start_delay;
+	uint64_t after = ((uint64_t)info->loop_end_frame + 1) * HCA_SAMPLES_PER_FRAME -
+	                 info->loop_end_padding;
+	*start = (first > info->encoder_delay) ? (uint32_t)(first - info->encoder_delay) : 0;
+	*end = (after > info->encoder_delay) ? (uint32_t)(after - info->encoder_delay) : 0;
+	return true;
+}
+
+int hca_set_loop_range(HcaInfo* info, uint32_t start, uint32_t end) {
+	uint32_t samples = hca_sample_count(info);
+	if (end == 0 || end > samples) {
+		end = samples;
+	}
+	if (start >= end) {
+		return -1;
+	}
+
+	uint32_t first = start + info->encoder_delay;
+	uint32_t last = end - 1 + info->encoder_delay;
+	info->loop_enabled = true;
+	info->loop_start_frame = first / HCA_SAMPLES_PER_FRAME;
+	info->loop_start_delay = first % HCA_SAMPLES_PER_FRAME;
+	info->loop_end_frame = last / HCA_SAMPLES_PER_FRAME;
+	info->loop_end_padding = HCA_SAMPLES_PER_FRAME - 1 - last % HCA_SAMPLES_PER_FRAME;
+	return 0;
+}
+
+// Position of a chunk in the fixed order, -1 for chunks without a fixed size
+static int chunk_rank(uint32_t id) {
+	switch (id) {
+	case CHUNK_ID('f', 'm', 't', 0):
+		return 0;
+	case CHUNK_ID('c', 'o', 'm', 'p'):
+	case CHUNK_ID('d', 'e', 'c', 0):
+		return 1;
+	case CHUNK_ID('v', 'b', 'r', 0):
+		return 2;
+	case CHUNK_ID('a', 't', 'h', 0):
+		return 3;
+	case CHUNK_ID('l', 'o', 'o', 'p'):
+		return 4;
+	case CHUNK_ID('c', 'i', 'p', 'h'):
+		return 5;
+	case CHUNK_ID('r', 'v', 'a', 0):
+		return 6;
+	default:
+		return -1;
+	}
+}
+
+int hca_header_set_chunk(const uint8_t* header, size_t size, const char id[4],
+                         const uint8_t* body, size_t body_size,
+                         uint8_t* output, size_t output_size) {
+	uint32_t wanted = CHUNK_ID(id[0], id[1], id[2], id[3]) & CHUNK_MASK;
+	int rank = chunk_rank(wanted);
+	if (rank < 0 || chunk_size(wanted, NULL, 0) != body_size + 4 || size < 10) {
+		return -1;
+	}
+
+	size_t end = size - 2;
+	size_t new_size = size;
+	int offset = hca_find_chunk(header, size, id);
+	if (offset >= 0) {
+		if (output_size < size) {
+			return -1;
+		}
+		memcpy(output, header, end);
+	} else {
+		// Before the first chunk that comes later in the order, comm and pad
+		// always do
+		size_t insert = end;
+		size_t pad = end;
+		size_t position = 8;
+		while (position + 4 <= end) {
+			uint32_t current = get_id(header + position);
+			int current_rank = chunk_rank(current);
+			if ((current_rank < 0 || current_rank > rank) && position < insert) {
+				insert = position;
+			}
+			if (current == CHUNK_ID('p', 'a', 'd', 0)) {
+				pad = position;
+			}
+			size_t chunk = chunk_size(current, header + position, end - position);
+			if (chunk == 0) {
+				break;
+			}
+			position += chunk;
+		}
+
+		// The pad name stays, its filler shrinks
+		size_t moved = end - insert;
+		if (end - pad >= 4 + body_size + 4) {
+			moved -= body_size + 4;
+		} else {
+			new_size += body_size + 4;
+		}
+		if (output_size < new_size || new_size > 0xFFFF) {
+			return -1;
+		}
+
+		memcpy(output, header, insert);
+		memcpy(output + insert + 4 + body_size, header + insert, moved);
+		memcpy(output + insert, id, 4);
+		offset = (int)insert;
+		output[6] = (uint8_t)(new_size >> 8);
+		output[7] = (uint8_t)new_size;
+	}
+
+	memcpy(output + offset + 4, body, body_size);
+	put_u16(output + new_size - 2, hca_crc16(output, new_size - 2));
+	return (int)new_size;
+}
+
+// Sequence of 16 nibbles, seeded by the upper nibble of key
+static void cipher_nibbles(uint8_t* nibbles, uint8_t key) {
+	int mul = ((key & 1) << 3) | 5;
+	int add = (key & 0xE) | 1;
+	key >>= 4;
+	for (int i = 0; i < 16; i++) {
+		key = (uint8_t)((key * mul + add) & 0xF);
+		nibbles[i] = key;
+	}
+}
+
+static void cipher_init_keyed(uint8_t table[256], uint64_t key) {
+	uint8_t kc[7];
+	if (key != 0) {
+		key--;
+	}
+	for (int i = 0; i < 7; i++) {
+		kc[i] = (uint8_t)(key & 0xFF);
+		key >>= 8;
+	}
+
+	const uint8_t seed[16] = {
+		kc[1], kc[1] ^ kc[6], kc[2] ^ kc[3], kc[2],
+		kc[2] ^ kc[1], kc[3] ^ kc[4], kc[3], kc[3] ^ kc[2],
+		kc[4] ^ kc[5], kc[4], kc[4] ^ kc[3], kc[5] ^ kc[6],
+		kc[5], kc[5] ^ kc[4], kc[6] ^ kc[1], kc[6]
+	};
+
+	// Upper nibbles from the first key byte, lower nibbles from the seeds
+	uint8_t base[256];
+	uint8_t rows[16];
+	uint8_t columns[16];
+	cipher_nibbles(rows, kc[0]);
+	for (int r = 0; r < 16; r++) {
+		cipher_nibbles(columns, seed[r]);
+		for (int c = 0; c < 16; c++) {
+			base[r * 16 + c] = (uint8_t)((rows[r] << 4) | columns[c]);
+		}
+	}
+
+	// Shuffle with a stride of 17, 0x00 and 0xFF always map to themselves
+	int x = 0;
+	int position = 1;
+	for (int i = 0; i < 256; i++) {
+		x = (x + 17) & 0xFF;
+		if (base[x] != 0 && base[x] != 0xFF) {
+			table[position++] = base[x];
+		}
+	}
+	table[0] = 0;
+	table[0xFF] = 0xFF;
+}
+
+static void cipher_init_static(uint8_t table[256]) {
+	unsigned value = 0;
+	for (int i = 1; i < 255; i++) {
+		value = (value * 13 + 11) & 0xFF;
+		if (value == 0 || value == 0xFF) {
+			value = (value * 13 + 11) & 0xFF;
+		}
+		table[i] = (uint8_t)value;
+	}
+	table[0] = 0;
+	table[0xFF] = 0xFF;
+}
+
+int hca_cipher_init(uint8_t table[256], unsigned type, uint64_t key) {
+	switch (type) {
+	case HCA_CIPHER_NONE:
+		for (int i = 0; i < 256; i++) {
+			table[i] = (uint8_t)i;
+		}
+		return 0;
+	case HCA_CIPHER_STATIC:
+		cipher_init_static(table);
+		return 0;
+	case HCA_CIPHER_KEYED:
+		cipher_init_keyed(table, key);
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+void hca_cipher_invert(const uint8_t table[256], uint8_t inverse[256]) {
+	for (int i = 0; i < 256; i++) {
+		inverse[table[i]] = (uint8_t)i;
+	}
+}
@@ -0,0 +1,127 @@
+#include "hca_loop.h"
+#include "atomic_file.h"
+#include "hca_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOP_BODY_SIZE 12
+#define TEMP_PATH_SIZE 1024
+// Bytes copied per write when the frames have to move
+#define COPY_BLOCK_SIZE (1 << 20)
+
+static uint8_t* put_u16(uint8_t* p, unsigned value) {
+	*p++ = (uint8_t)(value >> 8);
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t value) {
+	p = put_u16(p, value >> 16);
+	return put_u16(p, value & 0xFFFF);
+}
+
+// Writes header followed by everything after the old header in source
+static int write_moved(FILE* source, const uint8_t* header, size_t size, FILE* output) {
+	if (fwrite(header, 1, size, output) != size) {
+		return HCA_LOOP_WRITE_FAILED;
+	}
+
+	uint8_t* block = malloc(COPY_BLOCK_SIZE);
+	if (!block) {
+		return HCA_LOOP_WRITE_FAILED;
+	}
+	int result = 0;
+	size_t bytes;
+	while ((bytes = fread(block, 1, COPY_BLOCK_SIZE, source)) > 0) {
+		if (fwrite(block, 1, bytes, output) != bytes) {
+			result = HCA_LOOP_WRITE_FAILED;
+			break;
+		}
+	}
+	if (ferror(source)) {
+		result = HCA_LOOP_BAD_INPUT;
+	}
+	free(block);
+	return result;
+}
+
+static int replace_file(const char* path, FILE* source, const uint8_t* header, size_t size) {
+	char temp_path[TEMP_PATH_SIZE];
+	atomic_file_temp_path(path, temp_path, sizeof(temp_path));
+	FILE* output = fopen(temp_path, "wb");
+	if (!output) {
+		return HCA_LOOP_WRITE_FAILED;
+	}
+
+	int result = write_moved(source, header, size, output);
+	if (fclose(output) != 0 && result == 0) {
+		result = HCA_LOOP_WRITE_FAILED;
+	}
+	// The source has to be closed before it can be replaced on Windows
+	fclose(source);
+
+	if (result == 0 && atomic_file_replace(temp_path, path) != 0) {
+		result = HCA_LOOP_WRITE_FAILED;
+	}
+	if (result != 0) {
+		remove(temp_path);
+	}
+	return result;
+}
+
+int hca_set_loop_file(const char* path, uint32_t start, uint32_t end) {
+	FILE* file = fopen(path, "r+b");
+	if (!file) {
+		return HCA_LOOP_BAD_INPUT;
+	}
+
+	HcaInfo info;
+	if (hca_read_file_header(file, &info) != 0 || hca_set_loop_range(&info, start, end) != 0) {
+		fclose(file);
+		return HCA_LOOP_BAD_INPUT;
+	}
+
+	// The original header followed by room for the patched one
+	size_t size = info.header_size;
+	size_t capacity = size + 4 + LOOP_BODY_SIZE;
+	uint8_t* header = malloc(size + capacity);
+	if (!header) {
+		fclose(file);
+		return HCA_LOOP_WRITE_FAILED;
+	}
+	uint8_t* patched = header + size;
+
+	uint8_t body[LOOP_BODY_SIZE];
+	uint8_t* p = put_u32(body, info.loop_start_frame);
+	p = put_u32(p, info.loop_end_frame);
+	p = put_u16(p, info.loop_start_delay);
+	put_u16(p, info.loop_end_padding);
+
+	int result = HCA_LOOP_BAD_INPUT;
+	int patched_size = -1;
+	if (fseek(file, 0, SEEK_SET) == 0 && fread(header, 1, size, file) == size) {
+		patched_size = hca_header_set_chunk(header, size, "loop", body, sizeof(body),
+		                                    patched, capacity);
+	}
+
+	if (patched_size < 0) {
+		fclose(file);
+	} else if ((size_t)patched_size != size) {
+		// The frames move, file is now right after the old header
+		result = replace_file(path, file, patched, (size_t)patched_size);
+	} else if (memcmp(header, patched, size) == 0) {
+		// Already looping like this
+		result = 0;
+		fclose(file);
+	} else {
+		result = (fseek(file, 0, SEEK_SET) == 0 &&
+		          fwrite(patched, 1, size, file) == size) ? 0 : HCA_LOOP_WRITE_FAILED;
+		if (fclose(file) != 0) {
+			result = HCA_LOOP_WRITE_FAILED;
+		}
+	}
+
+	free(header);
+	return result;
+}
@@ -0,0 +1,74 @@
+#include "hca_mdct.h"
+#include "hca_dsp.h"
+#include <math.h>
+#include <pthread.h>
+
+#define FFT_SIZE HCA_FFT_SIZE
+#define PI 3.14159265358979323846
+
+// Pre-twiddles are stored in bit-reversed order to match the FFT input,
+// stage twiddles are laid out per stage: size / 2 factors for every size
+static float pre_re[FFT_SIZE];
+static float pre_im[FFT_SIZE];
+static float post_re[FFT_SIZE]; // Include the sqrt(2 / N) scale
+static float post_im[FFT_SIZE];
+static float stage_re[FFT_SIZE];
+static float stage_im[FFT_SIZE];
+static unsigned char bit_reverse[FFT_SIZE];
+static const HcaDsp* dsp;
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void init_tables(void) {
+	const double n = HCA_MDCT_SIZE;
+	const double scale = sqrt(2.0 / n);
+
+	for (int m = 0; m < FFT_SIZE; m++) {
+		int reversed = 0;
+		for (int bit = 1, value = m; bit < FFT_SIZE; bit <<= 1, value >>= 1) {
+			reversed = (reversed << 1) | (value & 1);
+		}
+		bit_reverse[m] = (unsigned char)reversed;
+
+		double angle = -PI * (4 * m + 1) / (4 * n);
+		pre_re[reversed] = (float)cos(angle);
+		pre_im[reversed] = (float)sin(angle);
+
+		angle = -PI * m / n;
+		post_re[m] = (float)(cos(angle) * scale);
+		post_im[m] = (float)(sin(angle) * scale);
+	}
+
+	for (int size = 2; size <= FFT_SIZE; size <<= 1) {
+		int half = size / 2;
+		for (int j = 0; j < half; j++) {
+			double angle = -2.0 * PI * j / size;
+			stage_re[half - 1 + j] = (float)cos(angle);
+			stage_im[half - 1 + j] = (float)sin(angle);
+		}
+	}
+
+	dsp = hca_dsp_get();
+}
+
+// Pairs even and reversed odd inputs into a half size complex FFT
+void hca_dct4(const float* input, float* output) {
+	pthread_once(&tables_once, init_tables);
+
+	float re[FFT_SIZE];
+	float im[FFT_SIZE];
+	for (int m = 0; m < FFT_SIZE; m++) {
+		re[bit_reverse[m]] = input[2 * m];
+		im[bit_reverse[m]] = input[HCA_MDCT_SIZE - 1 - 2 * m];
+	}
+	dsp->complex_multiply(re, im, pre_re, pre_im, FFT_SIZE);
+
+	for (int size = 2; size <= FFT_SIZE; size <<= 1) {
+		dsp->fft_stage(re, im, stage_re + size / 2 - 1, stage_im + size / 2 - 1, size);
+	}
+
+	dsp->complex_multiply(re, im, post_re, post_im, FFT_SIZE);
+	for (int m = 0; m < FFT_SIZE; m++) {
+		output[2 * m] = re[m];
+		output[HCA_MDCT_SIZE - 1 - 2 * m] = -im[m];
+	}
+}
@@ -0,0 +1,168 @@
+#include "hca_stream.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct HcaStream {
+	WavReader wav;
+	HcaEncoder* encoder;
+	uint8_t header[HCA_MAX_HEADER_SIZE];
+	size_t header_size;
+	bool header_read;
+
+	// Frame f goes to slot f % slot_count, the encoder only writes slots the
+	// reader has handed back
+	uint8_t* ring;
+	uint32_t slot_count;
+	uint32_t frame_count;
+	uint16_t frame_size;
+	uint32_t encoded;
+	uint32_t released;
+	uint32_t reading;   // Frames of the block the reader currently holds
+	bool stopped;
+
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	pthread_t thread;
+};
+
+static void* encode_frames(void* context) {
+	HcaStream* stream = context;
+	float* samples = malloc(HCA_SAMPLES_PER_FRAME * stream->wav.channels * sizeof(float));
+
+	for (uint32_t f = 0; f < stream->frame_count; f++) {
+		pthread_mutex_lock(&stream->lock);
+		while (!stream->stopped && stream->encoded - stream->released == stream->slot_count) {
+			pthread_cond_wait(&stream->changed, &stream->lock);
+		}
+		bool stopped = stream->stopped || !samples;
+		pthread_mutex_unlock(&stream->lock);
+		if (stopped) {
+			break;
+		}
+
+		size_t count = wav_reader_read(&stream->wav, samples, HCA_SAMPLES_PER_FRAME);
+		uint8_t* frame = stream->ring + (size_t)(f % stream->slot_count) * stream->frame_size;
+		hca_encoder_encode_frame(stream->encoder, samples, (unsigned)count, frame);
+
+		pthread_mutex_lock(&stream->lock);
+		stream->encoded++;
+		pthread_cond_broadcast(&stream->changed);
+		pthread_mutex_unlock(&stream->lock);
+	}
+
+	// Wakes a reader waiting for frames that won't come
+	pthread_mutex_lock(&stream->lock);
+	stream->stopped = true;
+	pthread_cond_broadcast(&stream->changed);
+	pthread_mutex_unlock(&stream->lock);
+	free(samples);
+	return NULL;
+}
+
+static void free_stream(HcaStream* stream) {
+	hca_encoder_free(stream->encoder);
+	wav_reader_close(&stream->wav);
+	free(stream->ring);
+	free(stream);
+}
+
+HcaStream* hca_stream_open(const char* wav_path, const HcaEncodeOptions* options,
+                           size_t ring_size) {
+	HcaStream* stream = calloc(1, sizeof(HcaStream));
+	if (!stream) {
+		return NULL;
+	}
+	if (wav_reader_open(wav_path, &stream->wav) != 0) {
+		free(stream);
+		return NULL;
+	}
+
+	HcaEncodeOptions wav_options;
+	if (hca_prepare_wav(&stream->wav, options, &wav_options) == 0) {
+		stream->encoder = hca_encoder_create(stream->wav.channels, stream->wav.sample_rate,
+		                                     stream->wav.frame_count, &wav_options);
+	}
+	int header_size = stream->encoder ? hca_encoder_write_header(stream->encoder,
+	                  stream->header, sizeof(stream->header)) : -1;
+	if (header_size < 0) {
+		free_stream(stream);
+		return NULL;
+	}
+	const HcaInfo* info = hca_encoder_info(stream->encoder);
+	stream->header_size = (size_t)header_size;
+	stream->frame_count = info->frame_count;
+	stream->frame_size = info->frame_size;
+
+	stream->slot_count = (uint32_t)(ring_size / info->frame_size);
+	if (stream->slot_count == 0) {
+		stream->slot_count = 1;
+	}
+	if (stream->slot_count > stream->frame_count) {
+		stream->slot_count = stream->frame_count;
+	}
+	stream->ring = malloc((size_t)stream->slot_count * info->frame_size);
+	if (!stream->ring) {
+		free_stream(stream);
+		return NULL;
+	}
+
+	pthread_mutex_init(&stream->lock, NULL);
+	pthread_cond_init(&stream->changed, NULL);
+	if (pthread_create(&stream->thread, NULL, encode_frames, stream) != 0) {
+		pthread_mutex_destroy(&stream->lock);
+		pthread_cond_destroy(&stream->changed);
+		free_stream(stream);
+		return NULL;
+	}
+	return stream;
+}
+
+uint64_t hca_stream_size(const HcaStream* stream) {
+	return stream->header_size + (uint64_t)stream->frame_count * stream->frame_size;
+}
+
+const uint8_t* hca_stream_read(HcaStream* stream, size_t* size) {
+	if (!stream->header_read) {
+		stream->header_read = true;
+		*size = stream->header_size;
+		return stream->header;
+	}
+
+	pthread_mutex_lock(&stream->lock);
+	stream->released += stream->reading;
+	stream->reading = 0;
+	pthread_cond_broadcast(&stream->changed);
+	while (!stream->stopped && stream->encoded == stream->released) {
+		pthread_cond_wait(&stream->changed, &stream->lock);
+	}
+
+	// Frames up to the end of the ring, the rest comes with the next call
+	uint32_t first = stream->released % stream->slot_count;
+	uint32_t available = stream->encoded - stream->released;
+	if (available > stream->slot_count - first) {
+		available = stream->slot_count - first;
+	}
+	stream->reading = available;
+	pthread_mutex_unlock(&stream->lock);
+
+	if (available == 0) {
+		return NULL;
+	}
+	*size = (size_t)available * stream->frame_size;
+	return stream->ring + (size_t)first * stream->frame_size;
+}
+
+int hca_stream_close(HcaStream* stream) {
+	pthread_mutex_lock(&stream->lock);
+	stream->stopped = true;
+	pthread_cond_broadcast(&stream->changed);
+	pthread_mutex_unlock(&stream->lock);
+	pthread_join(stream->thread, NULL);
+
+	int result = (stream->released + stream->reading == stream->frame_count) ? 0 : -1;
+	pthread_mutex_destroy(&stream->lock);
+	pthread_cond_destroy(&stream->changed);
+	free_stream(stream);
+	return result;
+}
@@ -0,0 +1,96 @@
+#include "hca_tables.h"
+
+const float hca_window[128] = {
+	6.905337796e-04f, 1.976234838e-03f, 3.673864529e-03f, 5.724240094e-03f,
+	8.096703328e-03f, 1.077318192e-02f, 1.374251768e-02f, 1.699785702e-02f,
+	2.053526416e-02f, 2.435290255e-02f, 2.845051885e-02f, 3.282909468e-02f,
+	3.749062121e-02f, 4.243789613e-02f, 4.767442867e-02f, 5.320430174e-02f,
+	5.903211236e-02f, 6.516288221e-02f, 7.160200924e-02f, 7.835522294e-02f,
+	8.542849123e-02f, 9.282802045e-02f, 1.005601510e-01f, 1.086313501e-01f,
+	1.170481220e-01f, 1.258169860e-01f, 1.349443495e-01f, 1.444365084e-01f,
+	1.542995125e-01f, 1.645391285e-01f, 1.751607209e-01f, 1.861691624e-01f,
+	1.975687295e-01f, 2.093629688e-01f, 2.215546221e-01f, 2.341454178e-01f,
+	2.471359968e-01f, 2.605257630e-01f, 2.743127048e-01f, 2.884931862e-01f,
+	3.030619323e-01f, 3.180117309e-01f, 3.333333433e-01f, 3.490152955e-01f,
+	3.650438190e-01f, 3.814027011e-01f, 3.980731070e-01f, 4.150335193e-01f,
+	4.322597980e-01f, 4.497250319e-01f, 4.673995674e-01f, 4.852511585e-01f,
+	5.032449365e-01f, 5.213438272e-01f, 5.395085216e-01f, 5.576977730e-01f,
+	5.758689046e-01f, 5.939780474e-01f, 6.119805574e-01f, 6.298314333e-01f,
+	6.474860311e-01f, 6.649002433e-01f, 6.820311546e-01f, 6.988375783e-01f,
+	7.152804136e-01f, 7.313231230e-01f, 7.469321489e-01f, 7.620773315e-01f,
+	7.767318487e-01f, 7.908728123e-01f, 8.044812679e-01f, 8.175420761e-01f,
+	8.300440907e-01f, 8.419801593e-01f, 8.533467054e-01f, 8.641437888e-01f,
+	8.743748069e-01f, 8.840461969e-01f, 8.931670785e-01f, 9.017491341e-01f,
+	9.098061323e-01f, 9.173536897e-01f, 9.244089723e-01f, 9.309903383e-01f,
+	9.371170402e-01f, 9.428090453e-01f, 9.480867982e-01f, 9.529708624e-01f,
+	9.574819207e-01f, 9.616405368e-01f, 9.654669166e-01f, 9.689807892e-01f,
+	9.722015858e-01f, 9.751479626e-01f, 9.778379798e-01f, 9.802890420e-01f,
+	9.825177193e-01f, 9.845398664e-01f, 9.863705635e-01f, 9.880241156e-01f,
+	9.895140529e-01f, 9.908531904e-01f, 9.920534492e-01f, 9.931262732e-01f,
+	9.940820932e-01f, 9.949309826e-01f, 9.956821799e-01f, 9.963443279e-01f,
+	9.969255328e-01f, 9.974333048e-01f, 9.978746176e-01f, 9.982560873e-01f,
+	9.985836744e-01f, 9.988629222e-01f, 9.990991354e-01f, 9.992969632e-01f,
+	9.994609952e-01f, 9.995952249e-01f, 9.997034073e-01f, 9.997891188e-01f,
+	9.998555183e-01f, 9.999055862e-01f, 9.999419451e-01f, 9.999672174e-01f,
+	9.999836087e-01f, 9.999932647e-01f, 9.999980330e-01f, 9.999997616e-01f,
+};
+
+const float hca_scaling_table[64] = {
+	0.000000000e+00f, 2.116413640e-07f, 2.819978420e-07f, 3.757431273e-07f,
+	5.006523338e-07f, 6.670854873e-07f, 8.888464436e-07f, 1.184327857e-06f,
+	1.578037086e-06f, 2.102627832e-06f, 2.801609753e-06f, 3.732956202e-06f,
+	4.973912382e-06f, 6.627402854e-06f, 8.830566912e-06f, 1.176613478e-05f,
+	1.567758045e-05f, 2.088931979e-05f, 2.783360833e-05f, 3.708640725e-05f,
+	4.941513544e-05f, 6.584233051e-05f, 8.773047011e-05f, 1.168949311e-04f,
+	1.557546057e-04f, 2.075325174e-04f, 2.765230893e-04f, 3.684483527e-04f,
+	4.909325507e-04f, 6.541345501e-04f, 8.715901640e-04f, 1.161335036e-03f,
+	1.547400607e-03f, 2.061807085e-03f, 2.747218823e-03f, 3.660483751e-03f,
+	4.877347499e-03f, 6.498736795e-03f, 8.659128100e-03f, 1.153770462e-02f,
+	1.537321229e-02f, 2.048376948e-02f, 2.729324065e-02f, 3.636640310e-02f,
+	4.845577851e-02f, 6.456405669e-02f, 8.602724969e-02f, 1.146255061e-01f,
+	1.527307481e-01f, 2.035034299e-01f, 2.711545825e-01f, 3.612951934e-01f,
+	4.814014733e-01f, 6.414350271e-01f, 8.546688557e-01f, 1.138788581e+00f,
+	1.517359018e+00f, 2.021778584e+00f, 2.693883657e+00f, 3.589418173e+00f,
+	4.782657623e+00f, 6.372568607e+00f, 8.491017342e+00f, 1.131370831e+01f,
+};
+
+const float hca_range_table[16] = {
+	0.000000000e+00f, 6.666666865e-01f, 4.000000060e-01f, 2.857142985e-01f,
+	2.222222239e-01f, 1.818181872e-01f, 1.538461596e-01f, 1.333333403e-01f,
+	6.451612711e-02f, 3.174603358e-02f, 1.574803144e-02f, 7.843137719e-03f,
+	3.913894296e-03f, 1.955034211e-03f, 9.770395700e-04f, 4.884005175e-04f,
+};
+
+const uint8_t hca_max_bit_size[16] = {
+	0, 2, 3, 3, 4, 4, 4, 4, 5, 6, 7, 8, 9, 10, 11, 12
+};
+
+const uint8_t hca_quant_bit_count[8][16] = {
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{1, 1, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{2, 2, 2, 2, 2, 2, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0},
+	{2, 2, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0},
+	{3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4},
+	{3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4},
+	{3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4},
+	{3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4}
+};
+
+const int8_t hca_quant_value[8][16] = {
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 1, 1, -1, -1, 2, -2, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 1, -1, 2, -2, 3, -3, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 1, 1, -1, -1, 2, 2, -2, -2, 3, 3, -3, -3, 4, -4},
+	{0, 0, 1, 1, -1, -1, 2, 2, -2, -2, 3, -3, 4, -4, 5, -5},
+	{0, 0, 1, 1, -1, -1, 2, -2, 3, -3, 4, -4, 5, -5, 6, -6},
+	{0, 0, 1, -1, 2, -2, 3, -3, 4, -4, 5, -5, 6, -6, 7, -7}
+};
+
+const uint8_t hca_invert_table[HCA_INVERT_TABLE_SIZE] = {
+	14, 14, 14, 14, 14, 14, 13, 13, 13, 13, 13, 13, 12, 12, 12, 12,
+	12, 12, 11, 11, 11, 11, 11, 11, 10, 10, 10, 10, 10, 10, 10, 9,
+	9, 9, 9, 9, 9, 8, 8, 8, 8, 8, 8, 7, 6, 6, 5, 4,
+	4, 4, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1
+};
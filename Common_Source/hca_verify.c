@@ -0,0 +1,39 @@
+#include "hca_verify.h"
+#include "hca_format.h"
+#include "mapped_file.h"
+
+int hca_verify(const uint8_t* data, uint64_t size, uint32_t* bad_frame) {
+	HcaInfo info;
+	size_t available = (size < SIZE_MAX) ? (size_t)size : SIZE_MAX;
+	int header_size = hca_header_size(data, available);
+	if (header_size < 0 || (uint64_t)header_size > size ||
+	        hca_read_header(data, (size_t)header_size, &info) != 0) {
+		return HCA_VERIFY_BAD_HEADER;
+	}
+	if (info.vbr) {
+		return HCA_VERIFY_OK;
+	}
+
+	if (header_size + (uint64_t)info.frame_count * info.frame_size > size) {
+		return HCA_VERIFY_TRUNCATED;
+	}
+	const uint8_t* frame = data + header_size;
+	for (uint32_t i = 0; i < info.frame_count; i++, frame += info.frame_size) {
+		if (hca_crc16(frame, info.frame_size) != 0) {
+			*bad_frame = i;
+			return HCA_VERIFY_BAD_FRAME;
+		}
+	}
+	return HCA_VERIFY_OK;
+}
+
+int hca_verify_file(const char* path, uint32_t* bad_frame) {
+	MappedFile file;
+	if (mapped_file_open(path, &file) != 0) {
+		return HCA_VERIFY_BAD_HEADER;
+	}
+	int result = file.data ? hca_verify(file.data, file.size, bad_frame) :
+	             HCA_VERIFY_BAD_HEADER;
+	mapped_file_close(&file);
+	return result;
+}
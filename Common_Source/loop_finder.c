@@ -0,0 +1,560 @@
+#include "loop_finder.h"
+#include "simd.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Tracks are mixed down and decimated to at least this rate before anything
+// is compared, the band below it holds enough to line a loop up
+#define ANALYSIS_RATE 8000
+// Decimation filter length per unit of the factor
+#define TAPS_PER_FACTOR 8
+// The autocorrelation that proposes loop lengths runs at 1/8 of that rate
+#define COARSE_FACTOR 8
+// Shortest loop, and shortest stretch of repeated audio that proves one
+#define MIN_LOOP_SECONDS 4
+#define MIN_MATCH_SECONDS 3
+// Loop lengths the autocorrelation proposes, tried from the longest down
+#define MAX_CANDIDATES 8
+#define MIN_CANDIDATE_SCORE 0.5
+// Quarter-second blocks repeat when they correlate this well at the same
+// level, within about 1 dB, so a fade-out doesn't count
+#define BLOCKS_PER_SECOND 4
+#define MATCH_CORRELATION 0.9f
+#define MAX_LEVEL_RATIO 1.12f
+// Mean power of a block below -60 dBFS, which proves nothing either way
+#define SILENCE_POWER 1e-6f
+// Linear prediction order of the whitening before the autocorrelation
+#define WHITENING_ORDER 16
+// Lags on each side of the best one the sub-sample fit interpolates between,
+// over at most the last seconds of the repetition
+#define REFINE_RADIUS 8
+#define REFINE_SECONDS 10
+#define READ_FRAMES 4096
+
+/* Decimation */
+
+// Low-pass FIR run every factor samples over input fed in blocks
+typedef struct {
+	unsigned factor;
+	unsigned taps;
+	float* coeffs;
+	float* input;      // taps + READ_FRAMES samples, the unused ones first
+	size_t buffered;
+	float* output;
+	size_t count;
+	size_t capacity;
+} Decimator;
+
+static double sinc(double x) {
+	return (x == 0.0) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+}
+
+// Hann windowed sinc cut off at 90% of the output's Nyquist frequency
+static bool decimator_init(Decimator* decimator, unsigned factor, size_t input_count) {
+	memset(decimator, 0, sizeof(*decimator));
+	decimator->factor = factor;
+	decimator->taps = (TAPS_PER_FACTOR * factor + 7) & ~7u;
+	decimator->capacity = input_count / factor + 1;
+	decimator->coeffs = malloc(decimator->taps * sizeof(float));
+	decimator->input = malloc((decimator->taps + READ_FRAMES) * sizeof(float));
+	decimator->output = malloc(decimator->capacity * sizeof(float));
+	if (!decimator->coeffs || !decimator->input || !decimator->output) {
+		return false;
+	}
+
+	double cutoff = 0.9 / factor;
+	double center = (decimator->taps - 1) / 2.0;
+	double sum = 0.0;
+	double* taps = malloc(decimator->taps * sizeof(double));
+	if (!taps) {
+		return false;
+	}
+	for (unsigned i = 0; i < decimator->taps; i++) {
+		double window = 0.5 - 0.5 * cos(2.0 * M_PI * (i + 0.5) / decimator->taps);
+		taps[i] = sinc(cutoff * (i - center)) * window;
+		sum += taps[i];
+	}
+	for (unsigned i = 0; i < decimator->taps; i++) {
+		decimator->coeffs[i] = (float)(taps[i] / sum);
+	}
+	free(taps);
+	return true;
+}
+
+// Takes up to READ_FRAMES samples
+static void decimator_write(Decimator* decimator, const float* samples, size_t count) {
+	memcpy(decimator->input + decimator->buffered, samples, count * sizeof(float));
+	decimator->buffered += count;
+
+	size_t position = 0;
+	while (position + decimator->taps <= decimator->buffered &&
+	        decimator->count < decimator->capacity) {
+		decimator->output[decimator->count++] = simd_dot(decimator->input + position,
+		                                                 decimator->coeffs, decimator->taps);
+		position += decimator->factor;
+	}
+	decimator->buffered -= position;
+	memmove(decimator->input, decimator->input + position, decimator->buffered * sizeof(float));
+}
+
+static void decimator_free(Decimator* decimator) {
+	free(decimator->coeffs);
+	free(decimator->input);
+	free(decimator->output);
+}
+
+// Mixes the rest of the reader down to mono into the decimator
+static bool read_mono(WavReader* wav, Decimator* decimator) {
+	float* frames = malloc(READ_FRAMES * wav->channels * sizeof(float));
+	float* mono = malloc(READ_FRAMES * sizeof(float));
+	if (!frames || !mono) {
+		free(frames);
+		free(mono);
+		return false;
+	}
+
+	float scale = 1.0f / wav->channels;
+	size_t count;
+	while ((count = wav_reader_read(wav, frames, READ_FRAMES)) > 0) {
+		for (size_t i = 0; i < count; i++) {
+			float sum = 0.0f;
+			for (unsigned c = 0; c < wav->channels; c++) {
+				sum += frames[i * wav->channels + c];
+			}
+			mono[i] = sum * scale;
+		}
+		decimator_write(decimator, mono, count);
+	}
+	free(frames);
+	free(mono);
+	return true;
+}
+
+/* Autocorrelation */
+
+/**
+ * Replaces a signal by its linear prediction error, which flattens its
+ * spectrum. Without it the bass and drums, which repeat every bar, outweigh
+ * everything else and every bar looks like a loop.
+ */
+static void whiten(float* signal, size_t count) {
+	double r[WHITENING_ORDER + 1];
+	for (int k = 0; k <= WHITENING_ORDER; k++) {
+		r[k] = (count > (size_t)k) ? simd_dot(signal, signal + k, count - k) : 0.0;
+	}
+	if (r[0] <= 0.0) {
+		return;
+	}
+	// A little white noise keeps the recursion stable
+	r[0] *= 1.0 + 1e-4;
+
+	// Levinson-Durbin recursion
+	double a[WHITENING_ORDER + 1] = {1.0};
+	double error = r[0];
+	for (int i = 1; i <= WHITENING_ORDER; i++) {
+		double sum = r[i];
+		for (int j = 1; j < i; j++) {
+			sum += a[j] * r[i - j];
+		}
+		double reflection = -sum / error;
+		double previous[WHITENING_ORDER + 1];
+		memcpy(previous, a, sizeof(a));
+		for (int j = 1; j < i; j++) {
+			a[j] = previous[j] + reflection * previous[i - j];
+		}
+		a[i] = reflection;
+		error *= 1.0 - reflection * reflection;
+	}
+
+	// From the end, so every sample is predicted from the original ones
+	for (size_t t = count; t-- > 0;) {
+		double value = signal[t];
+		for (int k = 1; k <= WHITENING_ORDER && (size_t)k <= t; k++) {
+			value += a[k] * signal[t - k];
+		}
+		signal[t] = (float)value;
+	}
+}
+
+/**
+ * In-place radix-2 FFTs of size points, twiddles holds exp(-i pi j / h) at
+ * h + j for every stage of half size h. The correlation only multiplies
+ * spectra point by point, so the forward one leaves them in bit-reversed
+ * order and the second one takes them that way, no permutation is needed.
+ */
+
+// Decimation in frequency, natural order in, bit-reversed order out
+static void fft_to_reversed(float* re, float* im, size_t size, const float* tw_re,
+                            const float* tw_im) {
+	for (size_t half = size / 2; half >= 1; half >>= 1) {
+		const float* w_re = tw_re + half;
+		const float* w_im = tw_im + half;
+		for (size_t block = 0; block < size; block += 2 * half) {
+			float* a_re = re + block;
+			float* a_im = im + block;
+			float* b_re = a_re + half;
+			float* b_im = a_im + half;
+			size_t j = 0;
+#ifdef HAVE_VECTOR4
+			for (; j + 4 <= half; j += 4) {
+				v4 ar = v4_load(a_re + j);
+				v4 ai = v4_load(a_im + j);
+				v4 br = v4_load(b_re + j);
+				v4 bi = v4_load(b_im + j);
+				v4 wr = v4_load(w_re + j);
+				v4 wi = v4_load(w_im + j);
+				v4 dr = v4_sub(ar, br);
+				v4 di = v4_sub(ai, bi);
+				v4_store(a_re + j, v4_add(ar, br));
+				v4_store(a_im + j, v4_add(ai, bi));
+				v4_store(b_re + j, v4_sub(v4_mul(dr, wr), v4_mul(di, wi)));
+				v4_store(b_im + j, v4_add(v4_mul(dr, wi), v4_mul(di, wr)));
+			}
+#endif
+			for (; j < half; j++) {
+				float dr = a_re[j] - b_re[j];
+				float di = a_im[j] - b_im[j];
+				a_re[j] += b_re[j];
+				a_im[j] += b_im[j];
+				b_re[j] = dr * w_re[j] - di * w_im[j];
+				b_im[j] = dr * w_im[j] + di * w_re[j];
+			}
+		}
+	}
+}
+
+// Decimation in time, bit-reversed order in, natural order out
+static void fft_from_reversed(float* re, float* im, size_t size, const float* tw_re,
+                              const float* tw_im) {
+	for (size_t half = 1; half < size; half <<= 1) {
+		const float* w_re = tw_re + half;
+		const float* w_im = tw_im + half;
+		for (size_t block = 0; block < size; block += 2 * half) {
+			float* a_re = re + block;
+			float* a_im = im + block;
+			float* b_re = a_re + half;
+			float* b_im = a_im + half;
+			size_t j = 0;
+#ifdef HAVE_VECTOR4
+			for (; j + 4 <= half; j += 4) {
+				v4 br = v4_load(b_re + j);
+				v4 bi = v4_load(b_im + j);
+				v4 wr = v4_load(w_re + j);
+				v4 wi = v4_load(w_im + j);
+				v4 tr = v4_sub(v4_mul(br, wr), v4_mul(bi, wi));
+				v4 ti = v4_add(v4_mul(br, wi), v4_mul(bi, wr));
+				v4 ar = v4_load(a_re + j);
+				v4 ai = v4_load(a_im + j);
+				v4_store(b_re + j, v4_sub(ar, tr));
+				v4_store(b_im + j, v4_sub(ai, ti));
+				v4_store(a_re + j, v4_add(ar, tr));
+				v4_store(a_im + j, v4_add(ai, ti));
+			}
+#endif
+			for (; j < half; j++) {
+				float tr = b_re[j] * w_re[j] - b_im[j] * w_im[j];
+				float ti = b_re[j] * w_im[j] + b_im[j] * w_re[j];
+				b_re[j] = a_re[j] - tr;
+				b_im[j] = a_im[j] - ti;
+				a_re[j] += tr;
+				a_im[j] += ti;
+			}
+		}
+	}
+}
+
+// Twiddles of the largest stage from a quarter cosine wave, the smaller
+// stages take every other one of the stage above
+static bool make_twiddles(float* tw_re, float* tw_im, size_t size) {
+	size_t quarter = size / 4;
+	double* cosine = malloc((quarter + 1) * sizeof(double));
+	if (!cosine) {
+		return false;
+	}
+	for (size_t j = 0; j <= quarter; j++) {
+		cosine[j] = cos(2.0 * M_PI * j / size);
+	}
+
+	size_t half = size / 2;
+	tw_re[0] = 1.0f;
+	tw_im[0] = 0.0f;
+	for (size_t j = 0; j < half; j++) {
+		double c = (j <= quarter) ? cosine[j] : -cosine[half - j];
+		double s = (j <= quarter) ? cosine[quarter - j] : cosine[j - quarter];
+		tw_re[half + j] = (float)c;
+		tw_im[half + j] = (float)-s;
+	}
+	for (size_t h = half / 2; h >= 1; h /= 2) {
+		for (size_t j = 0; j < h; j++) {
+			tw_re[h + j] = tw_re[2 * h + 2 * j];
+			tw_im[h + j] = tw_im[2 * h + 2 * j];
+		}
+	}
+	free(cosine);
+	return true;
+}
+
+// Lag in analysis samples with how well the audio matches itself there
+typedef struct {
+	double lag;
+	double score;
+} Candidate;
+
+/**
+ * Autocorrelation of the coarse signal, each lag normalized by the energy
+ * of the two parts it lines up, so long and short overlaps compare. Its
+ * best peaks are kept, ordered from the longest lag down.
+ */
+static int find_candidates(const float* coarse, size_t count, size_t min_lag,
+                           size_t min_overlap, Candidate* candidates) {
+	if (count < min_lag + min_overlap + 2) {
+		return 0;
+	}
+	size_t size = 1;
+	while (size < 2 * count) {
+		size <<= 1;
+	}
+	float* re = calloc(size, sizeof(float));
+	float* im = calloc(size, sizeof(float));
+	float* tw_re = malloc(size * sizeof(float));
+	float* tw_im = malloc(size * sizeof(float));
+	double* energy = malloc((count + 1) * sizeof(double));
+	int found = 0;
+	if (!re || !im || !tw_re || !tw_im || !energy || !make_twiddles(tw_re, tw_im, size)) {
+		goto done;
+	}
+
+	// |X|^2 is real and even, so a second forward FFT is also the inverse
+	memcpy(re, coarse, count * sizeof(float));
+	fft_to_reversed(re, im, size, tw_re, tw_im);
+	for (size_t i = 0; i < size; i++) {
+		re[i] = re[i] * re[i] + im[i] * im[i];
+		im[i] = 0.0f;
+	}
+	fft_from_reversed(re, im, size, tw_re, tw_im);
+
+	energy[0] = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		energy[i + 1] = energy[i] + (double)coarse[i] * coarse[i];
+	}
+	// Scores replace the spectrum, lags outside the range stay at 0
+	float* score = im;
+	size_t max_lag = count - min_overlap;
+	for (size_t lag = min_lag; lag <= max_lag; lag++) {
+		double head = energy[count - lag];
+		double tail = energy[count] - energy[lag];
+		double floor = SILENCE_POWER * (double)(count - lag);
+		score[lag] = (head > floor && tail > floor) ?
+		             (float)(re[lag] / size / sqrt(head * tail)) : 0.0f;
+	}
+
+	for (size_t lag = min_lag + 1; lag < max_lag; lag++) {
+		if (score[lag] < MIN_CANDIDATE_SCORE || score[lag] < score[lag - 1] ||
+		        score[lag] <= score[lag + 1]) {
+			continue;
+		}
+		// Fractional part from a parabola through the peak
+		double curve = score[lag - 1] - 2.0 * score[lag] + score[lag + 1];
+		double offset = (curve < 0.0) ? 0.5 * (score[lag - 1] - score[lag + 1]) / curve : 0.0;
+		Candidate peak = {lag + offset, score[lag]};
+
+		// Kept by score, the weakest falls off the end
+		int position = found;
+		while (position > 0 && candidates[position - 1].score < peak.score) {
+			position--;
+		}
+		if (position == MAX_CANDIDATES) {
+			continue;
+		}
+		int moved = ((found < MAX_CANDIDATES) ? found : MAX_CANDIDATES - 1) - position;
+		memmove(candidates + position + 1, candidates + position, moved * sizeof(Candidate));
+		candidates[position] = peak;
+		if (found < MAX_CANDIDATES) {
+			found++;
+		}
+	}
+
+	// Longest lag first
+	for (int i = 1; i < found; i++) {
+		Candidate candidate = candidates[i];
+		int j = i;
+		for (; j > 0 && candidates[j - 1].lag < candidate.lag; j--) {
+			candidates[j] = candidates[j - 1];
+		}
+		candidates[j] = candidate;
+	}
+
+done:
+	free(re);
+	free(im);
+	free(tw_re);
+	free(tw_im);
+	free(energy);
+	return found;
+}
+
+/* Verification */
+
+// Loop found in the analysis signal, lag in input samples
+typedef struct {
+	size_t end;
+	uint64_t lag;
+} AnalysisLoop;
+
+// Exact lag from the analysis lag by band-limited interpolation of the
+// correlation around it, to 1/factor of an analysis sample
+static uint64_t refine_lag(const float* signal, size_t end, size_t length, size_t lag,
+                           unsigned factor) {
+	float correlation[2 * REFINE_RADIUS + 1];
+	const float* window = signal + end - length;
+	for (int k = -REFINE_RADIUS; k <= REFINE_RADIUS; k++) {
+		correlation[k + REFINE_RADIUS] = simd_dot(window, window - lag - k, length);
+	}
+
+	int best_step = 0;
+	double best = -INFINITY;
+	for (int step = -(int)factor; step <= (int)factor; step++) {
+		double x = (double)step / factor;
+		double value = 0.0;
+		for (int k = -REFINE_RADIUS; k <= REFINE_RADIUS; k++) {
+			double distance = x - k;
+			double window_value = 0.5 + 0.5 * cos(M_PI * distance / (REFINE_RADIUS + 1));
+			value += correlation[k + REFINE_RADIUS] * sinc(distance) * window_value;
+		}
+		if (value > best) {
+			best = value;
+			best_step = step;
+		}
+	}
+	return (uint64_t)lag * factor + best_step;
+}
+
+/**
+ * Lines a candidate up to the analysis sample, then walks its overlap in
+ * blocks. The longest run of blocks that repeat, silent ones allowed in
+ * between, must last MIN_MATCH_SECONDS and gives the loop end: one block
+ * before the run stops, so the seam never lands where the music starts to
+ * change.
+ */
+static bool verify_candidate(const float* signal, size_t count, double rate,
+                             const Candidate* candidate, unsigned factor, AnalysisLoop* loop) {
+	size_t block = (size_t)(rate / BLOCKS_PER_SECOND);
+	long estimate = lround(candidate->lag * COARSE_FACTOR);
+	long lowest = estimate - COARSE_FACTOR;
+	if (lowest < (long)REFINE_RADIUS + 1) {
+		lowest = REFINE_RADIUS + 1;
+	}
+
+	size_t lag = 0;
+	float best = -INFINITY;
+	for (long k = lowest; k <= estimate + COARSE_FACTOR && (size_t)k + block < count; k++) {
+		float value = simd_dot(signal + k, signal, count - (size_t)k);
+		if (value > best) {
+			best = value;
+			lag = (size_t)k;
+		}
+	}
+	if (lag == 0) {
+		return false;
+	}
+
+	// Repeating blocks of the current run and of the longest one so far
+	size_t matched = 0;
+	size_t best_matched = 0;
+	size_t end = 0;
+	for (size_t start = lag; start + block <= count; start += block) {
+		const float* later = signal + start;
+		const float* earlier = later - lag;
+		float later_power = simd_dot(later, later, block) / block;
+		float earlier_power = simd_dot(earlier, earlier, block) / block;
+		if (later_power < SILENCE_POWER && earlier_power < SILENCE_POWER) {
+			continue;
+		}
+
+		float limit = MAX_LEVEL_RATIO * MAX_LEVEL_RATIO;
+		bool repeats = later_power >= SILENCE_POWER && earlier_power >= SILENCE_POWER &&
+		               later_power <= earlier_power * limit &&
+		               earlier_power <= later_power * limit &&
+		               simd_dot(later, earlier, block) >=
+		               MATCH_CORRELATION * block * sqrtf(later_power * earlier_power);
+		matched = repeats ? matched + 1 : 0;
+		// The last block of the run is kept back
+		if (matched > best_matched) {
+			best_matched = matched;
+			end = start;
+		}
+	}
+	if (best_matched < 2 || (best_matched - 1) * block < MIN_MATCH_SECONDS * rate) {
+		return false;
+	}
+
+	size_t length = (size_t)(REFINE_SECONDS * rate);
+	size_t available = (best_matched - 1) * block;
+	if (length > available) {
+		length = available;
+	}
+	if (end < lag + REFINE_RADIUS + length) {
+		length = end - lag - REFINE_RADIUS;
+	}
+	loop->end = end;
+	loop->lag = refine_lag(signal, end, length, lag, factor);
+	return true;
+}
+
+bool loop_find(WavReader* wav, uint32_t* start, uint32_t* end) {
+	unsigned factor = wav->sample_rate / ANALYSIS_RATE;
+	if (factor == 0) {
+		factor = 1;
+	}
+	double rate = (double)wav->sample_rate / factor;
+	double coarse_rate = rate / COARSE_FACTOR;
+	if (wav->frame_count < (uint64_t)(MIN_LOOP_SECONDS + MIN_MATCH_SECONDS) * wav->sample_rate) {
+		return false;
+	}
+
+	Decimator analysis = {0};
+	Decimator coarse = {0};
+	bool found = false;
+	bool ready = decimator_init(&analysis, factor, wav->frames_left) &&
+	             read_mono(wav, &analysis) &&
+	             decimator_init(&coarse, COARSE_FACTOR, analysis.count);
+	if (!ready) {
+		goto done;
+	}
+	for (size_t i = 0; i < analysis.count; i += READ_FRAMES) {
+		size_t count = analysis.count - i;
+		decimator_write(&coarse, analysis.output + i, count < READ_FRAMES ? count : READ_FRAMES);
+	}
+
+	whiten(coarse.output, coarse.count);
+	Candidate candidates[MAX_CANDIDATES];
+	int candidate_count = find_candidates(coarse.output, coarse.count,
+	                                      (size_t)(MIN_LOOP_SECONDS * coarse_rate),
+	                                      (size_t)(MIN_MATCH_SECONDS * coarse_rate), candidates);
+	AnalysisLoop loop;
+	for (int i = 0; i < candidate_count && !found; i++) {
+		found = verify_candidate(analysis.output, analysis.count, rate, &candidates[i], factor,
+		                         &loop);
+	}
+
+	if (found) {
+		// Analysis samples are centered half a filter into the input
+		uint64_t loop_end = (uint64_t)loop.end * factor + analysis.taps / 2;
+		if (loop_end > wav->frame_count) {
+			loop_end = wav->frame_count;
+		}
+		found = loop_end > loop.lag;
+		*start = (uint32_t)(loop_end - loop.lag);
+		*end = (uint32_t)loop_end;
+	}
+
+done:
+	decimator_free(&analysis);
+	decimator_free(&coarse);
+	return found;
+}
@@ -0,0 +1,199 @@
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // copy_file_range
+#endif
+#include "mapped_file.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+// Largest single WriteFile call
+#define WRITE_CHUNK (1u << 30)
+
+int mapped_file_open(const char* path, MappedFile* file) {
+	memset(file, 0, sizeof(*file));
+
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+	                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size)) {
+		CloseHandle(handle);
+		return -1;
+	}
+
+	file->file_handle = handle;
+	file->size = (uint64_t)size.QuadPart;
+	if (file->size == 0) {
+		return 0;
+	}
+
+	HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		CloseHandle(handle);
+		return -1;
+	}
+
+	file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!file->data) {
+		CloseHandle(mapping);
+		CloseHandle(handle);
+		return -1;
+	}
+
+	file->mapping_handle = mapping;
+	return 0;
+}
+
+void mapped_file_close(MappedFile* file) {
+	if (file->data) UnmapViewOfFile(file->data);
+	if (file->mapping_handle) CloseHandle(file->mapping_handle);
+	if (file->file_handle) CloseHandle(file->file_handle);
+	memset(file, 0, sizeof(*file));
+}
+
+int mapped_file_write_range(const MappedFile* file, uint64_t offset,
+                            uint64_t size, const char* dest_path) {
+	if (offset > file->size || size > file->size - offset) {
+		return -1;
+	}
+
+	HANDLE dest = CreateFileA(dest_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+	                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (dest == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+
+	// Windows has no ranged kernel copy, write directly from the mapped pages
+	const uint8_t* source = file->data + offset;
+	while (size > 0) {
+		DWORD chunk = (size > WRITE_CHUNK) ? WRITE_CHUNK : (DWORD)size;
+		DWORD written = 0;
+		if (!WriteFile(dest, source, chunk, &written, NULL) || written == 0) {
+			CloseHandle(dest);
+			return -1;
+		}
+		source += written;
+		size -= written;
+	}
+
+	CloseHandle(dest);
+	return 0;
+}
+
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+int mapped_file_open(const char* path, MappedFile* file) {
+	memset(file, 0, sizeof(*file));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		file->fd = -1;
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		file->fd = -1;
+		return -1;
+	}
+
+	file->fd = fd;
+	file->size = (uint64_t)st.st_size;
+	if (file->size == 0) {
+		return 0;
+	}
+
+	void* data = mmap(NULL, file->size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		file->fd = -1;
+		return -1;
+	}
+	madvise(data, file->size, MADV_SEQUENTIAL);
+
+	file->data = data;
+	return 0;
+}
+
+void mapped_file_close(MappedFile* file) {
+	if (file->data) munmap((void*)file->data, file->size);
+	if (file->fd >= 0) close(file->fd);
+	memset(file, 0, sizeof(*file));
+	file->fd = -1;
+}
+
+// Kernel-side copy, returns bytes left if the kernel refused the copy
+static uint64_t kernel_copy(int src_fd, uint64_t offset, uint64_t size,
+                            int dest_fd) {
+#ifdef __linux__
+	off_t src_offset = (off_t)offset;
+
+	while (size > 0) {
+		ssize_t copied = copy_file_range(src_fd, &src_offset, dest_fd, NULL,
+		                                 size, 0);
+		if (copied <= 0) {
+			if (copied < 0 && errno == EINTR) continue;
+			break;
+		}
+		size -= copied;
+	}
+
+	while (size > 0) {
+		ssize_t copied = sendfile(dest_fd, src_fd, &src_offset, size);
+		if (copied <= 0) {
+			if (copied < 0 && errno == EINTR) continue;
+			break;
+		}
+		size -= copied;
+	}
+#else
+	(void)src_fd;
+	(void)offset;
+	(void)dest_fd;
+#endif
+	return size;
+}
+
+int mapped_file_write_range(const MappedFile* file, uint64_t offset,
+                            uint64_t size, const char* dest_path) {
+	if (offset > file->size || size > file->size - offset) {
+		return -1;
+	}
+
+	int dest = open(dest_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (dest < 0) {
+		return -1;
+	}
+
+	uint64_t left = kernel_copy(file->fd, offset, size, dest);
+
+	// Whatever the kernel didn't copy is written from the mapping
+	const uint8_t* source = file->data + offset + (size - left);
+	while (left > 0) {
+		ssize_t written = write(dest, source, left);
+		if (written <= 0) {
+			if (written < 0 && errno == EINTR) continue;
+			close(dest);
+			return -1;
+		}
+		source += written;
+		left -= written;
+	}
+
+	return close(dest);
+}
+
+#endif
@@ -0,0 +1,1357 @@
+#include "audio_decoder.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define seek_file _fseeki64
+#define tell_file _ftelli64
+#else
+#define seek_file fseeko
+#define tell_file ftello
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define INPUT_BUFFER_SIZE 65536
+#define HEADER_SIZE 4
+// 144 * 320 kbps / 32 kHz plus padding, the largest Layer III frame
+#define MAX_FRAME_SIZE 1441
+#define MAX_RESERVOIR 511
+#define GRANULE_SIZE 576
+#define SUBBANDS 32
+#define SUBBAND_SIZE 18
+#define MAX_GRANULES 2
+// The first frame has to be found this early in the file
+#define SYNC_SEARCH_SIZE 65536
+// Samples the reference decoder lags behind, encoder delays in the LAME tag leave it out
+#define DECODER_DELAY 529
+#define HUFFMAN_ENTRIES 1378
+#define HUFFMAN_TABLES 15
+#define MAX_VALUE 8207
+
+#define MODE_JOINT_STEREO 1
+#define MODE_MONO 3
+#define BLOCK_SHORT 2
+
+typedef struct {
+	unsigned version;     // 0 MPEG-1, 1 MPEG-2, 2 MPEG-2.5
+	unsigned rate_index;  // Into sample_rates, over every version
+	unsigned channels;
+	unsigned mode;
+	unsigned mode_extension;
+	bool crc;
+	unsigned size;        // Of the whole frame
+} FrameHeader;
+
+typedef struct {
+	unsigned part2_3_length;
+	unsigned big_values;
+	unsigned global_gain;
+	unsigned scalefac_compress;
+	bool window_switching;
+	unsigned block_type;
+	bool mixed;
+	unsigned table_select[3];
+	unsigned subblock_gain[3];
+	unsigned region0_count;
+	unsigned region1_count;
+	bool preflag;
+	bool scalefac_scale;
+	bool count1_table;
+	uint8_t scalefac_long[22];
+	uint8_t scalefac_short[13][3];
+	// Intensity positions that mean none, MPEG-2 derives them from the scalefactor sizes
+	uint8_t is_illegal_long[22];
+	uint8_t is_illegal_short[13];
+} Granule;
+
+// Read most significant bit first, the data has zeros past its end
+typedef struct {
+	const uint8_t* data;
+	size_t position;  // In bits
+} BitInput;
+
+typedef struct {
+	AudioDecoder base;
+	FILE* file;
+	uint8_t* input;
+	size_t input_start;
+	size_t input_end;
+	FrameHeader first;  // Frames of another version, rate or channel count are false syncs
+
+	uint8_t frame[MAX_FRAME_SIZE];
+	uint8_t reservoir[MAX_RESERVOIR + MAX_FRAME_SIZE + 8];
+	size_t reservoir_size;
+
+	uint32_t huffman_starts[HUFFMAN_ENTRIES];  // Codewords aligned to the top bit
+	uint32_t quad_starts[16];
+	float pow43[MAX_VALUE];
+	// Transforms laid out input by input, so their loops run over the outputs
+	float imdct_long[18][36];
+	float imdct_short[6][12];
+	float windows[4][36];
+	float alias_cs[8];
+	float alias_ca[8];
+	float synthesis[SUBBANDS][SUBBANDS];  // Rows 0-15 and 33-48 of the matrix
+	float synthesis_window[512];
+
+	int values[GRANULE_SIZE];
+	float lines[2][GRANULE_SIZE];
+	float overlap[2][GRANULE_SIZE];
+	float v[2][1024];
+	unsigned v_offset[2];
+
+	float output[MAX_GRANULES * GRANULE_SIZE * 2];
+	unsigned output_size;
+	unsigned output_position;
+	uint64_t skip;
+	uint64_t frames_left;
+	bool failed;
+} Mp3Decoder;
+
+static const uint16_t bitrates[2][15] = {
+	{0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+	{0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+};
+
+static const unsigned sample_rates[9] = {
+	44100, 48000, 32000, 22050, 24000, 16000, 11025, 12000, 8000,
+};
+
+// Scalefactor band widths per sample rate
+static const uint8_t long_bands[9][22] = {
+	{4, 4, 4, 4, 4, 4, 6, 6, 8, 8, 10, 12, 16, 20, 24, 28, 34, 42, 50, 54, 76, 158},
+	{4, 4, 4, 4, 4, 4, 6, 6, 6, 8, 10, 12, 16, 18, 22, 28, 34, 40, 46, 54, 54, 192},
+	{4, 4, 4, 4, 4, 4, 6, 6, 8, 10, 12, 16, 20, 24, 30, 38, 46, 56, 68, 84, 102, 26},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 18, 22, 26, 32, 38, 46, 54, 62, 70, 76, 36},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{12, 12, 12, 12, 12, 12, 16, 20, 24, 28, 32, 40, 48, 56, 64, 76, 90, 2, 2, 2, 2, 2},
+};
+
+static const uint8_t short_bands[9][13] = {
+	{4, 4, 4, 4, 6, 8, 10, 12, 14, 18, 22, 30, 56},
+	{4, 4, 4, 4, 6, 6, 10, 12, 14, 16, 20, 26, 66},
+	{4, 4, 4, 4, 6, 8, 12, 16, 20, 26, 34, 42, 12},
+	{4, 4, 4, 6, 6, 8, 10, 14, 18, 26, 32, 42, 18},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 32, 44, 12},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+	{8, 8, 8, 12, 16, 20, 24, 28, 36, 2, 2, 2, 26},
+};
+
+static const uint8_t pretab[22] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 3, 2, 0,
+};
+
+// MPEG-1 scalefactor sizes by scalefac_compress
+static const uint8_t slen_table[16][2] = {
+	{0, 0}, {0, 1}, {0, 2}, {0, 3}, {3, 0}, {1, 1}, {1, 2}, {1, 3},
+	{2, 1}, {2, 2}, {2, 3}, {3, 1}, {3, 2}, {3, 3}, {4, 2}, {4, 3},
+};
+
+// MPEG-2 scalefactors per size group, by scalefac_compress range and long/short/mixed blocks
+static const uint8_t lsf_groups[6][3][4] = {
+	{{6, 5, 5, 5}, {9, 9, 9, 9}, {6, 9, 9, 9}},
+	{{6, 5, 7, 3}, {9, 9, 12, 6}, {6, 9, 12, 6}},
+	{{11, 10, 0, 0}, {18, 18, 0, 0}, {15, 18, 0, 0}},
+	{{7, 7, 7, 0}, {12, 12, 12, 0}, {6, 15, 12, 0}},
+	{{6, 6, 6, 3}, {12, 9, 9, 6}, {6, 12, 9, 6}},
+	{{8, 8, 5, 0}, {15, 12, 9, 0}, {6, 18, 9, 0}},
+};
+
+/*
+ * Big value tables 1-24 as codeword lengths and the x << 4 | y pairs they code,
+ * in codeword order. Tables 16 and 24 serve eight tables each with more linbits.
+ */
+static const uint8_t huffman_lengths[HUFFMAN_ENTRIES] = {
+	// Table 1
+	3, 3, 2, 1,
+	// Table 2
+	6, 6, 5, 5, 5, 3, 3, 3, 1,
+	// Table 3
+	6, 6, 5, 5, 5, 3, 2, 2, 2,
+	// Table 5
+	8, 8, 7, 6, 7, 7, 7, 7, 6, 6, 6, 6, 3, 3, 3, 1,
+	// Table 6
+	7, 7, 6, 6, 6, 5, 5, 5, 5, 4, 4, 4, 3, 2, 3, 3,
+	// Table 7
+	10, 10, 10, 10, 9, 9, 9, 9, 8, 8, 9, 9, 8, 9, 9, 8,
+	8, 7, 7, 7, 8, 8, 8, 8, 7, 7, 7, 7, 6, 5, 6, 6,
+	4, 3, 3, 1,
+	// Table 8
+	11, 11, 10, 9, 10, 10, 9, 9, 9, 8, 8, 9, 9, 9, 9, 8,
+	8, 8, 7, 8, 8, 8, 8, 8, 8, 8, 8, 6, 6, 6, 4, 4,
+	2, 3, 3, 2,
+	// Table 9
+	9, 9, 8, 8, 9, 9, 8, 8, 8, 8, 7, 7, 7, 8, 8, 7,
+	7, 7, 7, 6, 6, 6, 6, 5, 5, 6, 6, 5, 5, 4, 4, 4,
+	3, 3, 3, 3,
+	// Table 10
+	11, 11, 11, 11, 11, 11, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10,
+	9, 9, 10, 10, 9, 9, 10, 10, 9, 10, 10, 8, 8, 9, 9, 10,
+	10, 9, 9, 10, 10, 8, 8, 8, 9, 9, 9, 9, 9, 9, 8, 8,
+	8, 8, 8, 8, 7, 7, 7, 7, 6, 6, 6, 6, 4, 3, 3, 1,
+	// Table 11
+	10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 9, 9, 9, 10, 10,
+	10, 10, 8, 8, 9, 9, 7, 8, 8, 8, 8, 8, 9, 9, 9, 9,
+	8, 7, 8, 8, 7, 7, 8, 8, 8, 9, 9, 8, 8, 8, 8, 8,
+	8, 7, 7, 6, 6, 7, 7, 6, 5, 4, 5, 5, 3, 3, 3, 2,
+	// Table 12
+	10, 10, 9, 9, 9, 9, 9, 9, 9, 8, 8, 9, 9, 8, 8, 8,
+	8, 8, 8, 9, 9, 8, 8, 8, 8, 8, 9, 9, 7, 7, 7, 8,
+	8, 8, 8, 8, 8, 7, 7, 7, 7, 8, 8, 7, 7, 7, 6, 6,
+	6, 6, 7, 7, 6, 5, 5, 5, 4, 4, 5, 5, 4, 3, 3, 3,
+	// Table 13
+	19, 19, 18, 17, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 17, 17,
+	15, 15, 16, 16, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 16, 16,
+	15, 16, 16, 14, 14, 15, 15, 15, 15, 14, 14, 14, 14, 14, 14, 14,
+	14, 14, 14, 14, 15, 15, 14, 13, 14, 14, 13, 13, 14, 14, 13, 14,
+	14, 13, 14, 14, 13, 14, 14, 13, 13, 14, 14, 12, 12, 12, 13, 13,
+	13, 13, 13, 13, 12, 13, 13, 12, 12, 13, 13, 13, 13, 13, 13, 13,
+	13, 13, 13, 13, 13, 12, 12, 13, 13, 12, 12, 12, 12, 13, 13, 13,
+	13, 12, 13, 13, 12, 11, 12, 12, 12, 12, 12, 12, 12, 12, 11, 11,
+	11, 11, 12, 12, 11, 11, 12, 12, 11, 12, 12, 12, 12, 11, 11, 12,
+	12, 11, 12, 12, 11, 12, 12, 11, 12, 12, 10, 10, 10, 11, 11, 11,
+	11, 11, 11, 11, 11, 10, 10, 10, 10, 11, 11, 10, 11, 11, 10, 11,
+	11, 11, 11, 10, 10, 11, 11, 10, 10, 11, 11, 11, 11, 11, 11, 9,
+	9, 10, 10, 10, 10, 10, 11, 11, 9, 9, 9, 10, 10, 9, 9, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 8, 9, 9, 9, 9, 9, 9,
+	10, 10, 9, 9, 9, 8, 8, 9, 9, 9, 9, 9, 9, 8, 7, 8,
+	8, 8, 8, 7, 7, 7, 7, 7, 6, 6, 6, 6, 4, 4, 3, 1,
+	// Table 15
+	13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13, 12, 13, 13, 12, 12,
+	12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+	12, 12, 12, 12, 12, 13, 13, 11, 11, 12, 12, 12, 12, 11, 11, 11,
+	11, 11, 11, 12, 12, 11, 11, 11, 11, 11, 11, 11, 11, 12, 12, 11,
+	11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+	11, 11, 11, 11, 11, 11, 11, 11, 12, 12, 11, 11, 11, 11, 11, 11,
+	10, 11, 11, 11, 11, 11, 11, 10, 10, 11, 11, 10, 10, 10, 10, 11,
+	11, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10, 10, 11,
+	11, 9, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 9, 10,
+	10, 10, 10, 9, 10, 10, 9, 10, 10, 10, 10, 10, 10, 10, 10, 9,
+	9, 9, 9, 9, 9, 9, 10, 10, 9, 9, 9, 9, 9, 9, 10, 10,
+	9, 9, 9, 9, 9, 9, 8, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+	9, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9, 8, 8, 8,
+	8, 8, 8, 9, 9, 8, 8, 8, 8, 8, 8, 8, 9, 9, 8, 7,
+	8, 8, 7, 7, 7, 7, 8, 8, 7, 7, 7, 7, 7, 6, 7, 7,
+	6, 6, 7, 7, 6, 6, 6, 5, 5, 5, 5, 5, 3, 4, 4, 3,
+	// Table 16
+	11, 11, 11, 11, 11, 11, 11, 11, 10, 11, 11, 11, 11, 10, 10, 10,
+	10, 10, 8, 10, 10, 9, 9, 9, 9, 10, 16, 17, 17, 15, 15, 16,
+	16, 14, 15, 15, 14, 14, 15, 15, 14, 14, 15, 15, 15, 15, 14, 15,
+	15, 14, 13, 8, 9, 9, 8, 8, 13, 14, 14, 14, 14, 14, 14, 14,
+	14, 14, 14, 13, 13, 14, 14, 14, 14, 13, 14, 14, 13, 13, 13, 14,
+	14, 14, 14, 13, 13, 14, 14, 13, 14, 14, 12, 13, 13, 13, 13, 13,
+	13, 13, 13, 13, 13, 13, 13, 13, 13, 12, 13, 13, 13, 13, 13, 13,
+	12, 13, 13, 12, 12, 13, 13, 11, 12, 12, 12, 12, 12, 12, 12, 13,
+	13, 11, 12, 12, 12, 12, 11, 12, 12, 12, 12, 12, 12, 12, 12, 11,
+	12, 12, 11, 11, 11, 11, 12, 12, 12, 12, 12, 12, 12, 12, 11, 12,
+	12, 11, 12, 12, 11, 12, 12, 11, 12, 12, 11, 10, 10, 11, 11, 11,
+	11, 11, 11, 10, 10, 11, 11, 10, 10, 11, 11, 11, 11, 11, 11, 11,
+	11, 10, 11, 11, 10, 10, 10, 11, 11, 10, 10, 11, 11, 10, 10, 11,
+	11, 10, 9, 9, 10, 10, 10, 10, 10, 10, 9, 9, 9, 10, 10, 9,
+	10, 10, 9, 9, 8, 9, 9, 9, 9, 9, 9, 9, 9, 8, 8, 9,
+	9, 8, 8, 7, 7, 8, 8, 7, 6, 6, 6, 6, 4, 4, 3, 1,
+	// Table 24
+	8, 8, 8, 8, 8, 8, 8, 8, 7, 8, 8, 7, 7, 8, 8, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 9, 11, 11,
+	11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+	11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 4, 11, 11, 11, 11, 12,
+	12, 11, 10, 11, 11, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10, 11,
+	11, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 11, 11, 10, 9, 10, 10,
+	10, 10, 11, 11, 10, 9, 9, 10, 10, 9, 10, 10, 10, 10, 9, 9,
+	10, 10, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+	9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+	9, 9, 9, 9, 9, 9, 10, 10, 9, 9, 9, 10, 10, 8, 9, 9,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 8,
+	8, 8, 8, 8, 8, 9, 9, 7, 8, 8, 7, 7, 7, 7, 7, 8,
+	8, 7, 7, 6, 6, 7, 7, 6, 5, 5, 6, 6, 4, 4, 4, 4,
+};
+
+static const uint8_t huffman_symbols[HUFFMAN_ENTRIES] = {
+	// Table 1
+	0x11, 0x01, 0x10, 0x00,
+	// Table 2
+	0x22, 0x02, 0x12, 0x21, 0x20, 0x11, 0x01, 0x10, 0x00,
+	// Table 3
+	0x22, 0x02, 0x12, 0x21, 0x20, 0x10, 0x11, 0x01, 0x00,
+	// Table 5
+	0x33, 0x23, 0x32, 0x31, 0x13, 0x03, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00,
+	// Table 6
+	0x33, 0x03, 0x23, 0x32, 0x30, 0x13, 0x31, 0x22, 0x02, 0x12, 0x21, 0x20, 0x01, 0x11, 0x10, 0x00,
+	// Table 7
+	0x55, 0x45, 0x54, 0x53, 0x35, 0x44, 0x25, 0x52, 0x15, 0x51, 0x05, 0x34, 0x50, 0x43, 0x33, 0x24,
+	0x42, 0x14, 0x41, 0x40, 0x04, 0x23, 0x32, 0x03, 0x13, 0x31, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20,
+	0x11, 0x01, 0x10, 0x00,
+	// Table 8
+	0x55, 0x54, 0x45, 0x53, 0x35, 0x44, 0x25, 0x52, 0x05, 0x15, 0x51, 0x34, 0x43, 0x50, 0x33, 0x24,
+	0x42, 0x14, 0x41, 0x04, 0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x02, 0x20, 0x12, 0x21,
+	0x11, 0x01, 0x10, 0x00,
+	// Table 9
+	0x55, 0x45, 0x35, 0x53, 0x54, 0x05, 0x44, 0x25, 0x52, 0x15, 0x51, 0x34, 0x43, 0x50, 0x04, 0x24,
+	0x42, 0x33, 0x40, 0x14, 0x41, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x02, 0x12, 0x21, 0x20,
+	0x11, 0x01, 0x10, 0x00,
+	// Table 10
+	0x77, 0x67, 0x76, 0x57, 0x75, 0x66, 0x47, 0x74, 0x56, 0x65, 0x37, 0x73, 0x46, 0x55, 0x54, 0x63,
+	0x27, 0x72, 0x64, 0x07, 0x70, 0x62, 0x45, 0x35, 0x06, 0x53, 0x44, 0x17, 0x71, 0x36, 0x26, 0x25,
+	0x52, 0x15, 0x51, 0x34, 0x43, 0x16, 0x61, 0x60, 0x05, 0x50, 0x24, 0x42, 0x33, 0x04, 0x14, 0x41,
+	0x40, 0x23, 0x32, 0x03, 0x13, 0x31, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00,
+	// Table 11
+	0x77, 0x67, 0x76, 0x75, 0x66, 0x47, 0x74, 0x57, 0x55, 0x56, 0x65, 0x37, 0x73, 0x46, 0x45, 0x54,
+	0x35, 0x53, 0x27, 0x72, 0x64, 0x07, 0x71, 0x17, 0x70, 0x36, 0x63, 0x60, 0x44, 0x25, 0x52, 0x05,
+	0x15, 0x62, 0x26, 0x06, 0x16, 0x61, 0x51, 0x34, 0x50, 0x43, 0x33, 0x24, 0x42, 0x14, 0x41, 0x04,
+	0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x21, 0x12, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00,
+	// Table 12
+	0x77, 0x67, 0x76, 0x57, 0x75, 0x66, 0x47, 0x74, 0x65, 0x56, 0x37, 0x73, 0x55, 0x27, 0x72, 0x46,
+	0x64, 0x17, 0x71, 0x07, 0x70, 0x36, 0x63, 0x45, 0x54, 0x44, 0x06, 0x05, 0x26, 0x62, 0x61, 0x16,
+	0x60, 0x35, 0x53, 0x25, 0x52, 0x15, 0x51, 0x34, 0x43, 0x50, 0x04, 0x24, 0x42, 0x14, 0x33, 0x41,
+	0x23, 0x32, 0x40, 0x03, 0x30, 0x13, 0x31, 0x22, 0x12, 0x21, 0x02, 0x20, 0x00, 0x11, 0x01, 0x10,
+	// Table 13
+	0xfe, 0xfc, 0xfd, 0xed, 0xff, 0xef, 0xdf, 0xee, 0xcf, 0xde, 0xbf, 0xfb, 0xce, 0xdc, 0xaf, 0xe9,
+	0xec, 0xdd, 0xfa, 0xcd, 0xbe, 0xeb, 0x9f, 0xf9, 0xea, 0xbd, 0xdb, 0x8f, 0xf8, 0xcc, 0xae, 0x9e,
+	0x8e, 0x7f, 0x7e, 0xf7, 0xda, 0xad, 0xbc, 0xcb, 0xf6, 0x6f, 0xe8, 0x5f, 0x9d, 0xd9, 0xf5, 0xe7,
+	0xac, 0xbb, 0x4f, 0xf4, 0xca, 0xe6, 0xf3, 0x3f, 0x8d, 0xd8, 0x2f, 0xf2, 0x6e, 0x9c, 0x0f, 0xc9,
+	0x5e, 0xab, 0x7d, 0xd7, 0x4e, 0xc8, 0xd6, 0x3e, 0xb9, 0x9b, 0xaa, 0x1f, 0xf1, 0xf0, 0xba, 0xe5,
+	0xe4, 0x8c, 0x6d, 0xe3, 0xe2, 0x2e, 0x0e, 0x1e, 0xe1, 0xe0, 0x5d, 0xd5, 0x7c, 0xc7, 0x4d, 0x8b,
+	0xb8, 0xd4, 0x9a, 0xa9, 0x6c, 0xc6, 0x3d, 0xd3, 0x7b, 0x2d, 0xd2, 0x1d, 0xb7, 0x5c, 0xc5, 0x99,
+	0x7a, 0xc3, 0xa7, 0x97, 0x4b, 0xd1, 0x0d, 0xd0, 0x8a, 0xa8, 0x4c, 0xc4, 0x6b, 0xb6, 0x3c, 0x2c,
+	0xc2, 0x5b, 0xb5, 0x89, 0x1c, 0xc1, 0x98, 0x0c, 0xc0, 0xb4, 0x6a, 0xa6, 0x79, 0x3b, 0xb3, 0x88,
+	0x5a, 0x2b, 0xa5, 0x69, 0xa4, 0x78, 0x87, 0x94, 0x77, 0x76, 0xb2, 0x1b, 0xb1, 0x0b, 0xb0, 0x96,
+	0x4a, 0x3a, 0xa3, 0x59, 0x95, 0x2a, 0xa2, 0x1a, 0xa1, 0x0a, 0x68, 0xa0, 0x86, 0x49, 0x93, 0x39,
+	0x58, 0x85, 0x67, 0x29, 0x92, 0x57, 0x75, 0x38, 0x83, 0x66, 0x47, 0x74, 0x56, 0x65, 0x73, 0x19,
+	0x91, 0x09, 0x90, 0x48, 0x84, 0x72, 0x46, 0x64, 0x28, 0x82, 0x18, 0x37, 0x27, 0x17, 0x71, 0x55,
+	0x07, 0x70, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x35, 0x81, 0x08, 0x80, 0x16, 0x61, 0x06, 0x60,
+	0x53, 0x44, 0x25, 0x52, 0x05, 0x15, 0x51, 0x34, 0x43, 0x50, 0x24, 0x42, 0x33, 0x14, 0x41, 0x04,
+	0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00,
+	// Table 15
+	0xff, 0xef, 0xfe, 0xdf, 0xee, 0xfd, 0xcf, 0xfc, 0xde, 0xed, 0xbf, 0xfb, 0xce, 0xec, 0xdd, 0xaf,
+	0xfa, 0xbe, 0xeb, 0xcd, 0xdc, 0x9f, 0xf9, 0xea, 0xbd, 0xdb, 0x8f, 0xf8, 0xcc, 0x9e, 0xe9, 0x7f,
+	0xf7, 0xad, 0xda, 0xbc, 0x6f, 0xae, 0x0f, 0xcb, 0xf6, 0x8e, 0xe8, 0x5f, 0x9d, 0xf5, 0x7e, 0xe7,
+	0xac, 0xca, 0xbb, 0xd9, 0x8d, 0x4f, 0xf4, 0x3f, 0xf3, 0xd8, 0xe6, 0x2f, 0xf2, 0x6e, 0xf0, 0x1f,
+	0xf1, 0x9c, 0xc9, 0x5e, 0xab, 0xba, 0xe5, 0x7d, 0xd7, 0x4e, 0xe4, 0x8c, 0xc8, 0x3e, 0x6d, 0xd6,
+	0xe3, 0x9b, 0xb9, 0x2e, 0xaa, 0xe2, 0x1e, 0xe1, 0x0e, 0xe0, 0x5d, 0xd5, 0x7c, 0xc7, 0x4d, 0x8b,
+	0xd4, 0xb8, 0x9a, 0xa9, 0x6c, 0xc6, 0x3d, 0xd3, 0xd2, 0x2d, 0x0d, 0x1d, 0x7b, 0xb7, 0xd1, 0x5c,
+	0xd0, 0xc5, 0x8a, 0xa8, 0x4c, 0xc4, 0x6b, 0xb6, 0x99, 0x0c, 0x3c, 0xc3, 0x7a, 0xa7, 0xa6, 0xc0,
+	0x0b, 0xc2, 0x2c, 0x5b, 0xb5, 0x1c, 0x89, 0x98, 0xc1, 0x4b, 0xb4, 0x6a, 0x3b, 0x79, 0xb3, 0x97,
+	0x88, 0x2b, 0x5a, 0xb2, 0xa5, 0x1b, 0xb1, 0xb0, 0x69, 0x96, 0x4a, 0xa4, 0x78, 0x87, 0x3a, 0xa3,
+	0x59, 0x95, 0x2a, 0xa2, 0x1a, 0xa1, 0x0a, 0xa0, 0x68, 0x86, 0x49, 0x94, 0x39, 0x93, 0x77, 0x09,
+	0x58, 0x85, 0x29, 0x67, 0x76, 0x92, 0x91, 0x19, 0x90, 0x48, 0x84, 0x57, 0x75, 0x38, 0x83, 0x66,
+	0x47, 0x28, 0x82, 0x18, 0x81, 0x74, 0x08, 0x80, 0x56, 0x65, 0x37, 0x73, 0x46, 0x27, 0x72, 0x64,
+	0x17, 0x55, 0x71, 0x07, 0x70, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x16, 0x06, 0x60, 0x35, 0x61,
+	0x53, 0x44, 0x25, 0x52, 0x15, 0x51, 0x05, 0x50, 0x34, 0x43, 0x24, 0x42, 0x33, 0x41, 0x14, 0x04,
+	0x23, 0x32, 0x40, 0x03, 0x13, 0x31, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00,
+	// Table 16
+	0xef, 0xfe, 0xdf, 0xfd, 0xcf, 0xfc, 0xbf, 0xfb, 0xaf, 0xfa, 0x9f, 0xf9, 0xf8, 0x8f, 0x7f, 0xf7,
+	0x6f, 0xf6, 0xff, 0x5f, 0xf5, 0x4f, 0xf4, 0xf3, 0xf0, 0x3f, 0xce, 0xec, 0xdd, 0xde, 0xe9, 0xea,
+	0xd9, 0xee, 0xed, 0xeb, 0xbe, 0xcd, 0xdc, 0xdb, 0xae, 0xcc, 0xad, 0xda, 0x7e, 0xac, 0xca, 0xc9,
+	0x7d, 0x5e, 0xbd, 0xf2, 0x2f, 0x0f, 0x1f, 0xf1, 0x9e, 0xbc, 0xcb, 0x8e, 0xe8, 0x9d, 0xe7, 0xbb,
+	0x8d, 0xd8, 0x6e, 0xe6, 0x9c, 0xab, 0xba, 0xe5, 0xd7, 0x4e, 0xe4, 0x8c, 0xc8, 0x3e, 0x6d, 0xd6,
+	0x9b, 0xb9, 0xaa, 0xe1, 0xd4, 0xb8, 0xa9, 0x7b, 0xb7, 0xd0, 0xe3, 0x0e, 0xe0, 0x5d, 0xd5, 0x7c,
+	0xc7, 0x4d, 0x8b, 0x9a, 0x6c, 0xc6, 0x3d, 0x5c, 0xc5, 0x0d, 0x8a, 0xa8, 0x99, 0x4c, 0xb6, 0x7a,
+	0x3c, 0x5b, 0x89, 0x1c, 0xc0, 0x98, 0x79, 0xe2, 0x2e, 0x1e, 0xd3, 0x2d, 0xd2, 0xd1, 0x3b, 0x97,
+	0x88, 0x1d, 0xc4, 0x6b, 0xc3, 0xa7, 0x2c, 0xc2, 0xb5, 0xc1, 0x0c, 0x4b, 0xb4, 0x6a, 0xa6, 0xb3,
+	0x5a, 0xa5, 0x2b, 0xb2, 0x1b, 0xb1, 0x0b, 0xb0, 0x69, 0x96, 0x4a, 0xa4, 0x78, 0x87, 0xa3, 0x3a,
+	0x59, 0x2a, 0x95, 0x68, 0xa1, 0x86, 0x77, 0x94, 0x49, 0x57, 0x67, 0xa2, 0x1a, 0x0a, 0xa0, 0x39,
+	0x93, 0x58, 0x85, 0x29, 0x92, 0x76, 0x09, 0x19, 0x91, 0x90, 0x48, 0x84, 0x75, 0x38, 0x83, 0x66,
+	0x28, 0x82, 0x47, 0x74, 0x18, 0x81, 0x80, 0x08, 0x56, 0x37, 0x73, 0x65, 0x46, 0x27, 0x72, 0x64,
+	0x55, 0x07, 0x17, 0x71, 0x70, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x16, 0x61, 0x06, 0x60, 0x53,
+	0x35, 0x44, 0x25, 0x52, 0x51, 0x15, 0x05, 0x34, 0x43, 0x50, 0x24, 0x42, 0x33, 0x14, 0x41, 0x04,
+	0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00,
+	// Table 24
+	0xef, 0xfe, 0xdf, 0xfd, 0xcf, 0xfc, 0xbf, 0xfb, 0xfa, 0xaf, 0x9f, 0xf9, 0xf8, 0x8f, 0x7f, 0xf7,
+	0x6f, 0xf6, 0x5f, 0xf5, 0x4f, 0xf4, 0x3f, 0xf3, 0x2f, 0xf2, 0xf1, 0x1f, 0xf0, 0x0f, 0xee, 0xde,
+	0xed, 0xce, 0xec, 0xdd, 0xbe, 0xeb, 0xcd, 0xdc, 0xae, 0xea, 0xbd, 0xdb, 0xcc, 0x9e, 0xe9, 0xad,
+	0xda, 0xbc, 0xcb, 0x8e, 0xe8, 0x9d, 0xd9, 0x7e, 0xe7, 0xac, 0xff, 0xca, 0xbb, 0x8d, 0xd8, 0x0e,
+	0xe0, 0x0d, 0xe6, 0x6e, 0x9c, 0xc9, 0x5e, 0xba, 0xe5, 0xab, 0x7d, 0xd7, 0xe4, 0x8c, 0xc8, 0x4e,
+	0x2e, 0x3e, 0x6d, 0xd6, 0xe3, 0x9b, 0xb9, 0xaa, 0xe2, 0x1e, 0xe1, 0x5d, 0xd5, 0x7c, 0xc7, 0x4d,
+	0x8b, 0xb8, 0xd4, 0x9a, 0xa9, 0x6c, 0xc6, 0x3d, 0xd3, 0x2d, 0xd2, 0x1d, 0x7b, 0xb7, 0xd1, 0x5c,
+	0xc5, 0x8a, 0xa8, 0x99, 0x4c, 0xc4, 0x6b, 0xb6, 0xd0, 0x0c, 0x3c, 0xc3, 0x7a, 0xa7, 0x2c, 0xc2,
+	0x5b, 0xb5, 0x1c, 0x89, 0x98, 0xc1, 0x4b, 0xc0, 0x0b, 0x3b, 0xb0, 0x0a, 0x1a, 0xb4, 0x6a, 0xa6,
+	0x79, 0x97, 0xa0, 0x09, 0x90, 0xb3, 0x88, 0x2b, 0x5a, 0xb2, 0xa5, 0x1b, 0xb1, 0x69, 0x96, 0xa4,
+	0x4a, 0x78, 0x87, 0x3a, 0xa3, 0x59, 0x95, 0x2a, 0xa2, 0xa1, 0x68, 0x86, 0x77, 0x49, 0x94, 0x39,
+	0x93, 0x58, 0x85, 0x29, 0x67, 0x76, 0x92, 0x19, 0x91, 0x48, 0x84, 0x57, 0x75, 0x38, 0x83, 0x66,
+	0x28, 0x82, 0x18, 0x47, 0x74, 0x81, 0x08, 0x80, 0x56, 0x65, 0x17, 0x07, 0x70, 0x73, 0x37, 0x27,
+	0x72, 0x46, 0x64, 0x55, 0x71, 0x36, 0x63, 0x45, 0x54, 0x26, 0x62, 0x16, 0x61, 0x06, 0x60, 0x35,
+	0x53, 0x44, 0x25, 0x52, 0x15, 0x05, 0x50, 0x51, 0x34, 0x43, 0x24, 0x42, 0x33, 0x14, 0x41, 0x04,
+	0x40, 0x23, 0x32, 0x13, 0x31, 0x03, 0x30, 0x22, 0x12, 0x21, 0x02, 0x20, 0x11, 0x01, 0x10, 0x00,
+};
+
+static const uint16_t huffman_sizes[HUFFMAN_TABLES] = {
+	4, 9, 9, 16, 16, 36, 36, 36, 64, 64, 64, 256, 256, 256, 256,
+};
+
+// Into huffman_sizes by table_select, 0 codes nothing and 4 and 14 don't exist
+static const int8_t huffman_tables[32] = {
+	-1, 0, 1, 2, -1, 3, 4, 5, 6, 7, 8, 9, 10, 11, -1, 12,
+	13, 13, 13, 13, 13, 13, 13, 13, 14, 14, 14, 14, 14, 14, 14, 14,
+};
+
+static const uint8_t linbits[32] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 2, 3, 4, 6, 8, 10, 13, 4, 5, 6, 7, 8, 9, 11, 13,
+};
+
+// Count1 table A in codeword order, table B is the inverted 4 bits
+static const uint8_t quad_lengths[16] = {6, 6, 6, 6, 6, 6, 5, 5, 5, 5, 5, 4, 4, 4, 4, 1};
+static const uint8_t quad_symbols[16] = {11, 15, 13, 14, 7, 5, 9, 6, 3, 10, 12, 2, 1, 4, 8, 0};
+
+// First half of the synthesis window in 1/65536, the rest mirrors it
+static const int32_t window_half[257] = {
+	0, -1, -1, -1, -1, -1, -1, -2, -2, -2,
+	-2, -3, -3, -4, -4, -5, -5, -6, -7, -7,
+	-8, -9, -10, -11, -13, -14, -16, -17, -19, -21,
+	-24, -26, -29, -31, -35, -38, -41, -45, -49, -53,
+	-58, -63, -68, -73, -79, -85, -91, -97, -104, -111,
+	-117, -125, -132, -139, -147, -154, -161, -169, -176, -183,
+	-190, -196, -202, -208, 213, 218, 222, 225, 227, 228,
+	228, 227, 224, 221, 215, 208, 200, 189, 177, 163,
+	146, 127, 106, 83, 57, 29, -2, -36, -72, -111,
+	-153, -197, -244, -294, -347, -401, -459, -519, -581, -645,
+	-711, -779, -848, -919, -991, -1064, -1137, -1210, -1283, -1356,
+	-1428, -1498, -1567, -1634, -1698, -1759, -1817, -1870, -1919, -1962,
+	-2001, -2032, -2057, -2075, -2085, -2087, -2080, -2063, 2037, 2000,
+	1952, 1893, 1822, 1739, 1644, 1535, 1414, 1280, 1131, 970,
+	794, 605, 402, 185, -45, -288, -545, -814, -1095, -1388,
+	-1692, -2006, -2330, -2663, -3004, -3351, -3705, -4063, -4425, -4788,
+	-5153, -5517, -5879, -6237, -6589, -6935, -7271, -7597, -7910, -8209,
+	-8491, -8755, -8998, -9219, -9416, -9585, -9727, -9838, -9916, -9959,
+	-9966, -9935, -9863, -9750, -9592, -9389, -9139, -8840, -8492, -8092,
+	-7640, -7134, 6574, 5959, 5288, 4561, 3776, 2935, 2037, 1082,
+	70, -998, -2122, -3300, -4533, -5818, -7154, -8540, -9975, -11455,
+	-12980, -14548, -16155, -17799, -19478, -21189, -22929, -24694, -26482, -28289,
+	-30112, -31947, -33791, -35640, -37489, -39336, -41176, -43006, -44821, -46617,
+	-48390, -50137, -51853, -53534, -55178, -56778, -58333, -59838, -61289, -62684,
+	-64019, -65290, -66494, -67629, -68692, -69679, -70590, -71420, -72169, -72835,
+	-73415, -73908, -74313, -74630, -74856, -74992, 75038,
+};
+
+static const float alias_coefficients[8] = {
+	-0.6f, -0.535f, -0.33f, -0.185f, -0.095f, -0.041f, -0.0142f, -0.0037f,
+};
+
+static uint32_t read_be32(const uint8_t* p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* Bits */
+
+static uint32_t peek_bits(const BitInput* in) {
+	const uint8_t* p = in->data + (in->position >> 3);
+	uint64_t value = (uint64_t)p[0] << 32 | (uint64_t)p[1] << 24 | (uint64_t)p[2] << 16 |
+	                 (uint64_t)p[3] << 8 | p[4];
+	return (uint32_t)(value >> (8 - (in->position & 7)));
+}
+
+static uint32_t read_bits(BitInput* in, int count) {
+	if (count == 0) {
+		return 0;
+	}
+	uint32_t value = peek_bits(in) >> (32 - count);
+	in->position += (size_t)count;
+	return value;
+}
+
+// The last codeword starting at or below the next 32 bits
+static unsigned decode_symbol(BitInput* in, const uint32_t* starts, const uint8_t* lengths,
+                              const uint8_t* symbols, unsigned count) {
+	uint32_t bits = peek_bits(in);
+	unsigned low = 0, high = count;
+	while (high - low > 1) {
+		unsigned middle = (low + high) / 2;
+		if (starts[middle] <= bits) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+	in->position += lengths[low];
+	return symbols[low];
+}
+
+/* Frames */
+
+static bool parse_header(const uint8_t* p, FrameHeader* header) {
+	if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+		return false;
+	}
+	unsigned version = (p[1] >> 3) & 3;
+	unsigned layer = (p[1] >> 1) & 3;
+	unsigned bitrate = p[2] >> 4;
+	unsigned rate = (p[2] >> 2) & 3;
+	// Layer III only, free format bitrates aren't supported
+	if (version == 1 || layer != 1 || bitrate == 0 || bitrate == 15 || rate == 3 ||
+	        (p[3] & 3) == 2) {
+		return false;
+	}
+	header->version = version == 3 ? 0 : version == 2 ? 1 : 2;
+	header->rate_index = header->version * 3 + rate;
+	header->crc = !(p[1] & 1);
+	header->mode = p[3] >> 6;
+	header->mode_extension = (p[3] >> 4) & 3;
+	header->channels = header->mode == MODE_MONO ? 1 : 2;
+	header->size = (header->version == 0 ? 144 : 72) * bitrates[header->version != 0][bitrate] *
+	               1000 / sample_rates[header->rate_index] + ((p[2] >> 1) & 1);
+	return true;
+}
+
+static bool same_stream(const FrameHeader* a, const FrameHeader* b) {
+	return a->version == b->version && a->rate_index == b->rate_index &&
+	       a->channels == b->channels;
+}
+
+static unsigned side_info_size(const FrameHeader* header) {
+	if (header->version == 0) {
+		return header->channels == 1 ? 17 : 32;
+	}
+	return header->channels == 1 ? 9 : 17;
+}
+
+// Makes count bytes available at input_start, false at the end of the file
+static bool fill_input(Mp3Decoder* decoder, size_t count) {
+	size_t available = decoder->input_end - decoder->input_start;
+	if (available >= count) {
+		return true;
+	}
+	memmove(decoder->input, decoder->input + decoder->input_start, available);
+	decoder->input_start = 0;
+	decoder->input_end = available + fread(decoder->input + available, 1,
+	                                       INPUT_BUFFER_SIZE - available, decoder->file);
+	return decoder->input_end >= count;
+}
+
+// Reads the next frame of the stream into frame, skipping junk between frames
+static bool next_frame(Mp3Decoder* decoder, FrameHeader* header) {
+	for (;;) {
+		if (!fill_input(decoder, HEADER_SIZE)) {
+			return false;
+		}
+		const uint8_t* p = decoder->input + decoder->input_start;
+		if (parse_header(p, header) && same_stream(header, &decoder->first)) {
+			if (!fill_input(decoder, header->size)) {
+				return false;
+			}
+			memcpy(decoder->frame, decoder->input + decoder->input_start, header->size);
+			decoder->input_start += header->size;
+			return true;
+		}
+		decoder->input_start++;
+	}
+}
+
+/* Side information and scalefactors */
+
+static void read_granule_info(BitInput* in, Granule* granule, bool lsf) {
+	granule->part2_3_length = read_bits(in, 12);
+	granule->big_values = read_bits(in, 9);
+	if (granule->big_values > GRANULE_SIZE / 2) {
+		granule->big_values = GRANULE_SIZE / 2;
+	}
+	granule->global_gain = read_bits(in, 8);
+	granule->scalefac_compress = read_bits(in, lsf ? 9 : 4);
+	granule->window_switching = read_bits(in, 1);
+	if (granule->window_switching) {
+		granule->block_type = read_bits(in, 2);
+		granule->mixed = read_bits(in, 1);
+		granule->table_select[0] = read_bits(in, 5);
+		granule->table_select[1] = read_bits(in, 5);
+		granule->table_select[2] = 0;
+		for (int w = 0; w < 3; w++) {
+			granule->subblock_gain[w] = read_bits(in, 3);
+		}
+	} else {
+		granule->block_type = 0;
+		granule->mixed = false;
+		for (int i = 0; i < 3; i++) {
+			granule->table_select[i] = read_bits(in, 5);
+		}
+		granule->region0_count = read_bits(in, 4);
+		granule->region1_count = read_bits(in, 3);
+	}
+	granule->preflag = lsf ? false : read_bits(in, 1);
+	granule->scalefac_scale = read_bits(in, 1);
+	granule->count1_table = read_bits(in, 1);
+}
+
+// Long bands before the short ones, all of them without short blocks
+static unsigned long_end(const Granule* granule, unsigned rate_index) {
+	if (granule->block_type != BLOCK_SHORT) {
+		return 22;
+	}
+	return granule->mixed ? (rate_index <= 2 ? 8 : 6) : 0;
+}
+
+static unsigned short_start(const Granule* granule) {
+	if (granule->block_type != BLOCK_SHORT) {
+		return 13;
+	}
+	return granule->mixed ? 3 : 0;
+}
+
+static void read_scalefactors(BitInput* in, Granule* granule, const Granule* first,
+                              unsigned scfsi) {
+	unsigned slen1 = slen_table[granule->scalefac_compress][0];
+	unsigned slen2 = slen_table[granule->scalefac_compress][1];
+	memset(granule->is_illegal_long, 7, sizeof(granule->is_illegal_long));
+	memset(granule->is_illegal_short, 7, sizeof(granule->is_illegal_short));
+
+	if (granule->block_type == BLOCK_SHORT) {
+		unsigned sfb = 0;
+		if (granule->mixed) {
+			for (; sfb < 8; sfb++) {
+				granule->scalefac_long[sfb] = (uint8_t)read_bits(in, (int)slen1);
+			}
+			sfb = 3;
+		}
+		for (; sfb < 12; sfb++) {
+			for (int w = 0; w < 3; w++) {
+				granule->scalefac_short[sfb][w] = (uint8_t)read_bits(in, (int)(sfb < 6 ? slen1 : slen2));
+			}
+		}
+		memset(granule->scalefac_short[12], 0, 3);
+		return;
+	}
+
+	// Each of the four groups may be shared with the first granule
+	static const uint8_t groups[5] = {0, 6, 11, 16, 21};
+	for (int g = 0; g < 4; g++) {
+		for (unsigned sfb = groups[g]; sfb < groups[g + 1]; sfb++) {
+			granule->scalefac_long[sfb] = first && (scfsi & (8u >> g)) ? first->scalefac_long[sfb] :
+			                              (uint8_t)read_bits(in, (int)(g < 2 ? slen1 : slen2));
+		}
+	}
+	granule->scalefac_long[21] = 0;
+}
+
+static void read_lsf_scalefactors(BitInput* in, Granule* granule, bool intensity_right) {
+	unsigned compress = granule->scalefac_compress;
+	unsigned slen[4] = {0};
+	unsigned table;
+	if (!intensity_right) {
+		if (compress < 400) {
+			slen[0] = (compress >> 4) / 5;
+			slen[1] = (compress >> 4) % 5;
+			slen[2] = (compress & 15) >> 2;
+			slen[3] = compress & 3;
+			table = 0;
+		} else if (compress < 500) {
+			compress -= 400;
+			slen[0] = (compress >> 2) / 5;
+			slen[1] = (compress >> 2) % 5;
+			slen[2] = compress & 3;
+			table = 1;
+		} else {
+			compress -= 500;
+			slen[0] = compress / 3;
+			slen[1] = compress % 3;
+			granule->preflag = true;
+			table = 2;
+		}
+	} else {
+		compress >>= 1;
+		if (compress < 180) {
+			slen[0] = compress / 36;
+			slen[1] = (compress % 36) / 6;
+			slen[2] = compress % 6;
+			table = 3;
+		} else if (compress < 244) {
+			compress -= 180;
+			slen[0] = (compress & 63) >> 4;
+			slen[1] = (compress & 15) >> 2;
+			slen[2] = compress & 3;
+			table = 4;
+		} else {
+			compress -= 244;
+			slen[0] = compress / 3;
+			slen[1] = compress % 3;
+			table = 5;
+		}
+	}
+
+	unsigned blocks = granule->block_type != BLOCK_SHORT ? 0 : granule->mixed ? 2 : 1;
+	uint8_t factors[39] = {0};
+	uint8_t illegal[39] = {0};
+	unsigned count = 0;
+	for (int g = 0; g < 4; g++) {
+		for (unsigned i = 0; i < lsf_groups[table][blocks][g]; i++) {
+			factors[count] = (uint8_t)read_bits(in, (int)slen[g]);
+			illegal[count++] = (uint8_t)((1u << slen[g]) - 1);
+		}
+	}
+
+	memset(granule->scalefac_long, 0, sizeof(granule->scalefac_long));
+	memset(granule->scalefac_short, 0, sizeof(granule->scalefac_short));
+	if (blocks == 0) {
+		for (unsigned sfb = 0; sfb < 21; sfb++) {
+			granule->scalefac_long[sfb] = factors[sfb];
+			granule->is_illegal_long[sfb] = illegal[sfb];
+		}
+		granule->is_illegal_long[21] = illegal[20];
+		return;
+	}
+	unsigned first = 0, sfb = 0;
+	if (blocks == 2) {
+		for (; first < 6; first++) {
+			granule->scalefac_long[first] = factors[first];
+			granule->is_illegal_long[first] = illegal[first];
+		}
+		sfb = 3;
+	}
+	for (unsigned i = first; i < count; i++) {
+		unsigned band = sfb + (i - first) / 3;
+		granule->scalefac_short[band][(i - first) % 3] = factors[i];
+		granule->is_illegal_short[band] = illegal[i];
+	}
+	granule->is_illegal_short[12] = granule->is_illegal_short[11];
+}
+
+/* Spectrum */
+
+static int read_value(BitInput* in, int value, unsigned extra_bits) {
+	if (extra_bits && value == 15) {
+		value += (int)read_bits(in, (int)extra_bits);
+	}
+	if (value && read_bits(in, 1)) {
+		value = -value;
+	}
+	return value;
+}
+
+// Quantized lines up to the end of the granule's bits
+static void read_huffman(Mp3Decoder* decoder, BitInput* in, const Granule* granule,
+                         unsigned rate_index, size_t end) {
+	int* values = decoder->values;
+	memset(values, 0, sizeof(decoder->values));
+
+	unsigned region1, region2;
+	if (granule->window_switching) {
+		// Three short bands or eight long ones, twice as wide at 8 kHz
+		if (granule->block_type == BLOCK_SHORT && !granule->mixed) {
+			region1 = rate_index != 8 ? 36 : 72;
+		} else {
+			region1 = rate_index <= 2 ? 36 : rate_index != 8 ? 54 : 108;
+		}
+		region2 = GRANULE_SIZE;
+	} else {
+		unsigned bands[23] = {0};
+		for (int i = 0; i < 22; i++) {
+			bands[i + 1] = bands[i] + long_bands[rate_index][i];
+		}
+		unsigned first = granule->region0_count + 1;
+		unsigned second = first + granule->region1_count + 1;
+		region1 = bands[first > 22 ? 22 : first];
+		region2 = bands[second > 22 ? 22 : second];
+	}
+
+	unsigned count = granule->big_values * 2;
+	unsigned i = 0;
+	for (; i < count; i += 2) {
+		unsigned select = granule->table_select[i < region1 ? 0 : i < region2 ? 1 : 2];
+		int table = huffman_tables[select];
+		if (table < 0) {
+			continue;
+		}
+		unsigned offset = 0;
+		for (int t = 0; t < table; t++) {
+			offset += huffman_sizes[t];
+		}
+		unsigned pair = decode_symbol(in, decoder->huffman_starts + offset, huffman_lengths + offset,
+		                              huffman_symbols + offset, huffman_sizes[table]);
+		values[i] = read_value(in, (int)(pair >> 4), linbits[select]);
+		values[i + 1] = read_value(in, (int)(pair & 15), linbits[select]);
+	}
+
+	// Quadruples of -1, 0 or 1 until the bits run out, one running past them is dropped
+	while (i + 4 <= GRANULE_SIZE && in->position < end) {
+		unsigned quad = granule->count1_table ? 15 - read_bits(in, 4) :
+		                decode_symbol(in, decoder->quad_starts, quad_lengths, quad_symbols, 16);
+		int quadruple[4];
+		for (int j = 0; j < 4; j++) {
+			quadruple[j] = read_value(in, (quad >> (3 - j)) & 1, 0);
+		}
+		if (in->position > end) {
+			break;
+		}
+		memcpy(values + i, quadruple, sizeof(quadruple));
+		i += 4;
+	}
+}
+
+static void dequantize(Mp3Decoder* decoder, const Granule* granule, unsigned rate_index,
+                       float* lines) {
+	const int* values = decoder->values;
+	float multiplier = granule->scalefac_scale ? 1.0f : 0.5f;
+	float gain = ((float)granule->global_gain - 210) * 0.25f;
+	unsigned position = 0;
+
+	unsigned bands = long_end(granule, rate_index);
+	for (unsigned sfb = 0; sfb < bands; sfb++) {
+		unsigned factor = granule->scalefac_long[sfb] + (granule->preflag ? pretab[sfb] : 0);
+		float scale = exp2f(gain - multiplier * (float)factor);
+		for (unsigned i = 0; i < long_bands[rate_index][sfb]; i++, position++) {
+			int value = values[position];
+			float magnitude = decoder->pow43[value < 0 ? -value : value];
+			lines[position] = (value < 0 ? -magnitude : magnitude) * scale;
+		}
+	}
+	for (unsigned sfb = short_start(granule); sfb < 13; sfb++) {
+		for (int w = 0; w < 3; w++) {
+			float scale = exp2f(gain - 2.0f * (float)granule->subblock_gain[w] -
+			                    multiplier * (float)granule->scalefac_short[sfb][w]);
+			for (unsigned i = 0; i < short_bands[rate_index][sfb]; i++, position++) {
+				int value = values[position];
+				float magnitude = decoder->pow43[value < 0 ? -value : value];
+				lines[position] = (value < 0 ? -magnitude : magnitude) * scale;
+			}
+		}
+	}
+}
+
+/* Stereo */
+
+static bool silent(const float* lines, unsigned count) {
+	for (unsigned i = 0; i < count; i++) {
+		if (lines[i] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Rebuilds both channels of a band from the left one, false for an illegal position
+static bool intensity_band(float* left, float* right, unsigned count, unsigned position,
+                           unsigned illegal, const FrameHeader* header, const Granule* granule,
+                           uint8_t* done) {
+	if (position == illegal) {
+		return false;
+	}
+	float left_gain, right_gain;
+	if (header->version == 0) {
+		if (position >= 6) {
+			left_gain = 1;
+			right_gain = 0;
+		} else {
+			float ratio = (float)tan(position * M_PI / 12);
+			left_gain = ratio / (1 + ratio);
+			right_gain = 1 / (1 + ratio);
+		}
+	} else {
+		// Powers of 2^-1/4, or of 2^-1/2 with intensity_scale
+		float step = granule->scalefac_compress & 1 ? 0.70710678f : 0.84089642f;
+		left_gain = right_gain = 1;
+		if (position & 1) {
+			left_gain = powf(step, (float)(position + 1) / 2);
+		} else {
+			right_gain = powf(step, (float)position / 2);
+		}
+	}
+	for (unsigned i = 0; i < count; i++) {
+		float value = left[i];
+		left[i] = value * left_gain;
+		right[i] = value * right_gain;
+		done[i] = 1;
+	}
+	return true;
+}
+
+// Bands above the highest one the right channel has lines in are coded as intensity
+static void intensity_stereo(const FrameHeader* header, const Granule* granule, float* left,
+                             float* right, uint8_t* done) {
+	unsigned rate = header->rate_index;
+	unsigned bands = long_end(granule, rate);
+	unsigned long_size = 0;
+	for (unsigned sfb = 0; sfb < bands; sfb++) {
+		long_size += long_bands[rate][sfb];
+	}
+
+	bool reached = false;
+	if (granule->block_type == BLOCK_SHORT) {
+		unsigned starts[13];
+		unsigned start = long_size;
+		for (unsigned sfb = short_start(granule); sfb < 13; sfb++) {
+			starts[sfb] = start;
+			start += short_bands[rate][sfb] * 3;
+		}
+		for (int w = 0; w < 3; w++) {
+			for (int sfb = 12; sfb >= (int)short_start(granule); sfb--) {
+				unsigned width = short_bands[rate][sfb];
+				unsigned offset = starts[sfb] + (unsigned)w * width;
+				if (!silent(right + offset, width)) {
+					reached = true;
+					break;
+				}
+				unsigned source = sfb == 12 ? 11 : (unsigned)sfb;
+				intensity_band(left + offset, right + offset, width,
+				               granule->scalefac_short[source][w], granule->is_illegal_short[source],
+				               header, granule, done + offset);
+			}
+		}
+		if (reached) {
+			return;
+		}
+	}
+
+	unsigned end = long_size;
+	for (int sfb = (int)bands - 1; sfb >= 0; sfb--) {
+		unsigned width = long_bands[rate][sfb];
+		end -= width;
+		if (!silent(right + end, width)) {
+			return;
+		}
+		unsigned source = sfb == 21 ? 20 : (unsigned)sfb;
+		intensity_band(left + end, right + end, width, granule->scalefac_long[source],
+		               granule->is_illegal_long[source], header, granule, done + end);
+	}
+}
+
+static void process_stereo(const FrameHeader* header, const Granule* right_granule,
+                           float* left, float* right) {
+	if (header->mode != MODE_JOINT_STEREO) {
+		return;
+	}
+	uint8_t done[GRANULE_SIZE] = {0};
+	if (header->mode_extension & 1) {
+		intensity_stereo(header, right_granule, left, right, done);
+	}
+	if (header->mode_extension & 2) {
+		for (unsigned i = 0; i < GRANULE_SIZE; i++) {
+			if (!done[i]) {
+				float mid = left[i], side = right[i];
+				left[i] = (mid + side) * 0.70710678f;
+				right[i] = (mid - side) * 0.70710678f;
+			}
+		}
+	}
+}
+
+/* Hybrid filterbank */
+
+// Short bands are stored window by window, the transform wants their lines interleaved
+static void reorder(const Granule* granule, unsigned rate_index, float* lines) {
+	if (granule->block_type != BLOCK_SHORT) {
+		return;
+	}
+	unsigned position = 0;
+	for (unsigned sfb = 0; sfb < long_end(granule, rate_index); sfb++) {
+		position += long_bands[rate_index][sfb];
+	}
+	float band[3 * 192];
+	for (unsigned sfb = short_start(granule); sfb < 13; sfb++) {
+		unsigned width = short_bands[rate_index][sfb];
+		for (unsigned w = 0; w < 3; w++) {
+			for (unsigned i = 0; i < width; i++) {
+				band[i * 3 + w] = lines[position + w * width + i];
+			}
+		}
+		memcpy(lines + position, band, width * 3 * sizeof(float));
+		position += width * 3;
+	}
+}
+
+static void reduce_aliasing(const Mp3Decoder* decoder, const Granule* granule, float* lines) {
+	unsigned limit = granule->block_type != BLOCK_SHORT ? SUBBANDS : granule->mixed ? 2 : 0;
+	for (unsigned sb = 1; sb < limit; sb++) {
+		float* upper = lines + sb * SUBBAND_SIZE;
+		for (int i = 0; i < 8; i++) {
+			float a = upper[-1 - i], b = upper[i];
+			upper[-1 - i] = a * decoder->alias_cs[i] - b * decoder->alias_ca[i];
+			upper[i] = b * decoder->alias_cs[i] + a * decoder->alias_ca[i];
+		}
+	}
+}
+
+// One granule of a channel through the inverse MDCTs into 18 rows of 32 subband samples
+static void inverse_mdct(Mp3Decoder* decoder, const Granule* granule, unsigned channel,
+                         float samples[SUBBAND_SIZE][SUBBANDS]) {
+	const float* lines = decoder->lines[channel];
+	float* overlap = decoder->overlap[channel];
+	for (unsigned sb = 0; sb < SUBBANDS; sb++) {
+		const float* in = lines + sb * SUBBAND_SIZE;
+		float* saved = overlap + sb * SUBBAND_SIZE;
+		float out[36] = {0};
+		unsigned type = granule->block_type;
+		if (type == BLOCK_SHORT && granule->mixed && sb < 2) {
+			type = 0;
+		}
+
+		if (!silent(in, SUBBAND_SIZE)) {
+			if (type != BLOCK_SHORT) {
+				for (int k = 0; k < SUBBAND_SIZE; k++) {
+					for (int i = 0; i < 36; i++) {
+						out[i] += in[k] * decoder->imdct_long[k][i];
+					}
+				}
+				for (int i = 0; i < 36; i++) {
+					out[i] *= decoder->windows[type][i];
+				}
+			} else {
+				for (int w = 0; w < 3; w++) {
+					float window[12] = {0};
+					for (int k = 0; k < 6; k++) {
+						for (int i = 0; i < 12; i++) {
+							window[i] += in[k * 3 + w] * decoder->imdct_short[k][i];
+						}
+					}
+					for (int i = 0; i < 12; i++) {
+						out[6 + w * 6 + i] += window[i] * decoder->windows[BLOCK_SHORT][i];
+					}
+				}
+			}
+		}
+
+		for (int i = 0; i < SUBBAND_SIZE; i++) {
+			float sample = out[i] + saved[i];
+			// Odd subbands come out frequency inverted
+			samples[i][sb] = (sb & i & 1) ? -sample : sample;
+			saved[i] = out[i + SUBBAND_SIZE];
+		}
+	}
+}
+
+// 32 subband samples into 32 PCM samples, written every stride floats
+static void synthesize(Mp3Decoder* decoder, unsigned channel, const float* subbands, float* pcm,
+                       unsigned stride) {
+	float* v = decoder->v[channel];
+	unsigned offset = decoder->v_offset[channel] = (decoder->v_offset[channel] - 64) & 1023;
+
+	float rows[SUBBANDS] = {0};
+	for (int k = 0; k < SUBBANDS; k++) {
+		for (int i = 0; i < SUBBANDS; i++) {
+			rows[i] += decoder->synthesis[k][i] * subbands[k];
+		}
+	}
+	// Half the 64 matrix rows are the others mirrored
+	for (int i = 0; i < 16; i++) {
+		v[offset + i] = rows[i];
+		v[offset + 32 - i] = -rows[i];
+		v[offset + 33 + i] = rows[16 + i];
+		v[offset + 63 - i] = rows[16 + i];
+	}
+	v[offset + 16] = 0;
+	v[offset + 48] = rows[31];
+
+	// Each 32 value run stays inside the ring since offset steps by 64
+	const float* window = decoder->synthesis_window;
+	float sums[SUBBANDS] = {0};
+	for (int i = 0; i < 8; i++) {
+		const float* first = v + ((offset + i * 128) & 1023);
+		const float* second = v + ((offset + i * 128 + 96) & 1023);
+		for (int j = 0; j < SUBBANDS; j++) {
+			sums[j] += first[j] * window[i * 64 + j] + second[j] * window[i * 64 + 32 + j];
+		}
+	}
+	for (int j = 0; j < SUBBANDS; j++) {
+		pcm[j * stride] = sums[j];
+	}
+}
+
+static bool decode_frame(Mp3Decoder* decoder) {
+	FrameHeader header;
+	if (!next_frame(decoder, &header)) {
+		return false;
+	}
+	unsigned channels = header.channels;
+	bool lsf = header.version != 0;
+	unsigned granules = lsf ? 1 : 2;
+	unsigned main_offset = HEADER_SIZE + (header.crc ? 2 : 0) + side_info_size(&header);
+	if (main_offset > header.size) {
+		return false;
+	}
+
+	BitInput side = {decoder->frame + HEADER_SIZE + (header.crc ? 2 : 0), 0};
+	unsigned main_data_begin = read_bits(&side, lsf ? 8 : 9);
+	read_bits(&side, lsf ? (int)channels : channels == 1 ? 5 : 3); // Private bits
+	unsigned scfsi[2] = {0};
+	if (!lsf) {
+		for (unsigned c = 0; c < channels; c++) {
+			scfsi[c] = read_bits(&side, 4);
+		}
+	}
+	Granule granule[MAX_GRANULES][2];
+	for (unsigned g = 0; g < granules; g++) {
+		for (unsigned c = 0; c < channels; c++) {
+			read_granule_info(&side, &granule[g][c], lsf);
+		}
+	}
+
+	// Main data starts in earlier frames, none is there after a cut
+	bool complete = main_data_begin <= decoder->reservoir_size;
+	size_t start = complete ? decoder->reservoir_size - main_data_begin : 0;
+	size_t main_size = header.size - main_offset;
+	memcpy(decoder->reservoir + decoder->reservoir_size, decoder->frame + main_offset, main_size);
+	decoder->reservoir_size += main_size;
+	memset(decoder->reservoir + decoder->reservoir_size, 0, 8);
+	BitInput in = {decoder->reservoir, start * 8};
+
+	bool intensity = header.mode == MODE_JOINT_STEREO && (header.mode_extension & 1);
+	for (unsigned g = 0; g < granules; g++) {
+		for (unsigned c = 0; c < channels; c++) {
+			Granule* current = &granule[g][c];
+			size_t end = in.position + current->part2_3_length;
+			if (!complete || end > decoder->reservoir_size * 8) {
+				memset(decoder->lines[c], 0, sizeof(decoder->lines[c]));
+				continue;
+			}
+			if (lsf) {
+				read_lsf_scalefactors(&in, current, intensity && c == 1);
+			} else {
+				read_scalefactors(&in, current, g == 1 ? &granule[0][c] : NULL, g == 1 ? scfsi[c] : 0);
+			}
+			read_huffman(decoder, &in, current, header.rate_index, end);
+			dequantize(decoder, current, header.rate_index, decoder->lines[c]);
+			in.position = end;
+		}
+
+		if (channels == 2) {
+			process_stereo(&header, &granule[g][1], decoder->lines[0], decoder->lines[1]);
+		}
+		for (unsigned c = 0; c < channels; c++) {
+			float samples[SUBBAND_SIZE][SUBBANDS];
+			reorder(&granule[g][c], header.rate_index, decoder->lines[c]);
+			reduce_aliasing(decoder, &granule[g][c], decoder->lines[c]);
+			inverse_mdct(decoder, &granule[g][c], c, samples);
+			float* pcm = decoder->output + g * GRANULE_SIZE * channels + c;
+			for (int t = 0; t < SUBBAND_SIZE; t++) {
+				synthesize(decoder, c, samples[t], pcm + t * SUBBANDS * channels, channels);
+			}
+		}
+	}
+
+	// Only the last 511 bytes can be referred back to
+	if (decoder->reservoir_size > MAX_RESERVOIR) {
+		memmove(decoder->reservoir, decoder->reservoir + decoder->reservoir_size - MAX_RESERVOIR,
+		        MAX_RESERVOIR);
+		decoder->reservoir_size = MAX_RESERVOIR;
+	}
+	decoder->output_size = granules * GRANULE_SIZE;
+	decoder->output_position = 0;
+	return true;
+}
+
+static size_t mp3_read(AudioDecoder* base, float* samples, size_t count) {
+	Mp3Decoder* decoder = (Mp3Decoder*)base;
+	unsigned channels = base->channels;
+	if (count > decoder->frames_left) {
+		count = (size_t)decoder->frames_left;
+	}
+	size_t done = 0;
+
+	while (done < count) {
+		if (decoder->output_position == decoder->output_size) {
+			if (decoder->failed || !decode_frame(decoder)) {
+				decoder->failed = true;
+				break;
+			}
+			continue;
+		}
+		size_t frames = decoder->output_size - decoder->output_position;
+		if (decoder->skip > 0) {
+			if (frames > decoder->skip) {
+				frames = (size_t)decoder->skip;
+			}
+			decoder->skip -= frames;
+			decoder->output_position += (unsigned)frames;
+			continue;
+		}
+		if (frames > count - done) {
+			frames = count - done;
+		}
+		memcpy(samples + done * channels, decoder->output + decoder->output_position * channels,
+		       frames * channels * sizeof(float));
+		decoder->output_position += (unsigned)frames;
+		done += frames;
+	}
+	decoder->frames_left -= done;
+	return done;
+}
+
+static void mp3_close(AudioDecoder* base) {
+	Mp3Decoder* decoder = (Mp3Decoder*)base;
+	free(decoder->input);
+	free(decoder);
+}
+
+/* Setup */
+
+static void init_tables(Mp3Decoder* decoder) {
+	unsigned offset = 0;
+	for (int t = 0; t < HUFFMAN_TABLES; t++) {
+		uint64_t code = 0;
+		for (unsigned i = 0; i < huffman_sizes[t]; i++) {
+			decoder->huffman_starts[offset + i] = (uint32_t)code;
+			code += 1ull << (32 - huffman_lengths[offset + i]);
+		}
+		offset += huffman_sizes[t];
+	}
+	uint64_t code = 0;
+	for (int i = 0; i < 16; i++) {
+		decoder->quad_starts[i] = (uint32_t)code;
+		code += 1ull << (32 - quad_lengths[i]);
+	}
+
+	for (int i = 0; i < MAX_VALUE; i++) {
+		decoder->pow43[i] = (float)pow(i, 4.0 / 3.0);
+	}
+	for (int k = 0; k < 18; k++) {
+		for (int i = 0; i < 36; i++) {
+			decoder->imdct_long[k][i] = (float)cos(M_PI / 72 * (2 * i + 1 + 18) * (2 * k + 1));
+		}
+	}
+	for (int k = 0; k < 6; k++) {
+		for (int i = 0; i < 12; i++) {
+			decoder->imdct_short[k][i] = (float)cos(M_PI / 24 * (2 * i + 1 + 6) * (2 * k + 1));
+		}
+	}
+	for (int i = 0; i < 8; i++) {
+		float c = alias_coefficients[i];
+		decoder->alias_cs[i] = 1 / sqrtf(1 + c * c);
+		decoder->alias_ca[i] = c * decoder->alias_cs[i];
+	}
+
+	// Normal, start, short and stop windows
+	for (int i = 0; i < 36; i++) {
+		float normal = (float)sin(M_PI / 36 * (i + 0.5));
+		decoder->windows[0][i] = normal;
+		decoder->windows[1][i] = i < 18 ? normal : i < 24 ? 1 : i < 30 ?
+		                         (float)sin(M_PI / 12 * (i - 18 + 0.5)) : 0;
+		decoder->windows[3][i] = i < 6 ? 0 : i < 12 ? (float)sin(M_PI / 12 * (i - 6 + 0.5)) :
+		                         i < 18 ? 1 : normal;
+		decoder->windows[2][i] = i < 12 ? (float)sin(M_PI / 12 * (i + 0.5)) : 0;
+	}
+
+	for (int k = 0; k < SUBBANDS; k++) {
+		for (int i = 0; i < SUBBANDS; i++) {
+			int row = i < 16 ? i : i + 17;
+			decoder->synthesis[k][i] = (float)cos((16 + row) * (2 * k + 1) * M_PI / 64);
+		}
+	}
+	for (int i = 0; i < 257; i++) {
+		float value = (float)window_half[i] / 65536;
+		decoder->synthesis_window[i] = value;
+		if (i > 0 && i < 256) {
+			decoder->synthesis_window[512 - i] = i % 64 ? -value : value;
+		}
+	}
+}
+
+// Finds the first frame, one followed by another so junk isn't taken for it
+static bool find_first_frame(Mp3Decoder* decoder) {
+	for (size_t skipped = 0; skipped < SYNC_SEARCH_SIZE; skipped++) {
+		if (!fill_input(decoder, HEADER_SIZE)) {
+			return false;
+		}
+		FrameHeader header, next;
+		const uint8_t* p = decoder->input + decoder->input_start;
+		if (parse_header(p, &header)) {
+			bool last = !fill_input(decoder, header.size + HEADER_SIZE);
+			p = decoder->input + decoder->input_start;
+			if (last || (parse_header(p + header.size, &next) && same_stream(&header, &next))) {
+				decoder->first = header;
+				return true;
+			}
+		}
+		decoder->input_start++;
+	}
+	return false;
+}
+
+// Frame count and encoder padding from a Xing/Info or VBRI frame, which holds no audio
+static bool read_info_frame(Mp3Decoder* decoder, uint64_t* frames, unsigned* delay,
+                            unsigned* padding) {
+	const FrameHeader* header = &decoder->first;
+	if (!fill_input(decoder, header->size)) {
+		return false;
+	}
+	const uint8_t* frame = decoder->input + decoder->input_start;
+	const uint8_t* end = frame + header->size;
+	const uint8_t* xing = frame + HEADER_SIZE + (header->crc ? 2 : 0) + side_info_size(header);
+	const uint8_t* vbri = frame + HEADER_SIZE + 32;
+
+	if (xing + 8 <= end && (memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0)) {
+		uint32_t flags = read_be32(xing + 4);
+		const uint8_t* p = xing + 8;
+		bool has_frames = flags & 1;
+		if (has_frames && p + 4 <= end) {
+			*frames = read_be32(p);
+		}
+		p += (flags & 1 ? 4 : 0) + (flags & 2 ? 4 : 0) + (flags & 4 ? 100 : 0) + (flags & 8 ? 4 : 0);
+		// The encoder tag, LAME's or FFmpeg's, carries the delay and padding
+		if (p + 24 <= end && (memcmp(p, "LAME", 4) == 0 || memcmp(p, "Lavf", 4) == 0 ||
+		                      memcmp(p, "Lavc", 4) == 0)) {
+			uint32_t gaps = (uint32_t)p[21] << 16 | (uint32_t)p[22] << 8 | p[23];
+			*delay = gaps >> 12;
+			*padding = gaps & 0xFFF;
+		}
+		decoder->input_start += header->size;
+		return has_frames;
+	}
+	if (vbri + 18 <= end && memcmp(vbri, "VBRI", 4) == 0) {
+		*frames = read_be32(vbri + 14);
+		decoder->input_start += header->size;
+		return true;
+	}
+	return false;
+}
+
+// Counts the frames of a file without an info frame, then goes back to the first one
+static bool count_frames(Mp3Decoder* decoder, uint64_t* frames) {
+	int64_t origin = tell_file(decoder->file) - (int64_t)(decoder->input_end - decoder->input_start);
+	if (origin < 0) {
+		return false;
+	}
+	FrameHeader header;
+	*frames = 0;
+	while (next_frame(decoder, &header)) {
+		(*frames)++;
+	}
+	decoder->input_start = decoder->input_end = 0;
+	return seek_file(decoder->file, origin, SEEK_SET) == 0;
+}
+
+AudioDecoder* mp3_decoder_open(FILE* file) {
+	Mp3Decoder* decoder = calloc(1, sizeof(Mp3Decoder));
+	if (!decoder) {
+		return NULL;
+	}
+	decoder->base.read = mp3_read;
+	decoder->base.close = mp3_close;
+	decoder->file = file;
+	decoder->input = malloc(INPUT_BUFFER_SIZE);
+	if (!decoder->input || !find_first_frame(decoder)) {
+		mp3_close(&decoder->base);
+		return NULL;
+	}
+
+	uint64_t frames = 0;
+	unsigned delay = 0, padding = 0;
+	if (!read_info_frame(decoder, &frames, &delay, &padding) && !count_frames(decoder, &frames)) {
+		mp3_close(&decoder->base);
+		return NULL;
+	}
+	unsigned frame_size = decoder->first.version == 0 ? 1152 : 576;
+	uint64_t samples = frames * frame_size;
+	if (delay || padding) {
+		decoder->skip = delay + DECODER_DELAY;
+		samples = samples > (uint64_t)delay + padding ? samples - delay - padding : 0;
+	}
+	if (samples == 0) {
+		mp3_close(&decoder->base);
+		return NULL;
+	}
+
+	decoder->base.channels = decoder->first.channels;
+	decoder->base.sample_rate = sample_rates[decoder->first.rate_index];
+	decoder->base.frame_count = samples;
+	decoder->frames_left = samples;
+	init_tables(decoder);
+	return &decoder->base;
+}
@@ -0,0 +1,200 @@
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // copy_file_range, fallocate
+#endif
+#include "range_writer.h"
+#include <string.h>
+
+#define COPY_CHUNK (64 * 1024)
+
+// Source of every zero fill, shared and never written
+static const uint8_t zero_page[COPY_CHUNK];
+
+#ifdef _WIN32
+#include <windows.h>
+
+int range_writer_open(const char* path, RangeWriter* writer) {
+	writer->handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+	                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (writer->handle == INVALID_HANDLE_VALUE) {
+		writer->handle = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+int range_writer_close(RangeWriter* writer) {
+	if (!writer->handle) {
+		return 0;
+	}
+	BOOL closed = CloseHandle(writer->handle);
+	writer->handle = NULL;
+	return closed ? 0 : -1;
+}
+
+static int write_at(HANDLE handle, uint64_t offset, const uint8_t* data,
+                    DWORD size) {
+	while (size > 0) {
+		OVERLAPPED position = {0};
+		position.Offset = (DWORD)offset;
+		position.OffsetHigh = (DWORD)(offset >> 32);
+
+		DWORD written = 0;
+		if (!WriteFile(handle, data, size, &written, &position) || written == 0) {
+			return -1;
+		}
+		offset += written;
+		data += written;
+		size -= written;
+	}
+	return 0;
+}
+
+int range_writer_copy_file(RangeWriter* writer, uint64_t offset,
+                           const char* source_path, uint64_t size) {
+	HANDLE source = CreateFileA(source_path, GENERIC_READ, FILE_SHARE_READ, NULL,
+	                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (source == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+
+	uint8_t buffer[COPY_CHUNK];
+	while (size > 0) {
+		DWORD chunk = (size > COPY_CHUNK) ? COPY_CHUNK : (DWORD)size;
+		DWORD bytes_read = 0;
+		if (!ReadFile(source, buffer, chunk, &bytes_read, NULL) || bytes_read == 0 ||
+		        write_at(writer->handle, offset, buffer, bytes_read) != 0) {
+			CloseHandle(source);
+			return -1;
+		}
+		offset += bytes_read;
+		size -= bytes_read;
+	}
+
+	CloseHandle(source);
+	return 0;
+}
+
+int range_writer_write(RangeWriter* writer, uint64_t offset, const uint8_t* data,
+                       uint64_t size) {
+	while (size > 0) {
+		DWORD chunk = (size > COPY_CHUNK) ? COPY_CHUNK : (DWORD)size;
+		if (write_at(writer->handle, offset, data, chunk) != 0) {
+			return -1;
+		}
+		offset += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+	return 0;
+}
+
+int range_writer_zero(RangeWriter* writer, uint64_t offset, uint64_t size) {
+	while (size > 0) {
+		DWORD chunk = (size > COPY_CHUNK) ? COPY_CHUNK : (DWORD)size;
+		if (write_at(writer->handle, offset, zero_page, chunk) != 0) {
+			return -1;
+		}
+		offset += chunk;
+		size -= chunk;
+	}
+	return 0;
+}
+
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+int range_writer_open(const char* path, RangeWriter* writer) {
+	writer->fd = open(path, O_RDWR);
+	return writer->fd < 0 ? -1 : 0;
+}
+
+int range_writer_close(RangeWriter* writer) {
+	if (writer->fd < 0) {
+		return 0;
+	}
+	int result = close(writer->fd);
+	writer->fd = -1;
+	return result == 0 ? 0 : -1;
+}
+
+static int write_at(int fd, uint64_t offset, const uint8_t* data, size_t size) {
+	while (size > 0) {
+		ssize_t written = pwrite(fd, data, size, (off_t)offset);
+		if (written <= 0) {
+			if (written < 0 && errno == EINTR) continue;
+			return -1;
+		}
+		offset += written;
+		data += written;
+		size -= written;
+	}
+	return 0;
+}
+
+int range_writer_copy_file(RangeWriter* writer, uint64_t offset,
+                           const char* source_path, uint64_t size) {
+	int source = open(source_path, O_RDONLY);
+	if (source < 0) {
+		return -1;
+	}
+
+#ifdef __linux__
+	// Kernel-side copy, falls through to the buffer for whatever it refused
+	off_t dest_offset = (off_t)offset;
+	while (size > 0) {
+		ssize_t copied = copy_file_range(source, NULL, writer->fd, &dest_offset,
+		                                 size, 0);
+		if (copied <= 0) {
+			if (copied < 0 && errno == EINTR) continue;
+			break;
+		}
+		size -= copied;
+	}
+	offset = (uint64_t)dest_offset;
+#endif
+
+	uint8_t buffer[COPY_CHUNK];
+	while (size > 0) {
+		size_t chunk = (size > COPY_CHUNK) ? COPY_CHUNK : (size_t)size;
+		ssize_t bytes_read = read(source, buffer, chunk);
+		if (bytes_read < 0 && errno == EINTR) continue;
+		if (bytes_read <= 0 || write_at(writer->fd, offset, buffer, bytes_read) != 0) {
+			close(source);
+			return -1;
+		}
+		offset += bytes_read;
+		size -= bytes_read;
+	}
+
+	close(source);
+	return 0;
+}
+
+int range_writer_write(RangeWriter* writer, uint64_t offset, const uint8_t* data,
+                       uint64_t size) {
+	return write_at(writer->fd, offset, data, (size_t)size);
+}
+
+int range_writer_zero(RangeWriter* writer, uint64_t offset, uint64_t size) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+	// Partial blocks at either end are zeroed by the kernel too
+	if (fallocate(writer->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+	              (off_t)offset, (off_t)size) == 0) {
+		return 0;
+	}
+#endif
+
+	while (size > 0) {
+		size_t chunk = (size > COPY_CHUNK) ? COPY_CHUNK : (size_t)size;
+		if (write_at(writer->fd, offset, zero_page, chunk) != 0) {
+			return -1;
+		}
+		offset += chunk;
+		size -= chunk;
+	}
+	return 0;
+}
+
+#endif
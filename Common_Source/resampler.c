@@ -0,0 +1,246 @@
+#include "resampler.h"
+#include "simd.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Zero crossings of the sinc on each side of the center
+#define ZERO_CROSSINGS 64
+// Cutoff as a fraction of the lower Nyquist frequency, the transition band
+// of the window sits between it and Nyquist
+#define ROLLOFF 0.95
+// About 90 dB of stopband attenuation
+#define KAISER_BETA 9.0
+// Phases kept in the table, finer ratios interpolate between neighbours
+#define MAX_PHASES 1024
+// Input frames buffered on top of one filter length
+#define BLOCK_FRAMES 4096
+
+struct Resampler {
+	unsigned channels;
+	// Ratio output/input reduced, up phases with down input frames per output frame
+	unsigned up;
+	unsigned down;
+	unsigned half;
+	// Filter length, a multiple of 8 with zero taps at the end
+	unsigned taps;
+	unsigned table_phases;
+	float* table;
+	float* scratch;
+	// One run of capacity frames per channel
+	float* history;
+	size_t capacity;
+	size_t filled;
+	// Input frame at the start of history, negative while the first frames
+	// still see the silence before the input
+	int64_t position;
+	// Input frame and phase the next output frame is centered on
+	int64_t index;
+	unsigned phase;
+	bool finished;
+	SimdDot dot;
+};
+
+/* Filter */
+
+static unsigned gcd(unsigned a, unsigned b) {
+	while (b != 0) {
+		unsigned rest = a % b;
+		a = b;
+		b = rest;
+	}
+	return a;
+}
+
+static double bessel_i0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 200 && term > sum * 1e-12; k++) {
+		double factor = x / (2.0 * k);
+		term *= factor * factor;
+		sum += term;
+	}
+	return sum;
+}
+
+// Taps for an output frame shift input frames past the center one,
+// normalized so each phase passes DC unchanged
+static void build_phase(const Resampler* resampler, double cutoff, double shift, float* coeffs) {
+	const double pi = 3.14159265358979323846;
+	double half = resampler->half;
+	double window_scale = 1.0 / bessel_i0(KAISER_BETA);
+	double sum = 0.0;
+
+	for (unsigned i = 0; i < resampler->taps; i++) {
+		double distance = (double)i - (half - 1.0) - shift;
+		double value = 0.0;
+		if (fabs(distance) < half) {
+			double x = cutoff * distance;
+			double sinc = x == 0.0 ? 1.0 : sin(pi * x) / (pi * x);
+			double ratio = distance / half;
+			double window = bessel_i0(KAISER_BETA * sqrt(1.0 - ratio * ratio)) * window_scale;
+			value = cutoff * sinc * window;
+		}
+		coeffs[i] = (float)value;
+		sum += coeffs[i];
+	}
+	for (unsigned i = 0; i < resampler->taps; i++) {
+		coeffs[i] = (float)(coeffs[i] / sum);
+	}
+}
+
+static const float* phase_coeffs(Resampler* resampler) {
+	if (resampler->table_phases == resampler->up) {
+		return resampler->table + (size_t)resampler->phase * resampler->taps;
+	}
+
+	// Linear between the two nearest rows, the table has one past the last
+	uint64_t scaled = (uint64_t)resampler->phase * resampler->table_phases;
+	unsigned row = (unsigned)(scaled / resampler->up);
+	float fraction = (float)(scaled % resampler->up) / (float)resampler->up;
+	const float* a = resampler->table + (size_t)row * resampler->taps;
+	const float* b = a + resampler->taps;
+	for (unsigned i = 0; i < resampler->taps; i++) {
+		resampler->scratch[i] = a[i] + (b[i] - a[i]) * fraction;
+	}
+	return resampler->scratch;
+}
+
+/* Streaming */
+
+Resampler* resampler_create(unsigned channels, unsigned input_rate, unsigned output_rate) {
+	if (channels == 0 || input_rate == 0 || output_rate == 0) {
+		return NULL;
+	}
+	Resampler* resampler = calloc(1, sizeof(Resampler));
+	if (!resampler) {
+		return NULL;
+	}
+
+	unsigned divisor = gcd(input_rate, output_rate);
+	resampler->channels = channels;
+	resampler->up = output_rate / divisor;
+	resampler->down = input_rate / divisor;
+
+	// Below the output's Nyquist when downsampling, the input's otherwise
+	double cutoff = ROLLOFF;
+	if (output_rate < input_rate) {
+		cutoff *= (double)output_rate / input_rate;
+	}
+	resampler->half = (unsigned)ceil(ZERO_CROSSINGS / cutoff);
+	resampler->taps = (2 * resampler->half + 7) & ~7u;
+
+	resampler->table_phases = resampler->up <= MAX_PHASES ? resampler->up : MAX_PHASES;
+	size_t rows = resampler->table_phases + (resampler->table_phases != resampler->up);
+	resampler->capacity = resampler->taps + BLOCK_FRAMES;
+	resampler->table = malloc(rows * resampler->taps * sizeof(float));
+	resampler->scratch = malloc(resampler->taps * sizeof(float));
+	resampler->history = calloc(resampler->capacity * channels, sizeof(float));
+	if (!resampler->table || !resampler->scratch || !resampler->history) {
+		resampler_free(resampler);
+		return NULL;
+	}
+	for (size_t row = 0; row < rows; row++) {
+		build_phase(resampler, cutoff, (double)row / resampler->table_phases,
+		            resampler->table + row * resampler->taps);
+	}
+
+	// The first output frame is centered on input frame 0 with silence before it
+	resampler->position = 1 - (int64_t)resampler->half;
+	resampler->filled = resampler->half - 1;
+
+	resampler->dot = simd_dot_kernel(simd_level());
+	return resampler;
+}
+
+void resampler_free(Resampler* resampler) {
+	if (resampler) {
+		free(resampler->table);
+		free(resampler->scratch);
+		free(resampler->history);
+		free(resampler);
+	}
+}
+
+uint64_t resampler_output_frames(uint64_t input_frames, unsigned input_rate,
+                                 unsigned output_rate) {
+	return (input_frames * output_rate + input_rate / 2) / input_rate;
+}
+
+// Drops the frames no output frame reaches back to anymore
+static void compact(Resampler* resampler) {
+	int64_t first = resampler->index - resampler->half + 1;
+	size_t drop = (size_t)(first - resampler->position);
+	if (drop == 0) {
+		return;
+	}
+	if (drop > resampler->filled) {
+		drop = resampler->filled;
+	}
+	size_t keep = resampler->filled - drop;
+	for (unsigned c = 0; c < resampler->channels; c++) {
+		float* run = resampler->history + c * resampler->capacity;
+		memmove(run, run + drop, keep * sizeof(float));
+	}
+	resampler->position += drop;
+	resampler->filled = keep;
+}
+
+size_t resampler_write(Resampler* resampler, const float* samples, size_t frames) {
+	if (resampler->capacity - resampler->filled < frames) {
+		compact(resampler);
+	}
+	size_t room = resampler->capacity - resampler->filled;
+	if (frames > room) {
+		frames = room;
+	}
+
+	unsigned channels = resampler->channels;
+	for (unsigned c = 0; c < channels; c++) {
+		float* run = resampler->history + c * resampler->capacity + resampler->filled;
+		for (size_t i = 0; i < frames; i++) {
+			run[i] = samples[i * channels + c];
+		}
+	}
+	resampler->filled += frames;
+	return frames;
+}
+
+void resampler_finish(Resampler* resampler) {
+	resampler->finished = true;
+}
+
+size_t resampler_read(Resampler* resampler, float* samples, size_t frames) {
+	unsigned channels = resampler->channels;
+	size_t produced = 0;
+
+	for (; produced < frames; produced++) {
+		size_t offset = (size_t)(resampler->index - resampler->half + 1 - resampler->position);
+		if (offset + resampler->taps > resampler->filled) {
+			if (!resampler->finished) {
+				break;
+			}
+			// Past the end of the input, the rest of the filter sees silence
+			compact(resampler);
+			offset = 0;
+			for (unsigned c = 0; c < channels; c++) {
+				float* run = resampler->history + c * resampler->capacity;
+				memset(run + resampler->filled, 0,
+				       (resampler->taps - resampler->filled) * sizeof(float));
+			}
+			resampler->filled = resampler->taps;
+		}
+
+		const float* coeffs = phase_coeffs(resampler);
+		for (unsigned c = 0; c < channels; c++) {
+			const float* run = resampler->history + c * resampler->capacity + offset;
+			samples[produced * channels + c] = resampler->dot(run, coeffs, resampler->taps);
+		}
+
+		resampler->phase += resampler->down;
+		resampler->index += resampler->phase / resampler->up;
+		resampler->phase %= resampler->up;
+	}
+	return produced;
+}
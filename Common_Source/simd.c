@@ -0,0 +1,113 @@
+#include "simd.h"
+#include <pthread.h>
+
+static SimdLevel detected_level = SIMD_SCALAR;
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+static void detect_level(void) {
+#ifdef HAVE_VECTOR4
+	detected_level = SIMD_VECTOR4;
+#endif
+#ifdef HAVE_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		detected_level = SIMD_AVX2;
+	}
+#endif
+}
+
+SimdLevel simd_level(void) {
+	pthread_once(&detect_once, detect_level);
+	return detected_level;
+}
+
+const char* simd_level_name(SimdLevel level) {
+	switch (level) {
+	case SIMD_SCALAR:
+		return "scalar";
+#ifdef HAVE_VECTOR4
+	case SIMD_VECTOR4:
+		return VECTOR4_NAME;
+#endif
+	case SIMD_AVX2:
+		return "avx2";
+	default:
+		return "none";
+	}
+}
+
+/* Dot products */
+
+static float reduce_lanes(const float lanes[8]) {
+	return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) +
+	       ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
+
+static float add_tail(float sum, const float* a, const float* b, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+static float dot_scalar(const float* a, const float* b, size_t count) {
+	float lanes[8] = {0};
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		for (unsigned j = 0; j < 8; j++) {
+			lanes[j] += a[i + j] * b[i + j];
+		}
+	}
+	return add_tail(reduce_lanes(lanes), a + i, b + i, count - i);
+}
+
+#ifdef HAVE_VECTOR4
+static float dot_vector4(const float* a, const float* b, size_t count) {
+	v4 low = v4_zero();
+	v4 high = v4_zero();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		low = v4_add(low, v4_mul(v4_load(a + i), v4_load(b + i)));
+		high = v4_add(high, v4_mul(v4_load(a + i + 4), v4_load(b + i + 4)));
+	}
+	float lanes[8];
+	v4_store(lanes, low);
+	v4_store(lanes + 4, high);
+	return add_tail(reduce_lanes(lanes), a + i, b + i, count - i);
+}
+#endif
+
+#ifdef HAVE_AVX2
+AVX2_FUNCTION static float dot_avx2(const float* a, const float* b, size_t count) {
+	__m256 sum = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+		                                       _mm256_loadu_ps(b + i)));
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, sum);
+	return add_tail(reduce_lanes(lanes), a + i, b + i, count - i);
+}
+#endif
+
+SimdDot simd_dot_kernel(SimdLevel level) {
+	switch (level) {
+	case SIMD_SCALAR:
+		return dot_scalar;
+#ifdef HAVE_VECTOR4
+	case SIMD_VECTOR4:
+		return dot_vector4;
+#endif
+#ifdef HAVE_AVX2
+	case SIMD_AVX2:
+		return dot_avx2;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+float simd_dot(const float* a, const float* b, size_t count) {
+	return simd_dot_kernel(simd_level())(a, b, count);
+}
@@ -0,0 +1,172 @@
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define MAX_WORKERS 64
+
+// Indices still owned by one worker, [next, end)
+typedef struct {
+	pthread_mutex_t lock;
+	int next;
+	int end;
+} WorkRange;
+
+typedef struct {
+	WorkRange ranges[MAX_WORKERS];
+	int worker_count;
+	ParallelTask task;
+	void* context;
+} ParallelJob;
+
+typedef struct {
+	ParallelJob* job;
+	int worker;
+} WorkerArgs;
+
+int thread_pool_default_workers(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long count = (long)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (count < 1) return 1;
+	if (count > MAX_WORKERS) return MAX_WORKERS;
+	return (int)count;
+}
+
+static bool take_own(WorkRange* range, int* index) {
+	bool found = false;
+	pthread_mutex_lock(&range->lock);
+	if (range->next < range->end) {
+		*index = range->next++;
+		found = true;
+	}
+	pthread_mutex_unlock(&range->lock);
+	return found;
+}
+
+// Moves the back half of the busiest worker's range to the thief
+static bool steal(ParallelJob* job, int thief, int* index) {
+	for (;;) {
+		int victim = -1;
+		int most = 0;
+
+		for (int i = 0; i < job->worker_count; i++) {
+			if (i == thief) continue;
+			pthread_mutex_lock(&job->ranges[i].lock);
+			int remaining = job->ranges[i].end - job->ranges[i].next;
+			pthread_mutex_unlock(&job->ranges[i].lock);
+			if (remaining > most) {
+				most = remaining;
+				victim = i;
+			}
+		}
+
+		if (victim < 0) {
+			return false;
+		}
+
+		WorkRange* range = &job->ranges[victim];
+		pthread_mutex_lock(&range->lock);
+		int remaining = range->end - range->next;
+		if (remaining <= 0) {
+			// Drained while we were looking, pick another victim
+			pthread_mutex_unlock(&range->lock);
+			continue;
+		}
+		int begin = range->end - (remaining + 1) / 2;
+		int end = range->end;
+		range->end = begin;
+		pthread_mutex_unlock(&range->lock);
+
+		WorkRange* own = &job->ranges[thief];
+		pthread_mutex_lock(&own->lock);
+		own->next = begin + 1;
+		own->end = end;
+		pthread_mutex_unlock(&own->lock);
+
+		*index = begin;
+		return true;
+	}
+}
+
+static void* worker_main(void* arg) {
+	WorkerArgs* args = arg;
+	ParallelJob* job = args->job;
+	int index;
+
+	while (take_own(&job->ranges[args->worker], &index) ||
+	        steal(job, args->worker, &index)) {
+		job->task(job->context, index, args->worker);
+	}
+	return NULL;
+}
+
+int parallel_for(int count, int worker_count, ParallelTask task, void* context) {
+	if (count <= 0) {
+		return 0;
+	}
+
+	if (worker_count <= 0) worker_count = thread_pool_default_workers();
+	if (worker_count > MAX_WORKERS) worker_count = MAX_WORKERS;
+	if (worker_count > count) worker_count = count;
+
+	// Nothing to share, skip the thread setup entirely
+	if (worker_count == 1) {
+		for (int i = 0; i < count; i++) {
+			task(context, i, 0);
+		}
+		return 0;
+	}
+
+	ParallelJob* job = malloc(sizeof(ParallelJob));
+	if (!job) {
+		return -1;
+	}
+	job->worker_count = worker_count;
+	job->task = task;
+	job->context = context;
+
+	for (int i = 0; i < worker_count; i++) {
+		pthread_mutex_init(&job->ranges[i].lock, NULL);
+		job->ranges[i].next = (int)((long long)count * i / worker_count);
+		job->ranges[i].end = (int)((long long)count * (i + 1) / worker_count);
+	}
+
+	pthread_t threads[MAX_WORKERS];
+	WorkerArgs args[MAX_WORKERS];
+	int started = 1;
+
+	for (int i = 1; i < worker_count; i++) {
+		args[i].job = job;
+		args[i].worker = i;
+		if (pthread_create(&threads[i], NULL, worker_main, &args[i]) != 0) {
+			// Ranges of workers that never started get stolen by the others
+			break;
+		}
+		started++;
+	}
+
+	args[0].job = job;
+	args[0].worker = 0;
+	worker_main(&args[0]);
+
+	for (int i = 1; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	for (int i = 0; i < worker_count; i++) {
+		pthread_mutex_destroy(&job->ranges[i].lock);
+	}
+	free(job);
+	return 0;
+}
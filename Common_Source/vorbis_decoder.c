@@ -0,0 +1,1494 @@
+#include "audio_decoder.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define seek_file _fseeki64
+#define tell_file _ftelli64
+#else
+#define seek_file fseeko
+#define tell_file ftello
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PAGE_HEADER_SIZE 27
+#define MAX_PAGE_SIZE (PAGE_HEADER_SIZE + 255 + 255 * 255)
+#define PAGE_CONTINUED 0x01
+#define PAGE_LAST 0x04
+// The last page is looked for in this much of the end of the file, doubled until found
+#define TAIL_SEARCH_SIZE 65536
+
+#define MAX_CHANNELS 8
+#define MAX_CODEBOOKS 256
+#define MAX_SETUP_ITEMS 64
+#define MAX_FLOOR_VALUES 256
+#define MAX_SUBMAPS 16
+#define MAX_COUPLING_STEPS 256
+#define MIN_BLOCK_SIZE 64
+#define MAX_BLOCK_SIZE 8192
+// Codewords up to this long are decoded by one table lookup
+#define FAST_BITS 10
+
+typedef struct {
+	unsigned dimensions;
+	uint32_t entries;
+	int* tree;         // Child pairs, > 0 another pair, < 0 ~entry, 0 no codeword
+	int16_t* fast;     // Entry for the next FAST_BITS bits, -1 when the codeword is longer
+	uint8_t* fast_lengths;
+	int single_entry;  // The entry of a book with one codeword, -1 otherwise
+	float* values;     // dimensions values per entry, NULL without a lookup table
+} Codebook;
+
+typedef struct {
+	unsigned partitions;
+	uint8_t partition_class[32];
+	uint8_t class_dimensions[16];
+	uint8_t class_subclasses[16];
+	int16_t class_masterbook[16];
+	int16_t subclass_books[16][8];
+	unsigned multiplier;
+	unsigned values;
+	uint16_t x[MAX_FLOOR_VALUES];
+	uint8_t sorted[MAX_FLOOR_VALUES];  // Value indexes by ascending x
+	uint8_t low[MAX_FLOOR_VALUES];     // Neighbours among the values before each one
+	uint8_t high[MAX_FLOOR_VALUES];
+} Floor;
+
+typedef struct {
+	unsigned type;
+	uint32_t begin;
+	uint32_t end;
+	uint32_t partition_size;
+	unsigned classifications;
+	unsigned classbook;
+	int16_t books[64][8];
+} Residue;
+
+typedef struct {
+	unsigned submaps;
+	unsigned coupling_steps;
+	uint8_t magnitude[MAX_COUPLING_STEPS];
+	uint8_t angle[MAX_COUPLING_STEPS];
+	uint8_t mux[MAX_CHANNELS];
+	uint8_t submap_floor[MAX_SUBMAPS];
+	uint8_t submap_residue[MAX_SUBMAPS];
+} Mapping;
+
+typedef struct {
+	bool long_block;
+	unsigned mapping;
+} Mode;
+
+// One packet, read least significant bit first
+typedef struct {
+	const uint8_t* data;
+	size_t size;
+	size_t position;
+	uint64_t cache;
+	int bits;
+	int64_t bits_left;  // Negative once reads went past the end
+} BitInput;
+
+// Inverse MDCT of one block size
+typedef struct {
+	unsigned n;
+	float* twiddle;      // cos and sin pairs for the pre and post rotation, n / 4
+	float* fft_twiddle;  // For the n / 4 point FFT
+	uint16_t* bit_reverse;
+	float* slope;        // Rising half of the window, n / 2
+} Transform;
+
+typedef struct {
+	AudioDecoder base;
+	FILE* file;
+
+	// Ogg pages of the first logical stream
+	uint32_t serial;
+	uint8_t* page;
+	unsigned segment_count;
+	unsigned segment_index;
+	size_t page_position;
+	bool last_page;
+	uint8_t* packet;
+	size_t packet_size;
+	size_t packet_capacity;
+
+	// Setup
+	unsigned block_sizes[2];
+	unsigned codebook_count;
+	Codebook codebooks[MAX_CODEBOOKS];
+	unsigned floor_count;
+	Floor* floors;
+	unsigned residue_count;
+	Residue* residues;
+	unsigned mapping_count;
+	Mapping* mappings;
+	unsigned mode_count;
+	Mode modes[MAX_SETUP_ITEMS];
+	Transform transforms[2];
+
+	// Decoding
+	float* spectrum[MAX_CHANNELS];  // Also the transform output, block size each
+	float* previous[MAX_CHANNELS];  // Windowed right half of the last block
+	unsigned previous_size;         // Block size of the last block, 0 before the first
+	float* work;
+	int* classes;
+	float* output[MAX_CHANNELS];    // Finished samples of the last packet
+	unsigned output_size;
+	unsigned output_position;
+	uint64_t frames_left;
+	bool failed;
+} VorbisDecoder;
+
+static const float inverse_db[256] = {
+	1.0649863e-07f, 1.1341951e-07f, 1.2079015e-07f, 1.2863978e-07f,
+	1.369995e-07f, 1.459025e-07f, 1.5538409e-07f, 1.6548181e-07f,
+	1.7623574e-07f, 1.8768856e-07f, 1.998856e-07f, 2.1287531e-07f,
+	2.2670913e-07f, 2.4144197e-07f, 2.5713223e-07f, 2.7384212e-07f,
+	2.9163792e-07f, 3.1059022e-07f, 3.307741e-07f, 3.5226967e-07f,
+	3.7516213e-07f, 3.995423e-07f, 4.2550681e-07f, 4.5315863e-07f,
+	4.8260745e-07f, 5.1397001e-07f, 5.4737063e-07f, 5.8294188e-07f,
+	6.2082472e-07f, 6.6116939e-07f, 7.0413591e-07f, 7.4989464e-07f,
+	7.9862701e-07f, 8.5052631e-07f, 9.0579829e-07f, 9.6466215e-07f,
+	1.0273513e-06f, 1.0941144e-06f, 1.1652161e-06f, 1.2409384e-06f,
+	1.3215816e-06f, 1.4074654e-06f, 1.4989305e-06f, 1.5963394e-06f,
+	1.7000785e-06f, 1.8105592e-06f, 1.9282195e-06f, 2.053526e-06f,
+	2.1869757e-06f, 2.3290977e-06f, 2.4804558e-06f, 2.6416496e-06f,
+	2.813319e-06f, 2.9961443e-06f, 3.1908505e-06f, 3.3982101e-06f,
+	3.6190449e-06f, 3.8542307e-06f, 4.1047006e-06f, 4.3714472e-06f,
+	4.6555283e-06f, 4.9580708e-06f, 5.2802739e-06f, 5.6234162e-06f,
+	5.9888571e-06f, 6.3780467e-06f, 6.7925284e-06f, 7.2339453e-06f,
+	7.7040477e-06f, 8.2047e-06f, 8.7378876e-06f, 9.3057251e-06f,
+	9.9104636e-06f, 1.0554501e-05f, 1.1240392e-05f, 1.1970856e-05f,
+	1.2748789e-05f, 1.3577278e-05f, 1.4459606e-05f, 1.5399271e-05f,
+	1.6400005e-05f, 1.7465769e-05f, 1.8600793e-05f, 1.9809577e-05f,
+	2.1096914e-05f, 2.2467912e-05f, 2.3928002e-05f, 2.5482977e-05f,
+	2.7139005e-05f, 2.890265e-05f, 3.078091e-05f, 3.2781227e-05f,
+	3.4911533e-05f, 3.7180282e-05f, 3.9596467e-05f, 4.2169668e-05f,
+	4.4910092e-05f, 4.7828602e-05f, 5.0936775e-05f, 5.4246932e-05f,
+	5.7772202e-05f, 6.1526567e-05f, 6.552491e-05f, 6.9783084e-05f,
+	7.4317984e-05f, 7.9147583e-05f, 8.4291038e-05f, 8.976875e-05f,
+	9.5602423e-05f, 0.00010181521f, 0.00010843174f, 0.00011547824f,
+	0.00012298267f, 0.00013097477f, 0.00013948625f, 0.00014855085f,
+	0.00015820454f, 0.00016848555f, 0.00017943469f, 0.00019109536f,
+	0.00020351382f, 0.0002167393f, 0.00023082423f, 0.00024582449f,
+	0.00026179955f, 0.00027881275f, 0.00029693157f, 0.00031622787f,
+	0.00033677815f, 0.00035866388f, 0.00038197188f, 0.00040679457f,
+	0.00043323037f, 0.0004613841f, 0.00049136748f, 0.00052329927f,
+	0.00055730622f, 0.00059352309f, 0.00063209358f, 0.00067317061f,
+	0.00071691698f, 0.00076350628f, 0.00081312325f, 0.00086596457f,
+	0.00092223985f, 0.00098217221f, 0.0010459992f, 0.0011139743f,
+	0.0011863665f, 0.0012634633f, 0.0013455702f, 0.0014330129f,
+	0.0015261382f, 0.0016253153f, 0.0017309374f, 0.0018434235f,
+	0.0019632196f, 0.0020908006f, 0.0022266726f, 0.0023713743f,
+	0.0025254795f, 0.0026895993f, 0.0028643848f, 0.0030505287f,
+	0.0032487691f, 0.0034598925f, 0.0036847359f, 0.0039241905f,
+	0.0041792067f, 0.0044507948f, 0.0047400328f, 0.0050480668f,
+	0.0053761187f, 0.005725489f, 0.0060975635f, 0.0064938175f,
+	0.0069158226f, 0.0073652514f, 0.0078438874f, 0.0083536273f,
+	0.0088964924f, 0.009474637f, 0.010090352f, 0.01074608f,
+	0.011444421f, 0.012188144f, 0.012980198f, 0.013823725f,
+	0.014722068f, 0.015678791f, 0.016697686f, 0.017782796f,
+	0.018938422f, 0.020169148f, 0.021479854f, 0.022875736f,
+	0.024362329f, 0.025945531f, 0.027631618f, 0.029427277f,
+	0.031339627f, 0.03337625f, 0.035545226f, 0.037855156f,
+	0.0403152f, 0.042935107f, 0.045725275f, 0.048696756f,
+	0.051861349f, 0.05523159f, 0.058820851f, 0.062643364f,
+	0.066714279f, 0.07104975f, 0.075666964f, 0.080584228f,
+	0.085821047f, 0.09139818f, 0.097337745f, 0.1036633f,
+	0.11039993f, 0.11757434f, 0.12521498f, 0.13335215f,
+	0.14201812f, 0.15124726f, 0.16107617f, 0.17154381f,
+	0.18269168f, 0.19456401f, 0.20720787f, 0.22067343f,
+	0.23501402f, 0.25028655f, 0.26655158f, 0.28387362f,
+	0.30232131f, 0.32196787f, 0.34289113f, 0.36517414f,
+	0.3889052f, 0.41417846f, 0.44109413f, 0.4697589f,
+	0.50028646f, 0.53279793f, 0.56742209f, 0.60429639f,
+	0.64356697f, 0.68538958f, 0.72993004f, 0.77736503f,
+	0.82788259f, 0.88168305f, 0.9389798f, 1.0f,
+};
+
+// Vorbis channel of each WAV channel
+static const uint8_t channel_orders[MAX_CHANNELS + 1][MAX_CHANNELS] = {
+	{0}, {0}, {0, 1}, {0, 2, 1}, {0, 1, 2, 3}, {0, 2, 1, 3, 4}, {0, 2, 1, 5, 3, 4},
+	{0, 2, 1, 6, 5, 3, 4}, {0, 2, 1, 7, 5, 6, 3, 4},
+};
+
+static unsigned ilog(uint32_t value) {
+	unsigned bits = 0;
+	while (value) {
+		bits++;
+		value >>= 1;
+	}
+	return bits;
+}
+
+static uint32_t read_le32(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+	       ((uint32_t)p[3] << 24);
+}
+
+/* Bits */
+
+static void bits_init(BitInput* in, const uint8_t* data, size_t size) {
+	in->data = data;
+	in->size = size;
+	in->position = 0;
+	in->cache = 0;
+	in->bits = 0;
+	in->bits_left = (int64_t)size * 8;
+}
+
+static void refill(BitInput* in) {
+	while (in->bits <= 56) {
+		uint64_t byte = in->position < in->size ? in->data[in->position++] : 0;
+		in->cache |= byte << in->bits;
+		in->bits += 8;
+	}
+}
+
+static uint32_t peek_bits(BitInput* in, int count) {
+	if (in->bits < count) {
+		refill(in);
+	}
+	return (uint32_t)(in->cache & ((1ull << count) - 1));
+}
+
+static void skip_bits(BitInput* in, int count) {
+	in->cache >>= count;
+	in->bits -= count;
+	in->bits_left -= count;
+}
+
+static uint32_t read_bits(BitInput* in, int count) {
+	if (count == 0) {
+		return 0;
+	}
+	uint32_t value = peek_bits(in, count);
+	skip_bits(in, count);
+	return value;
+}
+
+static bool bits_ended(const BitInput* in) {
+	return in->bits_left < 0;
+}
+
+/* Codebooks */
+
+static float unpack_float(uint32_t value) {
+	double mantissa = value & 0x1FFFFF;
+	int exponent = (int)((value & 0x7FE00000) >> 21);
+	if (value & 0x80000000) {
+		mantissa = -mantissa;
+	}
+	return (float)ldexp(mantissa, exponent - 788);
+}
+
+// The largest count whose dimensions-th power doesn't exceed entries
+static uint32_t lookup1_values(uint32_t entries, unsigned dimensions) {
+	uint32_t count = (uint32_t)floor(pow(entries, 1.0 / dimensions));
+	for (;;) {
+		double power = pow(count + 1, dimensions);
+		if (power > entries) {
+			break;
+		}
+		count++;
+	}
+	while (count > 0 && pow(count, dimensions) > entries) {
+		count--;
+	}
+	return count;
+}
+
+// Assigns codewords to lengths in entry order, as the reference decoder does
+static bool build_tree(Codebook* book, const uint8_t* lengths) {
+	uint32_t used = 0;
+	uint32_t last_used = 0;
+	for (uint32_t i = 0; i < book->entries; i++) {
+		if (lengths[i]) {
+			used++;
+			last_used = i;
+		}
+	}
+	book->single_entry = -1;
+	if (used == 0) {
+		return true;
+	}
+	if (used == 1) {
+		// Nothing to tell apart, it still takes its length in bits
+		book->single_entry = (int)last_used;
+		return lengths[last_used] == 1;
+	}
+
+	book->tree = calloc((size_t)used * 2, sizeof(int));
+	book->fast = malloc(sizeof(int16_t) << FAST_BITS);
+	book->fast_lengths = calloc((size_t)1 << FAST_BITS, 1);
+	if (!book->tree || !book->fast || !book->fast_lengths) {
+		return false;
+	}
+	for (int i = 0; i < 1 << FAST_BITS; i++) {
+		book->fast[i] = -1;
+	}
+
+	uint32_t marker[33] = {0};
+	int nodes = 1;
+	for (uint32_t i = 0; i < book->entries; i++) {
+		unsigned length = lengths[i];
+		if (!length) {
+			continue;
+		}
+		uint32_t code = marker[length];
+		if (length < 32 && (code >> length)) {
+			return false; // Overspecified
+		}
+		for (unsigned j = length; j > 0; j--) {
+			if (marker[j] & 1) {
+				marker[j] = j == 1 ? marker[1] + 1 : marker[j - 1] << 1;
+				break;
+			}
+			marker[j]++;
+		}
+		uint32_t next = code;
+		for (unsigned j = length + 1; j < 33; j++) {
+			if ((marker[j] >> 1) == next) {
+				next = marker[j];
+				marker[j] = marker[j - 1] << 1;
+			} else {
+				break;
+			}
+		}
+
+		// The first bit in the stream is the codeword's most significant one
+		int node = 0;
+		for (unsigned b = length; b > 1; b--) {
+			int* child = &book->tree[node * 2 + ((code >> (b - 1)) & 1)];
+			if (*child < 0) {
+				return false;
+			}
+			if (*child == 0) {
+				if ((uint32_t)nodes >= used) {
+					return false;
+				}
+				*child = nodes++;
+			}
+			node = *child;
+		}
+		int* leaf = &book->tree[node * 2 + (code & 1)];
+		if (*leaf != 0) {
+			return false;
+		}
+		*leaf = ~(int)i;
+
+		if (length <= FAST_BITS) {
+			uint32_t reversed = 0;
+			for (unsigned b = 0; b < length; b++) {
+				reversed |= ((code >> b) & 1) << (length - 1 - b);
+			}
+			for (uint32_t k = reversed; k < 1u << FAST_BITS; k += 1u << length) {
+				book->fast[k] = (int16_t)i;
+				book->fast_lengths[k] = (uint8_t)length;
+			}
+		}
+	}
+	return true;
+}
+
+// -1 for a codeword the book doesn't have or past the end of the packet
+static int decode_entry(BitInput* in, const Codebook* book) {
+	if (book->single_entry >= 0) {
+		skip_bits(in, 1);
+		return bits_ended(in) ? -1 : book->single_entry;
+	}
+	if (!book->tree) {
+		return -1;
+	}
+	uint32_t bits = peek_bits(in, FAST_BITS);
+	int entry = book->fast[bits];
+	if (entry >= 0) {
+		skip_bits(in, book->fast_lengths[bits]);
+		return bits_ended(in) ? -1 : entry;
+	}
+
+	int node = 0;
+	for (;;) {
+		int child = book->tree[node * 2 + read_bits(in, 1)];
+		if (child == 0 || bits_ended(in)) {
+			return -1;
+		}
+		if (child < 0) {
+			return ~child;
+		}
+		node = child;
+	}
+}
+
+static bool read_codebook(BitInput* in, Codebook* book) {
+	if (read_bits(in, 24) != 0x564342) {
+		return false;
+	}
+	book->dimensions = read_bits(in, 16);
+	book->entries = read_bits(in, 24);
+	if (book->dimensions == 0 || book->entries == 0) {
+		return false;
+	}
+
+	uint8_t* lengths = calloc(book->entries, 1);
+	if (!lengths) {
+		return false;
+	}
+	if (read_bits(in, 1)) {
+		// Ordered, runs of entries with the same length
+		unsigned length = read_bits(in, 5) + 1;
+		uint32_t entry = 0;
+		while (entry < book->entries) {
+			uint32_t count = read_bits(in, (int)ilog(book->entries - entry));
+			if (length > 32 || count > book->entries - entry || bits_ended(in)) {
+				free(lengths);
+				return false;
+			}
+			memset(lengths + entry, (int)length, count);
+			entry += count;
+			length++;
+		}
+	} else {
+		bool sparse = read_bits(in, 1);
+		for (uint32_t i = 0; i < book->entries; i++) {
+			if (!sparse || read_bits(in, 1)) {
+				lengths[i] = (uint8_t)(read_bits(in, 5) + 1);
+			}
+		}
+	}
+	bool valid = !bits_ended(in) && build_tree(book, lengths);
+	free(lengths);
+	if (!valid) {
+		return false;
+	}
+
+	unsigned lookup = read_bits(in, 4);
+	if (lookup == 0) {
+		return true;
+	}
+	if (lookup > 2) {
+		return false;
+	}
+	float minimum = unpack_float(read_bits(in, 32));
+	float delta = unpack_float(read_bits(in, 32));
+	int value_bits = (int)read_bits(in, 4) + 1;
+	bool sequence = read_bits(in, 1);
+	uint64_t count = lookup == 1 ? lookup1_values(book->entries, book->dimensions) :
+	                 (uint64_t)book->entries * book->dimensions;
+	if (count == 0 || count > (uint64_t)in->size * 8 || bits_ended(in)) {
+		return false;
+	}
+	uint32_t* multiplicands = malloc(count * sizeof(uint32_t));
+	book->values = malloc((size_t)book->entries * book->dimensions * sizeof(float));
+	if (!multiplicands || !book->values) {
+		free(multiplicands);
+		return false;
+	}
+	for (uint64_t i = 0; i < count; i++) {
+		multiplicands[i] = read_bits(in, value_bits);
+	}
+
+	for (uint32_t entry = 0; entry < book->entries; entry++) {
+		float last = 0;
+		uint32_t divisor = 1;
+		float* values = book->values + (size_t)entry * book->dimensions;
+		for (unsigned i = 0; i < book->dimensions; i++) {
+			uint64_t offset = lookup == 1 ? (entry / divisor) % count :
+			                  (uint64_t)entry * book->dimensions + i;
+			values[i] = (float)multiplicands[offset] * delta + minimum + last;
+			if (sequence) {
+				last = values[i];
+			}
+			divisor *= (uint32_t)count;
+		}
+	}
+	free(multiplicands);
+	return !bits_ended(in);
+}
+
+static void free_codebook(Codebook* book) {
+	free(book->tree);
+	free(book->fast);
+	free(book->fast_lengths);
+	free(book->values);
+}
+
+/* Setup */
+
+static bool valid_book(const VorbisDecoder* decoder, int book) {
+	return book >= 0 && (unsigned)book < decoder->codebook_count;
+}
+
+static bool read_floor(VorbisDecoder* decoder, BitInput* in, Floor* floor) {
+	if (read_bits(in, 16) != 1) {
+		return false; // Floor 0 hasn't been written by encoders for two decades
+	}
+	floor->partitions = read_bits(in, 5);
+	int max_class = -1;
+	for (unsigned i = 0; i < floor->partitions; i++) {
+		floor->partition_class[i] = (uint8_t)read_bits(in, 4);
+		if (floor->partition_class[i] > max_class) {
+			max_class = floor->partition_class[i];
+		}
+	}
+	for (int i = 0; i <= max_class; i++) {
+		floor->class_dimensions[i] = (uint8_t)(read_bits(in, 3) + 1);
+		floor->class_subclasses[i] = (uint8_t)read_bits(in, 2);
+		floor->class_masterbook[i] = -1;
+		if (floor->class_subclasses[i]) {
+			floor->class_masterbook[i] = (int16_t)read_bits(in, 8);
+			if (!valid_book(decoder, floor->class_masterbook[i])) {
+				return false;
+			}
+		}
+		for (int j = 0; j < 1 << floor->class_subclasses[i]; j++) {
+			floor->subclass_books[i][j] = (int16_t)((int)read_bits(in, 8) - 1);
+			if (floor->subclass_books[i][j] >= 0 &&
+			        !valid_book(decoder, floor->subclass_books[i][j])) {
+				return false;
+			}
+		}
+	}
+
+	floor->multiplier = read_bits(in, 2) + 1;
+	int range_bits = (int)read_bits(in, 4);
+	floor->x[0] = 0;
+	floor->x[1] = (uint16_t)(1u << range_bits);
+	floor->values = 2;
+	for (unsigned i = 0; i < floor->partitions; i++) {
+		unsigned dimensions = floor->class_dimensions[floor->partition_class[i]];
+		for (unsigned j = 0; j < dimensions; j++) {
+			floor->x[floor->values++] = (uint16_t)read_bits(in, range_bits);
+		}
+	}
+
+	for (unsigned i = 0; i < floor->values; i++) {
+		floor->sorted[i] = (uint8_t)i;
+	}
+	for (unsigned i = 1; i < floor->values; i++) {
+		uint8_t value = floor->sorted[i];
+		unsigned j = i;
+		for (; j > 0 && floor->x[floor->sorted[j - 1]] > floor->x[value]; j--) {
+			floor->sorted[j] = floor->sorted[j - 1];
+		}
+		floor->sorted[j] = value;
+	}
+	for (unsigned i = 1; i < floor->values; i++) {
+		if (floor->x[floor->sorted[i]] == floor->x[floor->sorted[i - 1]]) {
+			return false;
+		}
+	}
+	for (unsigned i = 2; i < floor->values; i++) {
+		unsigned low = 0, high = 1;
+		for (unsigned j = 0; j < i; j++) {
+			if (floor->x[j] < floor->x[i] && floor->x[j] > floor->x[low]) {
+				low = j;
+			}
+			if (floor->x[j] > floor->x[i] && floor->x[j] < floor->x[high]) {
+				high = j;
+			}
+		}
+		floor->low[i] = (uint8_t)low;
+		floor->high[i] = (uint8_t)high;
+	}
+	return !bits_ended(in);
+}
+
+static bool read_residue(VorbisDecoder* decoder, BitInput* in, Residue* residue) {
+	residue->type = read_bits(in, 16);
+	if (residue->type > 2) {
+		return false;
+	}
+	residue->begin = read_bits(in, 24);
+	residue->end = read_bits(in, 24);
+	residue->partition_size = read_bits(in, 24) + 1;
+	residue->classifications = read_bits(in, 6) + 1;
+	residue->classbook = read_bits(in, 8);
+	if (!valid_book(decoder, (int)residue->classbook) ||
+	        decoder->codebooks[residue->classbook].entries == 0) {
+		return false;
+	}
+
+	uint8_t cascade[64];
+	for (unsigned i = 0; i < residue->classifications; i++) {
+		unsigned low = read_bits(in, 3);
+		unsigned high = read_bits(in, 1) ? read_bits(in, 5) : 0;
+		cascade[i] = (uint8_t)(high << 3 | low);
+	}
+	for (unsigned i = 0; i < residue->classifications; i++) {
+		for (int pass = 0; pass < 8; pass++) {
+			residue->books[i][pass] = -1;
+			if (cascade[i] & (1 << pass)) {
+				int book = (int)read_bits(in, 8);
+				if (!valid_book(decoder, book) || !decoder->codebooks[book].values) {
+					return false;
+				}
+				residue->books[i][pass] = (int16_t)book;
+			}
+		}
+	}
+	return !bits_ended(in);
+}
+
+static bool read_mapping(VorbisDecoder* decoder, BitInput* in, Mapping* mapping) {
+	unsigned channels = decoder->base.channels;
+	if (read_bits(in, 16) != 0) {
+		return false;
+	}
+	mapping->submaps = read_bits(in, 1) ? read_bits(in, 4) + 1 : 1;
+	mapping->coupling_steps = read_bits(in, 1) ? read_bits(in, 8) + 1 : 0;
+	int channel_bits = (int)ilog(channels - 1);
+	for (unsigned i = 0; i < mapping->coupling_steps; i++) {
+		mapping->magnitude[i] = (uint8_t)read_bits(in, channel_bits);
+		mapping->angle[i] = (uint8_t)read_bits(in, channel_bits);
+		if (mapping->magnitude[i] == mapping->angle[i] || mapping->magnitude[i] >= channels ||
+		        mapping->angle[i] >= channels) {
+			return false;
+		}
+	}
+	if (read_bits(in, 2) != 0) {
+		return false;
+	}
+	for (unsigned c = 0; c < channels; c++) {
+		mapping->mux[c] = mapping->submaps > 1 ? (uint8_t)read_bits(in, 4) : 0;
+		if (mapping->mux[c] >= mapping->submaps) {
+			return false;
+		}
+	}
+	for (unsigned i = 0; i < mapping->submaps; i++) {
+		read_bits(in, 8); // Unused time configuration
+		mapping->submap_floor[i] = (uint8_t)read_bits(in, 8);
+		mapping->submap_residue[i] = (uint8_t)read_bits(in, 8);
+		if (mapping->submap_floor[i] >= decoder->floor_count ||
+		        mapping->submap_residue[i] >= decoder->residue_count) {
+			return false;
+		}
+	}
+	return !bits_ended(in);
+}
+
+static bool read_setup(VorbisDecoder* decoder, BitInput* in) {
+	decoder->codebook_count = read_bits(in, 8) + 1;
+	for (unsigned i = 0; i < decoder->codebook_count; i++) {
+		if (!read_codebook(in, &decoder->codebooks[i])) {
+			return false;
+		}
+	}
+
+	unsigned times = read_bits(in, 6) + 1;
+	for (unsigned i = 0; i < times; i++) {
+		if (read_bits(in, 16) != 0) {
+			return false;
+		}
+	}
+
+	decoder->floor_count = read_bits(in, 6) + 1;
+	decoder->floors = calloc(decoder->floor_count, sizeof(Floor));
+	if (!decoder->floors) {
+		return false;
+	}
+	for (unsigned i = 0; i < decoder->floor_count; i++) {
+		if (!read_floor(decoder, in, &decoder->floors[i])) {
+			return false;
+		}
+	}
+
+	decoder->residue_count = read_bits(in, 6) + 1;
+	decoder->residues = calloc(decoder->residue_count, sizeof(Residue));
+	if (!decoder->residues) {
+		return false;
+	}
+	for (unsigned i = 0; i < decoder->residue_count; i++) {
+		if (!read_residue(decoder, in, &decoder->residues[i])) {
+			return false;
+		}
+	}
+
+	decoder->mapping_count = read_bits(in, 6) + 1;
+	decoder->mappings = calloc(decoder->mapping_count, sizeof(Mapping));
+	if (!decoder->mappings) {
+		return false;
+	}
+	for (unsigned i = 0; i < decoder->mapping_count; i++) {
+		if (!read_mapping(decoder, in, &decoder->mappings[i])) {
+			return false;
+		}
+	}
+
+	decoder->mode_count = read_bits(in, 6) + 1;
+	for (unsigned i = 0; i < decoder->mode_count; i++) {
+		Mode* mode = &decoder->modes[i];
+		mode->long_block = read_bits(in, 1);
+		unsigned window = read_bits(in, 16);
+		unsigned transform = read_bits(in, 16);
+		mode->mapping = read_bits(in, 8);
+		if (window != 0 || transform != 0 || mode->mapping >= decoder->mapping_count) {
+			return false;
+		}
+	}
+	return read_bits(in, 1) == 1 && !bits_ended(in);
+}
+
+/* Transform */
+
+static bool transform_init(Transform* transform, unsigned n) {
+	unsigned n4 = n / 4;
+	transform->n = n;
+	transform->twiddle = malloc(n4 * 2 * sizeof(float));
+	transform->fft_twiddle = malloc(n4 * sizeof(float));
+	transform->bit_reverse = malloc(n4 * sizeof(uint16_t));
+	transform->slope = malloc(n / 2 * sizeof(float));
+	if (!transform->twiddle || !transform->fft_twiddle || !transform->bit_reverse ||
+	        !transform->slope) {
+		return false;
+	}
+
+	for (unsigned k = 0; k < n4; k++) {
+		double angle = 2 * M_PI * (k + 0.125) / n;
+		transform->twiddle[k * 2] = (float)cos(angle);
+		transform->twiddle[k * 2 + 1] = (float)sin(angle);
+	}
+	for (unsigned k = 0; k < n4 / 2; k++) {
+		double angle = 2 * M_PI * k / n4;
+		transform->fft_twiddle[k * 2] = (float)cos(angle);
+		transform->fft_twiddle[k * 2 + 1] = (float)sin(angle);
+	}
+	unsigned bits = ilog(n4) - 1;
+	for (unsigned k = 0; k < n4; k++) {
+		unsigned reversed = 0;
+		for (unsigned b = 0; b < bits; b++) {
+			reversed |= ((k >> b) & 1) << (bits - 1 - b);
+		}
+		transform->bit_reverse[k] = (uint16_t)reversed;
+	}
+	for (unsigned i = 0; i < n / 2; i++) {
+		double x = sin((i + 0.5) / (n / 2) * M_PI / 2);
+		transform->slope[i] = (float)sin(M_PI / 2 * x * x);
+	}
+	return true;
+}
+
+static void transform_free(Transform* transform) {
+	free(transform->twiddle);
+	free(transform->fft_twiddle);
+	free(transform->bit_reverse);
+	free(transform->slope);
+}
+
+// In place radix-2 inverse FFT of bit reversed input, z holds re/im pairs
+static void inverse_fft(const Transform* transform, float* z) {
+	unsigned count = transform->n / 4;
+	for (unsigned size = 2; size <= count; size *= 2) {
+		unsigned half = size / 2;
+		unsigned step = count / size;
+		for (unsigned start = 0; start < count; start += size) {
+			for (unsigned k = 0; k < half; k++) {
+				float wr = transform->fft_twiddle[k * step * 2];
+				float wi = transform->fft_twiddle[k * step * 2 + 1];
+				float* a = z + (start + k) * 2;
+				float* b = z + (start + k + half) * 2;
+				float br = b[0] * wr - b[1] * wi;
+				float bi = b[0] * wi + b[1] * wr;
+				b[0] = a[0] - br;
+				b[1] = a[1] - bi;
+				a[0] += br;
+				a[1] += bi;
+			}
+		}
+	}
+}
+
+/*
+ * n outputs of the n / 2 coefficients in x, through an n / 4 point complex FFT
+ * y[i] = sum x[k] cos(2 pi / n (i + 1/2 + n/4) (k + 1/2))
+ */
+static void inverse_mdct(const Transform* transform, const float* x, float* y, float* z) {
+	unsigned n = transform->n;
+	unsigned n2 = n / 2, n4 = n / 4, n8 = n / 8;
+	const float* t = transform->twiddle;
+
+	for (unsigned k = 0; k < n4; k++) {
+		float re = x[n2 - 1 - 2 * k];
+		float im = x[2 * k];
+		unsigned j = transform->bit_reverse[k];
+		z[j * 2] = re * t[k * 2] - im * t[k * 2 + 1];
+		z[j * 2 + 1] = re * t[k * 2 + 1] + im * t[k * 2];
+	}
+	inverse_fft(transform, z);
+
+	// The middle half comes out of the rotation, the rest by symmetry
+	float* middle = y + n4;
+	for (unsigned k = 0; k < n8; k++) {
+		unsigned a = n8 - k - 1, b = n8 + k;
+		float ar = z[a * 2], ai = z[a * 2 + 1];
+		float br = z[b * 2], bi = z[b * 2 + 1];
+		middle[a * 2] = -(ai * t[a * 2 + 1] - ar * t[a * 2]);
+		middle[b * 2 + 1] = -(ai * t[a * 2] + ar * t[a * 2 + 1]);
+		middle[b * 2] = -(bi * t[b * 2 + 1] - br * t[b * 2]);
+		middle[a * 2 + 1] = -(bi * t[b * 2] + br * t[b * 2 + 1]);
+	}
+	for (unsigned k = 0; k < n4; k++) {
+		y[k] = -y[n2 - k - 1];
+		y[n - k - 1] = y[n2 + k];
+	}
+}
+
+/* Packets */
+
+static bool read_page(VorbisDecoder* decoder) {
+	uint8_t* header = decoder->page;
+	for (;;) {
+		if (fread(header, 1, PAGE_HEADER_SIZE, decoder->file) != PAGE_HEADER_SIZE) {
+			return false;
+		}
+		if (memcmp(header, "OggS", 4) != 0 || header[4] != 0) {
+			return false;
+		}
+		unsigned segments = header[26];
+		uint8_t* table = header + PAGE_HEADER_SIZE;
+		if (fread(table, 1, segments, decoder->file) != segments) {
+			return false;
+		}
+		size_t size = 0;
+		for (unsigned i = 0; i < segments; i++) {
+			size += table[i];
+		}
+		uint8_t* body = table + segments;
+		if (fread(body, 1, size, decoder->file) != size) {
+			return false;
+		}
+		// Pages of other streams muxed in are skipped
+		if (read_le32(header + 14) != decoder->serial) {
+			continue;
+		}
+		decoder->segment_count = segments;
+		decoder->segment_index = 0;
+		decoder->page_position = PAGE_HEADER_SIZE + segments;
+		decoder->last_page = header[5] & PAGE_LAST;
+		return true;
+	}
+}
+
+static bool next_packet(VorbisDecoder* decoder) {
+	decoder->packet_size = 0;
+	bool started = false;
+	for (;;) {
+		if (decoder->segment_index == decoder->segment_count) {
+			if (decoder->last_page || !read_page(decoder)) {
+				return false;
+			}
+			// The end of a packet this one never saw the start of
+			if ((decoder->page[5] & PAGE_CONTINUED) && !started) {
+				while (decoder->segment_index < decoder->segment_count) {
+					uint8_t lacing = decoder->page[PAGE_HEADER_SIZE + decoder->segment_index++];
+					decoder->page_position += lacing;
+					if (lacing < 255) {
+						break;
+					}
+				}
+				continue;
+			}
+		}
+
+		uint8_t lacing = decoder->page[PAGE_HEADER_SIZE + decoder->segment_index++];
+		if (decoder->packet_size + lacing > decoder->packet_capacity) {
+			size_t capacity = decoder->packet_capacity * 2 + lacing;
+			uint8_t* packet = realloc(decoder->packet, capacity);
+			if (!packet) {
+				return false;
+			}
+			decoder->packet = packet;
+			decoder->packet_capacity = capacity;
+		}
+		memcpy(decoder->packet + decoder->packet_size, decoder->page + decoder->page_position,
+		       lacing);
+		decoder->packet_size += lacing;
+		decoder->page_position += lacing;
+		started = true;
+		if (lacing < 255) {
+			return true;
+		}
+	}
+}
+
+// Granule position of the stream's last page, samples up to the end of its last packet
+static bool find_length(VorbisDecoder* decoder, uint64_t* length) {
+	int64_t start = tell_file(decoder->file);
+	if (start < 0 || seek_file(decoder->file, 0, SEEK_END) != 0) {
+		return false;
+	}
+	int64_t end = tell_file(decoder->file);
+	bool found = false;
+
+	for (int64_t search = TAIL_SEARCH_SIZE; !found; search *= 2) {
+		int64_t from = end - search < start ? start : end - search;
+		size_t size = (size_t)(end - from);
+		uint8_t* tail = malloc(size);
+		if (!tail || seek_file(decoder->file, from, SEEK_SET) != 0 ||
+		        fread(tail, 1, size, decoder->file) != size) {
+			free(tail);
+			break;
+		}
+		for (size_t i = 0; i + PAGE_HEADER_SIZE <= size; i++) {
+			if (memcmp(tail + i, "OggS", 4) != 0 || tail[i + 4] != 0 ||
+			        read_le32(tail + i + 14) != decoder->serial) {
+				continue;
+			}
+			uint64_t granule = read_le32(tail + i + 6) | (uint64_t)read_le32(tail + i + 10) << 32;
+			// -1 marks a page no packet ends on
+			if (granule != UINT64_MAX) {
+				*length = granule;
+				found = true;
+			}
+		}
+		free(tail);
+		if (from == start) {
+			break;
+		}
+	}
+	return seek_file(decoder->file, start, SEEK_SET) == 0 && found;
+}
+
+static bool read_headers(VorbisDecoder* decoder) {
+	uint8_t header[PAGE_HEADER_SIZE];
+	int64_t start = tell_file(decoder->file);
+	if (fread(header, 1, PAGE_HEADER_SIZE, decoder->file) != PAGE_HEADER_SIZE ||
+	        seek_file(decoder->file, start, SEEK_SET) != 0) {
+		return false;
+	}
+	decoder->serial = read_le32(header + 14);
+
+	BitInput in;
+	for (unsigned type = 1; type <= 5; type += 2) {
+		if (!next_packet(decoder) || decoder->packet_size < 7 ||
+		        decoder->packet[0] != type || memcmp(decoder->packet + 1, "vorbis", 6) != 0) {
+			return false;
+		}
+		bits_init(&in, decoder->packet + 7, decoder->packet_size - 7);
+
+		if (type == 1) {
+			if (read_bits(&in, 32) != 0) {
+				return false;
+			}
+			decoder->base.channels = read_bits(&in, 8);
+			decoder->base.sample_rate = read_bits(&in, 32);
+			read_bits(&in, 32); // Bitrates
+			read_bits(&in, 32);
+			read_bits(&in, 32);
+			decoder->block_sizes[0] = 1u << read_bits(&in, 4);
+			decoder->block_sizes[1] = 1u << read_bits(&in, 4);
+			if (decoder->base.channels == 0 || decoder->base.channels > MAX_CHANNELS ||
+			        decoder->base.sample_rate == 0 || decoder->block_sizes[0] < MIN_BLOCK_SIZE ||
+			        decoder->block_sizes[1] > MAX_BLOCK_SIZE ||
+			        decoder->block_sizes[0] > decoder->block_sizes[1] || read_bits(&in, 1) != 1) {
+				return false;
+			}
+		} else if (type == 3) {
+			LoopComments loop = {0};
+			const uint8_t* data = decoder->packet + 7;
+			size_t size = decoder->packet_size - 7;
+			uint64_t position = size >= 4 ? 4 + (uint64_t)read_le32(data) : size;
+			if (position + 4 <= size) {
+				uint32_t count = read_le32(data + position);
+				position += 4;
+				for (uint32_t i = 0; i < count && position + 4 <= size; i++) {
+					uint32_t length = read_le32(data + position);
+					position += 4;
+					if (position + length > size) {
+						break;
+					}
+					loop_comments_parse(&loop, (const char*)data + position, length);
+					position += length;
+				}
+			}
+			if (!find_length(decoder, &decoder->base.frame_count) ||
+			        decoder->base.frame_count == 0) {
+				return false;
+			}
+			loop_comments_apply(&loop, &decoder->base);
+		} else if (!read_setup(decoder, &in)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Audio */
+
+static void render_line(int x0, int y0, int x1, int y1, int* values, int limit) {
+	int dy = y1 - y0;
+	int adx = x1 - x0;
+	int base = dy / adx;
+	int ady = abs(dy) - abs(base) * adx;
+	int step = dy < 0 ? base - 1 : base + 1;
+	int y = y0;
+	int error = 0;
+	if (x0 < limit) {
+		values[x0] = y;
+	}
+	for (int x = x0 + 1; x < x1 && x < limit; x++) {
+		error += ady;
+		if (error >= adx) {
+			error -= adx;
+			y += step;
+		} else {
+			y += base;
+		}
+		values[x] = y;
+	}
+}
+
+// false for a channel the floor leaves silent
+static bool decode_floor(VorbisDecoder* decoder, BitInput* in, const Floor* floor, float* curve,
+                         unsigned half) {
+	static const int ranges[4] = {256, 128, 86, 64};
+	if (!read_bits(in, 1)) {
+		return false;
+	}
+	int range = ranges[floor->multiplier - 1];
+	int y[MAX_FLOOR_VALUES];
+	int y_bits = (int)ilog((uint32_t)range - 1);
+	y[0] = (int)read_bits(in, y_bits);
+	y[1] = (int)read_bits(in, y_bits);
+	unsigned offset = 2;
+	for (unsigned i = 0; i < floor->partitions; i++) {
+		unsigned class = floor->partition_class[i];
+		unsigned dimensions = floor->class_dimensions[class];
+		unsigned bits = floor->class_subclasses[class];
+		unsigned value = 0;
+		if (bits) {
+			int entry = decode_entry(in, &decoder->codebooks[floor->class_masterbook[class]]);
+			if (entry < 0) {
+				return false;
+			}
+			value = (unsigned)entry;
+		}
+		for (unsigned j = 0; j < dimensions; j++) {
+			int book = floor->subclass_books[class][value & ((1u << bits) - 1)];
+			value >>= bits;
+			y[offset] = 0;
+			if (book >= 0) {
+				int entry = decode_entry(in, &decoder->codebooks[book]);
+				if (entry < 0) {
+					return false;
+				}
+				y[offset] = entry;
+			}
+			offset++;
+		}
+	}
+	if (bits_ended(in)) {
+		return false;
+	}
+
+	// Each value is coded as a difference from the line between its neighbours
+	bool used[MAX_FLOOR_VALUES];
+	used[0] = used[1] = true;
+	for (unsigned i = 2; i < floor->values; i++) {
+		unsigned low = floor->low[i], high = floor->high[i];
+		int x0 = floor->x[low], x1 = floor->x[high];
+		int y0 = y[low], y1 = y[high];
+		int dy = y1 - y0;
+		int predicted = y0 + (dy < 0 ? -1 : 1) * (abs(dy) * (floor->x[i] - x0) / (x1 - x0));
+		int value = y[i];
+		int high_room = range - predicted;
+		int low_room = predicted;
+		int room = (high_room < low_room ? high_room : low_room) * 2;
+		if (value != 0) {
+			used[low] = used[high] = used[i] = true;
+			if (value >= room) {
+				y[i] = high_room > low_room ? value - low_room + predicted :
+				       predicted - value + high_room - 1;
+			} else {
+				y[i] = value & 1 ? predicted - (value + 1) / 2 : predicted + value / 2;
+			}
+		} else {
+			used[i] = false;
+			y[i] = predicted;
+		}
+	}
+
+	int* values = (int*)decoder->work;
+	int multiplier = (int)floor->multiplier;
+	int lx = 0, ly = y[floor->sorted[0]] * multiplier;
+	for (unsigned i = 1; i < floor->values; i++) {
+		unsigned index = floor->sorted[i];
+		if (!used[index]) {
+			continue;
+		}
+		int hx = floor->x[index];
+		int hy = y[index] * multiplier;
+		if (lx < (int)half) {
+			render_line(lx, ly, hx, hy, values, (int)half);
+		}
+		lx = hx;
+		ly = hy;
+	}
+	for (int x = lx; x < (int)half; x++) {
+		values[x] = ly;
+	}
+	for (unsigned i = 0; i < half; i++) {
+		int value = values[i];
+		curve[i] = inverse_db[value < 0 ? 0 : value > 255 ? 255 : value];
+	}
+	return true;
+}
+
+static void decode_partition(BitInput* in, const Codebook* book, float* v, uint32_t size,
+                             unsigned type) {
+	unsigned dimensions = book->dimensions;
+	if (type == 0) {
+		// Interleaved, each entry adds one value every step
+		uint32_t step = size / dimensions;
+		for (uint32_t i = 0; i < step; i++) {
+			int entry = decode_entry(in, book);
+			if (entry < 0) {
+				return;
+			}
+			const float* values = book->values + (size_t)entry * dimensions;
+			for (unsigned j = 0; j < dimensions; j++) {
+				v[i + j * step] += values[j];
+			}
+		}
+		return;
+	}
+	for (uint32_t i = 0; i < size;) {
+		int entry = decode_entry(in, book);
+		if (entry < 0) {
+			return;
+		}
+		const float* values = book->values + (size_t)entry * dimensions;
+		for (unsigned j = 0; j < dimensions && i < size; j++) {
+			v[i++] += values[j];
+		}
+	}
+}
+
+static void decode_residue(VorbisDecoder* decoder, BitInput* in, const Residue* residue,
+                           float** vectors, unsigned count, uint32_t size) {
+	const Codebook* classbook = &decoder->codebooks[residue->classbook];
+	unsigned per_codeword = classbook->dimensions;
+	uint32_t begin = residue->begin < size ? residue->begin : size;
+	uint32_t end = residue->end < size ? residue->end : size;
+	uint32_t partitions = (end - begin) / residue->partition_size;
+	uint32_t stride = partitions + per_codeword;
+	int* classes = decoder->classes;
+
+	for (int pass = 0; pass < 8; pass++) {
+		uint32_t partition = 0;
+		while (partition < partitions) {
+			if (pass == 0) {
+				for (unsigned c = 0; c < count; c++) {
+					int entry = decode_entry(in, classbook);
+					if (entry < 0) {
+						return;
+					}
+					for (int i = (int)per_codeword - 1; i >= 0; i--) {
+						classes[c * stride + partition + (unsigned)i] =
+						    entry % (int)residue->classifications;
+						entry /= (int)residue->classifications;
+					}
+				}
+			}
+			for (unsigned i = 0; i < per_codeword && partition < partitions; i++, partition++) {
+				for (unsigned c = 0; c < count; c++) {
+					int book = residue->books[classes[c * stride + partition]][pass];
+					if (book < 0) {
+						continue;
+					}
+					uint32_t offset = begin + partition * residue->partition_size;
+					decode_partition(in, &decoder->codebooks[book], vectors[c] + offset,
+					                 residue->partition_size, residue->type);
+					if (bits_ended(in)) {
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Decodes one packet into its spectra and runs the transform, 0 samples for the first
+static bool decode_packet(VorbisDecoder* decoder) {
+	BitInput in;
+	bits_init(&in, decoder->packet, decoder->packet_size);
+	if (decoder->packet_size == 0 || read_bits(&in, 1) != 0) {
+		// Empty or not audio, nothing to add
+		decoder->output_size = 0;
+		return true;
+	}
+	unsigned mode_number = read_bits(&in, (int)ilog(decoder->mode_count - 1));
+	if (mode_number >= decoder->mode_count) {
+		return false;
+	}
+	const Mode* mode = &decoder->modes[mode_number];
+	const Mapping* mapping = &decoder->mappings[mode->mapping];
+	unsigned n = decoder->block_sizes[mode->long_block];
+	unsigned half = n / 2;
+	bool previous_long = true, next_long = true;
+	if (mode->long_block) {
+		previous_long = read_bits(&in, 1);
+		next_long = read_bits(&in, 1);
+	}
+	unsigned channels = decoder->base.channels;
+
+	// Floor curves wait in the upper half of each spectrum while the residues are read
+	bool nonzero[MAX_CHANNELS];
+	float* curves[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; c++) {
+		curves[c] = decoder->spectrum[c] + half;
+		const Floor* floor = &decoder->floors[mapping->submap_floor[mapping->mux[c]]];
+		nonzero[c] = decode_floor(decoder, &in, floor, curves[c], half);
+		memset(decoder->spectrum[c], 0, half * sizeof(float));
+	}
+	bool decode[MAX_CHANNELS];
+	memcpy(decode, nonzero, sizeof(decode));
+	for (unsigned i = 0; i < mapping->coupling_steps; i++) {
+		if (decode[mapping->magnitude[i]] || decode[mapping->angle[i]]) {
+			decode[mapping->magnitude[i]] = decode[mapping->angle[i]] = true;
+		}
+	}
+
+	for (unsigned s = 0; s < mapping->submaps; s++) {
+		const Residue* residue = &decoder->residues[mapping->submap_residue[s]];
+		float* vectors[MAX_CHANNELS];
+		unsigned count = 0;
+		bool any = false;
+		for (unsigned c = 0; c < channels; c++) {
+			if (mapping->mux[c] == s) {
+				any |= decode[c];
+				vectors[count++] = decode[c] || residue->type == 2 ? decoder->spectrum[c] : NULL;
+			}
+		}
+		if (residue->type == 2) {
+			// All the channels interleaved into one vector
+			if (!any) {
+				continue;
+			}
+			float* interleaved = decoder->work;
+			memset(interleaved, 0, (size_t)half * count * sizeof(float));
+			decode_residue(decoder, &in, residue, &interleaved, 1, half * count);
+			for (unsigned i = 0; i < half; i++) {
+				for (unsigned c = 0; c < count; c++) {
+					vectors[c][i] = interleaved[i * count + c];
+				}
+			}
+		} else {
+			unsigned used = 0;
+			for (unsigned c = 0; c < count; c++) {
+				if (vectors[c]) {
+					vectors[used++] = vectors[c];
+				}
+			}
+			decode_residue(decoder, &in, residue, vectors, used, half);
+		}
+	}
+
+	for (int i = (int)mapping->coupling_steps - 1; i >= 0; i--) {
+		float* magnitudes = decoder->spectrum[mapping->magnitude[i]];
+		float* angles = decoder->spectrum[mapping->angle[i]];
+		for (unsigned j = 0; j < half; j++) {
+			float m = magnitudes[j], a = angles[j];
+			if (m > 0) {
+				if (a > 0) {
+					angles[j] = m - a;
+				} else {
+					angles[j] = m;
+					magnitudes[j] = m + a;
+				}
+			} else {
+				if (a > 0) {
+					angles[j] = m + a;
+				} else {
+					angles[j] = m;
+					magnitudes[j] = m - a;
+				}
+			}
+		}
+	}
+
+	const Transform* transform = &decoder->transforms[mode->long_block];
+	const Transform* short_transform = &decoder->transforms[0];
+	unsigned short_half = decoder->block_sizes[0] / 2;
+	// Window slopes, a long block next to a short one uses the short slope
+	unsigned left_start = 0, left_size = half;
+	const float* left_slope = transform->slope;
+	if (mode->long_block && !previous_long) {
+		left_start = n / 4 - short_half / 2;
+		left_size = short_half;
+		left_slope = short_transform->slope;
+	}
+	unsigned right_start = half, right_size = half;
+	const float* right_slope = transform->slope;
+	if (mode->long_block && !next_long) {
+		right_start = n * 3 / 4 - short_half / 2;
+		right_size = short_half;
+		right_slope = short_transform->slope;
+	}
+
+	for (unsigned c = 0; c < channels; c++) {
+		float* spectrum = decoder->spectrum[c];
+		if (nonzero[c]) {
+			for (unsigned i = 0; i < half; i++) {
+				spectrum[i] *= curves[c][i];
+			}
+		} else {
+			memset(spectrum, 0, half * sizeof(float));
+		}
+		// The spectrum is copied out since the output overwrites it
+		memcpy(decoder->work, spectrum, half * sizeof(float));
+		inverse_mdct(transform, decoder->work, spectrum, decoder->work + half);
+
+		for (unsigned i = 0; i < left_start; i++) {
+			spectrum[i] = 0;
+		}
+		for (unsigned i = 0; i < left_size; i++) {
+			spectrum[left_start + i] *= left_slope[i];
+		}
+		for (unsigned i = 0; i < right_size; i++) {
+			spectrum[right_start + i] *= right_slope[right_size - 1 - i];
+		}
+		for (unsigned i = right_start + right_size; i < n; i++) {
+			spectrum[i] = 0;
+		}
+	}
+
+	// Overlap the left half with the last block's right half, centre to centre
+	unsigned previous = decoder->previous_size;
+	decoder->output_size = 0;
+	if (previous > 0) {
+		unsigned size = previous / 4 + n / 4;
+		for (unsigned c = 0; c < channels; c++) {
+			const float* spectrum = decoder->spectrum[channel_orders[channels][c]];
+			const float* last = decoder->previous[channel_orders[channels][c]];
+			float* output = decoder->output[c];
+			for (unsigned i = 0; i < size; i++) {
+				int j = (int)i - (int)(previous / 4) + (int)(n / 4);
+				float value = i < previous / 2 ? last[i] : 0;
+				if (j >= 0) {
+					value += spectrum[j];
+				}
+				output[i] = value;
+			}
+		}
+		decoder->output_size = size;
+	}
+	for (unsigned c = 0; c < channels; c++) {
+		memcpy(decoder->previous[c], decoder->spectrum[c] + half, half * sizeof(float));
+	}
+	decoder->previous_size = n;
+	decoder->output_position = 0;
+	return true;
+}
+
+static size_t vorbis_read(AudioDecoder* base, float* samples, size_t count) {
+	VorbisDecoder* decoder = (VorbisDecoder*)base;
+	unsigned channels = base->channels;
+	if (count > decoder->frames_left) {
+		count = (size_t)decoder->frames_left;
+	}
+	size_t done = 0;
+
+	while (done < count) {
+		if (decoder->output_position == decoder->output_size) {
+			if (decoder->failed || !next_packet(decoder) || !decode_packet(decoder)) {
+				decoder->failed = true;
+				break;
+			}
+			continue;
+		}
+		size_t frames = decoder->output_size - decoder->output_position;
+		if (frames > count - done) {
+			frames = count - done;
+		}
+		for (unsigned c = 0; c < channels; c++) {
+			const float* source = decoder->output[c] + decoder->output_position;
+			float* target = samples + done * channels + c;
+			for (size_t i = 0; i < frames; i++) {
+				target[i * channels] = source[i];
+			}
+		}
+		decoder->output_position += (unsigned)frames;
+		done += frames;
+	}
+	decoder->frames_left -= done;
+	return done;
+}
+
+static void vorbis_close(AudioDecoder* base) {
+	VorbisDecoder* decoder = (VorbisDecoder*)base;
+	for (unsigned i = 0; i < MAX_CODEBOOKS; i++) {
+		free_codebook(&decoder->codebooks[i]);
+	}
+	transform_free(&decoder->transforms[0]);
+	transform_free(&decoder->transforms[1]);
+	for (int c = 0; c < MAX_CHANNELS; c++) {
+		free(decoder->spectrum[c]);
+		free(decoder->previous[c]);
+		free(decoder->output[c]);
+	}
+	free(decoder->floors);
+	free(decoder->residues);
+	free(decoder->mappings);
+	free(decoder->work);
+	free(decoder->classes);
+	free(decoder->packet);
+	free(decoder->page);
+	free(decoder);
+}
+
+// Buffers sized from the setup
+static bool allocate(VorbisDecoder* decoder) {
+	unsigned channels = decoder->base.channels;
+	unsigned n = decoder->block_sizes[1];
+	for (unsigned c = 0; c < channels; c++) {
+		decoder->spectrum[c] = malloc(n * sizeof(float));
+		decoder->previous[c] = malloc(n / 2 * sizeof(float));
+		decoder->output[c] = malloc(n * sizeof(float));
+		if (!decoder->spectrum[c] || !decoder->previous[c] || !decoder->output[c]) {
+			return false;
+		}
+	}
+	// Holds a residue 2 vector of every channel or a spectrum and the FFT
+	decoder->work = malloc((size_t)n * (channels > 2 ? channels : 2) * sizeof(float));
+
+	// Classifications per partition for the largest residue
+	size_t classes = 0;
+	for (unsigned i = 0; i < decoder->residue_count; i++) {
+		const Residue* residue = &decoder->residues[i];
+		size_t size = (size_t)n / 2 * (residue->type == 2 ? channels : 1);
+		size_t partitions = size / residue->partition_size +
+		                    decoder->codebooks[residue->classbook].dimensions;
+		size_t needed = partitions * (residue->type == 2 ? 1 : channels);
+		if (needed > classes) {
+			classes = needed;
+		}
+	}
+	decoder->classes = malloc((classes + 1) * sizeof(int));
+	return decoder->work && decoder->classes &&
+	       transform_init(&decoder->transforms[0], decoder->block_sizes[0]) &&
+	       transform_init(&decoder->transforms[1], decoder->block_sizes[1]);
+}
+
+AudioDecoder* vorbis_decoder_open(FILE* file) {
+	VorbisDecoder* decoder = calloc(1, sizeof(VorbisDecoder));
+	if (!decoder) {
+		return NULL;
+	}
+	decoder->base.read = vorbis_read;
+	decoder->base.close = vorbis_close;
+	decoder->file = file;
+	decoder->page = malloc(MAX_PAGE_SIZE);
+
+	if (!decoder->page || !read_headers(decoder) || !allocate(decoder)) {
+		vorbis_close(&decoder->base);
+		return NULL;
+	}
+	decoder->frames_left = decoder->base.frame_count;
+	return &decoder->base;
+}
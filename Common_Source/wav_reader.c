@@ -0,0 +1,443 @@
+#include "wav_reader.h"
+#include <string.h>
+
+// Samples converted per fread
+#define READ_BLOCK_SIZE 4096
+// Bytes read at once while walking the chunks, enough for the usual fmt,
+// LIST and smpl chunks in front of the audio
+#define PROBE_SIZE 4096
+// Fixed part of a smpl chunk, then 24 bytes per loop
+#define SMPL_HEADER_SIZE 36
+#define SMPL_LOOP_SIZE 24
+// RF64 chunk sizes that are only given in ds64
+#define RF64_SIZE_IN_DS64 0xFFFFFFFFu
+
+#ifdef _WIN32
+#define seek_file _fseeki64
+#define tell_file _ftelli64
+#else
+#define seek_file fseeko
+#define tell_file ftello
+#endif
+
+static uint32_t read_le32(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+	       ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read_le16(const uint8_t* p) {
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint64_t read_le64(const uint8_t* p) {
+	return read_le32(p) | ((uint64_t)read_le32(p + 4) << 32);
+}
+
+// Part of the file kept in memory while the chunks are walked
+typedef struct {
+	FILE* file;
+	uint64_t file_size;
+	uint64_t start;
+	size_t size;
+	uint8_t data[PROBE_SIZE];
+} ProbeWindow;
+
+// Returns size bytes at offset (size <= PROBE_SIZE), reading only when
+// they aren't in the window yet, NULL past the end of the file
+static const uint8_t* window_get(ProbeWindow* window, uint64_t offset, size_t size) {
+	if (offset >= window->start && offset + size <= window->start + window->size) {
+		return window->data + (offset - window->start);
+	}
+	if (offset + size > window->file_size || seek_file(window->file, (int64_t)offset, SEEK_SET) != 0) {
+		return NULL;
+	}
+	window->start = offset;
+	window->size = fread(window->data, 1, sizeof(window->data), window->file);
+	return (size <= window->size) ? window->data : NULL;
+}
+
+// Chunk ids are printable ASCII, used to tell whether a writer left out the
+// padding byte of an odd-sized chunk
+static bool is_chunk_id(const uint8_t* id) {
+	for (int i = 0; i < 4; i++) {
+		if (id[i] < 0x20 || id[i] > 0x7E) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int parse_format(WavInfo* info, const uint8_t* fmt, uint32_t size) {
+	if (size < 16) {
+		return WAV_READER_UNSUPPORTED;
+	}
+
+	info->format = read_le16(fmt);
+	info->channels = read_le16(fmt + 2);
+	info->sample_rate = read_le32(fmt + 4);
+	info->block_align = read_le16(fmt + 12);
+	info->bits_per_sample = read_le16(fmt + 14);
+
+	// The real format is the first two bytes of the sub-format GUID
+	if (info->format == WAVE_FORMAT_EXTENSIBLE) {
+		if (size < 40) {
+			return WAV_READER_UNSUPPORTED;
+		}
+		info->format = read_le16(fmt + 24);
+	}
+	return (info->channels == 0 || info->block_align == 0) ? WAV_READER_UNSUPPORTED : 0;
+}
+
+// First usable loop of a smpl chunk, its end is stored inclusive
+static void parse_loop(WavInfo* info, const uint8_t* smpl, uint32_t size) {
+	uint32_t loop_count = read_le32(smpl + 28);
+	for (uint32_t i = 0; i < loop_count; i++) {
+		uint64_t position = SMPL_HEADER_SIZE + (uint64_t)i * SMPL_LOOP_SIZE;
+		if (position + SMPL_LOOP_SIZE > size || position + SMPL_LOOP_SIZE > PROBE_SIZE) {
+			return;
+		}
+		uint32_t start = read_le32(smpl + position + 8);
+		uint32_t end = read_le32(smpl + position + 12);
+		if (end >= start && end != UINT32_MAX) {
+			info->has_loop = true;
+			info->loop_start = start;
+			info->loop_end = end + 1;
+			return;
+		}
+	}
+}
+
+int wav_read_info(FILE* file, WavInfo* info) {
+	memset(info, 0, sizeof(*info));
+	if (seek_file(file, 0, SEEK_END) != 0) {
+		return WAV_READER_UNSUPPORTED;
+	}
+	ProbeWindow probe = {file, (uint64_t)tell_file(file), 0, 0, {0}};
+	ProbeWindow* window = &probe;
+
+	const uint8_t* riff = window_get(window, 0, 12);
+	if (!riff || memcmp(riff + 8, "WAVE", 4) != 0 ||
+	        (memcmp(riff, "RIFF", 4) != 0 && memcmp(riff, "RF64", 4) != 0 &&
+	         memcmp(riff, "BW64", 4) != 0)) {
+		return WAV_READER_UNSUPPORTED;
+	}
+	info->rf64 = memcmp(riff, "RIFF", 4) != 0;
+
+	bool have_format = false;
+	bool have_data = false;
+	uint64_t ds64_data_size = 0;
+	uint64_t offset = 12;
+	const uint8_t* chunk;
+	while (offset + 8 <= window->file_size && (chunk = window_get(window, offset, 8)) != NULL) {
+		uint64_t size = read_le32(chunk + 4);
+		bool is_data = memcmp(chunk, "data", 4) == 0;
+		if (info->rf64 && is_data && size == RF64_SIZE_IN_DS64) {
+			size = ds64_data_size;
+		}
+
+		uint64_t body = offset + 8;
+		uint32_t wanted = (size < PROBE_SIZE) ? (uint32_t)size : PROBE_SIZE;
+		if (memcmp(chunk, "ds64", 4) == 0 && size >= 28) {
+			const uint8_t* ds64 = window_get(window, body, 28);
+			if (ds64) {
+				ds64_data_size = read_le64(ds64 + 8);
+			}
+		} else if (memcmp(chunk, "fmt ", 4) == 0) {
+			const uint8_t* fmt = window_get(window, body, wanted < 40 ? wanted : 40);
+			if (!fmt || parse_format(info, fmt, (uint32_t)size) != 0) {
+				break;
+			}
+			have_format = true;
+		} else if (memcmp(chunk, "smpl", 4) == 0 && size >= SMPL_HEADER_SIZE) {
+			const uint8_t* smpl = window_get(window, body, wanted);
+			if (smpl) {
+				parse_loop(info, smpl, (uint32_t)size);
+			}
+		} else if (is_data && !have_data) {
+			if (!have_format) {
+				break;
+			}
+			// Streamed or cut off files claim more than they hold
+			uint64_t available = window->file_size - body;
+			if (size > available) {
+				size = available;
+			}
+			have_data = true;
+			info->data_offset = body;
+			info->frame_count = size / info->block_align;
+		}
+
+		// Chunks are padded to an even size, which some writers forget. The
+		// padding byte is zero, an ID right after the chunk means it was left out
+		uint64_t next = body + size;
+		if (size & 1) {
+			const uint8_t* unpadded = window_get(window, next, 4);
+			if (!(unpadded && is_chunk_id(unpadded))) {
+				next++;
+			}
+		}
+		offset = next;
+	}
+
+	if (!have_data) {
+		return WAV_READER_UNSUPPORTED;
+	}
+	if (info->has_loop && info->loop_end > info->frame_count) {
+		info->has_loop = false;
+	}
+	return 0;
+}
+
+int wav_query_file(const char* path, WavInfo* info) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return WAV_READER_CANNOT_OPEN;
+	}
+	// Only the window is ever read
+	setvbuf(file, NULL, _IONBF, 0);
+	int result = wav_read_info(file, info);
+	fclose(file);
+	return result;
+}
+
+// Formats wav_reader_read converts
+static bool is_readable(const WavInfo* info) {
+	if (info->format == WAVE_FORMAT_IEEE_FLOAT) {
+		if (info->bits_per_sample != 32) {
+			return false;
+		}
+	} else if (info->format != WAVE_FORMAT_PCM || info->bits_per_sample % 8 != 0 ||
+	           info->bits_per_sample == 0 || info->bits_per_sample > 32) {
+		return false;
+	}
+	return info->sample_rate != 0 &&
+	       info->block_align == info->channels * info->bits_per_sample / 8 &&
+	       info->frame_count <= UINT32_MAX;
+}
+
+// FLAC, Ogg Vorbis or MP3 in place of a WAV
+static int open_decoder(WavReader* reader) {
+	reader->decoder = audio_decoder_open(reader->file);
+	if (!reader->decoder || reader->decoder->frame_count > UINT32_MAX) {
+		wav_reader_close(reader);
+		return WAV_READER_UNSUPPORTED;
+	}
+
+	reader->channels = reader->decoder->channels;
+	reader->sample_rate = reader->decoder->sample_rate;
+	reader->is_float = true;
+	reader->frame_count = (uint32_t)reader->decoder->frame_count;
+	reader->frames_left = reader->frame_count;
+	reader->source_frames_left = reader->frame_count;
+	reader->has_loop = reader->decoder->has_loop;
+	reader->loop_start = reader->decoder->loop_start;
+	reader->loop_end = reader->decoder->loop_end;
+	return 0;
+}
+
+int wav_reader_open(const char* path, WavReader* reader) {
+	memset(reader, 0, sizeof(*reader));
+	reader->file = fopen(path, "rb");
+	if (!reader->file) {
+		return WAV_READER_CANNOT_OPEN;
+	}
+
+	uint8_t magic[4];
+	bool is_wav = fread(magic, 1, sizeof(magic), reader->file) == sizeof(magic) &&
+	              (memcmp(magic, "RIFF", 4) == 0 || memcmp(magic, "RF64", 4) == 0 ||
+	               memcmp(magic, "BW64", 4) == 0);
+	if (!is_wav) {
+		rewind(reader->file);
+		return open_decoder(reader);
+	}
+
+	WavInfo info;
+	if (wav_read_info(reader->file, &info) != 0 || !is_readable(&info) ||
+	        seek_file(reader->file, (int64_t)info.data_offset, SEEK_SET) != 0) {
+		wav_reader_close(reader);
+		return WAV_READER_UNSUPPORTED;
+	}
+
+	reader->channels = info.channels;
+	reader->sample_rate = info.sample_rate;
+	reader->bits_per_sample = info.bits_per_sample;
+	reader->block_align = info.block_align;
+	reader->is_float = info.format == WAVE_FORMAT_IEEE_FLOAT;
+	reader->frame_count = (uint32_t)info.frame_count;
+	reader->frames_left = reader->frame_count;
+	reader->source_frames_left = reader->frame_count;
+	reader->has_loop = info.has_loop;
+	reader->loop_start = info.loop_start;
+	reader->loop_end = info.loop_end;
+	reader->data_offset = info.data_offset;
+	return 0;
+}
+
+// Converts values samples, one switch per block rather than per sample so
+// the 16-bit loop, by far the most common, vectorizes
+static void convert_block(const WavReader* reader, const uint8_t* block, float* samples,
+                          size_t values) {
+	switch (reader->bits_per_sample) {
+	case 8:
+		for (size_t i = 0; i < values; i++) {
+			samples[i] = ((int)block[i] - 128) / 128.0f;
+		}
+		break;
+	case 16:
+		for (size_t i = 0; i < values; i++) {
+			samples[i] = (int16_t)read_le16(block + 2 * i) / 32768.0f;
+		}
+		break;
+	case 24:
+		for (size_t i = 0; i < values; i++) {
+			const uint8_t* p = block + 3 * i;
+			int32_t value = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 |
+			                          (uint32_t)p[2] << 24);
+			samples[i] = (value >> 8) / 8388608.0f;
+		}
+		break;
+	default:
+		for (size_t i = 0; i < values; i++) {
+			uint32_t bits = read_le32(block + 4 * i);
+			if (reader->is_float) {
+				memcpy(&samples[i], &bits, sizeof(float));
+			} else {
+				samples[i] = (int32_t)bits / 2147483648.0f;
+			}
+		}
+		break;
+	}
+}
+
+// Frames as the file has them
+static size_t read_source(WavReader* reader, float* samples, size_t count) {
+	if (count > reader->source_frames_left) {
+		count = reader->source_frames_left;
+	}
+
+	if (reader->decoder) {
+		size_t done = reader->decoder->read(reader->decoder, samples, count);
+		reader->source_frames_left = done < count ? 0 : reader->source_frames_left -
+		                             (uint32_t)done;
+		return done;
+	}
+
+	uint8_t block[READ_BLOCK_SIZE * 4];
+	size_t frames_per_block = sizeof(block) / reader->block_align;
+	size_t done = 0;
+	while (done < count) {
+		size_t frames = count - done;
+		if (frames > frames_per_block) {
+			frames = frames_per_block;
+		}
+
+		size_t got = fread(block, reader->block_align, frames, reader->file);
+		convert_block(reader, block, samples + done * reader->channels, got * reader->channels);
+
+		done += got;
+		if (got < frames) {
+			// Truncated data chunk, the rest reads as nothing
+			reader->source_frames_left = 0;
+			return done;
+		}
+	}
+
+	reader->source_frames_left -= (uint32_t)done;
+	return done;
+}
+
+static uint32_t scale_position(uint32_t position, unsigned from_rate, unsigned to_rate) {
+	return (uint32_t)resampler_output_frames(position, from_rate, to_rate);
+}
+
+int wav_reader_resample(WavReader* reader, unsigned sample_rate) {
+	if (sample_rate == reader->sample_rate) {
+		return 0;
+	}
+	uint64_t frame_count = resampler_output_frames(reader->frame_count, reader->sample_rate,
+	                       sample_rate);
+	if (frame_count > UINT32_MAX) {
+		return -1;
+	}
+	reader->resampler = resampler_create(reader->channels, reader->sample_rate, sample_rate);
+	if (!reader->resampler) {
+		return -1;
+	}
+
+	if (reader->has_loop) {
+		reader->loop_start = scale_position(reader->loop_start, reader->sample_rate,
+		                                    sample_rate);
+		reader->loop_end = scale_position(reader->loop_end, reader->sample_rate, sample_rate);
+		reader->has_loop = reader->loop_start < reader->loop_end;
+	}
+	reader->sample_rate = sample_rate;
+	reader->frame_count = (uint32_t)frame_count;
+	reader->frames_left = reader->frame_count;
+	return 0;
+}
+
+size_t wav_reader_read(WavReader* reader, float* samples, size_t count) {
+	if (count > reader->frames_left) {
+		count = reader->frames_left;
+	}
+	if (!reader->resampler) {
+		size_t done = read_source(reader, samples, count);
+		reader->frames_left = done < count ? 0 : reader->frames_left - (uint32_t)done;
+		return done;
+	}
+
+	// The resampler always has room for a block once it asks for more input
+	float block[READ_BLOCK_SIZE];
+	size_t block_frames = READ_BLOCK_SIZE / reader->channels;
+	size_t done = 0;
+	for (;;) {
+		done += resampler_read(reader->resampler, samples + done * reader->channels,
+		                       count - done);
+		if (done == count) {
+			break;
+		}
+		size_t got = read_source(reader, block, block_frames);
+		if (got == 0) {
+			resampler_finish(reader->resampler);
+		} else {
+			resampler_write(reader->resampler, block, got);
+		}
+	}
+
+	reader->frames_left -= (uint32_t)done;
+	return done;
+}
+
+int wav_reader_rewind(WavReader* reader) {
+	if (reader->resampler) {
+		return -1;
+	}
+	if (reader->decoder) {
+		// Decoders only go forward, a new one starts over
+		AudioDecoder* previous = reader->decoder;
+		rewind(reader->file);
+		reader->decoder = audio_decoder_open(reader->file);
+		bool same = reader->decoder && reader->decoder->channels == previous->channels &&
+		            reader->decoder->sample_rate == previous->sample_rate;
+		audio_decoder_close(previous);
+		if (!same) {
+			return -1;
+		}
+	} else if (seek_file(reader->file, (int64_t)reader->data_offset, SEEK_SET) != 0) {
+		return -1;
+	}
+	reader->frames_left = reader->frame_count;
+	reader->source_frames_left = reader->frame_count;
+	return 0;
+}
+
+void wav_reader_close(WavReader* reader) {
+	audio_decoder_close(reader->decoder);
+	reader->decoder = NULL;
+	if (reader->file) {
+		fclose(reader->file);
+		reader->file = NULL;
+	}
+	resampler_free(reader->resampler);
+	reader->resampler = NULL;
+}
@@ -0,0 +1,249 @@
+#include "wav_tagger.h"
+#include "thread_pool.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define seek_file _fseeki64
+#define tell_file _ftelli64
+#define truncate_file(file, size) _chsize_s(_fileno(file), (long long)(size))
+#else
+#include <unistd.h>
+#define seek_file fseeko
+#define tell_file ftello
+#define truncate_file(file, size) ftruncate(fileno(file), (off_t)(size))
+#endif
+
+#define CHUNK_HEADER_SIZE 8
+
+// Where the chunks of a WAV end and where its INFO list is
+typedef struct {
+	uint64_t end;         // End of the last chunk, padding included
+	bool has_info;
+	uint64_t info_offset;
+	uint64_t info_size;   // Whole chunk, header and padding included
+} RiffLayout;
+
+static uint32_t read_le32(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+	       ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t* p, uint32_t value) {
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+	p[2] = (uint8_t)(value >> 16);
+	p[3] = (uint8_t)(value >> 24);
+}
+
+static size_t read_at(FILE* file, uint64_t offset, void* buffer, size_t size) {
+	if (seek_file(file, (int64_t)offset, SEEK_SET) != 0) {
+		return 0;
+	}
+	return fread(buffer, 1, size, file);
+}
+
+static bool write_at(FILE* file, uint64_t offset, const void* buffer, size_t size) {
+	return seek_file(file, (int64_t)offset, SEEK_SET) == 0 &&
+	       fwrite(buffer, 1, size, file) == size;
+}
+
+// Printable four character code, as every chunk ID is
+static bool is_chunk_id(const uint8_t* id) {
+	for (int i = 0; i < 4; i++) {
+		if (id[i] < 0x20 || id[i] > 0x7E) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool is_chunk_at(FILE* file, uint64_t offset, uint64_t end) {
+	uint8_t id[4];
+	return offset + CHUNK_HEADER_SIZE <= end && read_at(file, offset, id, 4) == 4 &&
+	       is_chunk_id(id);
+}
+
+static int walk_chunks(FILE* file, uint64_t file_size, RiffLayout* layout) {
+	uint8_t header[12];
+	if (read_at(file, 0, header, sizeof(header)) != sizeof(header) ||
+	        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+		return WAV_TAG_BAD_INPUT;
+	}
+	uint64_t end = CHUNK_HEADER_SIZE + (uint64_t)read_le32(header + 4);
+	if (end > file_size) {
+		end = file_size;
+	}
+
+	memset(layout, 0, sizeof(*layout));
+	uint64_t offset = sizeof(header);
+	uint8_t chunk[12];
+	while (offset + CHUNK_HEADER_SIZE <= end &&
+	        read_at(file, offset, chunk, sizeof(chunk)) >= CHUNK_HEADER_SIZE &&
+	        is_chunk_id(chunk)) {
+		uint32_t size = read_le32(chunk + 4);
+		uint64_t next = offset + CHUNK_HEADER_SIZE + size;
+		if (next > end) {
+			// Anything written after it would be read as part of it
+			return WAV_TAG_BAD_INPUT;
+		}
+		// Some writers leave out the padding byte of odd-sized chunks. The byte
+		// is zero when it is there, so an ID right after the chunk means it isn't
+		if ((size & 1) && next < end && !is_chunk_at(file, next, end)) {
+			next++;
+		}
+
+		if (!layout->has_info && memcmp(chunk, "LIST", 4) == 0 && size >= 4 &&
+		        memcmp(chunk + 8, "INFO", 4) == 0) {
+			layout->has_info = true;
+			layout->info_offset = offset;
+			layout->info_size = next - offset;
+		}
+		offset = next;
+	}
+	layout->end = offset;
+	return 0;
+}
+
+// Size of a text subchunk: header, the string, its terminator and padding
+static size_t text_chunk_size(const char* text) {
+	size_t size = strlen(text) + 1;
+	return CHUNK_HEADER_SIZE + size + (size & 1);
+}
+
+static uint8_t* put_text_chunk(uint8_t* p, const char* id, const char* text) {
+	size_t size = strlen(text) + 1;
+	memcpy(p, id, 4);
+	put_le32(p + 4, (uint32_t)size);
+	memcpy(p + CHUNK_HEADER_SIZE, text, size);
+	p += CHUNK_HEADER_SIZE + size;
+	if (size & 1) {
+		*p++ = 0;
+	}
+	return p;
+}
+
+// Whole LIST chunk, always an even number of bytes
+static uint8_t* build_info_list(const WavTags* tags, size_t* list_size) {
+	const char* ids[] = {"INAM", "IPRD", "IART", "IGNR", "ITRK"};
+	const char* texts[] = {tags->title, tags->album, tags->artist, tags->genre, tags->track};
+	const int text_count = sizeof(ids) / sizeof(ids[0]);
+
+	size_t size = CHUNK_HEADER_SIZE + 4;
+	for (int i = 0; i < text_count; i++) {
+		if (texts[i]) {
+			size += text_chunk_size(texts[i]);
+		}
+	}
+	if (size - CHUNK_HEADER_SIZE > UINT32_MAX) {
+		return NULL;
+	}
+	uint8_t* list = malloc(size);
+	if (!list) {
+		return NULL;
+	}
+
+	memcpy(list, "LIST", 4);
+	put_le32(list + 4, (uint32_t)(size - CHUNK_HEADER_SIZE));
+	memcpy(list + CHUNK_HEADER_SIZE, "INFO", 4);
+	uint8_t* p = list + CHUNK_HEADER_SIZE + 4;
+	for (int i = 0; i < text_count; i++) {
+		if (texts[i]) {
+			p = put_text_chunk(p, ids[i], texts[i]);
+		}
+	}
+	*list_size = size;
+	return list;
+}
+
+static int write_tags(FILE* file, const uint8_t* list, size_t list_size) {
+	if (seek_file(file, 0, SEEK_END) != 0) {
+		return WAV_TAG_WRITE_FAILED;
+	}
+	int64_t file_size = tell_file(file);
+	RiffLayout layout;
+	int result = file_size < 0 ? WAV_TAG_WRITE_FAILED :
+	             walk_chunks(file, (uint64_t)file_size, &layout);
+	if (result != 0) {
+		return result;
+	}
+
+	// Same size, nothing else has to change
+	if (layout.has_info && layout.info_size == list_size) {
+		return write_at(file, layout.info_offset, list, list_size) ? 0 : WAV_TAG_WRITE_FAILED;
+	}
+
+	uint64_t offset = layout.end;
+	if (layout.has_info && layout.info_offset + layout.info_size == layout.end) {
+		offset = layout.info_offset;
+	} else if (layout.has_info && !write_at(file, layout.info_offset, "JUNK", 4)) {
+		return WAV_TAG_WRITE_FAILED;
+	}
+
+	// Chunks start on even offsets
+	if ((offset & 1) && !write_at(file, offset++, "", 1)) {
+		return WAV_TAG_WRITE_FAILED;
+	}
+	uint64_t end = offset + list_size;
+	if (end - CHUNK_HEADER_SIZE > UINT32_MAX) {
+		return WAV_TAG_BAD_INPUT;
+	}
+	uint8_t riff_size[4];
+	put_le32(riff_size, (uint32_t)(end - CHUNK_HEADER_SIZE));
+	if (!write_at(file, offset, list, list_size) || !write_at(file, 4, riff_size, 4) ||
+	        fflush(file) != 0) {
+		return WAV_TAG_WRITE_FAILED;
+	}
+
+	// Whatever followed the last chunk (a longer old list) is dropped
+	if ((uint64_t)file_size > end && truncate_file(file, end) != 0) {
+		return WAV_TAG_WRITE_FAILED;
+	}
+	return 0;
+}
+
+int wav_tag_file(const WavTags* tags) {
+	size_t list_size;
+	uint8_t* list = build_info_list(tags, &list_size);
+	if (!list) {
+		return WAV_TAG_BAD_INPUT;
+	}
+	FILE* file = fopen(tags->path, "rb+");
+	if (!file) {
+		free(list);
+		return WAV_TAG_WRITE_FAILED;
+	}
+
+	int result = write_tags(file, list, list_size);
+	if (fclose(file) != 0 && result == 0) {
+		result = WAV_TAG_WRITE_FAILED;
+	}
+	free(list);
+	return result;
+}
+
+typedef struct {
+	const WavTags* files;
+	atomic_int failed;
+} TagJob;
+
+static void tag_one(void* context, int index, int worker) {
+	(void)worker;
+	TagJob* job = context;
+	if (wav_tag_file(&job->files[index]) != 0) {
+		atomic_fetch_add(&job->failed, 1);
+	}
+}
+
+int wav_tag_files(const WavTags* files, int count, int worker_count) {
+	TagJob job = {files, 0};
+	if (count > 0 && parallel_for(count, worker_count, tag_one, &job) != 0) {
+		return -1;
+	}
+	return atomic_load(&job.failed);
+}
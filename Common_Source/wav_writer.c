@@ -0,0 +1,93 @@
+#include "wav_writer.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+// Samples converted per fwrite
+#define WRITE_BLOCK_SIZE 4096
+
+static uint8_t* put_le16(uint8_t* p, unsigned value) {
+	*p++ = (uint8_t)value;
+	*p++ = (uint8_t)(value >> 8);
+	return p;
+}
+
+static uint8_t* put_le32(uint8_t* p, uint32_t value) {
+	p = put_le16(p, value & 0xFFFF);
+	return put_le16(p, value >> 16);
+}
+
+int wav_write_header(FILE* file, unsigned channels, unsigned sample_rate,
+                     uint32_t frame_count) {
+	uint32_t block_align = channels * 2;
+	uint32_t data_size = frame_count * block_align;
+	uint8_t header[44];
+	uint8_t* p = header;
+
+	memcpy(p, "RIFF", 4);
+	p = put_le32(p + 4, 36 + data_size);
+	memcpy(p, "WAVEfmt ", 8);
+	p = put_le32(p + 8, 16);
+	p = put_le16(p, 1); // PCM
+	p = put_le16(p, channels);
+	p = put_le32(p, sample_rate);
+	p = put_le32(p, sample_rate * block_align);
+	p = put_le16(p, block_align);
+	p = put_le16(p, 16);
+	memcpy(p, "data", 4);
+	put_le32(p + 4, data_size);
+
+	return (fwrite(header, 1, sizeof(header), file) == sizeof(header)) ? 0 : -1;
+}
+
+// Rounds to nearest like lrintf, clamping first gives the same result
+static size_t convert_block(uint8_t* block, const float* samples, size_t count) {
+	size_t i = 0;
+#if defined(HAVE_SSE2)
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	const __m128 low = _mm_set1_ps(-32768.0f);
+	const __m128 high = _mm_set1_ps(32767.0f);
+	// Little endian like the file, so the packed words are stored as they are
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(samples + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(samples + i + 4), scale);
+		a = _mm_min_ps(_mm_max_ps(a, low), high);
+		b = _mm_min_ps(_mm_max_ps(b, low), high);
+		__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+		_mm_storeu_si128((__m128i*)(block + i * 2), packed);
+	}
+#else
+	(void)block;
+	(void)samples;
+	(void)count;
+#endif
+	return i;
+}
+
+int wav_write_samples(FILE* file, const float* samples, size_t count) {
+	uint8_t block[WRITE_BLOCK_SIZE * 2];
+
+	while (count > 0) {
+		size_t values = (count < WRITE_BLOCK_SIZE) ? count : WRITE_BLOCK_SIZE;
+		for (size_t i = convert_block(block, samples, values); i < values; i++) {
+			long value = lrintf(samples[i] * 32768.0f);
+			if (value > 32767) {
+				value = 32767;
+			} else if (value < -32768) {
+				value = -32768;
+			}
+			put_le16(block + i * 2, (unsigned)value & 0xFFFF);
+		}
+
+		if (fwrite(block, 2, values, file) != values) {
+			return -1;
+		}
+		samples += values;
+		count -= values;
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+#include "xxh64.h"
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// Little endian whatever the host, like the reference
+static uint64_t read64(const uint8_t* p) {
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 |
+	       (uint64_t)p[3] << 24 | (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 |
+	       (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static uint32_t read32(const uint8_t* p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+	       (uint32_t)p[3] << 24;
+}
+
+static uint64_t round64(uint64_t accumulator, uint64_t input) {
+	accumulator += input * PRIME2;
+	return rotl(accumulator, 31) * PRIME1;
+}
+
+static uint64_t merge_round(uint64_t hash, uint64_t accumulator) {
+	hash ^= round64(0, accumulator);
+	return hash * PRIME1 + PRIME4;
+}
+
+uint64_t xxh64(const void* data, size_t size, uint64_t seed) {
+	const uint8_t* p = data;
+	const uint8_t* end = p + size;
+	uint64_t hash;
+
+	if (size >= 32) {
+		// Four independent lanes over 32-byte stripes
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+		const uint8_t* limit = end - 32;
+		do {
+			v1 = round64(v1, read64(p));
+			v2 = round64(v2, read64(p + 8));
+			v3 = round64(v3, read64(p + 16));
+			v4 = round64(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		hash = merge_round(hash, v1);
+		hash = merge_round(hash, v2);
+		hash = merge_round(hash, v3);
+		hash = merge_round(hash, v4);
+	} else {
+		hash = seed + PRIME5;
+	}
+	hash += (uint64_t)size;
+
+	for (; p + 8 <= end; p += 8) {
+		hash ^= round64(0, read64(p));
+		hash = rotl(hash, 27) * PRIME1 + PRIME4;
+	}
+	if (p + 4 <= end) {
+		hash ^= (uint64_t)read32(p) * PRIME1;
+		hash = rotl(hash, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		hash ^= *p * PRIME5;
+		hash = rotl(hash, 11) * PRIME1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
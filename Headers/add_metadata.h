@@ -6,20 +6,53 @@
 #include "config.h"
 #include "file_mapping.h"
 #include "initialization.h"
+#include "wav_tagger.h"
+
+// Tags and cue name renames for WAVs that are yet to be decoded
+typedef struct {
+	WavTags* tags;     // Paths and strings are owned by the list
+	char** new_names;  // Name each WAV gets once tagged, NULL keeps its own
+	int count;
+	int capacity;
+} MetadataList;
 
 /**
- * @brief Creates a batch file that adds metadata to extracted audio files.
+ * @brief Collects the metadata of the audio files extracted from an .awb.
  *
  * @param input_file The path to the original .awb file.
+ * @param metadata Appended to, for apply_metadata once the WAVs exist.
  * @return 0 on success, non-zero on failure.
  */
-int add_metadata(const char* input_file);
+int add_metadata(const char* input_file, MetadataList* metadata);
+
+// Tags the listed WAVs on all cores, then gives them their cue names
+void apply_metadata(const MetadataList* metadata);
+void free_metadata(MetadataList* metadata);
 
 char* generate_file_name(const char* sanitized_name, int original_num,
                          const char* extension,
                          FileMappingList* mapping, int config_dont_use_numbers);
 
 void rename_files_back(const char* foldername);
+
+typedef struct {
+	char original[MAX_PATH];
+	char renamed[MAX_PATH];
+} RenamedFile;
+
+/**
+ * @brief Gives the WAVs in a folder the numbered names the BGM tool expects.
+ *
+ * FLAC, Ogg Vorbis and MP3 files are renamed too, keeping their extension.
+ * Files whose numbered name is already taken are left alone.
+ *
+ * @param renamed Set to the renamed files, for restore_file_names.
+ * @return Number of files renamed, or -1 if the folder can't be read.
+ */
+int rename_wavs_back(const char* foldername, RenamedFile** renamed);
+
+// Undoes rename_wavs_back and frees the list
+void restore_file_names(RenamedFile* renamed, int count);
 int rename_hcas(const char* input_file);
 void sanitize_filename(const char* input, char* output);
 
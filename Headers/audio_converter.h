@@ -6,15 +6,21 @@
 #include <inttypes.h>
 #include "utils.h"
 #include "initialization.h"
+#include "add_metadata.h"
 
 // Extract HCA key from the .hcakey file in the given folder
 uint64_t extract_hca_key(const char* folder);
 
-// Process all WAV files in a folder
+// Encodes every WAV in a folder to HCA on all cores, -1 if any file failed
 int process_wav_files(const char* folder, uint64_t hca_key, int set_looping_points);
 int encrypt_hcas(const char* folder, uint64_t hcakey);
+// Sets loop points from start to end on the HCAs in a folder that have none
+// and no WAV next to them, returns how many were changed or -1
+int loop_hcas(const char* folder);
 
 int convert_hca_to_wav(const char* hca_path, const char* output_path);
-int process_hca_files(const char* folder);
+// Decodes every HCA in a folder to WAV on all cores and deletes the decoded
+// HCAs, then applies metadata (NULL for none). -1 if any file failed
+int process_hca_files(const char* folder, const MetadataList* metadata);
 
 #endif // AUDIO_CONVERTER_H
@@ -15,6 +15,7 @@ typedef struct {
     bool Use_Cue_Names;
     bool Dont_Use_Numbers;
     bool Disable_Looping;
+    bool Resample_To_48kHz;
     bool Disable_Metadata;
     bool Use_Cue_IDs;
     char Game_Directory[MAX_PATH];
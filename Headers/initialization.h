@@ -11,7 +11,6 @@
 typedef struct {
     AcbMappingData acb_mapping_data;
 	char program_directory[MAX_PATH];
-	char vgaudio_cli_path[MAX_PATH];
 	char acb_editor_path[MAX_PATH];
 	char unrealrezen_path[MAX_PATH];
 	char unrealpak_path[MAX_PATH];
@@ -19,7 +18,6 @@ typedef struct {
 	char unrealpak_exe_path[MAX_PATH];
 	char vgmstream_path[MAX_PATH];
 	char bgm_tool_path[MAX_PATH];
-	char metadata_tool_path[MAX_PATH];
 	bool is_cmd_mode;
 	Config config;
 } AppData;
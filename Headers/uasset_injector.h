@@ -6,6 +6,8 @@
 #include "utils.h"
 
 #define BUFFER_SIZE 4096
+// Lists the working copy of an injection in progress, see file_transaction.h
+#define INJECTION_JOURNAL "injection.journal"
 
 
 // Function declarations for the injector
@@ -1,4 +1,5 @@
 #include "add_metadata.h"
+#include "audio_decoder.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,9 +44,53 @@ char* generate_file_name(const char* sanitized_name, int original_num,
 	return new_name;
 }
 
+// Number of the track a renamed file was extracted from, or -1
+static int find_original_number(const char* filename, FileMappingList* mapping) {
+	int original_num = -1;
+
+	// Try Cue_N format first
+	if (strncmp(filename, "Cue_", 4) == 0) {
+		if (sscanf(filename + 4, "%d", &original_num) == 1) {
+			return original_num;
+		}
+	}
+
+	// If not found and we have a mapping, try to find by cue name
+	if (mapping) {
+		// Try to find the number from the mapped name
+		char cue_name[MAX_PATH];
+		strncpy(cue_name, filename, sizeof(cue_name) - 1);
+		cue_name[sizeof(cue_name) - 1] = '\0';
+		char* dot = strrchr(cue_name, '.');
+		if (dot) *dot = '\0';
+
+		// If the name contains " - ", extract the part after it
+		char* separator = strstr(cue_name, " - ");
+		if (separator) {
+			separator += 3; // Skip " - "
+			memmove(cue_name, separator, strlen(separator) + 1);
+		}
+
+		return get_number_from_cue_name(mapping, cue_name);
+	}
+	return -1;
+}
+
+static int is_bgm_folder(const char* foldername) {
+	return (strstr(foldername, "BGM") != NULL || strstr(foldername, "bgm") != NULL);
+}
+
+static void numbered_name(char* name, size_t size, int is_bgm, int original_num,
+                          const char* extension) {
+	if (is_bgm) {
+		snprintf(name, size, "%d.%s", original_num, extension);
+	} else {
+		snprintf(name, size, "%05d_streaming.%s", original_num, extension);
+	}
+}
+
 void rename_files_back(const char* foldername) {
-	int is_bgm = (strstr(foldername, "BGM") != NULL
-	              || strstr(foldername, "bgm") != NULL);
+	int is_bgm = is_bgm_folder(foldername);
 	DIR* dir;
 	struct dirent* ent;
 	FileMappingList* mapping = NULL;
@@ -58,46 +103,13 @@ void rename_files_back(const char* foldername) {
 			const char* filename = ent->d_name;
 			if (!strstr(filename, ".hca")) continue;
 
-			int original_num = -1;
-			int found = 0;
-
-			// Try Cue_N format first
-			if (strncmp(filename, "Cue_", 4) == 0) {
-				if (sscanf(filename + 4, "%d", &original_num) == 1) {
-					found = 1;
-				}
-			}
-
-			// If not found and we have a mapping, try to find by cue name
-			if (!found && mapping) {
-				// Try to find the number from the mapped name
-				char cue_name[MAX_PATH];
-				strncpy(cue_name, filename, sizeof(cue_name));
-				char* dot = strrchr(cue_name, '.');
-				if (dot) *dot = '\0';
-
-				// If the name contains " - ", extract the part after it
-				char* separator = strstr(cue_name, " - ");
-				if (separator) {
-					separator += 3; // Skip " - "
-					memmove(cue_name, separator, strlen(separator) + 1);
-				}
-
-				original_num = get_number_from_cue_name(mapping, cue_name);
-				if (original_num != -1) {
-					found = 1;
-				}
-			}
+			int original_num = find_original_number(filename, mapping);
 
 			// If we found a valid number through either method, proceed with rename
-			if (found) {
+			if (original_num != -1) {
 				// Determine new name
 				char new_name[MAX_PATH];
-				if (is_bgm) {
-					snprintf(new_name, sizeof(new_name), "%d.hca", original_num);
-				} else {
-					snprintf(new_name, sizeof(new_name), "%05d_streaming.hca", original_num);
-				}
+				numbered_name(new_name, sizeof(new_name), is_bgm, original_num, "hca");
 
 				// Delete existing file with target name first
 				char target_path[MAX_PATH];
@@ -120,7 +132,148 @@ void rename_files_back(const char* foldername) {
 	}
 }
 
-int add_metadata(const char* input_file) {
+int rename_wavs_back(const char* foldername, RenamedFile** renamed) {
+	int is_bgm = is_bgm_folder(foldername);
+	*renamed = NULL;
+
+	DIR* dir = opendir(foldername);
+	if (!dir) {
+		return -1;
+	}
+	FileMappingList* mapping = load_file_mapping(foldername);
+
+	int count = 0;
+	int capacity = 0;
+	struct dirent* ent;
+	while ((ent = readdir(dir)) != NULL) {
+		const char* ext = get_file_extension(ent->d_name);
+		if (!ext || (strcasecmp(ext, "wav") != 0 && !audio_decoder_handles(ext))) continue;
+
+		int original_num = find_original_number(ent->d_name, mapping);
+		if (original_num == -1) continue;
+
+		char new_name[MAX_PATH];
+		numbered_name(new_name, sizeof(new_name), is_bgm, original_num, ext);
+		if (strcmp(new_name, ent->d_name) == 0) continue;
+
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 16;
+			RenamedFile* grown = realloc(*renamed, capacity * sizeof(RenamedFile));
+			if (!grown) break;
+			*renamed = grown;
+		}
+
+		// Unlike the HCAs these are the user's files, nothing is overwritten
+		RenamedFile* file = &(*renamed)[count];
+		snprintf(file->original, sizeof(file->original), "%s\\%s", foldername, ent->d_name);
+		snprintf(file->renamed, sizeof(file->renamed), "%s\\%s", foldername, new_name);
+		if (access(file->renamed, F_OK) == 0) {
+			printf("Warning: %s was not used as %s already exists\n", ent->d_name, new_name);
+			continue;
+		}
+		if (rename(file->original, file->renamed) == 0) {
+			count++;
+		}
+	}
+	closedir(dir);
+
+	if (mapping) {
+		free_file_mapping(mapping);
+	}
+	return count;
+}
+
+void restore_file_names(RenamedFile* renamed, int count) {
+	for (int i = 0; i < count; i++) {
+		if (rename(renamed[i].renamed, renamed[i].original) != 0) {
+			fprintf(stderr, "Error: Could not rename %s back to %s\n",
+			        extract_name_from_path(renamed[i].renamed),
+			        extract_name_from_path(renamed[i].original));
+		}
+	}
+	free(renamed);
+}
+
+// Copies the strings, returns -1 on allocation failure
+static int append_metadata(MetadataList* metadata, const char* wav_path, const char* title,
+                           const char* album, const char* artist, const char* genre,
+                           const char* track, const char* new_name) {
+	if (metadata->count == metadata->capacity) {
+		int capacity = metadata->capacity ? metadata->capacity * 2 : 64;
+		WavTags* tags = realloc(metadata->tags, capacity * sizeof(WavTags));
+		if (tags) metadata->tags = tags;
+		char** new_names = realloc(metadata->new_names, capacity * sizeof(char*));
+		if (new_names) metadata->new_names = new_names;
+		if (!tags || !new_names) return -1;
+		metadata->capacity = capacity;
+	}
+
+	WavTags* tags = &metadata->tags[metadata->count];
+	tags->path = strdup(wav_path);
+	tags->title = strdup(title);
+	tags->album = strdup(album);
+	tags->artist = strdup(artist);
+	tags->genre = strdup(genre);
+	tags->track = strdup(track);
+	metadata->new_names[metadata->count] = new_name ? strdup(new_name) : NULL;
+	metadata->count++;
+	if (!tags->path || !tags->title || !tags->album || !tags->artist || !tags->genre ||
+	        !tags->track || (new_name && !metadata->new_names[metadata->count - 1])) {
+		return -1;
+	}
+	return 0;
+}
+
+// Frees the entries from first on
+static void truncate_metadata(MetadataList* metadata, int first) {
+	for (int i = first; i < metadata->count; i++) {
+		WavTags* tags = &metadata->tags[i];
+		free((char*)tags->path);
+		free((char*)tags->title);
+		free((char*)tags->album);
+		free((char*)tags->artist);
+		free((char*)tags->genre);
+		free((char*)tags->track);
+		free(metadata->new_names[i]);
+	}
+	metadata->count = first;
+}
+
+void free_metadata(MetadataList* metadata) {
+	truncate_metadata(metadata, 0);
+	free(metadata->tags);
+	free(metadata->new_names);
+	memset(metadata, 0, sizeof(*metadata));
+}
+
+void apply_metadata(const MetadataList* metadata) {
+	if (metadata->count == 0) {
+		return;
+	}
+
+	printf("Adding metadata to %d WAV file(s)...\n", metadata->count);
+	int failed = wav_tag_files(metadata->tags, metadata->count, 0);
+	if (failed != 0) {
+		fprintf(stderr, "Warning: Could not add metadata to %d WAV file(s)\n",
+		        failed < 0 ? metadata->count : failed);
+	}
+
+	// Renamed last, the tags are written to the extracted names
+	for (int i = 0; i < metadata->count; i++) {
+		if (!metadata->new_names[i]) continue;
+
+		const char* wav_path = metadata->tags[i].path;
+		char new_path[MAX_PATH];
+		snprintf(new_path, sizeof(new_path), "%s\\%s", get_parent_directory(wav_path),
+		         metadata->new_names[i]);
+		if (rename(wav_path, new_path) != 0) {
+			fprintf(stderr, "Warning: Could not rename %s to %s\n",
+			        extract_name_from_path(wav_path), metadata->new_names[i]);
+		}
+	}
+}
+
+int add_metadata(const char* input_file, MetadataList* metadata) {
 	char awb_path[MAX_PATH];
 
 	// Acbs would show all their cues, has to be the awb file
@@ -184,26 +337,9 @@ int add_metadata(const char* input_file) {
 		return 1;
 	}
 
-	// Create path for metadata batch file
-	char metadata_batch_path[MAX_PATH];
-	snprintf(metadata_batch_path, sizeof(metadata_batch_path),
-	         "%s\\add_metadata.bat", folder_path);
-
-	// Create a batch file for adding metadata
-	FILE* metadata_batch_file = fopen(metadata_batch_path, "w");
-	if (!metadata_batch_file) {
-		perror("Error creating metadata batch file");
-		if (mapping) free_file_mapping(mapping);
-		free(streamData.records);
-		streamData.records = NULL;
-		return 1;
-	}
-
-	// Write batch file header
-	fprintf(metadata_batch_file, "@echo off\n");
-	fprintf(metadata_batch_file, "echo Adding metadata to WAV files...\n");
-
 	// Iterate through files in the folder
+	int first_added = metadata->count;
+	int append_failed = 0;
 	DIR* dir;
 	struct dirent* ent;
 	if ((dir = opendir(folder_path)) != NULL) {
@@ -235,14 +371,15 @@ int add_metadata(const char* input_file) {
 					continue;
 
 				const char* genre = get_genre(awb_path);
-
-				fprintf(metadata_batch_file,
-				        "\"%s\" \"%s\" \"Cue: %s\" \"%s\" \"CueID: %s\" \"%s\" \"%d\"\n",
-				        app_data.metadata_tool_path, wav_file_path, // Now with .wav extension
-				        streamData.records[fileindex].stream_name, extract_name_from_path(awb_path),
-				        streamData.records[fileindex].cue_id, genre, fileindex + 1);
-
-				// Add rename command if Use_Cue_Names or Use_Cue_IDs is enabled
+				char title[MAX_PATH];
+				char artist[MAX_PATH];
+				char track[16];
+				snprintf(title, sizeof(title), "Cue: %s", streamData.records[fileindex].stream_name);
+				snprintf(artist, sizeof(artist), "CueID: %s", streamData.records[fileindex].cue_id);
+				snprintf(track, sizeof(track), "%d", fileindex + 1);
+				const char* new_name = NULL;
+
+				// Rename as well if Use_Cue_Names or Use_Cue_IDs is enabled
 				if (app_data.config.Use_Cue_Names || app_data.config.Use_Cue_IDs) {
 					const char* cue_name = streamData.records[fileindex].stream_name;
 					const char* cue_id = streamData.records[fileindex].cue_id;
@@ -270,11 +407,15 @@ int add_metadata(const char* input_file) {
 					}
 
 					// Generate new name
-					const char* new_name = generate_file_name(sanitized_name, original_num,
-					                       ".wav", mapping, app_data.config.Dont_Use_Numbers);
+					new_name = generate_file_name(sanitized_name, original_num,
+					                              ".wav", mapping, app_data.config.Dont_Use_Numbers);
+				}
 
-					// Write rename command
-					fprintf(metadata_batch_file, "ren \"%s\" \"%s\"\n", wav_file_path, new_name);
+				if (append_metadata(metadata, wav_file_path, title,
+				                    extract_name_from_path(awb_path), artist, genre, track,
+				                    new_name) != 0) {
+					append_failed = 1;
+					break;
 				}
 			}
 		}
@@ -284,7 +425,6 @@ int add_metadata(const char* input_file) {
 		if (mapping) free_file_mapping(mapping);
 		free(streamData.records);
 		streamData.records = NULL;
-		fclose(metadata_batch_file);
 		return 1;
 	}
 
@@ -294,13 +434,15 @@ int add_metadata(const char* input_file) {
 		free_file_mapping(mapping);
 	}
 
-	// Add completion message and cleanup to the batch file
-	fprintf(metadata_batch_file, "echo Metadata addition complete!\n");
-	fprintf(metadata_batch_file, "del \"%s\"\n", metadata_batch_path);
-	fclose(metadata_batch_file);
-
 	free(streamData.records);
 	streamData.records = NULL;
+
+	// A partial list would tag some files and not others
+	if (append_failed) {
+		fprintf(stderr, "Error: Out of memory while collecting metadata\n");
+		truncate_metadata(metadata, first_added);
+		return 1;
+	}
 	return 0;
 }
 
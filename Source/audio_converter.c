@@ -1,8 +1,23 @@
 #include "audio_converter.h"
+#include "audio_decoder.h"
+#include "hca_cipher.h"
+#include "hca_decoder.h"
+#include "hca_encoder.h"
+#include "hca_loop.h"
+#include "thread_pool.h"
+#include "atomic_file.h"
+#include "mapped_file.h"
+#include "xxh64.h"
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
 
+// HCAs encoded from the WAVs of a folder, named after the hash of their WAV
+// and encode settings, so unchanged WAVs are never encoded twice
+#define HCA_CACHE_FOLDER ".hca_cache"
+
 uint64_t extract_hca_key(const char* folder) {
 	char hcakey_path[MAX_PATH];
 	snprintf(hcakey_path, sizeof(hcakey_path), "%s/.hcakey", folder);
@@ -27,278 +42,398 @@ uint64_t extract_hca_key(const char* folder) {
 	return key;
 }
 
-int encrypt_hcas(const char* folder, uint64_t hcakey) {
-    DIR* dir = opendir(folder);
-    if (!dir) {
-        return -1;
-    }
-
-    printf("Checking if any HCA is in need of encryption...\n");
-
-    struct dirent* entry;
-    char input_path[MAX_PATH];
-    char output_path[MAX_PATH];
-    char command[MAX_PATH * 8];
-    char output[1024] = { 0 };
-    int success = 0;
-    FILE* output_file;
-
-    while ((entry = readdir(dir)) != NULL) {
-        const char* ext = get_file_extension(entry->d_name);
-        if (ext != NULL && strcasecmp(ext, "hca") == 0) {
-            // Construct full input path
-            snprintf(input_path, sizeof(input_path), "%s\\%s", folder, entry->d_name);
-
-            // Check if HCA is encrypted by reading the first 3 bytes
-            FILE* hca_file = fopen(input_path, "rb");
-            if (!hca_file) {
-                continue;
-            }
-
-            char header[3];
-            fread(header, 1, 3, hca_file);
-            fclose(hca_file);
-
-            if (memcmp(header, "HCA", 3) != 0) {
-                // HCA is likely already encrypted, skip it
-                continue;
-            }
-
-            // Construct path for the corresponding .wav file using your replace_extension
-            const char* wav_path = replace_extension(input_path, "wav");
-            if (!wav_path) {
-                continue;
-            }
-
-            // Check if the .wav file exists using your is_path_exists
-            if (is_path_exists(wav_path)) {
-                continue;
-            }
-
-            // Construct full output path (no change here)
-            snprintf(output_path, sizeof(output_path), "%s\\%s", folder, entry->d_name);
-
-            // Create a temporary file for output
-            char temp_output_path[MAX_PATH];
-            snprintf(temp_output_path, sizeof(temp_output_path), "%s\\temp_output_%d.txt",
-                folder, rand());
-
-            // Construct command with output redirected to temp file
-            snprintf(command, sizeof(command),
-                "\"\"%s\" -i \"%s\" \"%s\" --keycode %" PRIu64 " >%s 2>&1\"",
-                app_data.vgaudio_cli_path, input_path, output_path, hcakey, temp_output_path);
-
-            // Execute command
-            system(command);
-
-            // Check output file
-            output_file = fopen(temp_output_path, "r");
-            if (output_file) {
-                if (fgets(output, sizeof(output), output_file) != NULL) {
-                   success++;
-                }
-                fclose(output_file);
-            }
-
-            // Remove temporary output file
-            remove(temp_output_path);
-        }
-    }
-
-    closedir(dir);
-    return success;
+typedef char FileName[MAX_PATH];
+
+// Files the HCA encoder reads, FLAC, Ogg Vorbis and MP3 are decoded on the fly
+static bool is_source_audio(const char* extension) {
+	return strcasecmp(extension, "wav") == 0 || audio_decoder_handles(extension);
 }
 
-int process_wav_files(const char* folder, uint64_t hca_key,
-                      int set_looping_points) {
+// Whether an HCA has a source file next to it that it will be encoded from
+static bool has_source_audio(const char* hca_path) {
+	if (is_path_exists(replace_extension(hca_path, "wav"))) {
+		return true;
+	}
+	for (int i = 0; i < AUDIO_DECODER_EXTENSION_COUNT; i++) {
+		if (is_path_exists(replace_extension(hca_path, audio_decoder_extensions[i]))) {
+			return true;
+		}
+	}
+	return false;
+}
 
-	if (set_looping_points)
-		printf("Checking if any WAVs need conversion...\n");
+// Collects the names of the files in folder with the given extension, or of
+// the source audio files if it is NULL, the caller frees *names
+static int list_files(const char* folder, const char* extension, FileName** names,
+                      int* count) {
 	DIR* dir = opendir(folder);
 	if (!dir) {
 		perror("Error opening directory");
 		return -1;
 	}
 
-	// Create a batch file for all conversions
-	char batch_path[MAX_PATH];
-	snprintf(batch_path, sizeof(batch_path), "%s\\convert_wav.bat", folder);
-	FILE* batch_file = fopen(batch_path, "w");
-	if (!batch_file) {
-		perror("Error creating batch file");
-		closedir(dir);
+	*names = NULL;
+	*count = 0;
+	int capacity = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		const char* ext = get_file_extension(entry->d_name);
+		if (ext == NULL || (extension ? strcasecmp(ext, extension) != 0 :
+		                    !is_source_audio(ext))) {
+			continue;
+		}
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			FileName* grown = realloc(*names, capacity * sizeof(FileName));
+			if (!grown) {
+				perror("Error listing files");
+				free(*names);
+				closedir(dir);
+				return -1;
+			}
+			*names = grown;
+		}
+		snprintf((*names)[(*count)++], MAX_PATH, "%s", entry->d_name);
+	}
+	closedir(dir);
+	return 0;
+}
+
+int encrypt_hcas(const char* folder, uint64_t hcakey) {
+	FileName* names;
+	int count;
+	if (list_files(folder, "hca", &names, &count) != 0) {
 		return -1;
 	}
 
+	printf("Checking if any HCA is in need of encryption...\n");
 
-	// Write batch file header
-	fprintf(batch_file, "@chcp 65001 >nul\n@echo off\n");
-	fprintf(batch_file, "echo Starting WAV to HCA conversion...\n");
+	char hca_path[MAX_PATH];
+	int success = 0;
+	for (int i = 0; i < count; i++) {
+		snprintf(hca_path, sizeof(hca_path), "%s\\%s", folder, names[i]);
+
+		// The ciph chunk tells whether the HCA is already encrypted
+		HcaInfo info;
+		if (hca_query_file(hca_path, &info) != 0 || info.cipher_type != HCA_CIPHER_NONE) {
+			continue;
+		}
+
+		// HCAs converted from a WAV in the folder are already handled
+		if (has_source_audio(hca_path)) {
+			continue;
+		}
+
+		// Only the frame bytes are remapped, nothing gets decoded
+		if (hca_rekey_file(hca_path, 0, HCA_CIPHER_KEYED, hcakey) != 0) {
+			fprintf(stderr, "Error: Could not encrypt '%s'\n", names[i]);
+			continue;
+		}
+		success++;
+	}
+
+	free(names);
+	return success;
+}
+
+int loop_hcas(const char* folder) {
+	FileName* names;
+	int count;
+	if (list_files(folder, "hca", &names, &count) != 0) {
+		return -1;
+	}
 
-	struct dirent* entry;
-	char wav_path[MAX_PATH];
 	char hca_path[MAX_PATH];
-	char temp_file[MAX_PATH];
-	char command[MAX_PATH * 8];
-	int has_files = 0;
+	int looped = 0;
+	for (int i = 0; i < count; i++) {
+		snprintf(hca_path, sizeof(hca_path), "%s\\%s", folder, names[i]);
+
+		// Loops that are already set, even partial ones, are kept
+		HcaInfo info;
+		if (hca_query_file(hca_path, &info) != 0 || info.loop_enabled) {
+			continue;
+		}
+		if (has_source_audio(hca_path)) {
+			continue;
+		}
 
-	while ((entry = readdir(dir)) != NULL) {
-		const char* ext = get_file_extension(entry->d_name);
-		if (ext != NULL && strcasecmp(ext, "wav") == 0) {
-			has_files = 1;
-			// Construct full paths
-			snprintf(wav_path, sizeof(wav_path), "%s\\%s", folder, entry->d_name);
-			const char* basename = get_basename(entry->d_name);
-			snprintf(hca_path, sizeof(hca_path), "%s\\%s.hca", folder, basename);
-			if (set_looping_points) {
-				snprintf(temp_file, sizeof(temp_file), "%s\\temp_samples.txt", folder);
-
-				// Get total samples and sample rate using vgmstream
-				snprintf(command, sizeof(command), "\"\"%s\" -m \"%s\" > \"%s\"\"",
-				         app_data.vgmstream_path, wav_path, temp_file);
-				system(command);
-				int samples = 0;
-				int sample_rate = 0;
-				FILE* temp = fopen(temp_file, "r");
-				if (temp) {
-					char buffer[1024] = {0};
-					while (fgets(buffer, sizeof(buffer), temp)) {
-						if (strstr(buffer, "sample rate:") != NULL) {
-							char* sample_rate_str = strstr(buffer, "sample rate:") + 12;
-							sample_rate = atoi(sample_rate_str);
-
-						} else if (strstr(buffer, "stream total samples:") != NULL) {
-							char* samples_str = strstr(buffer, "samples:") + 8;
-							samples = atoi(samples_str);
-							break; // No need to continue if we have both values
-						}
-					}
-					fclose(temp);
-					remove(temp_file);
-
-					if (sample_rate != 48000) {
-						fprintf(stderr,
-						        "Warning: File '%s' has a different sampling rate: %dHz, 48KHz is preferred\n",
-						        extract_name_from_path(wav_path), sample_rate);
-					}
-
-					if (samples > 0) {
-						fprintf(batch_file, "echo Converting %s to HCA (adding loop points 0-%d)\n",
-						        basename, samples);
-						fprintf(batch_file, "\"%s\" \"%s\" \"%s\" --keycode %" PRIu64
-						        " --out-format hca -l 0-%d\n",
-						        app_data.vgaudio_cli_path, wav_path, hca_path, hca_key, samples);
-					}
-				}
-			} else {
-				fprintf(batch_file, "echo Converting %s to HCA\n", basename);
-				fprintf(batch_file, "\"%s\" \"%s\" \"%s\" --keycode %" PRIu64
-				        " --out-format hca\n",
-				        app_data.vgaudio_cli_path, wav_path, hca_path, hca_key);
-			}
+		// Only the header is patched, the audio stays as it is
+		if (hca_set_loop_file(hca_path, 0, 0) != 0) {
+			fprintf(stderr, "Error: Could not set the loop points of '%s'\n", names[i]);
+			continue;
 		}
+		looped++;
 	}
 
-	// Add completion message and auto-exit
-	fprintf(batch_file, "echo Conversion complete!\n");
-	fprintf(batch_file, "del \"%s\\convert_wav.bat\"\n", folder);
-	fprintf(batch_file, "exit\n");
-	fclose(batch_file);
-	closedir(dir);
+	free(names);
+	return looped;
+}
 
-	if (!has_files) {
-		remove(batch_path);
-		return 0;
+typedef struct {
+	const char* folder;
+	FileName* names;
+	HcaEncodeOptions options;
+	uint64_t* cache_keys; // Per WAV, 0 if it couldn't be hashed
+	int total;
+	atomic_int done;
+	atomic_int reused;
+	atomic_int failed;
+} WavConversionJob;
+
+// Identifies the HCA a WAV encodes to from its bytes, the options and the
+// encoder version
+static int get_cache_key(const char* wav_path, const HcaEncodeOptions* options,
+                         uint64_t* key) {
+	MappedFile wav;
+	if (mapped_file_open(wav_path, &wav) != 0) {
+		return -1;
 	}
-	if (set_looping_points) {
-		printf("Note: Looping points were set from start to end for converted HCAs\n");
+	uint64_t settings[7] = {
+		xxh64(wav.data, (size_t)wav.size, 0), options->key, options->loop,
+		options->loop_start, options->loop_end,
+		(uint64_t)options->frame_size << 32 | HCA_ENCODER_VERSION, options->sample_rate
+	};
+	mapped_file_close(&wav);
+
+	*key = xxh64(settings, sizeof(settings), 0);
+	return 0;
+}
+
+static void get_cache_path(const char* folder, uint64_t key, char* path, size_t size) {
+	snprintf(path, size, "%s\\%s\\%016" PRIx64 ".hca", folder, HCA_CACHE_FOLDER, key);
+}
+
+// Keeps a copy of a new HCA, failing to only costs an encode next time. Two
+// identical WAVs share a key, so each worker writes its own temporary file
+static void store_in_cache(const char* hca_path, const char* cache_path, int worker) {
+	char temp_path[MAX_PATH];
+	snprintf(temp_path, sizeof(temp_path), "%s.%d.tmp", cache_path, worker);
+	if (atomic_file_clone(hca_path, temp_path) != 0 ||
+	        atomic_file_replace(temp_path, cache_path) != 0) {
+		remove(temp_path);
+	}
+}
+
+// Drops the cached HCAs no WAV of the folder encodes to anymore
+static void prune_cache(const char* folder, const uint64_t* keys, int count) {
+	char cache_folder[MAX_PATH];
+	snprintf(cache_folder, sizeof(cache_folder), "%s\\%s", folder, HCA_CACHE_FOLDER);
+	FileName* names;
+	int cached;
+	if (list_files(cache_folder, "hca", &names, &cached) != 0) {
+		return;
 	}
 
-	// Execute the batch file in a new window and wait for completion
-	snprintf(command, sizeof(command),
-	         "start \"WAV to HCA Conversion\" /wait cmd /C \"chcp 65001 >nul && \"%s\"\"",
-	         batch_path);
-	return system(command);
+	for (int i = 0; i < cached; i++) {
+		uint64_t key = strtoull(names[i], NULL, 16);
+		bool used = false;
+		for (int k = 0; k < count && !used; k++) {
+			used = keys[k] != 0 && keys[k] == key;
+		}
+		if (!used) {
+			char path[MAX_PATH];
+			snprintf(path, sizeof(path), "%s\\%s", cache_folder, names[i]);
+			remove(path);
+		}
+	}
+	free(names);
 }
 
-int process_hca_files(const char* folder) {
-	DIR* dir = opendir(folder);
-	if (!dir) {
-		perror("Error opening directory");
+static void convert_wav(void* context, int index, int worker) {
+	WavConversionJob* job = context;
+	const char* name = job->names[index];
+
+	char wav_path[MAX_PATH];
+	char hca_path[MAX_PATH];
+	snprintf(wav_path, sizeof(wav_path), "%s\\%s", job->folder, name);
+	char* basename = get_basename(name);
+	snprintf(hca_path, sizeof(hca_path), "%s\\%s.hca", job->folder, basename ? basename : name);
+	free(basename);
+
+	char cache_path[MAX_PATH] = "";
+	if (get_cache_key(wav_path, &job->options, &job->cache_keys[index]) == 0) {
+		get_cache_path(job->folder, job->cache_keys[index], cache_path, sizeof(cache_path));
+		if (is_path_exists(cache_path) && atomic_file_clone(cache_path, hca_path) == 0) {
+			int done = atomic_fetch_add(&job->done, 1) + 1;
+			atomic_fetch_add(&job->reused, 1);
+			printf("[%d/%d] %s was already encoded, reused its HCA\n", done, job->total, name);
+			return;
+		}
+	}
+
+	WavReader wav;
+	int result = wav_reader_open(wav_path, &wav);
+	if (result != 0) {
+		fprintf(stderr, "Error: %s '%s'\n", (result == WAV_READER_UNSUPPORTED) ?
+		        "Unsupported format (PCM or float WAV, FLAC, Ogg Vorbis or MP3 expected) in" :
+		        "Could not open", name);
+		atomic_store(&job->failed, 1);
+		return;
+	}
+
+	if (wav.sample_rate != 48000 && job->options.sample_rate == 0) {
+		fprintf(stderr,
+		        "Warning: File '%s' has a different sampling rate: %uHz, 48KHz is preferred\n",
+		        name, wav.sample_rate);
+	}
+	result = hca_encode_wav(&wav, hca_path, &job->options);
+	wav_reader_close(&wav);
+	if (result != 0) {
+		fprintf(stderr, "Error: Could not %s '%s'\n", (result == HCA_ENCODE_BAD_INPUT) ?
+		        "encode" : "write the HCA for", name);
+		atomic_store(&job->failed, 1);
+		return;
+	}
+	if (cache_path[0]) {
+		store_in_cache(hca_path, cache_path, worker);
+	}
+
+	// The loop is reported as the written header has it
+	HcaInfo info;
+	uint32_t loop_start;
+	uint32_t loop_end;
+	int done = atomic_fetch_add(&job->done, 1) + 1;
+	if (hca_query_file(hca_path, &info) == 0 && hca_loop_range(&info, &loop_start, &loop_end)) {
+		printf("[%d/%d] Converted %s to HCA (loop points %u-%u)\n", done, job->total,
+		       name, loop_start, loop_end);
+	} else {
+		printf("[%d/%d] Converted %s to HCA\n", done, job->total, name);
+	}
+}
+
+int process_wav_files(const char* folder, uint64_t hca_key,
+                      int set_looping_points) {
+
+	if (set_looping_points)
+		printf("Checking if any WAVs need conversion...\n");
+
+	// Collect the names first, the encoding runs on every core
+	FileName* names;
+	int count;
+	if (list_files(folder, NULL, &names, &count) != 0) {
 		return -1;
 	}
+	if (count == 0) {
+		free(names);
+		return 0;
+	}
+
+	printf("Converting %d audio file(s) to HCA...\n", count);
+	char cache_folder[MAX_PATH];
+	snprintf(cache_folder, sizeof(cache_folder), "%s\\%s", folder, HCA_CACHE_FOLDER);
+	create_directory(cache_folder);
+
+	WavConversionJob job = {folder, names, {0}, calloc(count, sizeof(uint64_t)), count, 0, 0, 0};
+	job.options.key = hca_key;
+	job.options.loop = set_looping_points != 0;
+	job.options.sample_rate = app_data.config.Resample_To_48kHz ? 48000 : 0;
+	if (!job.cache_keys || parallel_for(count, 0, convert_wav, &job) != 0) {
+		fprintf(stderr, "Error: Could not start the WAV to HCA conversion\n");
+		atomic_store(&job.failed, 1);
+	} else {
+		prune_cache(folder, job.cache_keys, count);
+	}
+	free(job.cache_keys);
+	free(names);
 
-	// Create a batch file for all conversions
-	char batch_path[MAX_PATH];
-	snprintf(batch_path, sizeof(batch_path), "%s\\convert_hca.bat", folder);
-	FILE* batch_file = fopen(batch_path, "w");
-	if (!batch_file) {
-		perror("Error creating batch file");
-		closedir(dir);
+	if (atomic_load(&job.failed)) {
 		return -1;
 	}
+	int reused = atomic_load(&job.reused);
+	if (reused > 0) {
+		printf("%d of them were already encoded and were not encoded again\n", reused);
+	}
+	if (set_looping_points) {
+		printf("Note: Converted HCAs loop over their own loop, else over the part of the audio that repeats, else from start to end\n");
+	}
+	printf("Conversion complete!\n");
+	return 0;
+}
 
-	// Write batch file header
-	fprintf(batch_file, "@chcp 65001 >nul\n@echo off\n");
-	fprintf(batch_file, "echo Starting HCA to WAV conversion...\n");
+typedef struct {
+	const char* folder;
+	FileName* names;
+	uint64_t key;
+	int total;
+	atomic_int done;
+	atomic_int failed;
+} HcaConversionJob;
+
+static void convert_hca(void* context, int index, int worker) {
+	(void)worker;
+	HcaConversionJob* job = context;
+	const char* name = job->names[index];
 
-	struct dirent* entry;
 	char hca_path[MAX_PATH];
 	char wav_path[MAX_PATH];
-	int has_files = 0;
-
-	while ((entry = readdir(dir)) != NULL) {
-		const char* ext = get_file_extension(entry->d_name);
-		if (ext != NULL && strcasecmp(ext, "hca") == 0
-		        && strcmp(entry->d_name, "00000.hca") != 0) {
-			has_files = 1;
-			// Construct full paths
-			snprintf(hca_path, sizeof(hca_path), "%s\\%s", folder, entry->d_name);
-			const char* basename = get_basename(entry->d_name);
-			snprintf(wav_path, sizeof(wav_path), "%s\\%s.wav", folder, basename);
-
-			// Write conversion and deletion logic to batch file
-			fprintf(batch_file, "echo Converting %s.hca to WAV\n", basename);
-			fprintf(batch_file, "\"%s\" -i \"%s\" -o \"%s\"\n", app_data.vgmstream_path, hca_path,
-			        wav_path);
-
-			// Check if conversion was successful and delete HCA if it was
-			fprintf(batch_file, "if %%errorlevel%% equ 0 (\n");
-			fprintf(batch_file, "    echo Conversion successful - deleting %s.hca\n",
-			        basename);
-			fprintf(batch_file, "    del \"%s\"\n", hca_path);
-			fprintf(batch_file, ") else (\n");
-			fprintf(batch_file,
-			        "    echo Conversion failed for %s.hca - keeping original file\n", basename);
-			fprintf(batch_file, ")\n");
+	snprintf(hca_path, sizeof(hca_path), "%s\\%s", job->folder, name);
+	char* basename = get_basename(name);
+	snprintf(wav_path, sizeof(wav_path), "%s\\%s.wav", job->folder, basename ? basename : name);
+	free(basename);
+
+	int result = hca_decode_file(hca_path, wav_path, job->key);
+	if (result != 0) {
+		const char* reason = "Could not decode";
+		if (result == HCA_DECODE_UNSUPPORTED) {
+			reason = "Unsupported HCA format in";
+		} else if (result == HCA_DECODE_WRITE_FAILED) {
+			reason = "Could not write the WAV for";
 		}
+		fprintf(stderr, "Error: %s '%s', keeping the original file\n", reason, name);
+		atomic_store(&job->failed, 1);
+		return;
 	}
 
-	// Create path for metadata batch file
-	char metadata_batch_path[MAX_PATH];
-	snprintf(metadata_batch_path, sizeof(metadata_batch_path),
-	         "%s\\add_metadata.bat", folder);
+	// Only remove the source once its WAV is complete
+	if (remove(hca_path) != 0) {
+		fprintf(stderr, "Warning: Could not delete '%s'\n", name);
+	}
+	int done = atomic_fetch_add(&job->done, 1) + 1;
+	printf("[%d/%d] Converted %s to WAV\n", done, job->total, name);
+}
 
-	// Add a line to run the metadata batch file after conversion
-	fprintf(batch_file, "echo Conversion complete!\n");
-	fprintf(batch_file, "if exist \"%s\" (\n", metadata_batch_path);
-	fprintf(batch_file, "    call \"%s\"\n", metadata_batch_path);
-	fprintf(batch_file, ")\n");
-	fprintf(batch_file, "del \"%s\\convert_hca.bat\" && exit\n", folder);
-	fclose(batch_file);
-	closedir(dir);
+int process_hca_files(const char* folder, const MetadataList* metadata) {
+	FileName* names;
+	int count;
+	if (list_files(folder, "hca", &names, &count) != 0) {
+		return -1;
+	}
+
+	// 00000.hca is left as it is
+	int kept = 0;
+	for (int i = 0; i < count; i++) {
+		if (strcmp(names[i], "00000.hca") != 0) {
+			memmove(names[kept++], names[i], MAX_PATH);
+		}
+	}
+	count = kept;
 
-	if (!has_files) {
-		remove(batch_path);
+	if (count == 0) {
+		free(names);
 		return 0;
 	}
 
-	// Execute the batch file in a new window
-	char command[MAX_PATH * 8];
-	snprintf(command, sizeof(command),
-	         "start \"HCA to WAV Conversion\" cmd /C \"chcp 65001 >nul && \"%s\"\"",
-	         batch_path);
-	system(command);
+	// Encrypted banks come with the key next to the files
+	char hcakey_path[MAX_PATH];
+	snprintf(hcakey_path, sizeof(hcakey_path), "%s\\.hcakey", folder);
+	uint64_t key = is_path_exists(hcakey_path) ? extract_hca_key(folder) : 0;
+
+	printf("Converting %d HCA file(s) to WAV...\n", count);
+	HcaConversionJob job = {folder, names, key, count, 0, 0};
+	if (parallel_for(count, 0, convert_hca, &job) != 0) {
+		fprintf(stderr, "Error: Could not start the HCA to WAV conversion\n");
+		atomic_store(&job.failed, 1);
+	}
+	free(names);
+
+	// Metadata and cue name renames apply to the finished WAVs
+	if (metadata) {
+		apply_metadata(metadata);
+	}
 
+	if (atomic_load(&job.failed)) {
+		return -1;
+	}
+	printf("Conversion complete!\n");
 	return 0;
 }
@@ -121,20 +121,28 @@ int process_bgm_directory(const char* dir_path) {
 		return -1;
 	}
 
-	// Process WAVs and encrypt HCAs
-	if (process_wav_files(dir_path, hca_key_to_use, !app_data.config.Disable_Looping) != 0) {
-		printf("Error during WAV to HCA conversion\n");
-		return -1;
+	// WAVs are encoded by the BGM tool as it writes the AWB, only HCAs are
+	// looped and encrypted here
+	if (!app_data.config.Disable_Looping) {
+		int looped = loop_hcas(dir_path);
+		if (looped > 0) printf("Looping points were set from start to end for %d HCAs\n",
+			                       looped);
 	}
 	int encryption_successes = encrypt_hcas(dir_path, hca_key_to_use);
 	if (encryption_successes > 0) printf("%d HCAs were encrypted\n",
 		                                     encryption_successes);
 
 	rename_files_back(dir_path);
+	RenamedFile* renamed_wavs;
+	int renamed_count = rename_wavs_back(dir_path, &renamed_wavs);
 
 	// Prepare bgm_tool arguments
-	char arguments[20] = "--cmd";
+	char arguments[80] = "--cmd";
 	if (app_data.config.Fixed_Size_BGM) strcat(arguments, " --fixed-size");
+	if (!app_data.config.Disable_Looping) strcat(arguments, " --loop");
+	if (app_data.config.Resample_To_48kHz) strcat(arguments, " --resample");
+	snprintf(arguments + strlen(arguments), sizeof(arguments) - strlen(arguments),
+	         " --hca-key=%llu", (unsigned long long)hca_key_to_use);
 
 	// Execute bgm_tool command
 	if (bgm_index == 0) {
@@ -148,6 +156,8 @@ int process_bgm_directory(const char* dir_path) {
 	}
 
 	int result = system(command);
+	if (renamed_count > 0) restore_file_names(renamed_wavs, renamed_count);
+	else free(renamed_wavs);
 	if (result != 0) {
 		printf("Error: BGM tool failed with return code %d\n", result);
 		return 1;
@@ -246,12 +256,15 @@ int process_bgm_awb_file(const char* file_path) {
 	}
 	generate_hcakey_dir(uasset_path, folder_path);
 
+	MetadataList metadata = {0};
 	if (!app_data.config.Disable_Metadata && process_uasset(uasset_path) == 0) {
 		generate_txtm(file_path);
-		add_metadata(file_path);
+		add_metadata(file_path, &metadata);
 	}
 	// Process HCA files in the folder
-	if (process_hca_files(folder_path) != 0) {
+	int conversion_result = process_hca_files(folder_path, &metadata);
+	free_metadata(&metadata);
+	if (conversion_result != 0) {
 		printf("Error extracting HCAs\n");
 		return 1;
 	}
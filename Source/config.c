@@ -32,6 +32,9 @@
 "Use_Cue_IDs=false\n\n" \
 "# If true, loop points will not be automatically set for converted BGM WAVs\n" \
 "Disable_Looping=false\n\n" \
+"# Converts WAVs that aren't 48kHz to 48kHz before encoding them, the game expects that rate\n" \
+"# If false, they are encoded at their own rate (the game may play them at the wrong pitch)\n" \
+"Resample_To_48kHz=true\n\n" \
 "# If disabled, metadata processing (including Cue Names and Cue IDs) is skipped\n" \
 "# This means files won't have the title, author, track number and other metadata\n" \
 "# This can significantly speed up operations on files with thousands of tracks\n" \
@@ -46,6 +49,7 @@ void config_init(Config* config) {
 	config->Use_Cue_Names = false;
 	config->Dont_Use_Numbers = true;
 	config->Disable_Looping = false;
+	config->Resample_To_48kHz = true;
 	config->Disable_Metadata = false;
 	config->Use_Cue_IDs = false;
 	strcpy(config->Game_Directory,
@@ -100,6 +104,8 @@ static void parse_line(Config* config, char* line) {
 		config->Dont_Use_Numbers = (strcasecmp(value, "true") == 0);
 	} else if (strcmp(key_lower, "disable_looping") == 0) {
 		config->Disable_Looping = (strcasecmp(value, "true") == 0);
+	} else if (strcmp(key_lower, "resample_to_48khz") == 0) {
+		config->Resample_To_48kHz = (strcasecmp(value, "true") == 0);
 	} else if (strcmp(key_lower, "disable_metadata") == 0) {
 		config->Disable_Metadata = (strcasecmp(value, "true") == 0);
 	} else if (strcmp(key_lower, "use_cue_ids") == 0) {
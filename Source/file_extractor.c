@@ -77,18 +77,20 @@ int extract_and_process(const char* input_file) {
 		// For files that need it
 		generate_txtm(input_file);
 
-		// Write metadata batch file
+		// Collect the metadata, written once the WAVs exist
 		// Not a big deal if it fails
-		if (!app_data.config.Disable_Metadata && add_metadata(input_file) != 0)
+		MetadataList metadata = {0};
+		if (!app_data.config.Disable_Metadata && add_metadata(input_file, &metadata) != 0)
 			fprintf(stderr, "Error adding metadata.\n");
 
-		printf("Converting HCAs into WAV in different CMD.\n");
+		printf("Converting HCAs into WAV.\n");
 		printf("Remember: you can turn this off in config.ini any time!\n");
 
-		if (process_hca_files(folder_path) != 0) {
+		if (process_hca_files(folder_path, &metadata) != 0) {
 			printf("Error extracting HCAs from %s\n",
 			       extract_name_from_path(get_basename(input_file)));
 		}
+		free_metadata(&metadata);
 	} else if (app_data.config.Use_Cue_Names || app_data.config.Use_Cue_IDs) {
 		// For files that need it
 		generate_txtm(input_file);
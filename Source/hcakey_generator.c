@@ -1,4 +1,5 @@
 #include "hcakey_generator.h"
+#include "afs2.h"
 #include <stdio.h>
 #include <sys/stat.h>
 
@@ -57,38 +58,13 @@ void generate_hcakey_dir(const char* filepath, const char* directory) {
 static const uint64_t MAIN_KEY = 13238534807163085345ULL;
 
 uint64_t get_key(const char *filepath) {
-    FILE *file = fopen(replace_extension(filepath,"awb"), "rb");
-    if (!file) return -1;
-
-    // Verify AFS2 header
-    unsigned char header[4];
-    if (fread(header, 1, 4, file) != 4) {
-        fclose(file);
-        return -1;
-    }
-
-    if (header[0] != 0x41 || header[1] != 0x46 ||
-        header[2] != 0x53 || header[3] != 0x32) {
-        fclose(file);
-        return -1;
-    }
-
-    // Read AwbHash from 0x0E
-    if (fseek(file, 0x0E, SEEK_SET) != 0) {
-        fclose(file);
+    // Only the fixed AFS2 header and tables are read for the AwbHash (subkey)
+    Afs2Archive archive;
+    if (afs2_read_file(replace_extension(filepath, "awb"), &archive) != 0)
         return -1;
-    }
-
-    unsigned char awb_hash_bytes[2];
-    if (fread(awb_hash_bytes, 1, 2, file) != 2) {
-        fclose(file);
-        return -1;
-    }
-
-    fclose(file);
 
-    // Convert to little-endian ushort
-    uint16_t awb_hash = (uint16_t)(awb_hash_bytes[1] << 8) | awb_hash_bytes[0];
+    uint16_t awb_hash = archive.subkey;
+    afs2_free(&archive);
 
     // Calculate key
     return MAIN_KEY * (
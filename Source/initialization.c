@@ -1,5 +1,7 @@
 #include "initialization.h"
 #include "hcakey_generator.h"
+#include "uasset_injector.h"
+#include "file_transaction.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -11,7 +13,6 @@ static int initialize_tool_paths(void) {
 	get_program_file_path("Tools\\", tools_path, sizeof(tools_path));
 
 	// Initialize paths using the struct members
-	snprintf(app_data.vgaudio_cli_path, MAX_PATH, "%sVGAudioCli.exe", tools_path);
 	snprintf(app_data.acb_editor_path, MAX_PATH, "%sAcbEditor.exe", tools_path);
 	snprintf(app_data.vgmstream_path, MAX_PATH, "%svgmstream-cli\\vgmstream-cli.exe",
 	         tools_path);
@@ -24,16 +25,8 @@ static int initialize_tool_paths(void) {
 	snprintf(app_data.unrealpak_exe_path, MAX_PATH,
 	         "%sUnrealPak\\UnrealPak.exe", tools_path);
 	snprintf(app_data.bgm_tool_path, MAX_PATH, "%sBgmModdingTool.exe", tools_path);
-	snprintf(app_data.metadata_tool_path, MAX_PATH, "%sAddWavMetadata.exe", tools_path);
 
 	// Verify required executables exist
-	FILE* vgaudio_test = fopen(app_data.vgaudio_cli_path, "r");
-	if (!vgaudio_test) {
-		fprintf(stderr, "Error: VGAudioCli.exe not found in Tools directory\n");
-		return 1;
-	}
-	fclose(vgaudio_test);
-
 	FILE* acbeditor_test = fopen(app_data.acb_editor_path, "r");
 	if (!acbeditor_test) {
 		fprintf(stderr, "Error: AcbEditor.exe not found in Tools directory\n");
@@ -66,6 +59,22 @@ int initialise_program(const char* program_path) {
 		*(last_backslash + 1) = '\0';
 	}
 
+	// Finish or undo an injection that was interrupted last time
+	char journal_path[MAX_PATH];
+	get_program_file_path(INJECTION_JOURNAL, journal_path, sizeof(journal_path));
+	switch (file_transaction_recover(journal_path)) {
+	case FILE_TRANSACTION_ROLLED_BACK:
+		printf("An interrupted injection was rolled back, your files are unchanged.\n");
+		break;
+	case FILE_TRANSACTION_FINISHED:
+		printf("Finished saving an interrupted injection.\n");
+		break;
+	case -1:
+		fprintf(stderr, "Error: Could not recover the injection listed in %s\n",
+		        journal_path);
+		return 1;
+	}
+
 	// Initialize tool paths
 	if (initialize_tool_paths() != 0) {
 		fprintf(stderr, "Error: Failed to initialize tool paths\n");
@@ -1,4 +1,5 @@
 #include "uasset_extractor.h"
+#include "byte_scan.h"
 #include <string.h>
 
 int process_uasset(const char* uasset_path) {
@@ -38,18 +39,8 @@ int process_uasset(const char* uasset_path) {
 }
 
 long find_utf_marker(FILE *fp) {
-    char buffer[BUFFER_SIZE];
-    size_t bytes_read;
-    const char *marker = "@UTF";
-    long position = -1;
-
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, fp)) > 0) {
-        for (size_t i = 0; i < bytes_read - 3; ++i) {
-            if (memcmp(&buffer[i], marker, 4) == 0) {
-                position = ftell(fp) - bytes_read + i;
-                return position;
-            }
-        }
-    }
-    return -1;  // Not found
+    const uint8_t marker[] = {'@', 'U', 'T', 'F'};
+
+    // Scans from the current position, -1 if not found
+    return byte_scan_file_nth(fp, ftell(fp), marker, sizeof(marker), 0);
 }
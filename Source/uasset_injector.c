@@ -1,4 +1,8 @@
 #include "uasset_injector.h"
+#include "byte_scan.h"
+#include "initialization.h"
+#include "atomic_file.h"
+#include "file_transaction.h"
 
 int inject_process_file(const char* input_path) {
 	char uasset_path[MAX_PATH];
@@ -30,35 +34,31 @@ void create_backup(const char* file_path) {
         return;
     }
 
-    FILE* src = fopen(file_path, "rb");
-    FILE* dest = fopen(backup_path, "wb");
-
-    if (!src || !dest) {
+    // Shares the blocks of the original where the filesystem supports it
+    if (atomic_file_clone(file_path, backup_path) != 0) {
         perror("Failed to create backup");
-        if (src) fclose(src);
-        if (dest) fclose(dest);
         return;
     }
-
-    char buffer[BUFFER_SIZE];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, src)) > 0) {
-        fwrite(buffer, 1, bytes_read, dest);
-    }
-
-    fclose(src);
-    fclose(dest);
     printf("Backup created: %s\n", extract_name_from_path(backup_path));
 }
 
 int inject_acb_content(const char* uasset_path, const char* acb_path) {
-	FILE* uasset = fopen(uasset_path, "rb+");
+	// The ACB goes into a working copy that replaces the uasset once complete
+	FileTransaction transaction;
+	char journal_path[MAX_PATH];
+	file_transaction_begin(&transaction,
+	                       get_program_file_path(INJECTION_JOURNAL, journal_path,
+	                                             sizeof(journal_path)));
+
+	const char* work_path = file_transaction_open(&transaction, uasset_path);
+	FILE* uasset = work_path ? fopen(work_path, "rb+") : NULL;
 	FILE* acb = fopen(acb_path, "rb");
 
 	if (!uasset || !acb) {
 		perror("Failed to open files");
 		if (uasset) fclose(uasset);
 		if (acb) fclose(acb);
+		file_transaction_abort(&transaction);
 		return -1;
 	}
 
@@ -71,24 +71,15 @@ int inject_acb_content(const char* uasset_path, const char* acb_path) {
 
 	// Find first @UTF marker
 	char buffer[BUFFER_SIZE];
-	long utf_pos = -1;
 	size_t bytes_read = 0;
-	const char* marker = "@UTF";
-
-	while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, uasset)) > 0) {
-		for (size_t i = 0; i < bytes_read - 3; ++i) {
-			if (memcmp(&buffer[i], marker, 4) == 0) {
-				utf_pos = ftell(uasset) - bytes_read + i;
-				goto marker_found;
-			}
-		}
-	}
+	const uint8_t marker[] = {'@', 'U', 'T', 'F'};
+	long utf_pos = byte_scan_file_nth(uasset, 0, marker, sizeof(marker), 0);
 
-marker_found:
 	if (utf_pos == -1) {
 		printf("No @UTF marker found in %s\n", extract_name_from_path(uasset_path));
 		fclose(uasset);
 		fclose(acb);
+		file_transaction_abort(&transaction);
 		return -1;
 	}
 
@@ -115,8 +106,17 @@ marker_found:
 		remaining_size -= to_write;
 	}
 
-	fclose(uasset);
 	fclose(acb);
+	if (fclose(uasset) != 0) {
+		fprintf(stderr, "Error: Failed to write %s\n", extract_name_from_path(uasset_path));
+		file_transaction_abort(&transaction);
+		return -1;
+	}
+	if (file_transaction_commit(&transaction) != 0) {
+		fprintf(stderr, "Error: Could not replace %s with the injected copy\n",
+		        extract_name_from_path(uasset_path));
+		return -1;
+	}
 	printf("Successfully injected .acb into %s (replaced %lu bytes and zeroed %lu remaining bytes)\n",
 	       extract_name_from_path(uasset_path),
 	       (unsigned long)total_written,
@@ -0,0 +1,86 @@
+// Times every byte_scan_find version this CPU runs and prints its speed.
+// Build: gcc -O2 -ICommon_Headers Tests/bench_byte_scan.c Common_Source/*.c -o bench_byte_scan -pthread -lm
+#include "byte_scan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BUFFER_SIZE (64 * 1024 * 1024)
+#define ROUNDS 10
+
+static double now(void) {
+	struct timespec time;
+	timespec_get(&time, TIME_UTC);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Fastest of a few runs, in GB/s. Returns false if the match isn't found
+// where it was planted
+static bool bench(ByteScanFind find, const uint8_t* data, const uint8_t* pattern,
+                  size_t length, size_t expected, double* speed) {
+	double best = 1e9;
+	for (int round = 0; round < ROUNDS; round++) {
+		double start = now();
+		size_t found = find(data, BUFFER_SIZE, pattern, length);
+		double elapsed = now() - start;
+		if (found != expected) {
+			return false;
+		}
+		if (elapsed < best) {
+			best = elapsed;
+		}
+	}
+	*speed = BUFFER_SIZE / best / 1e9;
+	return true;
+}
+
+int main(void) {
+	uint8_t* data = malloc(BUFFER_SIZE);
+	if (!data) {
+		fprintf(stderr, "Error: Could not allocate the buffer\n");
+		return 1;
+	}
+
+	// Encrypted HCAs look like noise, zeroed padding like the rest of a uasset
+	static const struct {
+		const char* name;
+		bool noise;
+	} inputs[] = {{"noise", true}, {"zeros", false}};
+	static const uint8_t pattern[] = {'H', 'C', 'A', 0};
+	size_t expected = BUFFER_SIZE - 1000;
+	int failures = 0;
+
+	for (size_t input = 0; input < sizeof(inputs) / sizeof(inputs[0]); input++) {
+		uint32_t seed = 1;
+		for (size_t i = 0; i < BUFFER_SIZE; i++) {
+			seed = seed * 1664525u + 1013904223u;
+			data[i] = inputs[input].noise ? (uint8_t)(seed >> 24) : 0;
+		}
+		// Keep accidental matches out so every version stops at the planted one
+		for (size_t i = 0; i + sizeof(pattern) <= BUFFER_SIZE; i++) {
+			if (memcmp(data + i, pattern, sizeof(pattern)) == 0) {
+				data[i] = 0;
+			}
+		}
+		memcpy(data + expected, pattern, sizeof(pattern));
+
+		for (int level = SIMD_SCALAR; level <= (int)simd_level(); level++) {
+			ByteScanFind find = byte_scan_kernel((SimdLevel)level);
+			if (!find) continue;
+
+			double speed;
+			if (!bench(find, data, pattern, sizeof(pattern), expected, &speed)) {
+				printf("%-6s %-6s FAILED, wrong match position\n", inputs[input].name,
+				       simd_level_name((SimdLevel)level));
+				failures++;
+				continue;
+			}
+			printf("%-6s %-6s %6.2f GB/s\n", inputs[input].name,
+			       simd_level_name((SimdLevel)level), speed);
+		}
+	}
+
+	free(data);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef CHECK_H
+#define CHECK_H
+
+// Helpers shared by the check programs, each is a single source file built
+// against Common_Source and exits with check_finish()
+
+#include <stdint.h>
+#include <stdio.h>
+
+static int check_count = 0;
+static int check_failures = 0;
+
+// Counts a check and prints the message when it fails
+#define CHECK(condition, ...) \
+	do { \
+		check_count++; \
+		if (!(condition)) { \
+			check_failures++; \
+			printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while (0)
+
+static uint32_t check_seed = 1;
+
+// Fixed sequence, so every run and every kernel sees the same inputs
+static inline uint32_t check_random(void) {
+	check_seed = check_seed * 1664525u + 1013904223u;
+	return check_seed;
+}
+
+// Uniform in [-1, 1)
+static inline float check_random_float(void) {
+	return (float)((int32_t)check_random() >> 8) / 8388608.0f;
+}
+
+static inline int check_finish(void) {
+	printf("%d of %d checks failed\n", check_failures, check_count);
+	return check_failures ? 1 : 0;
+}
+
+#endif // CHECK_H
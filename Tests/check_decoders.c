@@ -0,0 +1,190 @@
+// Decodes the FLAC, Ogg Vorbis and MP3 files in Tests/data through the WAV
+// reader. FLAC has to give back the source signal exactly, Vorbis and MP3
+// have to stay within one 16-bit step of ffmpeg's decode of the same file.
+// Build: gcc -O2 -ICommon_Headers Tests/check_decoders.c Common_Source/*.c -o check_decoders -pthread -lm
+// Run from the repository root, or pass the data folder as the argument.
+//
+// The sources are make_source() written as WAVs (17640 stereo frames at
+// 44.1 kHz, 9600 mono 24-bit frames at 48 kHz, 11025 mono and 6615 5.1
+// frames at 22.05 kHz), encoded with ffmpeg 7 (-fflags +bitexact):
+//   flac16_fixed.flac  -c:a flac -compression_level 0 -metadata LOOPSTART=4410 -metadata LOOPLENGTH=8820
+//   flac16_lpc.flac    -c:a flac -compression_level 8
+//   flac24.flac        -c:a flac -sample_fmt s32
+//   vorbis.ogg         -c:a libvorbis -q:a 4 -metadata LOOPSTART=4410 -metadata LOOPEND=13230
+//   vorbis_6ch.ogg     -c:a libvorbis -q:a 0 (5.1)
+//   mp3_mpeg1.mp3      -c:a libmp3lame -b:a 192k (44.1 kHz stereo)
+//   mp3_mpeg2.mp3      -c:a libmp3lame -b:a 48k (22.05 kHz mono)
+//   mp3_mpeg25.mp3     -ar 11025 -c:a libmp3lame -b:a 24k (mono)
+// and each lossy file decoded by ffmpeg into <name>.ref.flac with -sample_fmt s16,
+// the Vorbis ones cut to the last granule with -af atrim=end_sample=<frames>.
+#include "check.h"
+#include "wav_reader.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	unsigned channels;
+	unsigned sample_rate;
+	size_t frames;
+	float* samples;
+	bool has_loop;
+	uint32_t loop_start;
+	uint32_t loop_end;
+} Decoded;
+
+static const char* data_folder = "Tests/data";
+
+// Triangles with a little noise, a stretch of silence for constant
+// subframes and a burst of loud noise for verbatim ones. Integer only, so
+// the exact values don't depend on the C library
+static void make_source(int32_t* samples, size_t frames, unsigned channels,
+                        unsigned bits) {
+	uint32_t seed = 12345;
+	for (size_t i = 0; i < frames; i++) {
+		for (unsigned c = 0; c < channels; c++) {
+			seed = seed * 1664525u + 1013904223u;
+			int32_t period = 100 + 37 * (int32_t)c;
+			int32_t value = 4 * 8000 * (int32_t)(i % (size_t)period) / period;
+			if (value > 2 * 8000) {
+				value = 4 * 8000 - value;
+			}
+			int32_t sample = value - 8000 + (int32_t)((seed >> 16) & 31) - 16;
+			if (i >= frames / 2 && i < frames / 2 + frames / 8) {
+				sample = 0;
+			} else if (i >= 3 * frames / 4 && i < 3 * frames / 4 + frames / 16) {
+				sample = (int32_t)((seed >> 8) & 0xFFFF) - 32768;
+			}
+			if (bits == 24) {
+				sample = sample * 256 + (int32_t)((seed >> 4) & 255);
+			}
+			samples[i * channels + c] = sample;
+		}
+	}
+}
+
+static bool decode(const char* name, Decoded* decoded) {
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", data_folder, name);
+	memset(decoded, 0, sizeof(*decoded));
+
+	WavReader reader;
+	if (wav_reader_open(path, &reader) != 0) {
+		return false;
+	}
+	decoded->channels = reader.channels;
+	decoded->sample_rate = reader.sample_rate;
+	decoded->has_loop = reader.has_loop;
+	decoded->loop_start = reader.loop_start;
+	decoded->loop_end = reader.loop_end;
+	decoded->samples = malloc(((size_t)reader.frame_count + 1) * reader.channels * sizeof(float));
+	if (decoded->samples) {
+		size_t read;
+		while ((read = wav_reader_read(&reader, decoded->samples + decoded->frames * reader.channels,
+		                               reader.frame_count - decoded->frames)) > 0) {
+			decoded->frames += read;
+		}
+		CHECK(decoded->frames == reader.frame_count, "%s: read %zu of %u frames", name,
+		      decoded->frames, reader.frame_count);
+	}
+	wav_reader_close(&reader);
+	return decoded->samples != NULL;
+}
+
+static void check_flac(const char* name, unsigned channels, unsigned sample_rate,
+                       unsigned bits, size_t frames) {
+	Decoded decoded;
+	if (!decode(name, &decoded)) {
+		CHECK(0, "%s: could not be decoded", name);
+		return;
+	}
+	CHECK(decoded.channels == channels && decoded.sample_rate == sample_rate &&
+	      decoded.frames == frames, "%s: %u channels at %u Hz, %zu frames", name,
+	      decoded.channels, decoded.sample_rate, decoded.frames);
+
+	int32_t* source = malloc(frames * channels * sizeof(int32_t));
+	size_t mismatches = 0;
+	if (source && decoded.frames == frames && decoded.channels == channels) {
+		make_source(source, frames, channels, bits);
+		float scale = (float)(1u << (bits - 1));
+		for (size_t i = 0; i < frames * channels; i++) {
+			mismatches += decoded.samples[i] != (float)source[i] / scale;
+		}
+	}
+	CHECK(source && mismatches == 0, "%s: %zu samples differ from the source", name,
+	      mismatches);
+	printf("%-20s %zu mismatches\n", name, mismatches);
+	free(source);
+	free(decoded.samples);
+}
+
+static int32_t to_int16(float sample) {
+	long value = lrintf(sample * 32768.0f);
+	return (int32_t)(value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+}
+
+static void check_lossy(const char* name, const char* reference_name) {
+	Decoded decoded;
+	Decoded reference;
+	bool opened = decode(name, &decoded);
+	if (!decode(reference_name, &reference) || !opened) {
+		CHECK(0, "%s: could not be decoded", opened ? reference_name : name);
+		free(decoded.samples);
+		free(reference.samples);
+		return;
+	}
+	CHECK(decoded.channels == reference.channels &&
+	      decoded.sample_rate == reference.sample_rate && decoded.frames == reference.frames,
+	      "%s: %u channels at %u Hz, %zu frames, ffmpeg has %u at %u Hz, %zu frames", name,
+	      decoded.channels, decoded.sample_rate, decoded.frames, reference.channels,
+	      reference.sample_rate, reference.frames);
+
+	int32_t largest = 0;
+	size_t rounded_apart = 0;
+	if (decoded.channels == reference.channels && decoded.frames == reference.frames) {
+		for (size_t i = 0; i < decoded.frames * decoded.channels; i++) {
+			int32_t difference = abs(to_int16(decoded.samples[i]) - to_int16(reference.samples[i]));
+			if (difference > largest) {
+				largest = difference;
+			}
+			rounded_apart += difference != 0;
+		}
+	}
+	CHECK(largest <= 1, "%s: off by up to %d from ffmpeg's decode", name, largest);
+	printf("%-20s within %d of ffmpeg, %zu of %zu samples rounded apart\n", name, largest,
+	       rounded_apart, decoded.frames * decoded.channels);
+	free(decoded.samples);
+	free(reference.samples);
+}
+
+static void check_loop(const char* name, uint32_t start, uint32_t end) {
+	Decoded decoded;
+	if (!decode(name, &decoded)) {
+		CHECK(0, "%s: could not be decoded", name);
+		return;
+	}
+	CHECK(decoded.has_loop && decoded.loop_start == start && decoded.loop_end == end,
+	      "%s: loop %d %u-%u instead of %u-%u", name, decoded.has_loop, decoded.loop_start,
+	      decoded.loop_end, start, end);
+	free(decoded.samples);
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1) {
+		data_folder = argv[1];
+	}
+
+	check_flac("flac16_fixed.flac", 2, 44100, 16, 17640);
+	check_flac("flac16_lpc.flac", 2, 44100, 16, 17640);
+	check_flac("flac24.flac", 1, 48000, 24, 9600);
+	check_lossy("vorbis.ogg", "vorbis.ref.flac");
+	check_lossy("vorbis_6ch.ogg", "vorbis_6ch.ref.flac");
+	check_lossy("mp3_mpeg1.mp3", "mp3_mpeg1.ref.flac");
+	check_lossy("mp3_mpeg2.mp3", "mp3_mpeg2.ref.flac");
+	check_lossy("mp3_mpeg25.mp3", "mp3_mpeg25.ref.flac");
+
+	// LOOPSTART with LOOPLENGTH, and with LOOPEND
+	check_loop("flac16_fixed.flac", 4410, 13230);
+	check_loop("vorbis.ogg", 4410, 13230);
+	return check_finish();
+}
@@ -0,0 +1,210 @@
+// Builds tracks out of generated music with a known repeat, writes them as
+// WAVs and checks that loop_find gives back the exact loop length inside the
+// repeated part, and nothing for tracks that don't repeat.
+// Build: gcc -O2 -ICommon_Headers Tests/check_loop_finder.c Common_Source/*.c -o check_loop_finder -pthread -lm
+#include "check.h"
+#include "loop_finder.h"
+#include "wav_writer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TRACK_PATH "check_loop_finder.wav"
+
+typedef struct {
+	float* samples;
+	size_t frames;
+	unsigned channels;
+	unsigned sample_rate;
+} Track;
+
+// A bass line that repeats every two seconds with hi-hats on the beat, and a
+// melody of random notes on top, so no two sections are alike
+static void add_section(Track* track, size_t frames) {
+	static const double bass[] = {55, 55, 73.4, 65.4};
+	double rate = track->sample_rate;
+	unsigned channels = track->channels;
+	float* out = track->samples + track->frames * channels;
+	size_t beat = (size_t)(0.5 * rate);
+	memset(out, 0, frames * channels * sizeof(float));
+
+	for (size_t a = 0, note = 0; a < frames; a += beat, note++) {
+		for (size_t i = 0; i < beat && a + i < frames; i++) {
+			double t = i / rate;
+			double bass_sample = 0.3 * sin(2 * M_PI * bass[note % 4] * t) * exp(-t * 3);
+			for (unsigned c = 0; c < channels; c++) {
+				double hat = t < 0.05 ? 0.05 * check_random_float() * exp(-t * 60) : 0;
+				out[(a + i) * channels + c] += (float)(bass_sample + hat);
+			}
+		}
+	}
+
+	static const double durations[] = {0.25, 0.5, 0.75};
+	for (double position = 0; position * rate < frames;) {
+		double duration = durations[check_random() % 3];
+		double frequency = 220 * pow(2, (check_random() % 24) / 12.0);
+		double pan = (check_random() % 1000) / 1000.0;
+		size_t a = (size_t)(position * rate);
+		for (size_t i = 0; i < (size_t)(duration * rate) && a + i < frames; i++) {
+			double t = i / rate;
+			double sample = 0;
+			for (int k = 1; k <= 5; k++) {
+				sample += sin(2 * M_PI * frequency * k * t) / k;
+			}
+			sample *= fmin(1, t * 50) * exp(-t * 2) * 0.15;
+			for (unsigned c = 0; c < channels; c++) {
+				double gain = channels == 1 ? 1 : (c == 0 ? pan : 1 - pan);
+				out[(a + i) * channels + c] += (float)(sample * gain);
+			}
+		}
+		position += duration;
+	}
+	track->frames += frames;
+}
+
+static void add_silence(Track* track, size_t frames) {
+	memset(track->samples + track->frames * track->channels, 0,
+	       frames * track->channels * sizeof(float));
+	track->frames += frames;
+}
+
+// Appends frames starting at from again, fading out over the last fade ones
+static void add_repeat(Track* track, size_t from, size_t frames, size_t fade) {
+	unsigned channels = track->channels;
+	float* out = track->samples + track->frames * channels;
+	memcpy(out, track->samples + from * channels, frames * channels * sizeof(float));
+	for (size_t i = frames - fade; i < frames; i++) {
+		for (unsigned c = 0; c < channels; c++) {
+			out[i * channels + c] *= (float)(frames - i) / fade;
+		}
+	}
+	track->frames += frames;
+}
+
+static bool start_track(Track* track, unsigned channels, unsigned sample_rate,
+                        double seconds) {
+	track->channels = channels;
+	track->sample_rate = sample_rate;
+	track->frames = 0;
+	track->samples = malloc(((size_t)(seconds * sample_rate) + sample_rate) * channels *
+	                        sizeof(float));
+	return track->samples != NULL;
+}
+
+// Scales the track below full scale and writes it as a 16-bit WAV
+static bool write_track(const Track* track, const char* path) {
+	size_t count = track->frames * track->channels;
+	float peak = 0;
+	for (size_t i = 0; i < count; i++) {
+		peak = fmaxf(peak, fabsf(track->samples[i]));
+	}
+	float scale = peak > 0 ? 1 / (peak * 1.1f) : 1;
+	for (size_t i = 0; i < count; i++) {
+		track->samples[i] *= scale;
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	bool written = wav_write_header(file, track->channels, track->sample_rate,
+	                                (uint32_t)track->frames) == 0 &&
+	               wav_write_samples(file, track->samples, count) == 0;
+	return fclose(file) == 0 && written;
+}
+
+static bool find(Track* track, uint32_t* start, uint32_t* end) {
+	bool found = false;
+	WavReader reader;
+	if (write_track(track, TRACK_PATH) && wav_reader_open(TRACK_PATH, &reader) == 0) {
+		found = loop_find(&reader, start, end);
+		wav_reader_close(&reader);
+	} else {
+		CHECK(0, "could not write %s", TRACK_PATH);
+	}
+	free(track->samples);
+	remove(TRACK_PATH);
+	return found;
+}
+
+// The loop has to be the repeat's exact length and lie inside the repeat
+static void check_loop(const char* name, Track* track, size_t repeat_start,
+                       size_t length, size_t repeat_end) {
+	uint32_t start = 0;
+	uint32_t end = 0;
+	bool found = find(track, &start, &end);
+	printf("%-40s loop %u-%u, %u frames of %zu\n", name, start, end, end - start, length);
+	CHECK(found && end - start == length && start >= repeat_start && end <= repeat_end,
+	      "%s: loop %u-%u, expected %zu frames within %zu-%zu", name, start, end, length,
+	      repeat_start, repeat_end);
+}
+
+static void check_no_loop(const char* name, Track* track) {
+	uint32_t start = 0;
+	uint32_t end = 0;
+	bool found = find(track, &start, &end);
+	printf("%-40s %s\n", name, found ? "loop found" : "no loop");
+	CHECK(!found, "%s: found a loop %u-%u", name, start, end);
+}
+
+int main(void) {
+	Track track;
+	size_t intro;
+	size_t body;
+
+	// An intro, then the body twice with the second time fading out. The odd
+	// body length checks that the loop is refined to the exact sample
+	if (start_track(&track, 2, 48000, 12.3 + 2 * 37.5)) {
+		intro = (size_t)(12.3 * 48000);
+		body = 37 * 48000 + 24000 + 37;
+		add_section(&track, intro);
+		add_section(&track, body);
+		add_repeat(&track, intro, body, 8 * 48000);
+		check_loop("48 kHz stereo, intro, fade-out", &track, intro, body, intro + 2 * body);
+	}
+
+	if (start_track(&track, 1, 44100, 3 + 2 * 20 + 4)) {
+		intro = 3 * 44100;
+		body = 20 * 44100 + 123;
+		add_section(&track, intro);
+		add_section(&track, body);
+		add_repeat(&track, intro, body, 0);
+		add_repeat(&track, intro, 4 * 44100, 0);
+		check_loop("44.1 kHz mono, cut into the third time", &track, intro, body,
+		           intro + 2 * body + 4 * 44100);
+	}
+
+	// Two seconds of silence inside the body mustn't end the repetition
+	if (start_track(&track, 2, 22050, 3 + 2 * 20)) {
+		intro = 3 * 22050;
+		body = 20 * 22050;
+		add_section(&track, intro);
+		add_section(&track, 5 * 22050);
+		add_silence(&track, 2 * 22050);
+		add_section(&track, body - 7 * 22050);
+		add_repeat(&track, intro, body, 0);
+		check_loop("22.05 kHz stereo, silent gap", &track, intro, body, intro + 2 * body);
+	}
+
+	if (start_track(&track, 2, 48000, 75)) {
+		add_section(&track, 20 * 48000);
+		add_section(&track, 30 * 48000);
+		add_section(&track, 25 * 48000);
+		check_no_loop("nothing repeats", &track);
+	}
+
+	if (start_track(&track, 2, 48000, 30)) {
+		add_silence(&track, 30 * 48000);
+		check_no_loop("silence", &track);
+	}
+
+	if (start_track(&track, 2, 48000, 5)) {
+		add_section(&track, 5 * 48000);
+		check_no_loop("5 seconds", &track);
+	}
+	return check_finish();
+}
@@ -0,0 +1,170 @@
+// Checks the resampler against tones with a known answer: the passband SNR
+// at the rates WAVs come in, the stopband, the output length, and that the
+// way the input is split into writes doesn't change a bit of the output.
+// Build: gcc -O2 -ICommon_Headers Tests/check_resampler.c Common_Source/*.c -o check_resampler -pthread -lm
+#include "check.h"
+#include "resampler.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define OUTPUT_RATE 48000
+#define SECONDS 2
+// The filter rings in from silence at both ends, the SNR skips that part
+#define EDGE_SECONDS 0.1
+#define MIN_PASSBAND_SNR 95.0
+#define MAX_STOPBAND_DB -100.0
+
+static void make_tone(float* samples, size_t frames, unsigned channels, unsigned rate,
+                      const double* frequencies) {
+	for (size_t i = 0; i < frames; i++) {
+		for (unsigned c = 0; c < channels; c++) {
+			samples[i * channels + c] =
+			    (float)(0.5 * sin(2 * M_PI * frequencies[c] * i / rate));
+		}
+	}
+}
+
+// Resamples input in writes of at most chunk frames into the output frames
+// the input turns into. Returns that count, or 0 if the resampler failed
+static size_t resample(const float* input, size_t frames, unsigned channels,
+                       unsigned input_rate, size_t chunk, float** output) {
+	Resampler* resampler = resampler_create(channels, input_rate, OUTPUT_RATE);
+	size_t total = (size_t)resampler_output_frames(frames, input_rate, OUTPUT_RATE);
+	*output = malloc(total * channels * sizeof(float));
+	if (!resampler || !*output) {
+		resampler_free(resampler);
+		return 0;
+	}
+
+	size_t written = 0;
+	size_t produced = 0;
+	if (frames == 0) {
+		resampler_finish(resampler);
+	}
+	while (produced < total) {
+		if (written < frames) {
+			size_t count = (frames - written < chunk) ? frames - written : chunk;
+			written += resampler_write(resampler, input + written * channels, count);
+			if (written == frames) {
+				resampler_finish(resampler);
+			}
+		}
+		produced += resampler_read(resampler, *output + produced * channels,
+		                           total - produced);
+	}
+	resampler_free(resampler);
+	return total;
+}
+
+// Error against the same tones generated at the output rate, in dB
+static double passband_snr(const float* output, size_t frames, unsigned channels,
+                           const double* frequencies) {
+	float* expected = malloc(frames * channels * sizeof(float));
+	if (!expected) {
+		return 0;
+	}
+	make_tone(expected, frames, channels, OUTPUT_RATE, frequencies);
+
+	size_t edge = (size_t)(EDGE_SECONDS * OUTPUT_RATE) * channels;
+	double signal = 0;
+	double noise = 0;
+	for (size_t i = edge; i + edge < frames * channels; i++) {
+		double error = (double)output[i] - expected[i];
+		signal += (double)expected[i] * expected[i];
+		noise += error * error;
+	}
+	free(expected);
+	return 10 * log10(signal / (noise + 1e-30));
+}
+
+static void check_passband(unsigned input_rate) {
+	static const double frequencies[] = {997, 3001};
+	unsigned channels = 2;
+	size_t frames = (size_t)input_rate * SECONDS;
+	float* input = malloc(frames * channels * sizeof(float));
+	float* output = NULL;
+	if (!input) {
+		CHECK(0, "out of memory");
+		return;
+	}
+	make_tone(input, frames, channels, input_rate, frequencies);
+
+	size_t count = resample(input, frames, channels, input_rate, 4096, &output);
+	CHECK(count == (size_t)OUTPUT_RATE * SECONDS, "%u Hz gave %zu frames instead of %u",
+	      input_rate, count, OUTPUT_RATE * SECONDS);
+	double snr = count ? passband_snr(output, count, channels, frequencies) : 0;
+	printf("%6u Hz -> %u Hz: %.1f dB SNR\n", input_rate, OUTPUT_RATE, snr);
+	CHECK(snr >= MIN_PASSBAND_SNR, "%u Hz is only %.1f dB above the error", input_rate, snr);
+
+	free(input);
+	free(output);
+}
+
+// A tone above the output Nyquist frequency has to be filtered out
+static void check_stopband(void) {
+	static const double frequency[] = {30000};
+	unsigned input_rate = 96000;
+	size_t frames = (size_t)input_rate * SECONDS;
+	float* input = malloc(frames * sizeof(float));
+	float* output = NULL;
+	if (!input) {
+		CHECK(0, "out of memory");
+		return;
+	}
+	make_tone(input, frames, 1, input_rate, frequency);
+
+	size_t count = resample(input, frames, 1, input_rate, 4096, &output);
+	size_t edge = (size_t)(EDGE_SECONDS * OUTPUT_RATE);
+	double power = 0;
+	for (size_t i = edge; i + edge < count; i++) {
+		power += (double)output[i] * output[i];
+	}
+	double level = 10 * log10(power / (count - 2 * edge) / (0.5 * 0.5 / 2) + 1e-30);
+	printf("30 kHz at 96 kHz -> %u Hz: %.1f dB\n", OUTPUT_RATE, level);
+	CHECK(count > 2 * edge && level <= MAX_STOPBAND_DB, "30 kHz tone only down %.1f dB", level);
+
+	free(input);
+	free(output);
+}
+
+// The output mustn't depend on how the input was split into writes
+static void check_chunking(void) {
+	static const double frequencies[] = {440, 1234};
+	static const size_t chunks[] = {1, 7, 1000, 100000};
+	unsigned input_rate = 44100;
+	size_t frames = 20000;
+	float input[20000 * 2];
+	make_tone(input, frames, 2, input_rate, frequencies);
+
+	float* reference = NULL;
+	size_t count = resample(input, frames, 2, input_rate, 4096, &reference);
+	for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+		float* output = NULL;
+		size_t result = resample(input, frames, 2, input_rate, chunks[i], &output);
+		CHECK(result == count && output && reference &&
+		      memcmp(output, reference, count * 2 * sizeof(float)) == 0,
+		      "writes of %zu frames change the output", chunks[i]);
+		free(output);
+	}
+	free(reference);
+
+	CHECK(resampler_output_frames(44100, 44100, 48000) == 48000 &&
+	      resampler_output_frames(1, 96000, 48000) == 1 &&
+	      resampler_output_frames(0, 22050, 48000) == 0,
+	      "resampler_output_frames rounds wrong");
+}
+
+int main(void) {
+	static const unsigned rates[] = {8000, 22050, 32000, 44100, 96000};
+	for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+		check_passband(rates[i]);
+	}
+	check_stopband();
+	check_chunking();
+	return check_finish();
+}
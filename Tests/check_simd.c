@@ -0,0 +1,155 @@
+// Runs every vector kernel this CPU runs on fixed random inputs and compares
+// the bits with the scalar reference: the hca_dsp sets and the dot product.
+// Build: gcc -O2 -ICommon_Headers Tests/check_simd.c Common_Source/*.c -o check_simd -pthread -lm
+#include "check.h"
+#include "hca_dsp.h"
+#include "simd.h"
+#include <string.h>
+
+// Longest run the kernels are given, with every tail length below it
+#define MAX_COUNT 136
+#define SUBFRAME_SIZE 128
+
+static void fill(float* values, unsigned count) {
+	for (unsigned i = 0; i < count; i++) {
+		values[i] = check_random_float();
+	}
+}
+
+static void check_dequantize(const HcaDsp* dsp, const HcaDsp* scalar) {
+	float gains[MAX_COUNT];
+	int32_t values[MAX_COUNT];
+	float expected[MAX_COUNT];
+	float result[MAX_COUNT];
+	for (unsigned count = 0; count <= MAX_COUNT; count++) {
+		fill(gains, count);
+		for (unsigned i = 0; i < count; i++) {
+			values[i] = (int32_t)(check_random() % 4096) - 2048;
+		}
+		scalar->dequantize(expected, gains, values, count);
+		dsp->dequantize(result, gains, values, count);
+		CHECK(memcmp(expected, result, count * sizeof(float)) == 0,
+		      "%s dequantize differs for %u values", dsp->name, count);
+	}
+}
+
+static void check_stereo(const HcaDsp* dsp, const HcaDsp* scalar) {
+	float left[2][MAX_COUNT];
+	float right[2][MAX_COUNT];
+	for (unsigned count = 0; count <= MAX_COUNT; count++) {
+		fill(left[0], count);
+		fill(right[0], count);
+		float ratio_left = check_random_float();
+		float ratio_right = check_random_float();
+
+		memcpy(left[1], left[0], sizeof(left[0]));
+		memcpy(right[1], right[0], sizeof(right[0]));
+		scalar->intensity_stereo(left[0], right[0], ratio_left, ratio_right, count);
+		dsp->intensity_stereo(left[1], right[1], ratio_left, ratio_right, count);
+		CHECK(memcmp(left[0], left[1], count * sizeof(float)) == 0 &&
+		      memcmp(right[0], right[1], count * sizeof(float)) == 0,
+		      "%s intensity_stereo differs for %u values", dsp->name, count);
+
+		scalar->mid_side_stereo(left[0], right[0], count);
+		dsp->mid_side_stereo(left[1], right[1], count);
+		CHECK(memcmp(left[0], left[1], count * sizeof(float)) == 0 &&
+		      memcmp(right[0], right[1], count * sizeof(float)) == 0,
+		      "%s mid_side_stereo differs for %u values", dsp->name, count);
+	}
+}
+
+static void check_complex_multiply(const HcaDsp* dsp, const HcaDsp* scalar) {
+	float re[2][MAX_COUNT];
+	float im[2][MAX_COUNT];
+	float w_re[MAX_COUNT];
+	float w_im[MAX_COUNT];
+	for (unsigned count = 0; count <= MAX_COUNT; count++) {
+		fill(re[0], count);
+		fill(im[0], count);
+		fill(w_re, count);
+		fill(w_im, count);
+		memcpy(re[1], re[0], sizeof(re[0]));
+		memcpy(im[1], im[0], sizeof(im[0]));
+		scalar->complex_multiply(re[0], im[0], w_re, w_im, count);
+		dsp->complex_multiply(re[1], im[1], w_re, w_im, count);
+		CHECK(memcmp(re[0], re[1], count * sizeof(float)) == 0 &&
+		      memcmp(im[0], im[1], count * sizeof(float)) == 0,
+		      "%s complex_multiply differs for %u values", dsp->name, count);
+	}
+}
+
+static void check_fft_stage(const HcaDsp* dsp, const HcaDsp* scalar) {
+	float re[2][HCA_FFT_SIZE];
+	float im[2][HCA_FFT_SIZE];
+	float tw_re[HCA_FFT_SIZE / 2];
+	float tw_im[HCA_FFT_SIZE / 2];
+	for (unsigned size = 2; size <= HCA_FFT_SIZE; size *= 2) {
+		fill(re[0], HCA_FFT_SIZE);
+		fill(im[0], HCA_FFT_SIZE);
+		fill(tw_re, size / 2);
+		fill(tw_im, size / 2);
+		memcpy(re[1], re[0], sizeof(re[0]));
+		memcpy(im[1], im[0], sizeof(im[0]));
+		scalar->fft_stage(re[0], im[0], tw_re, tw_im, size);
+		dsp->fft_stage(re[1], im[1], tw_re, tw_im, size);
+		CHECK(memcmp(re[0], re[1], sizeof(re[0])) == 0 &&
+		      memcmp(im[0], im[1], sizeof(im[0])) == 0,
+		      "%s fft_stage differs for blocks of %u", dsp->name, size);
+	}
+}
+
+static void check_imdct_window(const HcaDsp* dsp, const HcaDsp* scalar) {
+	float dct[SUBFRAME_SIZE];
+	float overlap[2][SUBFRAME_SIZE];
+	float samples[2][SUBFRAME_SIZE];
+	// A few subframes in a row, so the overlap carried over is compared too
+	fill(overlap[0], SUBFRAME_SIZE);
+	memcpy(overlap[1], overlap[0], sizeof(overlap[0]));
+	for (int subframe = 0; subframe < 8; subframe++) {
+		fill(dct, SUBFRAME_SIZE);
+		scalar->imdct_window(dct, overlap[0], samples[0]);
+		dsp->imdct_window(dct, overlap[1], samples[1]);
+		CHECK(memcmp(samples[0], samples[1], sizeof(samples[0])) == 0 &&
+		      memcmp(overlap[0], overlap[1], sizeof(overlap[0])) == 0,
+		      "%s imdct_window differs in subframe %d", dsp->name, subframe);
+	}
+}
+
+static void check_dot(SimdLevel level) {
+	SimdDot dot = simd_dot_kernel(level);
+	SimdDot scalar = simd_dot_kernel(SIMD_SCALAR);
+	float a[MAX_COUNT + 3];
+	float b[MAX_COUNT + 3];
+	fill(a, MAX_COUNT + 3);
+	fill(b, MAX_COUNT + 3);
+	// Every length, from unaligned starts as well
+	for (unsigned offset = 0; offset < 4; offset++) {
+		for (unsigned count = 0; count + offset <= MAX_COUNT + 3; count++) {
+			float expected = scalar(a + offset, b, count);
+			float result = dot(a + offset, b, count);
+			CHECK(memcmp(&expected, &result, sizeof(float)) == 0,
+			      "%s dot differs for %u values at offset %u", simd_level_name(level),
+			      count, offset);
+		}
+	}
+}
+
+int main(void) {
+	const HcaDsp* scalar = hca_dsp_kernels(SIMD_SCALAR);
+	printf("CPU level: %s\n", simd_level_name(simd_level()));
+
+	for (int level = SIMD_SCALAR + 1; level <= (int)simd_level(); level++) {
+		const HcaDsp* dsp = hca_dsp_kernels((SimdLevel)level);
+		if (!dsp) continue;
+
+		int failures = check_failures;
+		check_dequantize(dsp, scalar);
+		check_stereo(dsp, scalar);
+		check_complex_multiply(dsp, scalar);
+		check_fft_stage(dsp, scalar);
+		check_imdct_window(dsp, scalar);
+		check_dot((SimdLevel)level);
+		printf("%-6s %s\n", dsp->name, failures == check_failures ? "matches scalar" : "FAILED");
+	}
+	return check_finish();
+}
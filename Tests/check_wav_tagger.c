@@ -0,0 +1,241 @@
+// Tags WAVs with the chunk layouts found in the wild and compares every byte
+// of the result with the file the tagger should have written.
+// Build: gcc -O2 -ICommon_Headers Tests/check_wav_tagger.c Common_Source/*.c -o check_wav_tagger -pthread -lm
+#include "check.h"
+#include "wav_tagger.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_WAV_SIZE 1024
+
+typedef struct {
+	uint8_t data[MAX_WAV_SIZE];
+	size_t size;
+} Bytes;
+
+typedef struct {
+	const char* name;
+	Bytes original;
+	Bytes expected;
+} Layout;
+
+static void put_le32(uint8_t* p, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		p[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static void add(Bytes* bytes, const void* data, size_t size) {
+	memcpy(bytes->data + bytes->size, data, size);
+	bytes->size += size;
+}
+
+static void add_chunk(Bytes* bytes, const char* id, const void* body, uint32_t size,
+                      bool pad) {
+	uint8_t header[8];
+	memcpy(header, id, 4);
+	put_le32(header + 4, size);
+	add(bytes, header, sizeof(header));
+	add(bytes, body, size);
+	if (pad && (size & 1)) {
+		add(bytes, "", 1);
+	}
+}
+
+static void add_header(Bytes* bytes) {
+	static const uint8_t fmt[16] = {1, 0, 1, 0, 0x80, 0xBB, 0, 0, 0, 0x77, 1, 0, 2, 0, 16, 0};
+	add(bytes, "RIFF\0\0\0\0WAVE", 12);
+	add_chunk(bytes, "fmt ", fmt, sizeof(fmt), true);
+}
+
+static void add_audio(Bytes* bytes, uint32_t size, bool pad) {
+	uint8_t audio[256];
+	for (uint32_t i = 0; i < size; i++) {
+		audio[i] = (uint8_t)(i * 7 + 1);
+	}
+	add_chunk(bytes, "data", audio, size, pad);
+}
+
+static void add_smpl(Bytes* bytes) {
+	uint8_t smpl[36] = {0};
+	add_chunk(bytes, "smpl", smpl, sizeof(smpl), true);
+}
+
+// The INFO list exactly as wav_tag_file has to write it
+static void add_info(Bytes* bytes, const WavTags* tags) {
+	const char* ids[] = {"INAM", "IPRD", "IART", "IGNR", "ITRK"};
+	const char* texts[] = {tags->title, tags->album, tags->artist, tags->genre, tags->track};
+	Bytes list = {{0}, 0};
+	add(&list, "INFO", 4);
+	for (int i = 0; i < 5; i++) {
+		if (texts[i]) {
+			add_chunk(&list, ids[i], texts[i], (uint32_t)strlen(texts[i]) + 1, true);
+		}
+	}
+	add_chunk(bytes, "LIST", list.data, (uint32_t)list.size, true);
+}
+
+static void finish(Bytes* bytes) {
+	put_le32(bytes->data + 4, (uint32_t)bytes->size - 8);
+}
+
+static bool write_file(const char* path, const Bytes* bytes) {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	bool written = fwrite(bytes->data, 1, bytes->size, file) == bytes->size;
+	return fclose(file) == 0 && written;
+}
+
+static bool read_file(const char* path, Bytes* bytes) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	bytes->size = fread(bytes->data, 1, sizeof(bytes->data), file);
+	fclose(file);
+	return true;
+}
+
+static bool file_is(const char* path, const Bytes* expected) {
+	Bytes bytes;
+	return read_file(path, &bytes) && bytes.size == expected->size &&
+	       memcmp(bytes.data, expected->data, bytes.size) == 0;
+}
+
+int main(void) {
+	const WavTags old_tags = {NULL, "An older and longer title", "bgm", NULL, "Voice", "12"};
+	const WavTags same_size = {NULL, "Cue 34", "bgm", NULL, "Voice", "4"};
+	const WavTags tags = {NULL, "Cue 12", "bgm", NULL, "Voice", "3"};
+	static Layout layouts[9];
+	int count = 0;
+	Layout* layout;
+
+	layout = &layouts[count++];
+	layout->name = "fmt and data";
+	add_header(&layout->original);
+	add_audio(&layout->original, 100, true);
+	layout->expected = layout->original;
+	add_info(&layout->expected, &tags);
+
+	layout = &layouts[count++];
+	layout->name = "odd data with its padding";
+	add_header(&layout->original);
+	add_audio(&layout->original, 101, true);
+	layout->expected = layout->original;
+	add_info(&layout->expected, &tags);
+
+	// The list has to start on an even offset, the missing padding is added
+	layout = &layouts[count++];
+	layout->name = "odd data without its padding";
+	add_header(&layout->original);
+	add_audio(&layout->original, 101, false);
+	layout->expected = layout->original;
+	add(&layout->expected, "", 1);
+	add_info(&layout->expected, &tags);
+
+	layout = &layouts[count++];
+	layout->name = "unpadded odd data before smpl";
+	add_header(&layout->original);
+	add_audio(&layout->original, 101, false);
+	add_smpl(&layout->original);
+	layout->expected = layout->original;
+	add(&layout->expected, "", 1);
+	add_info(&layout->expected, &tags);
+
+	layout = &layouts[count++];
+	layout->name = "smpl after data";
+	add_header(&layout->original);
+	add_audio(&layout->original, 100, true);
+	add_smpl(&layout->original);
+	layout->expected = layout->original;
+	add_info(&layout->expected, &tags);
+
+	// A longer list at the end is rewritten where it is and the file cut short
+	layout = &layouts[count++];
+	layout->name = "longer INFO at the end";
+	add_header(&layout->original);
+	add_audio(&layout->original, 100, true);
+	layout->expected = layout->original;
+	add_info(&layout->original, &old_tags);
+	add_info(&layout->expected, &tags);
+
+	// One elsewhere becomes JUNK and the new one goes after the last chunk
+	layout = &layouts[count++];
+	layout->name = "INFO before data";
+	add_header(&layout->original);
+	size_t info_offset = layout->original.size;
+	add_info(&layout->original, &old_tags);
+	add_audio(&layout->original, 100, true);
+	layout->expected = layout->original;
+	memcpy(layout->expected.data + info_offset, "JUNK", 4);
+	add_info(&layout->expected, &tags);
+
+	layout = &layouts[count++];
+	layout->name = "same size INFO before data";
+	add_header(&layout->original);
+	add_info(&layout->original, &same_size);
+	add_audio(&layout->original, 100, true);
+	add_header(&layout->expected);
+	add_info(&layout->expected, &tags);
+	add_audio(&layout->expected, 100, true);
+
+	layout = &layouts[count++];
+	layout->name = "INFO between data and smpl";
+	add_header(&layout->original);
+	add_audio(&layout->original, 100, true);
+	info_offset = layout->original.size;
+	add_info(&layout->original, &old_tags);
+	add_smpl(&layout->original);
+	layout->expected = layout->original;
+	memcpy(layout->expected.data + info_offset, "JUNK", 4);
+	add_info(&layout->expected, &tags);
+
+	char paths[9][32];
+	WavTags files[9];
+	for (int i = 0; i < count; i++) {
+		finish(&layouts[i].original);
+		finish(&layouts[i].expected);
+		snprintf(paths[i], sizeof(paths[i]), "check_wav_tagger_%d.wav", i);
+		files[i] = tags;
+		files[i].path = paths[i];
+
+		bool written = write_file(paths[i], &layouts[i].original);
+		int result = written ? wav_tag_file(&files[i]) : WAV_TAG_WRITE_FAILED;
+		CHECK(result == 0 && file_is(paths[i], &layouts[i].expected),
+		      "%s: tagged wrong (result %d)", layouts[i].name, result);
+	}
+
+	// Tagging again with the same tags rewrites the list in place, unchanged
+	CHECK(wav_tag_files(files, count, 0) == 0, "wav_tag_files failed");
+	for (int i = 0; i < count; i++) {
+		CHECK(file_is(paths[i], &layouts[i].expected), "%s: tagging twice changed it",
+		      layouts[i].name);
+	}
+
+	// Files the tagger must refuse are left alone
+	Bytes refused[2] = {{{0}, 0}, {{0}, 0}};
+	add_header(&refused[0]);
+	add_audio(&refused[0], 100, true);
+	finish(&refused[0]);
+	memcpy(refused[0].data, "RF64", 4);
+	add_header(&refused[1]);
+	add_audio(&refused[1], 100, true);
+	finish(&refused[1]);
+	refused[1].size -= 10; // data cut short
+	for (int i = 0; i < 2; i++) {
+		WavTags bad = tags;
+		bad.path = paths[i];
+		bool written = write_file(paths[i], &refused[i]);
+		CHECK(written && wav_tag_file(&bad) == WAV_TAG_BAD_INPUT &&
+		      file_is(paths[i], &refused[i]),
+		      "%s was not refused", i == 0 ? "RF64" : "a cut short WAV");
+	}
+
+	for (int i = 0; i < count; i++) {
+		remove(paths[i]);
+	}
+	return check_finish();
+}